@@ -6,6 +6,8 @@
 
 enum {
 	DEFAULT_CAPACITY = 1 << 14, //16kb
+	BLOCK_HEADER = sizeof(char *),
+	OBJECT_ALIGN = 8,
 };
 
 struct Allocator init_allocator() {
@@ -17,26 +19,43 @@ struct Allocator init_allocator() {
 	if (!allocator.mem)
 		errx("out of memory: failed to allocate %d bytes", allocator.capacity);
 
-	allocator.index = 0;
+	*(char **)allocator.mem = NULL;
+	allocator.index = BLOCK_HEADER;
 	return allocator;
 }
 
 void free_allocator(struct Allocator *allocator) {
-	free(allocator->mem);
+	char *block = allocator->mem;
+
+	while (block) {
+		char *previous = *(char **)block;
+		free(block);
+		block = previous;
+	}
+
+	allocator->mem = NULL;
 	allocator->capacity = 0;
 	allocator->index = 0;
 }
 
 void
 expand_allocator(struct Allocator *allocator, int size) {
-	// capacity = next power of 2 greater than minimum
-	allocator->capacity = allocator->index + size;
-	allocator->capacity = 0x80000000 >> (__builtin_clz(allocator->capacity) - 1);
-	allocator->mem = realloc(allocator->mem, allocator->capacity);
+	// start a new block instead of reallocating, so that nodes already
+	// handed out are never moved: capacity = next power of 2 that fits
+	int capacity = max(allocator->capacity, BLOCK_HEADER + size);
+	capacity = 0x80000000 >> (__builtin_clz(capacity) - 1);
 
-	if (!allocator->mem) {
-		errx("out of memory: failed to allocate %d bytes", allocator->capacity);
+	char *block = malloc(capacity);
+
+	if (!block) {
+		errx("out of memory: failed to allocate %d bytes", capacity);
 	}
+
+	*(char **)block = allocator->mem;
+
+	allocator->mem = block;
+	allocator->capacity = capacity;
+	allocator->index = BLOCK_HEADER;
 }
 
 char *store_string(struct Allocator *allocator, const char *mem, int length) {
@@ -53,6 +72,8 @@ char *store_string(struct Allocator *allocator, const char *mem, int length) {
 
 
 void *store_object(struct Allocator *allocator, const void *mem, int size) {
+	allocator->index = (allocator->index + OBJECT_ALIGN - 1) & -OBJECT_ALIGN;
+
 	if  (allocator->capacity - allocator->index < size)
 		expand_allocator(allocator, size);
 
@@ -62,3 +83,16 @@ void *store_object(struct Allocator *allocator, const void *mem, int size) {
 	allocator->index += size;
 	return dst;
 }
+
+void *allocate_object(struct Allocator *allocator, int size) {
+	allocator->index = (allocator->index + OBJECT_ALIGN - 1) & -OBJECT_ALIGN;
+
+	if  (allocator->capacity - allocator->index < size)
+		expand_allocator(allocator, size);
+
+	void *dst = &allocator->mem[allocator->index];
+	memset(dst, 0, size);
+
+	allocator->index += size;
+	return dst;
+}
@@ -1,6 +1,8 @@
 #ifndef ALLOC_H_
 #define ALLOC_H_
 
+// arena of chained blocks: pointers returned by store_* stay valid until
+// free_allocator, the first word of each block links to the previous one
 struct Allocator {
 	char *mem;
 	int index;
@@ -10,6 +12,7 @@ struct Allocator {
 struct Allocator init_allocator();
 char *store_string(struct Allocator *, const char *, int);
 void *store_object(struct Allocator *, const void *, int);
+void *allocate_object(struct Allocator *, int); // zeroed
 void free_allocator(struct Allocator *);
 
 #endif //ALLOC_H_
@@ -0,0 +1,743 @@
+#include "assembler.h"
+
+#include "ast.h"
+#include "tokens.h"
+#include "util.h"
+#include "writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct Fixup {
+	int offset; // of a rel32
+	int label;
+	int base;   // what the label is relative to: the end of the instruction, or a table
+};
+
+void init_assembler(struct Assembler *a, struct Writer *out) {
+	*a = (struct Assembler) {
+		.out = out,
+		.code = vec(uint8_t),
+		.relocations = vec(struct Relocation),
+		.functions = vec(struct CodeSymbol),
+		.labels = vec(int),
+		.fixups = vec(struct Fixup),
+	};
+
+	init_literal_pool(&a->strings);
+}
+
+void free_assembler(struct Assembler *a) {
+	vec_free(&a->code);
+	vec_free(&a->relocations);
+	vec_free(&a->functions);
+	free_literal_pool(&a->strings);
+	vec_free(&a->labels);
+	vec_free(&a->fixups);
+}
+
+struct Operand string_operand(struct Assembler *a, struct Token *token) {
+	int id = add_literal(&a->strings, token->text, token->length);
+	return (struct Operand) { .kind = OPERAND_SYMBOL, .target = TARGET_STRING, .string = id };
+}
+
+
+// text
+
+static const char *const register_names[16][4] = {
+	{ "%rax", "%eax",  "%ax",   "%al"   },
+	{ "%rcx", "%ecx",  "%cx",   "%cl"   },
+	{ "%rdx", "%edx",  "%dx",   "%dl"   },
+	{ "%rbx", "%ebx",  "%bx",   "%bl"   },
+	{ "%rsp", "%esp",  "%sp",   "%spl"  },
+	{ "%rbp", "%ebp",  "%bp",   "%bpl"  },
+	{ "%rsi", "%esi",  "%si",   "%sil"  },
+	{ "%rdi", "%edi",  "%di",   "%dil"  },
+	{ "%r8",  "%r8d",  "%r8w",  "%r8b"  },
+	{ "%r9",  "%r9d",  "%r9w",  "%r9b"  },
+	{ "%r10", "%r10d", "%r10w", "%r10b" },
+	{ "%r11", "%r11d", "%r11w", "%r11b" },
+	{ "%r12", "%r12d", "%r12w", "%r12b" },
+	{ "%r13", "%r13d", "%r13w", "%r13b" },
+	{ "%r14", "%r14d", "%r14w", "%r14b" },
+	{ "%r15", "%r15d", "%r15w", "%r15b" },
+};
+
+static const char *const mnemonic_names[] = {
+	[I_MOV] = "mov", [I_MOVZB] = "movzb", [I_MOVZW] = "movzw", [I_MOVSLQ] = "movslq", [I_LEA] = "lea",
+	[I_ADD] = "add", [I_OR] = "or", [I_AND] = "and", [I_SUB] = "sub", [I_XOR] = "xor",
+	[I_CMP] = "cmp", [I_TEST] = "test", [I_IMUL] = "imul", [I_BT] = "bt",
+	[I_SHL] = "shl", [I_SHR] = "shr", [I_SAR] = "sar", [I_ROL] = "rol",
+	[I_BSF] = "bsf", [I_BSR] = "bsr", [I_LZCNT] = "lzcnt", [I_TZCNT] = "tzcnt", [I_POPCNT] = "popcnt",
+	[I_NEG] = "neg", [I_NOT] = "not", [I_DIV] = "div", [I_IDIV] = "idiv", [I_BSWAP] = "bswap",
+	[I_PREFETCHT0] = "prefetcht0",
+	[I_PUSH] = "push", [I_POP] = "pop",
+	[I_CLTD] = "cltd", [I_LEAVE] = "leave", [I_RET] = "ret", [I_UD2] = "ud2", [I_REP_STOSB] = "rep stosb",
+
+	[I_MOVD] = "movd", [I_MOVDQA] = "movdqa", [I_MOVDQU] = "movdqu",
+	[I_PADDB] = "paddb", [I_PADDD] = "paddd", [I_PSUBB] = "psubb", [I_PSUBD] = "psubd", [I_PMULUDQ] = "pmuludq",
+	[I_PAND] = "pand", [I_POR] = "por", [I_PXOR] = "pxor",
+	[I_PCMPEQB] = "pcmpeqb", [I_PCMPEQD] = "pcmpeqd", [I_PCMPGTB] = "pcmpgtb", [I_PCMPGTD] = "pcmpgtd",
+	[I_PSLLD] = "pslld", [I_PSRLD] = "psrld", [I_PSRLQ] = "psrlq",
+	[I_PUNPCKLDQ] = "punpckldq", [I_PSHUFB] = "pshufb", [I_PSHUFD] = "pshufd",
+	[I_PMOVMSKB] = "pmovmskb", [I_MOVMSKPS] = "movmskps",
+};
+
+static const char *const condition_names[] = {
+	[CC_B] = "b", [CC_AE] = "ae", [CC_E] = "e", [CC_NE] = "ne", [CC_BE] = "be", [CC_A] = "a",
+	[CC_L] = "l", [CC_GE] = "ge", [CC_LE] = "le", [CC_G] = "g",
+};
+
+static
+char suffix(int size) {
+	switch (size) {
+		case 1:  return 'b';
+		case 2:  return 'w';
+		case 4:  return 'l';
+		default: return 'q';
+	}
+}
+
+static
+const char *register_name(enum Register r, int size) {
+	switch (size) {
+		case 1:  return register_names[r][3];
+		case 2:  return register_names[r][2];
+		case 4:  return register_names[r][1];
+		default: return register_names[r][0];
+	}
+}
+
+static
+char *format_operand(struct Assembler *a, struct Operand operand, int size, char *buffer) {
+	switch (operand.kind) {
+		case OPERAND_REGISTER:
+			snprintf(buffer, 64, "%s", register_name(operand.reg, size));
+			break;
+
+		case OPERAND_IMMEDIATE:
+			snprintf(buffer, 64, "$%lld", (long long)operand.value);
+			break;
+
+		case OPERAND_MEMORY:
+			if (operand.scale) {
+				snprintf(buffer, 64, "%lld(%s,%s,%d)", (long long)operand.value, register_names[operand.reg][0],
+				         register_names[operand.index][0], operand.scale);
+			} else {
+				snprintf(buffer, 64, "%lld(%s)", (long long)operand.value, register_names[operand.reg][0]);
+			}
+			break;
+
+		case OPERAND_LABEL:
+			snprintf(buffer, 64, ".L%d(%%rip)", (int)operand.value);
+			break;
+
+		case OPERAND_VECTOR:
+			snprintf(buffer, 64, "%%xmm%d", operand.reg);
+			break;
+
+		case OPERAND_SYMBOL:
+			if (operand.target == TARGET_STRING) snprintf(buffer, 64, ".LS%d(%%rip)", operand.string);
+			else if (operand.value) snprintf(buffer, 64, "%s%+lld(%%rip)", ((struct AST_Declaration *)operand.symbol)->token->text, (long long)operand.value);
+			else snprintf(buffer, 64, "%s(%%rip)", ((struct AST_Declaration *)operand.symbol)->token->text);
+			break;
+	}
+
+	(void)a;
+	return buffer;
+}
+
+
+// machine code
+
+static
+void put_byte(struct Assembler *a, uint8_t byte) {
+	vec_push(&a->code, &byte);
+}
+
+static
+void put_bytes(struct Assembler *a, uint64_t value, int count) {
+	for (int i = 0; i < count; i++) put_byte(a, value >> (8 * i));
+}
+
+static
+void patch32(struct Assembler *a, int offset, uint32_t value) {
+	uint8_t *code = a->code.mem;
+	for (int i = 0; i < 4; i++) code[offset + i] = value >> (8 * i);
+}
+
+static
+bool fits8(int64_t value) {
+	return value >= -128 && value <= 127;
+}
+
+// which operands are byte registers: %spl to %dil need a REX prefix to be
+// told from %ah to %bh
+enum {
+	BYTE_FIELD = 1,
+	BYTE_RM = 2,
+	BYTES = BYTE_FIELD | BYTE_RM,
+};
+
+// prefixes, opcode, ModRM and whatever addressing needs for an instruction
+// with a register field (a register or an opcode extension) and an r/m
+// operand. the immediate that follows is counted so that rip-relative
+// displacements can be made relative to the next instruction
+static
+void encode(struct Assembler *a, int size, int bytes, const uint8_t *opcode, int opcode_length,
+            int field, struct Operand rm, int immediate_bytes) {
+	int base = rm.kind == OPERAND_REGISTER || rm.kind == OPERAND_VECTOR || rm.kind == OPERAND_MEMORY ? rm.reg : 0;
+	int index = rm.kind == OPERAND_MEMORY && rm.scale ? rm.index : 0;
+	uint8_t rex = 0x40 | (size == 8) << 3 | (field >> 3 & 1) << 2 | (index >> 3 & 1) << 1 | (base >> 3 & 1);
+
+	bool byte_register = ((bytes & BYTE_FIELD) && field >= 4 && field < 8) ||
+	                     ((bytes & BYTE_RM) && rm.kind == OPERAND_REGISTER && rm.reg >= 4 && rm.reg < 8);
+
+	if (size == 2) put_byte(a, 0x66);
+	if (rex != 0x40 || byte_register) put_byte(a, rex);
+	for (int i = 0; i < opcode_length; i++) put_byte(a, opcode[i]);
+
+	uint8_t reg = (field & 7) << 3;
+
+	switch (rm.kind) {
+		case OPERAND_REGISTER:
+		case OPERAND_VECTOR:
+			put_byte(a, 0xc0 | reg | (rm.reg & 7));
+			break;
+
+		case OPERAND_MEMORY: {
+			// %rbp and %r13 have no form without displacement, %rsp and %r12 need a SIB byte
+			int mode = (rm.value == 0 && (rm.reg & 7) != RBP) ? 0 : fits8(rm.value) ? 1 : 2;
+
+			if (rm.scale) {
+				put_byte(a, mode << 6 | reg | 4);
+				put_byte(a, __builtin_ctz(rm.scale) << 6 | (rm.index & 7) << 3 | (rm.reg & 7));
+			} else {
+				put_byte(a, mode << 6 | reg | (rm.reg & 7));
+				if ((rm.reg & 7) == RSP) put_byte(a, 0x24);
+			}
+
+			if (mode == 1) put_bytes(a, rm.value, 1);
+			if (mode == 2) put_bytes(a, rm.value, 4);
+			break;
+		}
+
+		case OPERAND_SYMBOL: {
+			put_byte(a, reg | 5);
+
+			struct Relocation relocation = {
+				.offset = a->code.length,
+				.type = RELOCATION_PC32,
+				.kind = rm.target,
+				.symbol = rm.symbol,
+				.string = rm.string,
+				.addend = rm.value - 4 - immediate_bytes,
+			};
+
+			vec_push(&a->relocations, &relocation);
+			put_bytes(a, 0, 4);
+			break;
+		}
+
+		case OPERAND_LABEL: {
+			put_byte(a, reg | 5);
+
+			struct Fixup fixup = { a->code.length, rm.value, a->code.length + 4 + immediate_bytes };
+			vec_push(&a->fixups, &fixup);
+			put_bytes(a, 0, 4);
+			break;
+		}
+
+		case OPERAND_IMMEDIATE:
+			assert(0 && "unreachable");
+	}
+}
+
+#define OPCODE(...) (const uint8_t[]) { __VA_ARGS__ }, sizeof((const uint8_t[]) { __VA_ARGS__ })
+
+// add, or, and, sub, xor and cmp share one pattern, by extension
+static
+int alu_extension(enum Mnemonic mnemonic) {
+	switch (mnemonic) {
+		case I_ADD: return 0;
+		case I_OR:  return 1;
+		case I_AND: return 4;
+		case I_SUB: return 5;
+		case I_XOR: return 6;
+		case I_CMP: return 7;
+
+		// shifts
+		case I_ROL: return 0;
+		case I_SHL: return 4;
+		case I_SHR: return 5;
+		case I_SAR: return 7;
+
+		// unary, 0xf7
+		case I_NOT:  return 2;
+		case I_NEG:  return 3;
+		case I_DIV:  return 6;
+		case I_IDIV: return 7;
+
+		default:
+			assert(0 && "unreachable");
+			return 0;
+	}
+}
+
+static
+int immediate_size(int size) {
+	return size == 8 ? 4 : size;
+}
+
+static
+void encode_binary(struct Assembler *a, enum Mnemonic mnemonic, int size, struct Operand src, struct Operand dst) {
+	int bytes = size == 1 ? BYTES : 0;
+	int byte_rm = size == 1 ? BYTE_RM : 0;
+	uint8_t wide = size != 1;
+
+	switch (mnemonic) {
+		case I_MOV:
+			if (src.kind == OPERAND_IMMEDIATE && dst.kind == OPERAND_REGISTER && size == 4) {
+				if (dst.reg >= 8) put_byte(a, 0x41);
+				put_byte(a, 0xb8 + (dst.reg & 7));
+				put_bytes(a, src.value, 4);
+			} else if (src.kind == OPERAND_IMMEDIATE) {
+				encode(a, size, byte_rm, OPCODE(0xc6 | wide), 0, dst, immediate_size(size));
+				put_bytes(a, src.value, immediate_size(size));
+			} else if (src.kind == OPERAND_REGISTER) {
+				encode(a, size, bytes, OPCODE(0x88 | wide), src.reg, dst, 0);
+			} else {
+				encode(a, size, bytes, OPCODE(0x8a | wide), dst.reg, src, 0);
+			}
+
+			break;
+
+		case I_MOVZB:
+			encode(a, size, BYTE_RM, OPCODE(0x0f, 0xb6), dst.reg, src, 0);
+			break;
+
+		case I_MOVZW:
+			encode(a, size, 0, OPCODE(0x0f, 0xb7), dst.reg, src, 0);
+			break;
+
+		case I_MOVSLQ:
+			encode(a, 8, 0, OPCODE(0x63), dst.reg, src, 0);
+			break;
+
+		case I_LEA:
+			encode(a, 8, 0, OPCODE(0x8d), dst.reg, src, 0);
+			break;
+
+		case I_ADD: case I_OR: case I_AND: case I_SUB: case I_XOR: case I_CMP: {
+			int extension = alu_extension(mnemonic);
+
+			if (src.kind == OPERAND_IMMEDIATE) {
+				if (size == 1) {
+					encode(a, size, byte_rm, OPCODE(0x80), extension, dst, 1);
+					put_bytes(a, src.value, 1);
+				} else if (fits8(src.value)) {
+					encode(a, size, 0, OPCODE(0x83), extension, dst, 1);
+					put_bytes(a, src.value, 1);
+				} else {
+					encode(a, size, 0, OPCODE(0x81), extension, dst, immediate_size(size));
+					put_bytes(a, src.value, immediate_size(size));
+				}
+			} else if (src.kind == OPERAND_REGISTER) {
+				encode(a, size, bytes, OPCODE(extension << 3 | wide), src.reg, dst, 0);
+			} else {
+				encode(a, size, bytes, OPCODE(extension << 3 | 2 | wide), dst.reg, src, 0);
+			}
+
+			break;
+		}
+
+		case I_TEST:
+			encode(a, size, bytes, OPCODE(0x84 | wide), src.reg, dst, 0);
+			break;
+
+		// the bit offset is the source
+		case I_BT:
+			encode(a, size, 0, OPCODE(0x0f, 0xa3), src.reg, dst, 0);
+			break;
+
+		case I_IMUL:
+			if (src.kind == OPERAND_IMMEDIATE && fits8(src.value)) {
+				encode(a, size, 0, OPCODE(0x6b), dst.reg, dst, 1);
+				put_bytes(a, src.value, 1);
+			} else if (src.kind == OPERAND_IMMEDIATE) {
+				encode(a, size, 0, OPCODE(0x69), dst.reg, dst, 4);
+				put_bytes(a, src.value, 4);
+			} else {
+				encode(a, size, 0, OPCODE(0x0f, 0xaf), dst.reg, src, 0);
+			}
+
+			break;
+
+		// by an immediate, or by %cl
+		case I_SHL: case I_SHR: case I_SAR: case I_ROL:
+			if (src.kind == OPERAND_IMMEDIATE) {
+				encode(a, size, byte_rm, OPCODE(0xc0 | wide), alu_extension(mnemonic), dst, 1);
+				put_bytes(a, src.value, 1);
+			} else {
+				encode(a, size, byte_rm, OPCODE(0xd2 | wide), alu_extension(mnemonic), dst, 0);
+			}
+
+			break;
+
+		// lzcnt, tzcnt and popcnt are bsr, bsf and an unused opcode behind a prefix
+		case I_BSF: case I_BSR: case I_LZCNT: case I_TZCNT: case I_POPCNT: {
+			uint8_t opcode = mnemonic == I_POPCNT ? 0xb8 : (mnemonic == I_BSF || mnemonic == I_TZCNT) ? 0xbc : 0xbd;
+
+			if (mnemonic == I_LZCNT || mnemonic == I_TZCNT || mnemonic == I_POPCNT) put_byte(a, 0xf3);
+			encode(a, size, 0, OPCODE(0x0f, opcode), dst.reg, src, 0);
+			break;
+		}
+
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+
+// instructions
+
+void emit_binary(struct Assembler *a, enum Mnemonic mnemonic, int size, struct Operand src, struct Operand dst) {
+	if (a->out == NULL) {
+		encode_binary(a, mnemonic, size, src, dst);
+		return;
+	}
+
+	// the source of a widening move has its own size
+	int src_size = size;
+	const char *name = mnemonic_names[mnemonic];
+	char buffer[2][64];
+
+	switch (mnemonic) {
+		case I_MOVZB:  src_size = 1; break;
+		case I_MOVZW:  src_size = 2; break;
+		case I_MOVSLQ: src_size = 4; break;
+
+		case I_SHL: case I_SHR: case I_SAR: case I_ROL:
+			if (src.kind == OPERAND_REGISTER) src_size = 1;
+			break;
+
+		default:
+			break;
+	}
+
+	if (mnemonic == I_MOVSLQ) {
+		write_format(a->out, "\t%s %s, %s\n", name,
+		             format_operand(a, src, src_size, buffer[0]), format_operand(a, dst, size, buffer[1]));
+		return;
+	}
+
+	write_format(a->out, "\t%s%c %s, %s\n", name, suffix(size),
+	             format_operand(a, src, src_size, buffer[0]), format_operand(a, dst, size, buffer[1]));
+}
+
+void emit_unary(struct Assembler *a, enum Mnemonic mnemonic, int size, struct Operand operand) {
+	if (a->out) {
+		char buffer[64], suffixes[2] = { suffix(size) };
+		if (mnemonic == I_PREFETCHT0) suffixes[0] = 0;
+
+		write_format(a->out, "\t%s%s %s\n", mnemonic_names[mnemonic], suffixes, format_operand(a, operand, size, buffer));
+		return;
+	}
+
+	switch (mnemonic) {
+		case I_PUSH: case I_POP:
+			if (operand.reg >= 8) put_byte(a, 0x41);
+			put_byte(a, (mnemonic == I_PUSH ? 0x50 : 0x58) + (operand.reg & 7));
+			break;
+
+		case I_NEG: case I_NOT: case I_DIV: case I_IDIV:
+			encode(a, size, size == 1 ? BYTE_RM : 0, OPCODE(size == 1 ? 0xf6 : 0xf7), alu_extension(mnemonic), operand, 0);
+			break;
+
+		case I_BSWAP:
+			if (operand.reg >= 8 || size == 8) put_byte(a, 0x40 | (size == 8) << 3 | (operand.reg >= 8));
+			put_byte(a, 0x0f);
+			put_byte(a, 0xc8 + (operand.reg & 7));
+			break;
+
+		case I_PREFETCHT0:
+			encode(a, 4, 0, OPCODE(0x0f, 0x18), 1, operand, 0);
+			break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+void emit_plain(struct Assembler *a, enum Mnemonic mnemonic) {
+	if (a->out) {
+		write_format(a->out, "\t%s\n", mnemonic_names[mnemonic]);
+		return;
+	}
+
+	switch (mnemonic) {
+		case I_CLTD:  put_byte(a, 0x99); break;
+		case I_LEAVE: put_byte(a, 0xc9); break;
+		case I_RET:   put_byte(a, 0xc3); break;
+
+		case I_UD2:
+			put_byte(a, 0x0f);
+			put_byte(a, 0x0b);
+			break;
+
+		case I_REP_STOSB:
+			put_byte(a, 0xf3);
+			put_byte(a, 0xaa);
+			break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+// the mandatory prefix goes before rex, the register field is the
+// destination unless that is memory or a general register
+static
+void encode_vector(struct Assembler *a, enum Mnemonic mnemonic, struct Operand src, struct Operand dst) {
+	bool load = dst.kind == OPERAND_VECTOR;
+
+	switch (mnemonic) {
+		case I_MOVD:
+			put_byte(a, 0x66);
+			if (load) encode(a, 4, 0, OPCODE(0x0f, 0x6e), dst.reg, src, 0);
+			else      encode(a, 4, 0, OPCODE(0x0f, 0x7e), src.reg, dst, 0);
+			break;
+
+		case I_MOVDQU:
+			put_byte(a, 0xf3);
+			if (load) encode(a, 4, 0, OPCODE(0x0f, 0x6f), dst.reg, src, 0);
+			else      encode(a, 4, 0, OPCODE(0x0f, 0x7f), src.reg, dst, 0);
+			break;
+
+		case I_PMOVMSKB:
+			put_byte(a, 0x66);
+			encode(a, 4, 0, OPCODE(0x0f, 0xd7), dst.reg, src, 0);
+			break;
+
+		case I_MOVMSKPS:
+			encode(a, 4, 0, OPCODE(0x0f, 0x50), dst.reg, src, 0);
+			break;
+
+		case I_PSHUFB:
+			put_byte(a, 0x66);
+			encode(a, 4, 0, OPCODE(0x0f, 0x38, 0x00), dst.reg, src, 0);
+			break;
+
+		// by an immediate the shift is an extension of one opcode
+		case I_PSLLD: case I_PSRLD: case I_PSRLQ:
+			if (src.kind == OPERAND_IMMEDIATE) {
+				int extension = mnemonic == I_PSLLD ? 6 : 2;
+
+				put_byte(a, 0x66);
+				encode(a, 4, 0, OPCODE(0x0f, mnemonic == I_PSRLQ ? 0x73 : 0x72), extension, dst, 1);
+				put_byte(a, src.value);
+				break;
+			}
+
+			// fallthrough
+		default: {
+			static const uint8_t opcodes[] = {
+				[I_MOVDQA] = 0x6f,
+				[I_PADDB] = 0xfc, [I_PADDD] = 0xfe, [I_PSUBB] = 0xf8, [I_PSUBD] = 0xfa, [I_PMULUDQ] = 0xf4,
+				[I_PAND] = 0xdb, [I_POR] = 0xeb, [I_PXOR] = 0xef,
+				[I_PCMPEQB] = 0x74, [I_PCMPEQD] = 0x76, [I_PCMPGTB] = 0x64, [I_PCMPGTD] = 0x66,
+				[I_PSLLD] = 0xf2, [I_PSRLD] = 0xd2, [I_PSRLQ] = 0xd3,
+				[I_PUNPCKLDQ] = 0x62,
+			};
+
+			assert(mnemonic < sizeof opcodes && opcodes[mnemonic]);
+			put_byte(a, 0x66);
+			encode(a, 4, 0, OPCODE(0x0f, opcodes[mnemonic]), dst.reg, src, 0);
+			break;
+		}
+	}
+}
+
+void emit_vector(struct Assembler *a, enum Mnemonic mnemonic, struct Operand src, struct Operand dst) {
+	if (a->out) {
+		char buffer[2][64];
+		write_format(a->out, "\t%s %s, %s\n", mnemonic_names[mnemonic],
+		             format_operand(a, src, 4, buffer[0]), format_operand(a, dst, 4, buffer[1]));
+		return;
+	}
+
+	encode_vector(a, mnemonic, src, dst);
+}
+
+void emit_shuffle(struct Assembler *a, int order, struct Operand src, struct Operand dst) {
+	if (a->out) {
+		char buffer[2][64];
+		write_format(a->out, "\tpshufd $%d, %s, %s\n", order,
+		             format_operand(a, src, 4, buffer[0]), format_operand(a, dst, 4, buffer[1]));
+		return;
+	}
+
+	put_byte(a, 0x66);
+	encode(a, 4, 0, OPCODE(0x0f, 0x70), dst.reg, src, 1);
+	put_byte(a, order);
+}
+
+void emit_move_if(struct Assembler *a, enum ConditionCode condition, int size, struct Operand src, struct Operand dst) {
+	if (a->out) {
+		char buffer[2][64];
+		write_format(a->out, "\tcmov%s %s, %s\n", condition_names[condition],
+		             format_operand(a, src, size, buffer[0]), format_operand(a, dst, size, buffer[1]));
+		return;
+	}
+
+	encode(a, size, 0, OPCODE(0x0f, 0x40 + condition), dst.reg, src, 0);
+}
+
+void emit_set(struct Assembler *a, enum ConditionCode condition, enum Register r) {
+	if (a->out) {
+		write_format(a->out, "\tset%s %s\n", condition_names[condition], register_name(r, 1));
+		return;
+	}
+
+	encode(a, 1, BYTE_RM, OPCODE(0x0f, 0x90 + condition), 0, reg(r), 0);
+}
+
+void emit_jump(struct Assembler *a, enum ConditionCode condition, int label) {
+	if (a->out) {
+		write_format(a->out, "\tj%s .L%d\n", condition == CC_ALWAYS ? "mp" : condition_names[condition], label);
+		return;
+	}
+
+	if (condition == CC_ALWAYS) {
+		put_byte(a, 0xe9);
+	} else {
+		put_byte(a, 0x0f);
+		put_byte(a, 0x80 + condition);
+	}
+
+	struct Fixup fixup = { a->code.length, label, a->code.length + 4 };
+	vec_push(&a->fixups, &fixup);
+	put_bytes(a, 0, 4);
+}
+
+void emit_jump_register(struct Assembler *a, enum Register r) {
+	if (a->out) {
+		write_format(a->out, "	jmp *%s\n", register_name(r, 8));
+		return;
+	}
+
+	encode(a, 4, 0, OPCODE(0xff), 4, reg(r), 0);
+}
+
+void emit_call(struct Assembler *a, struct AST_Declaration *decl) {
+	if (a->out) {
+		write_format(a->out, "\tcall %s@PLT\n", decl->token->text);
+		return;
+	}
+
+	put_byte(a, 0xe8);
+
+	struct Relocation relocation = {
+		.offset = a->code.length,
+		.type = RELOCATION_PLT32,
+		.kind = TARGET_FUNCTION,
+		.symbol = decl,
+		.addend = -4,
+	};
+
+	vec_push(&a->relocations, &relocation);
+	put_bytes(a, 0, 4);
+}
+
+
+// labels and functions
+
+int new_label(struct Assembler *a) {
+	int unplaced = -1;
+	vec_push(&a->labels, &unplaced);
+	return a->labels.length - 1;
+}
+
+void place_label(struct Assembler *a, int label) {
+	if (a->out) {
+		write_format(a->out, ".L%d:\n", label);
+		return;
+	}
+
+	((int *)a->labels.mem)[label] = a->code.length;
+}
+
+void emit_table(struct Assembler *a, int label, const int *targets, int count) {
+	if (a->out) {
+		write_format(a->out, "\t.p2align 2\n");
+		place_label(a, label);
+
+		for (int i = 0; i < count; i++) write_format(a->out, "\t.long .L%d-.L%d\n", targets[i], label);
+		return;
+	}
+
+	// nothing falls into a table, the padding traps
+	while (a->code.length % 4) put_byte(a, 0xcc);
+	place_label(a, label);
+
+	for (int i = 0; i < count; i++) {
+		struct Fixup fixup = { a->code.length, targets[i], a->code.length - 4 * i };
+		vec_push(&a->fixups, &fixup);
+		put_bytes(a, 0, 4);
+	}
+}
+
+int reserve_frame(struct Assembler *a) {
+	if (a->out) {
+		write_format(a->out, "\tsubq $.Lframe%d, %%rsp\n", a->frames);
+		return a->frames++;
+	}
+
+	// subq $imm32, %rsp
+	put_bytes(a, 0xec8148, 3);
+	put_bytes(a, 0, 4);
+	return a->code.length - 4;
+}
+
+void set_frame(struct Assembler *a, int frame, int size) {
+	if (a->out) write_format(a->out, "\t.set .Lframe%d, %d\n", frame, size);
+	else        patch32(a, frame, size);
+}
+
+void begin_function(struct Assembler *a, struct AST_Declaration *decl) {
+	const char *name = decl->token->text;
+
+	if (a->out) {
+		write_format(a->out, "\n\t.text\n\t.globl %s\n\t.type %s, @function\n%s:\n", name, name, name);
+		return;
+	}
+
+	// functions start on 16 bytes, the gaps trap
+	while (a->code.length % 16) put_byte(a, 0xcc);
+
+	struct CodeSymbol function = { decl, a->code.length, 0 };
+	vec_push(&a->functions, &function);
+}
+
+// jumps are within a function, all their labels are placed by its end
+void end_function(struct Assembler *a, struct AST_Declaration *decl) {
+	const char *name = decl->token->text;
+
+	if (a->out) {
+		write_format(a->out, "\t.size %s, .-%s\n", name, name);
+		return;
+	}
+
+	struct Fixup *fixups = a->fixups.mem;
+	int *labels = a->labels.mem;
+
+	for (int i = 0; i < a->fixups.length; i++) {
+		assert(labels[fixups[i].label] >= 0);
+		patch32(a, fixups[i].offset, labels[fixups[i].label] - fixups[i].base);
+	}
+
+	vec_truncate(&a->fixups, 0);
+
+	struct CodeSymbol *function = &((struct CodeSymbol *)a->functions.mem)[a->functions.length - 1];
+	function->size = a->code.length - function->offset;
+}
@@ -0,0 +1,194 @@
+#ifndef ASSEMBLER_H_
+#define ASSEMBLER_H_
+
+#include "ast.h"
+#include "literals.h"
+#include "tokens.h"
+#include "util.h"
+#include "writer.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// x86-64 assembler:
+//
+// the code generator emits instructions here one at a time. with a writer
+// they are printed as GNU assembly in AT&T syntax, without one they are
+// encoded as machine code. jumps go to numbered labels, which are resolved
+// as soon as both ends are known; references to functions, globals and
+// strings become relocations for whoever places the code: the JIT or the
+// object writer.
+//
+
+enum Register {
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+enum OperandKind {
+	OPERAND_REGISTER,
+	OPERAND_IMMEDIATE,
+	OPERAND_MEMORY, // displacement(base), or displacement(base,index,scale)
+	OPERAND_SYMBOL, // symbol+displacement(%rip)
+	OPERAND_LABEL,  // .Llabel(%rip)
+	OPERAND_VECTOR, // %xmm register, numbered in reg
+};
+
+enum Target {
+	TARGET_FUNCTION, // declaration, found by name: it may be a prototype
+	TARGET_GLOBAL,   // declaration
+	TARGET_STRING,   // literal id in strings
+};
+
+struct Operand {
+	enum OperandKind kind;
+	enum Register reg; // register or base
+	int64_t value;     // immediate, displacement or label
+
+	enum Register index;
+	int scale; // 1, 2, 4 or 8, 0 without an index
+
+	enum Target target;
+	const void *symbol; // declaration
+	int string;
+};
+
+// two operand instructions take the source first, as AT&T does
+enum Mnemonic {
+	I_MOV, I_MOVZB, I_MOVZW, I_MOVSLQ, I_LEA,
+	I_ADD, I_OR, I_AND, I_SUB, I_XOR, I_CMP, I_TEST, I_IMUL, I_BT,
+	I_SHL, I_SHR, I_SAR, I_ROL,
+	I_BSF, I_BSR, I_LZCNT, I_TZCNT, I_POPCNT, // into a register
+	I_NEG, I_NOT, I_DIV, I_IDIV, I_BSWAP,
+	I_PREFETCHT0,
+	I_PUSH, I_POP,
+	I_CLTD, I_LEAVE, I_RET, I_UD2,
+	I_REP_STOSB, // %ecx bytes of %al at (%rdi)
+
+	// sse2, and pshufb from ssse3
+	I_MOVD, I_MOVDQA, I_MOVDQU,
+	I_PADDB, I_PADDD, I_PSUBB, I_PSUBD, I_PMULUDQ,
+	I_PAND, I_POR, I_PXOR,
+	I_PCMPEQB, I_PCMPEQD, I_PCMPGTB, I_PCMPGTD,
+	I_PSLLD, I_PSRLD, I_PSRLQ,
+	I_PUNPCKLDQ, I_PSHUFB, I_PSHUFD,
+	I_PMOVMSKB, I_MOVMSKPS,
+};
+
+// the encoding of the condition code
+enum ConditionCode {
+	CC_B = 2, CC_AE, CC_E, CC_NE, CC_BE, CC_A, // b is also c, the bit of bt
+	CC_L = 12, CC_GE, CC_LE, CC_G,
+	CC_ALWAYS = 16, // jmp
+};
+
+enum RelocationType {
+	RELOCATION_PC32,  // 32-bit displacement from the next instruction
+	RELOCATION_PLT32, // same, to a function that may be external
+};
+
+struct Relocation {
+	int offset; // in code
+	enum RelocationType type;
+	enum Target kind;
+	const void *symbol;
+	int string;
+	int64_t addend;
+};
+
+// a function definition in code
+struct CodeSymbol {
+	struct AST_Declaration *declaration;
+	int offset, size;
+};
+
+struct Assembler {
+	struct Writer *out; // text, or NULL for machine code
+
+	struct Vec code;        // uint8_t
+	struct Vec relocations; // struct Relocation
+	struct Vec functions;   // struct CodeSymbol
+	struct LiteralPool strings; // .LS<id>, placed by the layout of the pool
+
+	struct Vec labels; // int: offset of each label, -1 until placed
+	struct Vec fixups; // jumps to labels not placed yet
+	int frames;        // frame sizes reserved
+};
+
+void init_assembler(struct Assembler *, struct Writer *out);
+void free_assembler(struct Assembler *);
+
+static inline
+struct Operand reg(enum Register r) {
+	return (struct Operand) { .kind = OPERAND_REGISTER, .reg = r };
+}
+
+static inline
+struct Operand imm(int64_t value) {
+	return (struct Operand) { .kind = OPERAND_IMMEDIATE, .value = value };
+}
+
+static inline
+struct Operand mem(enum Register base, int32_t displacement) {
+	return (struct Operand) { .kind = OPERAND_MEMORY, .reg = base, .value = displacement };
+}
+
+static inline
+struct Operand indexed(enum Register base, enum Register index, int scale) {
+	return (struct Operand) { .kind = OPERAND_MEMORY, .reg = base, .index = index, .scale = scale };
+}
+
+static inline
+struct Operand xmm(int r) {
+	return (struct Operand) { .kind = OPERAND_VECTOR, .reg = r };
+}
+
+static inline
+struct Operand label_operand(int label) {
+	return (struct Operand) { .kind = OPERAND_LABEL, .value = label };
+}
+
+static inline
+struct Operand symbol(enum Target kind, const void *declaration) {
+	return (struct Operand) { .kind = OPERAND_SYMBOL, .target = kind, .symbol = declaration };
+}
+
+// a string literal, added to the strings once per content
+struct Operand string_operand(struct Assembler *, struct Token *);
+
+// size in bytes is that of the operation: the destination of movzb, movzw
+// and movslq, the source of shifts by %cl is always %cl
+void emit_binary(struct Assembler *, enum Mnemonic, int size, struct Operand src, struct Operand dst);
+void emit_unary(struct Assembler *, enum Mnemonic, int size, struct Operand);
+void emit_plain(struct Assembler *, enum Mnemonic);
+
+// sse instructions on %xmm registers: movd, pmovmskb and movmskps take a
+// 32-bit general register on one side, shifts take an immediate count
+void emit_vector(struct Assembler *, enum Mnemonic, struct Operand src, struct Operand dst);
+
+// pshufd: lane i of dst is lane (order >> 2 * i & 3) of src
+void emit_shuffle(struct Assembler *, int order, struct Operand src, struct Operand dst);
+
+// cmovcc between registers
+void emit_move_if(struct Assembler *, enum ConditionCode, int size, struct Operand src, struct Operand dst);
+
+// setcc to a byte register
+void emit_set(struct Assembler *, enum ConditionCode, enum Register);
+void emit_jump(struct Assembler *, enum ConditionCode, int label);
+void emit_jump_register(struct Assembler *, enum Register);
+void emit_call(struct Assembler *, struct AST_Declaration *);
+
+int new_label(struct Assembler *);
+void place_label(struct Assembler *, int label);
+
+// a jump table at `label`: 32-bit offsets of the targets from the table
+void emit_table(struct Assembler *, int label, const int *targets, int count);
+
+// `subq $frame, %rsp` before the size of the frame is known
+int reserve_frame(struct Assembler *);
+void set_frame(struct Assembler *, int frame, int size);
+
+void begin_function(struct Assembler *, struct AST_Declaration *);
+void end_function(struct Assembler *, struct AST_Declaration *);
+
+#endif //ASSEMBLER_H_
@@ -1,16 +1,9 @@
 #ifndef AST_H
 #define AST_H
 
-// type info for AST_ExprNode
-enum BasicType {
-	VOID, U8, U16, U32, INT,
-};
+#include <stdbool.h>
 
-struct ExpressionType {
-	enum BasicType type;
-	unsigned pointers: 31, temporary: 1;
-};
-//
+#include "types.h"
 
 enum AST_ExpressionType {
 	LITERAL    = 0x01,
@@ -30,11 +23,13 @@ struct AST_ExprLiteral {
 
 struct AST_ExprString {
 	struct Token *token;
+	struct ExpressionType type;
 };
 
 struct AST_ExprIdentifier {
 	struct Token *token;
 	struct ExpressionType type;
+	struct AST_Declaration *declaration; // resolved during type checking
 };
 
 struct AST_ExprUnaryOp {
@@ -56,11 +51,28 @@ struct AST_ExprTypeCast {
 	struct AST_Expression *rhs;
 };
 
+// operations called like functions, named by an identifier that is not
+// declared: they have no declaration and each backend lowers them itself
+enum Builtin {
+	BUILTIN_NONE,
+	BUILTIN_SHUFFLE,  // lanes of a vector picked by the lanes of another
+	BUILTIN_MOVEMASK, // the top bit of each lane of a vector
+
+	// on integers, at the width of their type
+	BUILTIN_CLZ,      // leading zero bits
+	BUILTIN_CTZ,      // trailing zero bits
+	BUILTIN_POPCOUNT, // bits set
+	BUILTIN_BSWAP,    // the bytes in reverse order
+	BUILTIN_ROTATE,   // rotated left, by a count modulo the width
+	BUILTIN_PREFETCH, // hints that memory a pointer points to is read soon
+};
+
 struct AST_ExprFuncCall {
 	struct Token *token;
 	struct ExpressionType type;
 	struct AST_Expression *func;
 	struct AST_Expression *args;
+	enum Builtin builtin; // resolved during type checking
 };
 
 struct AST_Expression {
@@ -77,4 +89,85 @@ struct AST_Expression {
 	};
 };
 
+
+enum AST_StatementType {
+	STMT_EXPRESSION,
+	STMT_DECLARATION,
+	STMT_BLOCK,
+	STMT_IF,
+	STMT_WHILE,
+	STMT_DO,
+	STMT_RETURN,
+	STMT_BREAK,
+	STMT_SWITCH,
+	STMT_CASE, // case and default labels, only in the body of a switch
+};
+
+struct AST_StmtBlock {
+	struct AST_Statement *body; // linked through AST_Statement.next
+};
+
+struct AST_StmtIf {
+	struct AST_Expression *condition;
+	struct AST_Statement *then, *otherwise;
+};
+
+// while and do-while loops
+struct AST_StmtLoop {
+	struct AST_Expression *condition;
+	struct AST_Statement *body;
+};
+
+// the value of a case label and the label statement it belongs to
+struct AST_SwitchCase {
+	unsigned value;
+	int label;
+};
+
+// labels with nothing between them are one label statement. the cases are
+// sorted in the order of the condition's type, no two have the same value
+struct AST_StmtSwitch {
+	struct AST_Expression *condition;
+	struct AST_Statement *body;
+
+	struct AST_SwitchCase *cases;
+	int case_count;
+
+	struct AST_Statement **labels; // by index
+	int label_count;
+	int otherwise; // label with `default`, -1 if there is none
+};
+
+struct AST_Statement {
+	enum AST_StatementType type;
+	struct Token *token;
+	struct AST_Statement *next;
+
+	union {
+		struct AST_Expression  *expression; // expression or return value
+		struct AST_Declaration *declaration;
+		struct AST_StmtBlock   block;
+		struct AST_StmtIf      conditional;
+		struct AST_StmtLoop    loop;
+		struct AST_StmtSwitch  selection;
+		int label; // index in the labels of its switch
+	};
+};
+
+struct AST_Declaration {
+	struct Token *token; // identifier
+	struct ExpressionType type;
+	struct AST_Expression *value;
+
+	// functions: `type` is the return type, body is NULL for prototypes
+	bool function, defined;
+
+	// struct and union declarations: `type` is the one they name, they
+	// define it unless they only declare the name
+	bool aggregate;
+	int param_count;
+	struct AST_Declaration **params;
+	struct AST_Statement *body;
+};
+
 #endif //AST_H
@@ -0,0 +1,607 @@
+#include "bounds.h"
+
+#include "allocator.h"
+#include "ast.h"
+#include "parser.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdint.h>
+
+// variable < bound. facts are killed by clearing the variable, so those
+// from before a branch are restored by truncating
+struct Fact {
+	struct AST_Declaration *variable;
+	uint32_t bound;
+};
+
+struct Checker {
+	struct Allocator *allocator;
+	struct TypeTable *types;
+
+	struct Vec facts;    // struct Fact
+	struct Vec pending;  // struct Fact, from the checks of the full expression
+	struct Vec locals;   // struct AST_Declaration *, unsigned scalars facts are kept about
+	struct Vec escaped;  // struct AST_Declaration *, whose address is taken
+	struct Vec assigned; // struct AST_Declaration *, by the last full expression
+
+	int conditional; // nesting of operands that may not be evaluated
+	int labels;      // facts that hold at the labels of the switch being checked
+};
+
+
+// ranges
+
+static
+bool is_integer(unsigned type) {
+	return type == U8 || type == U16 || type == U32 || type == INT;
+}
+
+static
+bool is_unsigned(unsigned type) {
+	return type == U8 || type == U16 || type == U32;
+}
+
+static
+struct IndexRange exact(uint32_t value) {
+	return (struct IndexRange) { value, value, true };
+}
+
+static
+struct IndexRange full_range(unsigned type) {
+	switch (type) {
+		case U8:  return (struct IndexRange) { 0, UINT8_MAX, false };
+		case U16: return (struct IndexRange) { 0, UINT16_MAX, false };
+		default:  return (struct IndexRange) { 0, UINT32_MAX, false };
+	}
+}
+
+static
+bool contains(struct Vec *list, struct AST_Declaration *decl) {
+	for (int i = 0; i < list->length; i++) {
+		if (((struct AST_Declaration **)list->mem)[i] == decl) return true;
+	}
+
+	return false;
+}
+
+// a variable facts can be kept about, NULL otherwise
+static
+struct AST_Declaration *variable(struct Checker *c, struct AST_Expression *expr) {
+	if (c == NULL || expr->type != IDENTIFIER) return NULL;
+
+	struct AST_Declaration *decl = expr->identifier.declaration;
+	return contains(&c->locals, decl) && !contains(&c->assigned, decl) ? decl : NULL;
+}
+
+// the least bound the facts give, 0 if they give none
+static
+uint32_t known_bound(struct Checker *c, struct AST_Declaration *decl) {
+	struct Fact *facts = c->facts.mem;
+	uint32_t bound = 0;
+
+	for (int i = 0; i < c->facts.length; i++) {
+		if (facts[i].variable != decl || (bound && facts[i].bound >= bound)) continue;
+		bound = facts[i].bound;
+	}
+
+	return bound;
+}
+
+static
+struct IndexRange range(struct Checker *, struct TypeTable *, struct AST_Expression *);
+
+// bounded as the operands are: either for masks and the like, both for sums
+static
+struct IndexRange binary_range(struct Checker *c, struct TypeTable *types, struct AST_ExprBinaryOp *op, struct IndexRange full) {
+	unsigned lhs = expression_type(op->lhs).id, rhs = expression_type(op->rhs).id;
+
+	if (op->token->type == KEYWORD_ELSE) return full;
+
+	switch (op->token->value) {
+		case EQ: case NEQ: case '<': case LEQ: case '>': case GEQ: case AND: case OR:
+			return (struct IndexRange) { 0, 1, true };
+
+		case ',':
+			return range(c, types, op->rhs);
+
+		case CHECK_INDEX: {
+			struct IndexRange index = range(c, types, op->lhs);
+			uint32_t last = op->rhs->literal.value - 1;
+
+			if (index.high > last) index.high = last;
+			return index;
+		}
+	}
+
+	if (!is_integer(lhs) || !is_integer(rhs)) return full;
+
+	struct IndexRange a = range(c, types, op->lhs), b = range(c, types, op->rhs);
+	bool either = a.bounded || b.bounded, both = a.bounded && b.bounded;
+	bool sign = op->type.id == INT;
+
+	switch (op->token->value) {
+		case '&':
+			if (a.low == a.high && b.low == b.high) return exact(a.low & b.low);
+			return (struct IndexRange) { 0, a.high < b.high ? a.high : b.high, either };
+
+		case '%':
+			if (sign || b.low == 0) return full;
+			if (a.high < b.low) return a;
+			return (struct IndexRange) { 0, a.high < b.high - 1 ? a.high : b.high - 1, b.bounded };
+
+		case '/':
+			if (sign || b.low == 0) return full;
+			return (struct IndexRange) { a.low / b.high, a.high / b.low, b.bounded };
+
+		case SHR:
+			if (lhs == INT || b.low != b.high) return full;
+			return (struct IndexRange) { a.low >> (b.low & 31), a.high >> (b.low & 31), either };
+
+		case SHL:
+			if (b.low != b.high || (uint64_t)a.high << (b.low & 31) > UINT32_MAX) return full;
+			return (struct IndexRange) { a.low << (b.low & 31), a.high << (b.low & 31), both };
+
+		case '+':
+			if ((uint64_t)a.high + b.high > UINT32_MAX) return full;
+			return (struct IndexRange) { a.low + b.low, a.high + b.high, both };
+
+		case '-':
+			if (a.low < b.high) return full;
+			return (struct IndexRange) { a.low - b.high, a.high - b.low, both };
+
+		case '*':
+			if ((uint64_t)a.high * b.high > UINT32_MAX) return full;
+			return (struct IndexRange) { a.low * b.low, a.high * b.high, both };
+	}
+
+	return full;
+}
+
+static
+struct IndexRange range(struct Checker *c, struct TypeTable *types, struct AST_Expression *expr) {
+	unsigned type = expression_type(expr).id;
+	struct IndexRange full = full_range(type);
+
+	switch (expr->type) {
+		case LITERAL:
+			return exact(expr->literal.value);
+
+		case IDENTIFIER: {
+			struct AST_Declaration *decl = variable(c, expr);
+			uint32_t bound = decl ? known_bound(c, decl) : 0;
+
+			if (bound) return (struct IndexRange) { 0, bound - 1, true };
+			return full;
+		}
+
+		case UNARY_OP: {
+			struct AST_ExprUnaryOp *op = &expr->unary_op;
+			if (op->token->type == KEYWORD_SIZEOF) return exact(type_size(types, expression_type(op->rhs).id));
+
+			if (op->token->value == '!') return (struct IndexRange) { 0, 1, true };
+			if (op->token->value != '-') return full;
+
+			struct IndexRange value = range(c, types, op->rhs);
+			return value.low == value.high ? exact(-value.low) : full;
+		}
+
+		// narrowing casts bound the value
+		case TYPE_CAST: {
+			struct IndexRange value = range(c, types, expr->type_cast.rhs);
+			if (!is_integer(type) || !is_integer(expression_type(expr->type_cast.rhs).id)) return full;
+
+			if (value.high <= full.high) return value;
+			if (value.low == value.high) return exact(value.low & full.high);
+			return (struct IndexRange) { 0, full.high, true };
+		}
+
+		case BINARY_OP:
+			return binary_range(c, types, &expr->binary_op, full);
+
+		case FUNC_CALL:
+			switch (expr->func_call.builtin) {
+				case BUILTIN_CLZ: case BUILTIN_CTZ: case BUILTIN_POPCOUNT:
+					return (struct IndexRange) { 0, 32, true };
+
+				default:
+					return full;
+			}
+
+		case STRING:
+			return full;
+	}
+
+	return full;
+}
+
+struct IndexRange index_range(struct TypeTable *types, struct AST_Expression *expr) {
+	return range(NULL, types, expr);
+}
+
+
+// facts
+
+static
+void kill(struct Checker *c, struct AST_Declaration *decl) {
+	struct Fact *facts = c->facts.mem;
+
+	for (int i = 0; i < c->facts.length; i++) {
+		if (facts[i].variable == decl) facts[i].variable = NULL;
+	}
+}
+
+static
+void restore(struct Checker *c, int facts) {
+	if (c->facts.length > facts) vec_truncate(&c->facts, facts);
+}
+
+// var < rhs, or var <= rhs, as unsigned
+static
+void learn_bound(struct Checker *c, struct AST_Expression *var, struct AST_Expression *rhs, bool equal) {
+	struct AST_Declaration *decl = variable(c, var);
+	if (decl == NULL || !is_unsigned(expression_type(rhs).id)) return;
+
+	uint64_t bound = (uint64_t)range(c, c->types, rhs).high + equal;
+	if (bound > UINT32_MAX) return;
+
+	struct Fact fact = { decl, bound };
+	vec_push(&c->facts, &fact);
+}
+
+// the facts a condition gives where it holds
+static
+void learn(struct Checker *c, struct AST_Expression *condition) {
+	if (condition->type != BINARY_OP || condition->binary_op.token->type == KEYWORD_ELSE) return;
+	struct AST_ExprBinaryOp *op = &condition->binary_op;
+
+	switch (op->token->value) {
+		case AND:
+			learn(c, op->lhs);
+			learn(c, op->rhs);
+			return;
+
+		case '<': case LEQ:
+			learn_bound(c, op->lhs, op->rhs, op->token->value == LEQ);
+			return;
+
+		case '>': case GEQ:
+			learn_bound(c, op->rhs, op->lhs, op->token->value == GEQ);
+			return;
+	}
+}
+
+// the variables an expression assigns, or those it takes the address of
+static
+void find_variables(struct AST_Expression *expr, bool address, struct Vec *out) {
+	switch (expr->type) {
+		case LITERAL: case STRING: case IDENTIFIER:
+			return;
+
+		case UNARY_OP: {
+			struct AST_ExprUnaryOp *op = &expr->unary_op;
+			unsigned value = op->token->value;
+
+			bool assigns = value == INC || value == DEC || value == POST_INC || value == POST_DEC;
+			bool found = op->token->type != KEYWORD_SIZEOF && (address ? value == '*' : assigns);
+
+			if (found && op->rhs->type == IDENTIFIER) vec_push(out, &op->rhs->identifier.declaration);
+			find_variables(op->rhs, address, out);
+			return;
+		}
+
+		case BINARY_OP: {
+			struct AST_ExprBinaryOp *op = &expr->binary_op;
+			bool assigns = op->token->type != KEYWORD_ELSE && op->token->value == '=';
+
+			if (!address && assigns && op->lhs->type == IDENTIFIER) vec_push(out, &op->lhs->identifier.declaration);
+			find_variables(op->lhs, address, out);
+			find_variables(op->rhs, address, out);
+			return;
+		}
+
+		case TYPE_CAST:
+			find_variables(expr->type_cast.rhs, address, out);
+			return;
+
+		case FUNC_CALL:
+			if (expr->func_call.args) find_variables(expr->func_call.args, address, out);
+			return;
+	}
+}
+
+static
+void find_in_statements(struct AST_Statement *statement, bool address, struct Vec *out) {
+	for (; statement; statement = statement->next) {
+		switch (statement->type) {
+			case STMT_EXPRESSION:
+			case STMT_RETURN:
+				if (statement->expression) find_variables(statement->expression, address, out);
+				break;
+
+			case STMT_DECLARATION:
+				if (!address) vec_push(out, &statement->declaration);
+				if (statement->declaration->value) find_variables(statement->declaration->value, address, out);
+				break;
+
+			case STMT_BLOCK:
+				find_in_statements(statement->block.body, address, out);
+				break;
+
+			case STMT_IF:
+				find_variables(statement->conditional.condition, address, out);
+				find_in_statements(statement->conditional.then, address, out);
+				find_in_statements(statement->conditional.otherwise, address, out);
+				break;
+
+			case STMT_WHILE:
+			case STMT_DO:
+				find_variables(statement->loop.condition, address, out);
+				find_in_statements(statement->loop.body, address, out);
+				break;
+
+			case STMT_SWITCH:
+				find_variables(statement->selection.condition, address, out);
+				find_in_statements(statement->selection.body, address, out);
+				break;
+
+			case STMT_BREAK:
+			case STMT_CASE:
+				break;
+		}
+	}
+}
+
+// what is assigned in a loop does not hold from one iteration to the next
+static
+void kill_assigned(struct Checker *c, struct AST_Expression *condition, struct AST_Statement *body) {
+	struct Vec assigned = vec(struct AST_Declaration *);
+	find_variables(condition, false, &assigned);
+	find_in_statements(body, false, &assigned);
+
+	for (int i = 0; i < assigned.length; i++) kill(c, ((struct AST_Declaration **)assigned.mem)[i]);
+	vec_free(&assigned);
+}
+
+
+// traversal
+
+static
+struct AST_Expression *index_check(struct Checker *c, struct Token *at, struct AST_Expression *index, uint32_t length) {
+	struct Token *tokens = allocate_object(c->allocator, 2 * sizeof *tokens);
+
+	tokens[0] = *at;
+	tokens[0].type = PUNCTUATION;
+	tokens[0].value = CHECK_INDEX;
+
+	tokens[1] = *at;
+	tokens[1].type = INT_LITERAL;
+	tokens[1].value = length;
+	tokens[1].is_char = false;
+
+	struct AST_Expression literal = {
+		.type = LITERAL,
+		.literal = { &tokens[1], { .id = U32, .temporary = true }, length },
+	};
+
+	struct AST_Expression check = {
+		.type = BINARY_OP,
+		.binary_op = {
+			.token = &tokens[0],
+			.lhs = index,
+			.rhs = store_object(c->allocator, &literal, sizeof literal),
+			.type = { .id = U32, .temporary = true },
+		},
+	};
+
+	return store_object(c->allocator, &check, sizeof check);
+}
+
+static
+void check_expression(struct Checker *, struct AST_Expression *);
+
+static
+void check_index(struct Checker *c, struct AST_ExprBinaryOp *op) {
+	uint32_t length = get_type(c->types, expression_type(op->lhs).id)->length;
+	if (range(c, c->types, op->rhs).high < length) return;
+
+	// the index is below the length after the check
+	struct AST_Declaration *decl = variable(c, op->rhs);
+
+	if (decl && !c->conditional) {
+		struct Fact fact = { decl, length };
+		vec_push(&c->pending, &fact);
+	}
+
+	op->rhs = index_check(c, op->token, op->rhs, length);
+}
+
+static
+void check_binary(struct Checker *c, struct AST_ExprBinaryOp *op) {
+	check_expression(c, op->lhs);
+
+	// the rhs is only evaluated after the lhs and not always, that of &&
+	// where the lhs holds
+	if (op->token->type == KEYWORD_ELSE || op->token->value == AND || op->token->value == OR) {
+		int facts = c->facts.length;
+		if (op->token->type != KEYWORD_ELSE && op->token->value == AND) learn(c, op->lhs);
+
+		c->conditional++;
+		check_expression(c, op->rhs);
+		c->conditional--;
+
+		restore(c, facts);
+		return;
+	}
+
+	check_expression(c, op->rhs);
+	if (op->token->value == '[' && is_array(c->types, expression_type(op->lhs).id)) check_index(c, op);
+}
+
+static
+void check_expression(struct Checker *c, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case LITERAL: case STRING: case IDENTIFIER:
+			return;
+
+		// the operand of sizeof is never evaluated
+		case UNARY_OP:
+			if (expr->unary_op.token->type != KEYWORD_SIZEOF) check_expression(c, expr->unary_op.rhs);
+			return;
+
+		case TYPE_CAST:
+			check_expression(c, expr->type_cast.rhs);
+			return;
+
+		case FUNC_CALL:
+			if (expr->func_call.args) check_expression(c, expr->func_call.args);
+			return;
+
+		case BINARY_OP:
+			check_binary(c, &expr->binary_op);
+			return;
+	}
+}
+
+// the checks of a full expression hold once it is evaluated, for the
+// variables it does not assign
+static
+void check_full(struct Checker *c, struct AST_Expression *expr) {
+	vec_truncate(&c->assigned, 0);
+	vec_truncate(&c->pending, 0);
+	find_variables(expr, false, &c->assigned);
+
+	check_expression(c, expr);
+
+	for (int i = 0; i < c->assigned.length; i++) kill(c, ((struct AST_Declaration **)c->assigned.mem)[i]);
+	vec_append(&c->facts, c->pending.mem, c->pending.length);
+}
+
+// a condition: the facts it gives are those above the count returned
+static
+int check_condition(struct Checker *c, struct AST_Expression *condition) {
+	check_full(c, condition);
+
+	int facts = c->facts.length;
+	learn(c, condition);
+	return facts;
+}
+
+static
+void check_statements(struct Checker *c, struct AST_Statement *statement) {
+	for (; statement; statement = statement->next) {
+		switch (statement->type) {
+			case STMT_EXPRESSION:
+			case STMT_RETURN:
+				if (statement->expression) check_full(c, statement->expression);
+				break;
+
+			case STMT_DECLARATION: {
+				struct AST_Declaration *decl = statement->declaration;
+				if (decl->value) check_full(c, decl->value);
+
+				kill(c, decl);
+				if (is_unsigned(decl->type.id) && !contains(&c->escaped, decl) && !contains(&c->locals, decl)) {
+					vec_push(&c->locals, &decl);
+				}
+
+				break;
+			}
+
+			case STMT_BLOCK:
+				check_statements(c, statement->block.body);
+				break;
+
+			case STMT_IF: {
+				int facts = check_condition(c, statement->conditional.condition);
+				check_statements(c, statement->conditional.then);
+				restore(c, facts);
+
+				check_statements(c, statement->conditional.otherwise);
+				restore(c, facts);
+				break;
+			}
+
+			case STMT_WHILE: {
+				int facts = c->facts.length;
+				kill_assigned(c, statement->loop.condition, statement->loop.body);
+
+				check_condition(c, statement->loop.condition);
+				check_statements(c, statement->loop.body);
+				restore(c, facts);
+				break;
+			}
+
+			case STMT_DO: {
+				int facts = c->facts.length;
+				kill_assigned(c, statement->loop.condition, statement->loop.body);
+
+				check_statements(c, statement->loop.body);
+				check_full(c, statement->loop.condition);
+				restore(c, facts);
+				break;
+			}
+
+			// a label is reached from the switch too
+			case STMT_SWITCH: {
+				check_full(c, statement->selection.condition);
+
+				int labels = c->labels;
+				c->labels = c->facts.length;
+				check_statements(c, statement->selection.body);
+
+				restore(c, c->labels);
+				c->labels = labels;
+				break;
+			}
+
+			case STMT_CASE:
+				restore(c, c->labels);
+				break;
+
+			case STMT_BREAK:
+				break;
+		}
+	}
+}
+
+static
+void check_function(struct Checker *c, struct AST_Declaration *decl) {
+	vec_truncate(&c->facts, 0);
+	vec_truncate(&c->locals, 0);
+	vec_truncate(&c->escaped, 0);
+	c->labels = 0;
+
+	find_in_statements(decl->body, true, &c->escaped);
+
+	for (int i = 0; i < decl->param_count; i++) {
+		struct AST_Declaration *param = decl->params[i];
+		if (is_unsigned(param->type.id) && !contains(&c->escaped, param)) vec_push(&c->locals, &param);
+	}
+
+	check_statements(c, decl->body);
+}
+
+// global initialisers are evaluated by the compiler, only bodies are rewritten
+void check_bounds(struct Allocator *allocator, struct TypeTable *types, struct AST_Declaration **declarations, int count) {
+	struct Checker c = {
+		.allocator = allocator,
+		.types = types,
+		.facts = vec(struct Fact),
+		.pending = vec(struct Fact),
+		.locals = vec(struct AST_Declaration *),
+		.escaped = vec(struct AST_Declaration *),
+		.assigned = vec(struct AST_Declaration *),
+	};
+
+	for (int i = 0; i < count; i++) {
+		if (declarations[i]->function && declarations[i]->body) check_function(&c, declarations[i]);
+	}
+
+	vec_free(&c.facts);
+	vec_free(&c.pending);
+	vec_free(&c.locals);
+	vec_free(&c.escaped);
+	vec_free(&c.assigned);
+}
@@ -0,0 +1,43 @@
+#ifndef BOUNDS_H_
+#define BOUNDS_H_
+
+#include "allocator.h"
+#include "ast.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// bounds checks:
+//
+// arrays have a length known at compile time. the parser checks the
+// indices whose range it knows against it, see index_range. with
+// -fbounds-check every other index into an array is checked at run time:
+// the index i of a[i] becomes `i CHECK_INDEX n`, which is i, or traps when
+// i is not below n as unsigned. no check is made where the index is known
+// to be in range:
+//
+//     from its operators     a[i & 7], a[i % 8], a[i >> 29], a[(u8)i]
+//     from its type          a u8 index into an array of 256
+//     from a condition       while (i < 8) a[i], i < 8 && a[i]
+//     from an earlier check  a[i] = 0; b[i] = 0; with b as long as a
+//
+// facts about a variable hold until it is assigned, so they are only kept
+// about locals whose address is never taken. a condition gives facts in
+// the branch or loop body it guards, a check after the statement it is in,
+// as the backends evaluate the operands of an expression in any order.
+//
+
+// the values an expression can have, as unsigned 32-bit integers. bounded
+// when something other than the types limits them
+struct IndexRange {
+	uint32_t low, high;
+	bool bounded;
+};
+
+struct IndexRange index_range(struct TypeTable *, struct AST_Expression *);
+
+// rewrites the indices of the function bodies in place
+void check_bounds(struct Allocator *, struct TypeTable *, struct AST_Declaration **, int count);
+
+#endif //BOUNDS_H_
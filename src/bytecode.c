@@ -0,0 +1,1119 @@
+#include "bytecode.h"
+
+#include "ast.h"
+#include "literals.h"
+#include "parser.h"
+#include "switch.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Compiler {
+	struct Program *program;
+	struct TypeTable *types;
+
+	// operand stack of the code being compiled
+	int depth, max_depth;
+
+	// frame of the function being compiled, in bytes
+	int frame, frame_size;
+
+	struct AST_Declaration *function;
+	struct Vec breaks; // int, operands of jumps out of loops
+	int loop;          // first break of the innermost loop
+
+	// the innermost switch: offsets of its labels, the end last
+	int *labels;
+	struct Vec jumps; // struct LabelJump, operands to patch with labels
+
+	// string literals, one copy per content, placed after the globals once
+	// all the code is compiled
+	struct LiteralPool strings;
+	struct Vec string_uses; // struct StringUse
+
+	// constant expressions: globals and strings fail, functions are
+	// compiled as they are called, once `callees` has their definitions
+	bool constant, failed;
+	struct Callees *callees;
+};
+
+
+// a jump to a label of a switch, which is placed later
+struct LabelJump {
+	int operand;
+	int label;
+};
+
+// the operand of a push of a literal's address
+struct StringUse {
+	int operand;
+	int id;
+};
+
+
+// slots
+
+static
+unsigned slot_hash(const void *key) {
+	return (unsigned)((uintptr_t)key >> 4) * 0x9e3779b1u;
+}
+
+static
+void grow_slots(struct Program *program) {
+	struct Slot *old = program->slots;
+	int capacity = program->slot_capacity;
+
+	program->slot_capacity = max(64, capacity * 2);
+	program->slots = calloc(program->slot_capacity, sizeof *program->slots);
+	if (!program->slots) errx("out of memory: failed to allocate %d slots", program->slot_capacity);
+
+	for (int i = 0; i < capacity; i++) {
+		if (old[i].key == NULL) continue;
+
+		unsigned index = slot_hash(old[i].key);
+		while (program->slots[index & (program->slot_capacity - 1)].key) index++;
+		program->slots[index & (program->slot_capacity - 1)] = old[i];
+	}
+
+	free(old);
+}
+
+struct Slot *find_slot(struct Program *program, const void *key) {
+	if (program->slot_capacity == 0) return NULL;
+
+	for (unsigned index = slot_hash(key);; index++) {
+		struct Slot *slot = &program->slots[index & (program->slot_capacity - 1)];
+
+		if (slot->key == key) return slot;
+		if (slot->key == NULL) return NULL;
+	}
+}
+
+static
+void bind(struct Program *program, const void *key, enum SlotKind kind, int location) {
+	struct Slot *slot = find_slot(program, key);
+
+	if (slot == NULL) {
+		if (2 * (program->slot_count + 1) > program->slot_capacity) grow_slots(program);
+
+		unsigned index = slot_hash(key);
+		while (program->slots[index & (program->slot_capacity - 1)].key) index++;
+
+		slot = &program->slots[index & (program->slot_capacity - 1)];
+		program->slot_count++;
+	}
+
+	*slot = (struct Slot) { key, kind, location };
+}
+
+
+// emitting
+
+int storage_size(struct TypeTable *types, unsigned id) {
+	char buffer[256];
+
+	// pointers are 32-bit addresses whatever the target is
+	if (is_pointer(types, id)) return 4;
+	if (is_aggregate(types, id)) return type_size(types, id);
+
+	int size = type_size(types, id);
+	if (size != 1 && size != 2 && size != 4) {
+		errx("values of type `%s` are not supported by the bytecode compiler", print_type(types, id, buffer, sizeof buffer));
+	}
+
+	return size;
+}
+
+int storage_align(struct TypeTable *types, unsigned id) {
+	return is_aggregate(types, id) ? type_align(types, id) : storage_size(types, id);
+}
+
+// 0, 1, 2 for 8, 16, 32 bits, the order of sized opcodes
+static
+int width(struct Compiler *c, unsigned id) {
+	return storage_size(c->types, id) >> 1;
+}
+
+// what pointer arithmetic and indexing scale by, void * counts bytes. the
+// stride is the size in the type layout, so pointers into arrays of pointers
+// step over 8 bytes though only 4 of them are used
+static
+int element_size(struct Compiler *c, unsigned id) {
+	unsigned element = pointee(c->types, id);
+	return element == VOID ? 1 : type_size(c->types, element);
+}
+
+static
+void emit(struct Compiler *c, enum Opcode op, int effect) {
+	uint8_t byte = op;
+	vec_push(&c->program->code, &byte);
+
+	c->depth += effect;
+	c->max_depth = max(c->max_depth, c->depth);
+}
+
+// returns the offset of the operand, for patching
+static
+int emit_operand(struct Compiler *c, enum Opcode op, int32_t operand, int effect) {
+	emit(c, op, effect);
+
+	int offset = c->program->code.length;
+	vec_append(&c->program->code, &operand, sizeof operand);
+	return offset;
+}
+
+static
+int here(struct Compiler *c) {
+	return c->program->code.length;
+}
+
+static
+void patch(struct Compiler *c, int offset, int32_t target) {
+	memcpy((uint8_t *)c->program->code.mem + offset, &target, sizeof target);
+}
+
+// values are canonical for their type, only narrowing truncates
+static
+void convert(struct Compiler *c, struct ExpressionType from, struct ExpressionType to) {
+	if (to.id == VOID || from.id == VOID) return;
+
+	int size = storage_size(c->types, to.id);
+	if (size >= storage_size(c->types, from.id)) return;
+
+	if (size == 1) emit(c, OP_TRUNC8, 0);
+	if (size == 2) emit(c, OP_TRUNC16, 0);
+}
+
+static
+bool is_signed(struct Compiler *c, struct ExpressionType lhs, struct ExpressionType rhs) {
+	if (is_pointer(c->types, lhs.id) || is_pointer(c->types, rhs.id)) return false;
+	return max(max(lhs.id, rhs.id), U32) == INT;
+}
+
+
+// expressions
+
+static
+void compile_expression(struct Compiler *, struct AST_Expression *);
+
+static
+struct Slot *variable(struct Compiler *c, struct Token *name, struct AST_Declaration *decl) {
+	struct Slot *slot = find_slot(c->program, decl);
+
+	// constants have no memory but the frames of the functions they call
+	if (c->constant && (slot == NULL || slot->kind != SLOT_LOCAL)) {
+		c->failed = true;
+		return NULL;
+	}
+
+	if (slot == NULL || slot->kind == SLOT_FUNCTION) {
+		errx("%s:%d:%d: `%s` cannot be used as a value", name->filename, name->line, name->col, name->text);
+	}
+
+	return slot;
+}
+
+// pushes the address of an lvalue
+static
+void compile_address(struct Compiler *c, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case IDENTIFIER: {
+			struct Slot *slot = variable(c, expr->identifier.token, expr->identifier.declaration);
+			if (slot == NULL) return;
+
+			if (slot->kind == SLOT_LOCAL) emit_operand(c, OP_LOCAL, slot->location, 1);
+			else                          emit_operand(c, OP_PUSH, slot->location, 1);
+			return;
+		}
+
+		// <<p
+		case UNARY_OP:
+			compile_expression(c, expr->unary_op.rhs);
+			return;
+
+		// p[i], a[i] and s.f
+		case BINARY_OP: {
+			struct AST_ExprBinaryOp op = expr->binary_op;
+			unsigned id = expression_type(op.lhs).id;
+
+			if (op.token->value == '.') {
+				struct Field *field = find_field(c->types, id, op.rhs->identifier.token->text);
+				int offset = field->offset;
+
+				// a[i].f of a soa array: the ith of the array of f
+				if (get_type(c->types, id)->soa) {
+					struct AST_ExprBinaryOp element = op.lhs->binary_op;
+					unsigned array = expression_type(element.lhs).id;
+
+					compile_address(c, element.lhs);
+					compile_expression(c, element.rhs);
+					emit_operand(c, OP_PUSH, type_size(c->types, field->type), 1);
+					emit(c, OP_MUL, -1);
+					emit(c, OP_ADD, -1);
+
+					offset *= get_type(c->types, array)->length;
+				} else {
+					compile_address(c, op.lhs);
+				}
+
+				if (offset) emit_operand(c, OP_ADDI, offset, 0);
+				return;
+			}
+
+			int size = is_array(c->types, id) ? type_size(c->types, get_type(c->types, id)->base) : element_size(c, id);
+
+			if (is_array(c->types, id)) compile_address(c, op.lhs);
+			else                        compile_expression(c, op.lhs);
+
+			compile_expression(c, op.rhs);
+
+			if (size != 1) {
+				emit_operand(c, OP_PUSH, size, 1);
+				emit(c, OP_MUL, -1);
+			}
+
+			emit(c, OP_ADD, -1);
+			return;
+		}
+
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+// the bit builtins read no memory, constants may use them. a prefetch only
+// evaluates its pointer
+static
+void compile_builtin(struct Compiler *c, struct AST_ExprFuncCall *call) {
+	static const enum Opcode opcodes[] = {
+		[BUILTIN_CLZ] = OP_CLZ, [BUILTIN_CTZ] = OP_CTZ, [BUILTIN_POPCOUNT] = OP_POPCOUNT,
+		[BUILTIN_BSWAP] = OP_BSWAP, [BUILTIN_ROTATE] = OP_ROTATE,
+	};
+
+	struct AST_Expression *args[MAX_PARAMS];
+	int count = call_arguments(call->args, args);
+
+	switch (call->builtin) {
+		case BUILTIN_CLZ: case BUILTIN_CTZ: case BUILTIN_POPCOUNT:
+		case BUILTIN_BSWAP: case BUILTIN_ROTATE:
+			for (int i = 0; i < count; i++) compile_expression(c, args[i]);
+			emit_operand(c, opcodes[call->builtin], 8 * storage_size(c->types, expression_type(args[0]).id), 1 - count);
+			break;
+
+		case BUILTIN_PREFETCH:
+			compile_expression(c, args[0]);
+			break;
+
+		default: {
+			struct Token *name = call->func->identifier.token;
+			errx("%s:%d:%d: builtin `%s` is not supported by the bytecode compiler", name->filename, name->line, name->col, name->text);
+		}
+	}
+}
+
+// a function a constant calls, compiled after it once its definition is
+// complete. NULL callees take the body the declaration has
+static
+struct Slot *callee(struct Compiler *c, struct AST_Declaration *decl) {
+	struct Slot *slot = find_slot(c->program, decl);
+	if (slot) return slot;
+
+	struct AST_Declaration *definition = c->callees ? c->callees->definition(c->callees->context, decl) : decl;
+
+	if (definition == NULL || definition->body == NULL) {
+		c->failed = true;
+		return NULL;
+	}
+
+	struct Function function = {
+		.declaration = definition,
+		.param_count = definition->param_count,
+	};
+
+	bind(c->program, decl, SLOT_FUNCTION, c->program->functions.length);
+	bind(c->program, definition, SLOT_FUNCTION, c->program->functions.length);
+	vec_push(&c->program->functions, &function);
+
+	return find_slot(c->program, decl);
+}
+
+static
+void compile_call(struct Compiler *c, struct AST_ExprFuncCall *call) {
+	if (call->builtin) {
+		compile_builtin(c, call);
+		return;
+	}
+
+	struct AST_Declaration *decl = call->func->identifier.declaration;
+	struct Slot *slot = c->constant ? callee(c, decl) : find_slot(c->program, decl);
+
+	if (c->failed) return;
+
+	if (slot == NULL) {
+		struct Token *name = decl->token;
+		errx("%s:%d:%d: function `%s` is called but never defined", name->filename, name->line, name->col, name->text);
+	}
+
+	struct AST_Expression *args[MAX_PARAMS];
+	int count = call_arguments(call->args, args);
+
+	for (int i = 0; i < count; i++) {
+		compile_expression(c, args[i]);
+		convert(c, expression_type(args[i]), decl->params[i]->type);
+	}
+
+	emit_operand(c, OP_CALL, slot->location, 1 - count);
+}
+
+static
+void compile_unary(struct Compiler *c, struct AST_ExprUnaryOp *op, struct ExpressionType type) {
+	struct ExpressionType rhs = expression_type(op->rhs);
+
+	if (op->token->type == KEYWORD_SIZEOF) {
+		emit_operand(c, OP_PUSH, type_size(c->types, rhs.id), 1);
+		return;
+	}
+
+	switch (op->token->value) {
+		case '+': compile_expression(c, op->rhs); break;
+		case '-': compile_expression(c, op->rhs); emit(c, OP_NEG, 0);  break;
+		case '~': compile_expression(c, op->rhs); emit(c, OP_NOT, 0);  break;
+		case '!': compile_expression(c, op->rhs); emit(c, OP_LNOT, 0); break;
+
+		case INC: case DEC:
+		case POST_INC: case POST_DEC: {
+			int step = is_pointer(c->types, rhs.id) ? element_size(c, rhs.id) : 1;
+			if (op->token->value == DEC || op->token->value == POST_DEC) step = -step;
+
+			bool post = op->token->value == POST_INC || op->token->value == POST_DEC;
+
+			compile_address(c, op->rhs);
+			emit_operand(c, (post ? OP_POSTINC8 : OP_INC8) + width(c, rhs.id), step, 0);
+			break;
+		}
+
+		// address of
+		case '*':
+			compile_address(c, op->rhs);
+			break;
+
+		// dereference
+		case SHL:
+			compile_expression(c, op->rhs);
+			emit(c, OP_LOAD8 + width(c, type.id), 0);
+			break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+// jumps over the rhs when the lhs decides, the result is 0 or 1
+static
+void compile_logical(struct Compiler *c, struct AST_ExprBinaryOp *op, enum Opcode jump) {
+	compile_expression(c, op->lhs);
+	emit(c, OP_BOOL, 0);
+	emit(c, OP_DUP, 1);
+
+	int skip = emit_operand(c, jump, 0, -1);
+	emit(c, OP_POP, -1);
+
+	compile_expression(c, op->rhs);
+	emit(c, OP_BOOL, 0);
+	patch(c, skip, here(c));
+}
+
+static
+void compile_binary(struct Compiler *c, struct AST_Expression *expr) {
+	struct AST_ExprBinaryOp *op = &expr->binary_op;
+	struct ExpressionType type = op->type;
+	struct ExpressionType lhs = expression_type(op->lhs);
+	struct ExpressionType rhs = expression_type(op->rhs);
+
+	if (op->token->type == KEYWORD_ELSE) {
+		compile_expression(c, op->lhs);
+		emit(c, OP_DUP, 1);
+
+		int skip = emit_operand(c, OP_JNZ, 0, -1);
+		emit(c, OP_POP, -1);
+
+		compile_expression(c, op->rhs);
+		convert(c, rhs, type);
+		patch(c, skip, here(c));
+		return;
+	}
+
+	switch (op->token->value) {
+		case ',':
+			compile_expression(c, op->lhs);
+			emit(c, OP_POP, -1);
+			compile_expression(c, op->rhs);
+			return;
+
+		case '=':
+			compile_address(c, op->lhs);
+			compile_expression(c, op->rhs);
+			convert(c, rhs, lhs);
+			emit(c, OP_STORE8 + width(c, lhs.id), -1);
+			return;
+
+		case AND: compile_logical(c, op, OP_JZ);  return;
+		case OR:  compile_logical(c, op, OP_JNZ); return;
+
+		case '[': case '.':
+			compile_address(c, expr);
+			emit(c, OP_LOAD8 + width(c, type.id), 0);
+			return;
+	}
+
+	bool left = is_pointer(c->types, lhs.id);
+	bool right = is_pointer(c->types, rhs.id);
+
+	// pointer arithmetic scales the integer operand
+	if ((op->token->value == '+' || op->token->value == '-') && (left || right)) {
+		int size = element_size(c, (left ? lhs : rhs).id);
+
+		compile_expression(c, op->lhs);
+		if (right && !left && size != 1) {
+			emit_operand(c, OP_PUSH, size, 1);
+			emit(c, OP_MUL, -1);
+		}
+
+		compile_expression(c, op->rhs);
+		if (left && !right && size != 1) {
+			emit_operand(c, OP_PUSH, size, 1);
+			emit(c, OP_MUL, -1);
+		}
+
+		emit(c, op->token->value == '+' ? OP_ADD : OP_SUB, -1);
+
+		if (left && right && size != 1) {
+			emit_operand(c, OP_PUSH, size, 1);
+			emit(c, OP_IDIV, -1);
+		}
+
+		return;
+	}
+
+	bool sign = is_signed(c, lhs, rhs);
+
+	// x + constant
+	if (op->token->value == '+' && op->rhs->type == LITERAL) {
+		compile_expression(c, op->lhs);
+		emit_operand(c, OP_ADDI, op->rhs->literal.value, 0);
+		return;
+	}
+
+	// the length is always a literal
+	if (op->token->value == CHECK_INDEX) {
+		compile_expression(c, op->lhs);
+		emit_operand(c, OP_CHECK, op->rhs->literal.value, 0);
+		return;
+	}
+
+	compile_expression(c, op->lhs);
+	compile_expression(c, op->rhs);
+
+	enum Opcode code;
+
+	switch (op->token->value) {
+		case '+': code = OP_ADD; break;
+		case '-': code = OP_SUB; break;
+		case '*': code = OP_MUL; break;
+		case '/': code = sign ? OP_IDIV : OP_DIV; break;
+		case '%': code = sign ? OP_IMOD : OP_MOD; break;
+		case '&': code = OP_AND; break;
+		case '|': code = OP_OR;  break;
+		case '^': code = OP_XOR; break;
+		case SHL: code = OP_SHL; break;
+
+		// strength reduction leaves it in functions constants call
+		case MUL_HIGH: code = sign ? OP_IMULHI : OP_MULHI; break;
+
+		// shifts take the signedness of the lhs alone
+		case SHR: code = (lhs.id == INT) ? OP_SAR : OP_SHR; break;
+
+		case EQ:  code = OP_EQ; break;
+		case NEQ: code = OP_NE; break;
+		case '<': code = sign ? OP_ILT : OP_LT; break;
+		case LEQ: code = sign ? OP_ILE : OP_LE; break;
+		case '>': code = sign ? OP_IGT : OP_GT; break;
+		case GEQ: code = sign ? OP_IGE : OP_GE; break;
+
+		default:
+			assert(0 && "unreachable");
+			return;
+	}
+
+	emit(c, code, -1);
+}
+
+static
+void compile_expression(struct Compiler *c, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case LITERAL:
+			emit_operand(c, OP_PUSH, expr->literal.value, 1);
+			break;
+
+		case STRING: {
+			struct Token *token = expr->string.token;
+
+			if (c->constant) {
+				c->failed = true;
+				emit_operand(c, OP_PUSH, 0, 1);
+				break;
+			}
+
+			// the slot holds the id until the pool is laid out
+			struct StringUse use = { .id = add_literal(&c->strings, token->text, token->length) };
+			bind(c->program, token, SLOT_STRING, use.id);
+
+			use.operand = emit_operand(c, OP_PUSH, 0, 1);
+			vec_push(&c->string_uses, &use);
+			break;
+		}
+
+		case IDENTIFIER: {
+			struct ExpressionType type = expr->identifier.type;
+
+			struct Slot *slot = variable(c, expr->identifier.token, expr->identifier.declaration);
+			if (slot == NULL) break;
+
+			if (slot->kind == SLOT_LOCAL) {
+				emit_operand(c, OP_GET8 + width(c, type.id), slot->location, 1);
+			} else {
+				emit_operand(c, OP_PUSH, slot->location, 1);
+				emit(c, OP_LOAD8 + width(c, type.id), 0);
+			}
+
+			break;
+		}
+
+		case UNARY_OP:
+			compile_unary(c, &expr->unary_op, expr->unary_op.type);
+			break;
+
+		case BINARY_OP:
+			compile_binary(c, expr);
+			break;
+
+		case TYPE_CAST:
+			compile_expression(c, expr->type_cast.rhs);
+			convert(c, expression_type(expr->type_cast.rhs), expr->type_cast.type);
+			break;
+
+		case FUNC_CALL:
+			compile_call(c, &expr->func_call);
+			break;
+	}
+}
+
+
+// statements leave the operand stack as they found it
+
+static
+void compile_statement(struct Compiler *, struct AST_Statement *);
+
+static
+void compile_body(struct Compiler *c, struct AST_Statement *body) {
+	int frame = c->frame;
+
+	for (struct AST_Statement *statement = body; statement; statement = statement->next) {
+		compile_statement(c, statement);
+	}
+
+	// locals of the block are dead, their bytes are reused
+	c->frame = frame;
+}
+
+// the body of a loop, breaks jump to wherever the loop ends
+static
+int compile_loop_body(struct Compiler *c, struct AST_Statement *body) {
+	int loop = c->loop;
+	c->loop = c->breaks.length;
+
+	if (body) compile_body(c, body);
+
+	int first = c->loop;
+	c->loop = loop;
+	return first;
+}
+
+static
+void patch_breaks(struct Compiler *c, int first) {
+	int *breaks = c->breaks.mem;
+
+	for (int i = first; i < c->breaks.length; i++) {
+		patch(c, breaks[i], here(c));
+	}
+
+	vec_truncate(&c->breaks, first);
+}
+
+static
+void compile_local(struct Compiler *c, struct AST_Declaration *decl) {
+	int size = storage_size(c->types, decl->type.id);
+	int align = storage_align(c->types, decl->type.id);
+
+	c->frame = (c->frame + align - 1) / align * align;
+	int offset = c->frame;
+
+	c->frame += size;
+	c->frame_size = max(c->frame_size, c->frame);
+
+	// aggregates are zeroed in place, they have no initialiser
+	if (is_aggregate(c->types, decl->type.id)) {
+		bind(c->program, decl, SLOT_LOCAL, offset);
+		emit_operand(c, OP_LOCAL, offset, 1);
+		emit_operand(c, OP_CLEAR, size, -1);
+		return;
+	}
+
+	if (decl->value) {
+		compile_expression(c, decl->value);
+		convert(c, expression_type(decl->value), decl->type);
+	} else {
+		emit_operand(c, OP_PUSH, 0, 1);
+	}
+
+	bind(c->program, decl, SLOT_LOCAL, offset);
+	emit_operand(c, OP_SET8 + width(c, decl->type.id), offset, -1);
+}
+
+// label -1 is `otherwise`: the default, or the end
+static
+void jump_to_label(struct Compiler *c, enum Opcode op, int label, int otherwise) {
+	struct LabelJump jump = {
+		.operand = emit_operand(c, op, 0, op == OP_JUMP ? 0 : -1),
+		.label = label < 0 ? otherwise : label,
+	};
+
+	vec_push(&c->jumps, &jump);
+}
+
+// the value is in the frame at `slot`, pushed again for every test
+static
+void compile_cases(struct Compiler *c, struct SwitchPlan *plan, int node, int slot, int otherwise) {
+	for (; node >= 0; node = switch_node(plan, node)->next) {
+		struct SwitchNode *n = switch_node(plan, node);
+
+		if (n->always && (n->test == SWITCH_EQUAL || n->test == SWITCH_RANGE)) {
+			jump_to_label(c, OP_JUMP, n->label, otherwise);
+			return;
+		}
+
+		// a bit test always in range reloads the value for each mask
+		if (n->test != SWITCH_BITS || !n->always) emit_operand(c, OP_GET32, slot, 1);
+
+		switch (n->test) {
+			case SWITCH_EQUAL:
+				emit_operand(c, OP_PUSH, n->low, 1);
+				emit(c, OP_EQ, -1);
+				jump_to_label(c, OP_JNZ, n->label, otherwise);
+				break;
+
+			case SWITCH_RANGE:
+				emit_operand(c, OP_ADDI, -n->low, 0);
+				emit_operand(c, OP_PUSH, n->high - n->low, 1);
+				emit(c, OP_LE, -1);
+				jump_to_label(c, OP_JNZ, n->label, otherwise);
+				break;
+
+			// (mask >> (value - low)) & 1 for each label
+			case SWITCH_BITS: {
+				int skip = -1;
+
+				if (!n->always) {
+					emit_operand(c, OP_ADDI, -n->low, 0);
+					emit_operand(c, OP_PUSH, n->high - n->low, 1);
+					emit(c, OP_GT, -1);
+					skip = emit_operand(c, OP_JNZ, 0, -1);
+				}
+
+				for (int i = 0; i < n->count; i++) {
+					struct SwitchMask *mask = (struct SwitchMask *)plan->masks.mem + n->first + i;
+
+					emit_operand(c, OP_PUSH, mask->bits, 1);
+					emit_operand(c, OP_GET32, slot, 1);
+					emit_operand(c, OP_ADDI, -n->low, 0);
+					emit(c, OP_SHR, -1);
+					emit_operand(c, OP_PUSH, 1, 1);
+					emit(c, OP_AND, -1);
+					jump_to_label(c, OP_JNZ, mask->label, otherwise);
+				}
+
+				jump_to_label(c, OP_JUMP, -1, otherwise);
+				if (skip >= 0) patch(c, skip, here(c));
+				break;
+			}
+
+			// values out of range fall through to the next test
+			case SWITCH_TABLE: {
+				emit_operand(c, OP_ADDI, -n->low, 0);
+				emit_operand(c, OP_TABLE, n->count, -1);
+
+				int *entries = (int *)plan->entries.mem + n->first;
+
+				for (int i = 0; i < n->count; i++) {
+					struct LabelJump jump = { here(c), entries[i] < 0 ? otherwise : entries[i] };
+					int32_t target = 0;
+
+					vec_append(&c->program->code, &target, sizeof target);
+					vec_push(&c->jumps, &jump);
+				}
+
+				break;
+			}
+
+			case SWITCH_SPLIT: {
+				emit_operand(c, OP_PUSH, n->low, 1);
+				emit(c, plan->sign ? OP_ILT : OP_LT, -1);
+				int less = emit_operand(c, OP_JNZ, 0, -1);
+
+				compile_cases(c, plan, n->more, slot, otherwise);
+				patch(c, less, here(c));
+				compile_cases(c, plan, n->less, slot, otherwise);
+				return;
+			}
+		}
+	}
+
+	jump_to_label(c, OP_JUMP, -1, otherwise);
+}
+
+// the dispatch goes first, then the body with its labels in place
+static
+void compile_switch(struct Compiler *c, struct AST_StmtSwitch *s) {
+	struct SwitchPlan plan;
+	plan_switch(&plan, s, true);
+
+	int frame = c->frame;
+	c->frame = (c->frame + 3) & ~3;
+	int slot = c->frame;
+
+	c->frame += 4;
+	c->frame_size = max(c->frame_size, c->frame);
+
+	compile_expression(c, s->condition);
+	emit_operand(c, OP_SET32, slot, -1);
+
+	int *labels = c->labels, first = c->jumps.length;
+	c->labels = malloc((s->label_count + 1) * sizeof *c->labels);
+	if (!c->labels) errx("out of memory: failed to allocate %d labels", s->label_count);
+
+	compile_cases(c, &plan, plan.root, slot, s->otherwise >= 0 ? s->otherwise : s->label_count);
+
+	int breaks = compile_loop_body(c, s->body);
+	c->labels[s->label_count] = here(c);
+	patch_breaks(c, breaks);
+
+	struct LabelJump *jumps = c->jumps.mem;
+	for (int i = first; i < c->jumps.length; i++) patch(c, jumps[i].operand, c->labels[jumps[i].label]);
+	vec_truncate(&c->jumps, first);
+
+	free(c->labels);
+	free_switch_plan(&plan);
+	c->labels = labels;
+	c->frame = frame;
+}
+
+static
+void compile_statement(struct Compiler *c, struct AST_Statement *statement) {
+	switch (statement->type) {
+		case STMT_EXPRESSION: {
+			struct AST_Expression *expr = statement->expression;
+
+			// `local = value;` stores without keeping the value
+			if (expr->type == BINARY_OP && expr->binary_op.token->type == PUNCTUATION &&
+			    expr->binary_op.token->value == '=' && expr->binary_op.lhs->type == IDENTIFIER) {
+				struct AST_ExprBinaryOp op = expr->binary_op;
+				struct Slot *slot = variable(c, op.lhs->identifier.token, op.lhs->identifier.declaration);
+
+				if (slot && slot->kind == SLOT_LOCAL) {
+					compile_expression(c, op.rhs);
+					convert(c, expression_type(op.rhs), expression_type(op.lhs));
+					emit_operand(c, OP_SET8 + width(c, expression_type(op.lhs).id), slot->location, -1);
+					break;
+				}
+			}
+
+			compile_expression(c, expr);
+			emit(c, OP_POP, -1);
+			break;
+		}
+
+		case STMT_DECLARATION:
+			compile_local(c, statement->declaration);
+			break;
+
+		case STMT_BLOCK:
+			compile_body(c, statement->block.body);
+			break;
+
+		case STMT_IF: {
+			struct AST_StmtIf *conditional = &statement->conditional;
+
+			compile_expression(c, conditional->condition);
+			int otherwise = emit_operand(c, OP_JZ, 0, -1);
+
+			if (conditional->then) compile_body(c, conditional->then);
+
+			if (conditional->otherwise) {
+				int end = emit_operand(c, OP_JUMP, 0, 0);
+				patch(c, otherwise, here(c));
+
+				compile_body(c, conditional->otherwise);
+				patch(c, end, here(c));
+			} else {
+				patch(c, otherwise, here(c));
+			}
+
+			break;
+		}
+
+		// the condition goes after the body, one jump per iteration
+		case STMT_WHILE: {
+			int condition = emit_operand(c, OP_JUMP, 0, 0);
+			int body = here(c);
+
+			int first = compile_loop_body(c, statement->loop.body);
+			patch(c, condition, here(c));
+
+			compile_expression(c, statement->loop.condition);
+			emit_operand(c, OP_JNZ, body, -1);
+			patch_breaks(c, first);
+			break;
+		}
+
+		case STMT_DO: {
+			int body = here(c);
+			int first = compile_loop_body(c, statement->loop.body);
+
+			compile_expression(c, statement->loop.condition);
+			emit_operand(c, OP_JNZ, body, -1);
+			patch_breaks(c, first);
+			break;
+		}
+
+		case STMT_RETURN:
+			if (statement->expression) {
+				struct AST_Expression *value = statement->expression;
+
+				compile_expression(c, value);
+				convert(c, expression_type(value), c->function->type);
+			} else {
+				emit_operand(c, OP_PUSH, 0, 1);
+			}
+
+			emit(c, OP_RET, -1);
+			break;
+
+		case STMT_BREAK: {
+			int jump = emit_operand(c, OP_JUMP, 0, 0);
+			vec_push(&c->breaks, &jump);
+			break;
+		}
+
+		case STMT_SWITCH:
+			compile_switch(c, &statement->selection);
+			break;
+
+		case STMT_CASE:
+			c->labels[statement->label] = here(c);
+			break;
+	}
+}
+
+static
+void compile_function(struct Compiler *c, struct AST_Declaration *decl, int index) {
+	struct Function *function = (struct Function *)c->program->functions.mem + index;
+
+	c->function = decl;
+	c->depth = c->max_depth = 0;
+	c->frame = c->frame_size = 4 * decl->param_count;
+
+	for (int i = 0; i < decl->param_count; i++) {
+		bind(c->program, decl->params[i], SLOT_LOCAL, 4 * i);
+	}
+
+	function->entry = here(c);
+	compile_body(c, decl->body);
+
+	// falling off the end returns 0
+	emit_operand(c, OP_PUSH, 0, 1);
+	emit(c, OP_RET, -1);
+
+	function = (struct Function *)c->program->functions.mem + index;
+	function->frame_size = (c->frame_size + 3) & ~3;
+	function->max_stack = c->max_depth;
+}
+
+
+static
+void init_program(struct Program *program, struct TypeTable *types) {
+	*program = (struct Program) {
+		.types = types,
+		.code = vec(uint8_t),
+		.functions = vec(struct Function),
+		.data = vec(uint8_t),
+		.globals = vec(struct AST_Declaration *),
+		.main = -1,
+	};
+
+	uint8_t guard[NULL_GUARD] = {0};
+	vec_append(&program->data, guard, sizeof guard);
+}
+
+void compile_program(struct Program *program, struct TypeTable *types, struct AST_Declaration **declarations, int count) {
+	init_program(program, types);
+
+	struct Compiler c = {
+		.program = program,
+		.types = types,
+		.breaks = vec(int),
+		.jumps = vec(struct LabelJump),
+		.string_uses = vec(struct StringUse),
+	};
+
+	init_literal_pool(&c.strings);
+	int globals = NULL_GUARD;
+
+	// functions and globals get their slots first, bodies refer to any of them
+	for (int i = 0; i < count; i++) {
+		struct AST_Declaration *decl = declarations[i];
+
+		if (decl->function && decl->body) {
+			struct Function function = {
+				.declaration = decl,
+				.param_count = decl->param_count,
+			};
+
+			if (strcmp(decl->token->text, "main") == 0) program->main = program->functions.length;
+
+			bind(program, decl, SLOT_FUNCTION, program->functions.length);
+			vec_push(&program->functions, &function);
+		}
+
+		else if (!decl->function) {
+			int size = storage_size(types, decl->type.id);
+			int align = storage_align(types, decl->type.id);
+			globals = (globals + align - 1) / align * align;
+
+			bind(program, decl, SLOT_GLOBAL, globals);
+			vec_push(&program->globals, &decl);
+			globals += size;
+		}
+	}
+
+	// calls name the declaration in scope, which may be a prototype
+	for (int i = 0; i < count; i++) {
+		struct AST_Declaration *decl = declarations[i];
+		if (!decl->function || decl->body) continue;
+
+		struct Function *functions = program->functions.mem;
+
+		for (int j = 0; j < program->functions.length; j++) {
+			if (strcmp(functions[j].declaration->token->text, decl->token->text) == 0) {
+				bind(program, decl, SLOT_FUNCTION, j);
+				break;
+			}
+		}
+	}
+
+	// globals are zero until initialised, strings go after them
+	uint8_t zero = 0;
+	while (program->data.length < globals) vec_push(&program->data, &zero);
+
+	if (program->main < 0) errx("no function `main` to run");
+
+	struct Function *main = (struct Function *)program->functions.mem + program->main;
+	if (main->param_count != 0) errx("`main` must take no parameters to be run");
+
+	for (int i = 0; i < program->functions.length; i++) {
+		struct Function *function = (struct Function *)program->functions.mem + i;
+		compile_function(&c, function->declaration, i);
+	}
+
+	// initialisers run in order, then main
+	program->start = here(&c);
+	c.depth = c.max_depth = 0;
+	c.frame = c.frame_size = 0;
+
+	struct AST_Declaration **variables = program->globals.mem;
+
+	for (int i = 0; i < program->globals.length; i++) {
+		struct AST_Declaration *decl = variables[i];
+		if (decl->value == NULL) continue;
+
+		emit_operand(&c, OP_PUSH, find_slot(program, decl)->location, 1);
+		compile_expression(&c, decl->value);
+		convert(&c, expression_type(decl->value), decl->type);
+		emit(&c, OP_STORE8 + width(&c, decl->type.id), -1);
+		emit(&c, OP_POP, -1);
+	}
+
+	emit_operand(&c, OP_CALL, program->main, 1);
+	emit(&c, OP_HALT, 0);
+	program->max_stack = c.max_depth;
+
+	// the literals follow the globals as one blob
+	layout_literals(&c.strings);
+	int strings = program->data.length;
+	vec_append(&program->data, c.strings.blob.mem, c.strings.blob.length);
+
+	struct StringUse *uses = c.string_uses.mem;
+	for (int i = 0; i < c.string_uses.length; i++) patch(&c, uses[i].operand, strings + literal_offset(&c.strings, uses[i].id));
+
+	for (int i = 0; i < program->slot_capacity; i++) {
+		struct Slot *slot = &program->slots[i];
+		if (slot->key && slot->kind == SLOT_STRING) slot->location = strings + literal_offset(&c.strings, slot->location);
+	}
+
+	vec_free(&c.breaks);
+	vec_free(&c.jumps);
+	vec_free(&c.string_uses);
+	free_literal_pool(&c.strings);
+}
+
+bool compile_constant(struct Program *program, struct TypeTable *types, struct AST_Expression *expr,
+                      struct Callees *callees) {
+	init_program(program, types);
+
+	struct Compiler c = {
+		.program = program,
+		.types = types,
+		.breaks = vec(int),
+		.jumps = vec(struct LabelJump),
+		.constant = true,
+		.callees = callees,
+	};
+
+	program->start = here(&c);
+	compile_expression(&c, expr);
+	emit(&c, OP_HALT, 0);
+	program->max_stack = c.max_depth;
+
+	// the functions it calls, and the ones they call in turn
+	for (int i = 0; i < program->functions.length && !c.failed; i++) {
+		struct Function *function = (struct Function *)program->functions.mem + i;
+		compile_function(&c, function->declaration, i);
+	}
+
+	vec_free(&c.breaks);
+	vec_free(&c.jumps);
+	return !c.failed;
+}
+
+void free_program(struct Program *program) {
+	vec_free(&program->code);
+	vec_free(&program->functions);
+	vec_free(&program->data);
+	vec_free(&program->globals);
+	free(program->slots);
+	program->slots = NULL;
+	program->slot_count = program->slot_capacity = 0;
+}
@@ -0,0 +1,133 @@
+#ifndef BYTECODE_H_
+#define BYTECODE_H_
+
+#include "ast.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Callees;
+
+// bytecode:
+//
+// the type checked AST lowers to code for a stack machine. an instruction
+// is one opcode byte, some are followed by a 32-bit operand. values are 32
+// bits: u8 and u16 are kept zero-extended and truncated when converted to,
+// int has the bits of u32 but divides, shifts and compares signed. pointers
+// are 32-bit addresses into the memory of the machine, which holds strings,
+// globals and the frames of calls, so any variable can be referenced.
+// memory is little-endian.
+//
+// the operand of a jump is an offset into the code, of a call the index of
+// the function. each function records how deep its operand stack gets, so
+// calls check for overflow once.
+//
+
+enum Opcode {
+	OP_HALT,   // returns the top of the stack
+	OP_PUSH,   // imm
+	OP_POP,
+	OP_DUP,
+	OP_LOCAL,  // imm: address of the frame + imm
+	OP_CLEAR,  // imm: bytes, address ->
+
+	// loads and stores by width, in the order 8, 16, 32
+	OP_LOAD8, OP_LOAD16, OP_LOAD32,       // address -> value
+	OP_STORE8, OP_STORE16, OP_STORE32,    // address value -> value
+	OP_GET8, OP_GET16, OP_GET32,          // imm: frame offset, -> value
+	OP_SET8, OP_SET16, OP_SET32,          // imm: frame offset, value ->
+	OP_INC8, OP_INC16, OP_INC32,          // imm: step, address -> new value
+	OP_POSTINC8, OP_POSTINC16, OP_POSTINC32, // imm: step, address -> old value
+
+	// a b -> a op b
+	OP_ADD, OP_SUB, OP_MUL,
+	OP_DIV, OP_IDIV, OP_MOD, OP_IMOD,
+	OP_AND, OP_OR, OP_XOR,
+	OP_SHL, OP_SHR, OP_SAR,
+	OP_EQ, OP_NE,
+	OP_LT, OP_LE, OP_GT, OP_GE,
+	OP_ILT, OP_ILE, OP_IGT, OP_IGE,
+	OP_ADDI, // imm: a -> a + imm
+	OP_MULHI, OP_IMULHI, // a b -> the high half of their 64-bit product
+	OP_CHECK, // imm: length, a -> a, faults unless a is below it as unsigned
+
+	// a -> op a
+	OP_NEG, OP_NOT, OP_LNOT, OP_BOOL,
+	OP_TRUNC8, OP_TRUNC16,
+
+	// imm: bits of the operand's type
+	OP_CLZ, OP_CTZ, OP_POPCOUNT, OP_BSWAP, // a -> op a
+	OP_ROTATE, // a b -> a rotated left by b
+
+	OP_JUMP, // imm: target
+	OP_JZ,   // imm: target, pops the condition
+	OP_JNZ,
+	OP_TABLE, // imm: n, then n targets: pops an index below n and jumps to its target, falls past them otherwise
+	OP_CALL, // imm: function, arguments -> result
+	OP_RET,  // result ->
+
+	OP_COUNT,
+};
+
+struct Function {
+	struct AST_Declaration *declaration;
+	int entry;       // offset in the code
+	int frame_size;  // bytes of parameters and locals
+	int max_stack;   // operand stack values
+	int param_count; // each in a 32-bit slot at the start of the frame
+};
+
+enum SlotKind {
+	SLOT_GLOBAL,   // location is an address
+	SLOT_LOCAL,    // location is an offset in the frame
+	SLOT_FUNCTION, // location is an index into functions
+	SLOT_STRING,   // location is an address
+};
+
+// keyed by declaration, or by the token of a string literal
+struct Slot {
+	const void *key;
+	enum SlotKind kind;
+	int location;
+};
+
+enum {
+	NULL_GUARD = 16, // addresses below are never valid
+};
+
+struct Program {
+	struct TypeTable *types;
+	struct Vec code;      // uint8_t
+	struct Vec functions; // struct Function
+	struct Vec data;      // uint8_t, memory from address 0: globals, then strings
+	struct Vec globals;   // struct AST_Declaration *, in order
+
+	// open addressing on the key
+	struct Slot *slots;
+	int slot_count, slot_capacity;
+
+	// initialises the globals, calls main and halts with its result
+	int start;
+	int max_stack;
+	int main; // function index
+};
+
+// lowers every definition, errors are fatal
+void compile_program(struct Program *, struct TypeTable *, struct AST_Declaration **, int count);
+void free_program(struct Program *);
+
+// compiles an expression to code that halts with its value, false if it is
+// not constant: it reads no globals or strings, and calls only functions
+// whose definitions `callees` gives, which are compiled with it
+bool compile_constant(struct Program *, struct TypeTable *, struct AST_Expression *, struct Callees *);
+
+struct Slot *find_slot(struct Program *, const void *key);
+
+// bytes a value of the type takes in memory: 1, 2 or 4, or the size of an
+// aggregate, which is never a value on the stack
+int storage_size(struct TypeTable *, unsigned id);
+int storage_align(struct TypeTable *, unsigned id);
+
+#endif //BYTECODE_H_
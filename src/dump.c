@@ -0,0 +1,520 @@
+#include "dump.h"
+
+#include "ast.h"
+#include "parser.h"
+#include "snapshot.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+static
+void put(struct Vec *out, const char *text) {
+	vec_append(out, text, strlen(text));
+}
+
+static
+void indent(struct Vec *out, int depth) {
+	static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+	for (; depth > 0; depth -= sizeof tabs - 1) {
+		vec_append(out, tabs, min(depth, sizeof tabs - 1));
+	}
+}
+
+static
+void put_line(struct Vec *out, int depth, const char *text) {
+	indent(out, depth);
+	put(out, text);
+	put(out, "\n");
+}
+
+// decimal without printf, most of a dump is numbers and names
+static
+char *format_unsigned(char *end, unsigned value) {
+	*--end = 0;
+	do *--end = '0' + value % 10; while (value /= 10);
+	return end;
+}
+
+// as print_type does, but whole however long the type is
+static
+void put_type(struct Vec *out, struct TypeTable *types, unsigned id) {
+	static const char *names[] = {
+		[VOID] = "void", [U8] = "u8", [U16] = "u16", [U32] = "u32", [INT] = "int",
+		[U8X16] = "u8x16", [U32X4] = "u32x4",
+	};
+
+	struct TypeEntry *T = get_type(types, id);
+	char number[16];
+
+	switch (T->kind) {
+		case TYPE_BASIC:
+			put(out, names[T->basic]);
+			break;
+
+		case TYPE_POINTER:
+			put_type(out, types, T->base);
+			put(out, is_pointer(types, T->base) ? "*" : " *");
+			break;
+
+		case TYPE_ARRAY:
+			put_type(out, types, T->base);
+			put(out, " [");
+			put(out, T->length < 0 ? "-" : "");
+			put(out, format_unsigned(number + sizeof number, T->length < 0 ? -(unsigned)T->length : (unsigned)T->length));
+			put(out, "]");
+			break;
+
+		case TYPE_STRUCT:
+		case TYPE_UNION:
+			put(out, T->kind == TYPE_STRUCT ? "struct " : "union ");
+			put(out, T->token ? T->token->text : "<anonymous>");
+			break;
+	}
+}
+
+// `u32 x`, `u8 *p`
+static
+void put_declarator(struct Vec *out, struct TypeTable *types, unsigned id, const char *name) {
+	put_type(out, types, id);
+	if (!is_pointer(types, id)) put(out, " ");
+	put(out, name);
+}
+
+static
+const char *operator_name(struct Token *token) {
+	switch (token->type) {
+		case KEYWORD_SIZEOF: return "sizeof";
+		case KEYWORD_ELSE:   return "else";
+		default: break;
+	}
+
+	switch (token->value) {
+		case INC:      return "++";
+		case DEC:      return "--";
+		case POST_INC: return "++ (postfix)";
+		case POST_DEC: return "-- (postfix)";
+		case SHL:      return "<<";
+		case SHR:      return ">>";
+		case EQ:       return "==";
+		case NEQ:      return "!=";
+		case LEQ:      return "<=";
+		case GEQ:      return ">=";
+		case AND:      return "&&";
+		case OR:       return "||";
+		case COM:      return "::";
+		case '[':      return "[]";
+	}
+
+	// single characters, indexed by value
+	static const char ascii[128][2] = {
+		['!'] = "!", ['%'] = "%", ['&'] = "&", ['*'] = "*", ['+'] = "+", [','] = ",",
+		['-'] = "-", ['.'] = ".", ['/'] = "/", ['<'] = "<", ['='] = "=", ['>'] = ">",
+		['?'] = "?", ['^'] = "^", ['|'] = "|", ['~'] = "~", [':'] = ":",
+	};
+
+	return token->value < 128 && ascii[token->value][0] ? ascii[token->value] : "?";
+}
+
+void dump_expression(struct Vec *out, struct TypeTable *types, struct AST_Expression *expr, int depth) {
+	char number[16];
+
+	if (expr == NULL) {
+		put_line(out, depth, "NULL");
+		return;
+	}
+
+	switch (expr->type) {
+		case LITERAL:
+			put_line(out, depth, format_unsigned(number + sizeof number, expr->literal.value));
+			break;
+
+		case STRING:
+			indent(out, depth);
+			put(out, "\"");
+			put(out, expr->string.token->text);
+			put(out, "\"\n");
+			break;
+
+		case IDENTIFIER:
+			indent(out, depth);
+			put(out, "ID(");
+			put(out, expr->identifier.token->text);
+			put(out, ")\n");
+			break;
+
+		case UNARY_OP:
+			put_line(out, depth, operator_name(expr->unary_op.token));
+			dump_expression(out, types, expr->unary_op.rhs, depth + 1);
+			break;
+
+		case BINARY_OP:
+			put_line(out, depth, operator_name(expr->binary_op.token));
+			dump_expression(out, types, expr->binary_op.lhs, depth + 1);
+			dump_expression(out, types, expr->binary_op.rhs, depth + 1);
+			break;
+
+		case TYPE_CAST:
+			indent(out, depth);
+			put(out, "(");
+			put_type(out, types, expr->type_cast.type.id);
+			put(out, ")\n");
+			dump_expression(out, types, expr->type_cast.rhs, depth + 1);
+			break;
+
+		case FUNC_CALL:
+			put_line(out, depth, expr->func_call.builtin ? "builtin" : "call");
+			dump_expression(out, types, expr->func_call.func, depth + 1);
+			if (expr->func_call.args) dump_expression(out, types, expr->func_call.args, depth + 1);
+			break;
+	}
+}
+
+// the values of an int switch print signed
+static
+void dump_labels(struct Vec *out, struct AST_StmtSwitch *s, int label, int depth) {
+	bool sign = expression_type(s->condition).id == INT;
+	char buffer[16];
+
+	for (int i = 0; i < s->case_count; i++) {
+		if (s->cases[i].label != label) continue;
+
+		int32_t value = s->cases[i].value;
+
+		indent(out, depth);
+		put(out, sign && value < 0 ? "case -" : "case ");
+		put(out, format_unsigned(buffer + sizeof buffer, sign && value < 0 ? -(uint32_t)value : (uint32_t)value));
+		put(out, "\n");
+	}
+
+	if (s->otherwise == label) put_line(out, depth, "default");
+}
+
+void dump_statement(struct Vec *out, struct TypeTable *types, struct AST_Statement *stmt, int depth) {
+	switch (stmt->type) {
+		case STMT_EXPRESSION:
+			dump_expression(out, types, stmt->expression, depth);
+			break;
+
+		case STMT_DECLARATION:
+			dump_declaration(out, types, stmt->declaration, depth);
+			break;
+
+		case STMT_BLOCK:
+			put_line(out, depth, "{");
+			for (struct AST_Statement *s = stmt->block.body; s; s = s->next) {
+				dump_statement(out, types, s, depth + 1);
+			}
+			put_line(out, depth, "}");
+			break;
+
+		case STMT_IF:
+			put_line(out, depth, "if");
+			dump_expression(out, types, stmt->conditional.condition, depth + 1);
+			dump_statement(out, types, stmt->conditional.then, depth + 1);
+
+			if (stmt->conditional.otherwise) {
+				put_line(out, depth, "else");
+				dump_statement(out, types, stmt->conditional.otherwise, depth + 1);
+			}
+			break;
+
+		case STMT_WHILE:
+			put_line(out, depth, "while");
+			dump_expression(out, types, stmt->loop.condition, depth + 1);
+			dump_statement(out, types, stmt->loop.body, depth + 1);
+			break;
+
+		case STMT_DO:
+			put_line(out, depth, "do");
+			dump_statement(out, types, stmt->loop.body, depth + 1);
+			put_line(out, depth, "while");
+			dump_expression(out, types, stmt->loop.condition, depth + 1);
+			break;
+
+		case STMT_RETURN:
+			put_line(out, depth, "return");
+			if (stmt->expression) dump_expression(out, types, stmt->expression, depth + 1);
+			break;
+
+		case STMT_BREAK:
+			put_line(out, depth, "break");
+			break;
+
+		// labels sit at the level of the switch, their statements below
+		case STMT_SWITCH:
+			put_line(out, depth, "switch");
+			dump_expression(out, types, stmt->selection.condition, depth + 1);
+
+			for (struct AST_Statement *s = stmt->selection.body; s; s = s->next) {
+				if (s->type == STMT_CASE) dump_labels(out, &stmt->selection, s->label, depth);
+				else                      dump_statement(out, types, s, depth + 1);
+			}
+			break;
+
+		// only ever in the body of a switch
+		case STMT_CASE:
+			break;
+	}
+}
+
+void dump_declaration(struct Vec *out, struct TypeTable *types, struct AST_Declaration *decl, int depth) {
+	indent(out, depth);
+	put_declarator(out, types, decl->type.id, decl->token->text);
+
+	if (decl->function) {
+		put(out, "(");
+
+		for (int i = 0; i < decl->param_count; i++) {
+			struct AST_Declaration *param = decl->params[i];
+
+			put(out, i ? ", " : "");
+			put_declarator(out, types, param->type.id, param->token->text);
+		}
+
+		put(out, decl->param_count ? ")" : "void)");
+	}
+
+	put(out, decl->value ? " =\n" : "\n");
+
+	if (decl->value) dump_expression(out, types, decl->value, depth + 1);
+	if (decl->body) dump_statement(out, types, decl->body, depth + 1);
+}
+
+
+// snapshots, dumped exactly as the AST they were written from
+
+static
+void put_snap_type(struct Vec *out, const struct SnapHeader *header, uint32_t id) {
+	static const char *names[] = {
+		[VOID] = "void", [U8] = "u8", [U16] = "u16", [U32] = "u32", [INT] = "int",
+		[U8X16] = "u8x16", [U32X4] = "u32x4",
+	};
+
+	const struct SnapType *types = snap_get(&header->types), *T = &types[id];
+	char number[16];
+
+	switch (T->kind) {
+		case TYPE_BASIC:
+			put(out, names[T->basic]);
+			break;
+
+		case TYPE_POINTER:
+			put_snap_type(out, header, T->base);
+			put(out, types[T->base].kind == TYPE_POINTER ? "*" : " *");
+			break;
+
+		case TYPE_ARRAY:
+			put_snap_type(out, header, T->base);
+			put(out, " [");
+			put(out, T->length < 0 ? "-" : "");
+			put(out, format_unsigned(number + sizeof number, T->length < 0 ? -(uint32_t)T->length : (uint32_t)T->length));
+			put(out, "]");
+			break;
+
+		case TYPE_STRUCT:
+		case TYPE_UNION:
+			put(out, T->kind == TYPE_STRUCT ? "struct " : "union ");
+			put(out, T->name ? (const char *)snap_get(&T->name) : "<anonymous>");
+			break;
+	}
+}
+
+static
+void put_snap_declarator(struct Vec *out, const struct SnapHeader *header, uint32_t id, const char *name) {
+	const struct SnapType *types = snap_get(&header->types);
+
+	put_snap_type(out, header, id);
+	if (types[id].kind != TYPE_POINTER) put(out, " ");
+	put(out, name);
+}
+
+static
+void dump_snap_expression(struct Vec *out, const struct SnapHeader *header, const struct SnapExpression *expr, int depth) {
+	char number[16];
+
+	if (expr == NULL) {
+		put_line(out, depth, "NULL");
+		return;
+	}
+
+	struct Token token = { .type = expr->token_type, .value = expr->value };
+
+	switch (expr->kind) {
+		case LITERAL:
+			put_line(out, depth, format_unsigned(number + sizeof number, expr->value));
+			break;
+
+		case STRING:
+			indent(out, depth);
+			put(out, "\"");
+			put(out, snap_get(&expr->text));
+			put(out, "\"\n");
+			break;
+
+		case IDENTIFIER:
+			indent(out, depth);
+			put(out, "ID(");
+			put(out, snap_get(&expr->text));
+			put(out, ")\n");
+			break;
+
+		case UNARY_OP:
+			put_line(out, depth, operator_name(&token));
+			dump_snap_expression(out, header, snap_get(&expr->rhs), depth + 1);
+			break;
+
+		case BINARY_OP:
+			put_line(out, depth, operator_name(&token));
+			dump_snap_expression(out, header, snap_get(&expr->lhs), depth + 1);
+			dump_snap_expression(out, header, snap_get(&expr->rhs), depth + 1);
+			break;
+
+		case TYPE_CAST:
+			indent(out, depth);
+			put(out, "(");
+			put_snap_type(out, header, expr->type);
+			put(out, ")\n");
+			dump_snap_expression(out, header, snap_get(&expr->rhs), depth + 1);
+			break;
+
+		case FUNC_CALL:
+			put_line(out, depth, expr->value ? "builtin" : "call");
+			dump_snap_expression(out, header, snap_get(&expr->lhs), depth + 1);
+			if (expr->rhs) dump_snap_expression(out, header, snap_get(&expr->rhs), depth + 1);
+			break;
+	}
+}
+
+static
+void dump_snap_declaration(struct Vec *, const struct SnapHeader *, const struct SnapDeclaration *, int depth);
+
+static
+void dump_snap_statement(struct Vec *, const struct SnapHeader *, const struct SnapStatement *, int depth);
+
+static
+void dump_snap_labels(struct Vec *out, const struct SnapStatement *s, bool sign, int label, int depth) {
+	const struct SnapCase *cases = snap_get(&s->cases);
+	char buffer[16];
+
+	for (uint32_t i = 0; i < s->case_count; i++) {
+		if (cases[i].label != label) continue;
+
+		int32_t value = cases[i].value;
+
+		indent(out, depth);
+		put(out, sign && value < 0 ? "case -" : "case ");
+		put(out, format_unsigned(buffer + sizeof buffer, sign && value < 0 ? -(uint32_t)value : (uint32_t)value));
+		put(out, "\n");
+	}
+
+	if (s->label == label) put_line(out, depth, "default");
+}
+
+static
+void dump_snap_statement(struct Vec *out, const struct SnapHeader *header, const struct SnapStatement *stmt, int depth) {
+	switch (stmt->kind) {
+		case STMT_EXPRESSION:
+			dump_snap_expression(out, header, snap_get(&stmt->expression), depth);
+			break;
+
+		case STMT_DECLARATION:
+			dump_snap_declaration(out, header, snap_get(&stmt->declaration), depth);
+			break;
+
+		case STMT_BLOCK:
+			put_line(out, depth, "{");
+			for (const struct SnapStatement *s = snap_get(&stmt->body); s; s = snap_get(&s->next)) {
+				dump_snap_statement(out, header, s, depth + 1);
+			}
+			put_line(out, depth, "}");
+			break;
+
+		case STMT_IF:
+			put_line(out, depth, "if");
+			dump_snap_expression(out, header, snap_get(&stmt->expression), depth + 1);
+			dump_snap_statement(out, header, snap_get(&stmt->body), depth + 1);
+
+			if (stmt->otherwise) {
+				put_line(out, depth, "else");
+				dump_snap_statement(out, header, snap_get(&stmt->otherwise), depth + 1);
+			}
+			break;
+
+		case STMT_WHILE:
+			put_line(out, depth, "while");
+			dump_snap_expression(out, header, snap_get(&stmt->expression), depth + 1);
+			dump_snap_statement(out, header, snap_get(&stmt->body), depth + 1);
+			break;
+
+		case STMT_DO:
+			put_line(out, depth, "do");
+			dump_snap_statement(out, header, snap_get(&stmt->body), depth + 1);
+			put_line(out, depth, "while");
+			dump_snap_expression(out, header, snap_get(&stmt->expression), depth + 1);
+			break;
+
+		case STMT_RETURN:
+			put_line(out, depth, "return");
+			if (stmt->expression) dump_snap_expression(out, header, snap_get(&stmt->expression), depth + 1);
+			break;
+
+		case STMT_BREAK:
+			put_line(out, depth, "break");
+			break;
+
+		case STMT_SWITCH: {
+			const struct SnapExpression *condition = snap_get(&stmt->expression);
+			bool sign = condition && condition->type == INT;
+
+			put_line(out, depth, "switch");
+			dump_snap_expression(out, header, condition, depth + 1);
+
+			for (const struct SnapStatement *s = snap_get(&stmt->body); s; s = snap_get(&s->next)) {
+				if (s->kind == STMT_CASE) dump_snap_labels(out, stmt, sign, s->label, depth);
+				else                      dump_snap_statement(out, header, s, depth + 1);
+			}
+			break;
+		}
+
+		case STMT_CASE:
+			break;
+	}
+}
+
+static
+void dump_snap_declaration(struct Vec *out, const struct SnapHeader *header, const struct SnapDeclaration *decl, int depth) {
+	indent(out, depth);
+	put_snap_declarator(out, header, decl->type, snap_get(&decl->name));
+
+	if (decl->function) {
+		const int32_t *params = snap_get(&decl->params);
+		put(out, "(");
+
+		for (int i = 0; i < decl->param_count; i++) {
+			const struct SnapDeclaration *param = snap_get(&params[i]);
+
+			put(out, i ? ", " : "");
+			put_snap_declarator(out, header, param->type, snap_get(&param->name));
+		}
+
+		put(out, decl->param_count ? ")" : "void)");
+	}
+
+	put(out, decl->value ? " =\n" : "\n");
+
+	if (decl->value) dump_snap_expression(out, header, snap_get(&decl->value), depth + 1);
+	if (decl->body) dump_snap_statement(out, header, snap_get(&decl->body), depth + 1);
+}
+
+void dump_snapshot(struct Vec *out, const struct SnapHeader *header) {
+	const int32_t *declarations = snap_get(&header->declarations);
+
+	for (uint32_t i = 0; i < header->declaration_count; i++) {
+		dump_snap_declaration(out, header, snap_get(&declarations[i]), 0);
+	}
+}
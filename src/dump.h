@@ -0,0 +1,18 @@
+#ifndef DUMP_H_
+#define DUMP_H_
+
+#include "ast.h"
+#include "snapshot.h"
+#include "types.h"
+#include "util.h"
+
+// text dump of the AST, appended to a buffer (chars): one node per line,
+// children indented by one tab more than their parent
+void dump_expression(struct Vec *, struct TypeTable *, struct AST_Expression *, int depth);
+void dump_statement(struct Vec *, struct TypeTable *, struct AST_Statement *, int depth);
+void dump_declaration(struct Vec *, struct TypeTable *, struct AST_Declaration *, int depth);
+
+// the declarations of a mapped snapshot, as dump_declaration printed them
+void dump_snapshot(struct Vec *, const struct SnapHeader *);
+
+#endif //DUMP_H_
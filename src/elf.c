@@ -0,0 +1,331 @@
+#include "elf.h"
+
+#include "assembler.h"
+#include "ast.h"
+#include "literals.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+#include "x86.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum {
+	SECTION_TEXT = 1,
+	SECTION_RODATA,
+	SECTION_DATA,
+	SECTION_BSS,
+	SECTION_RELA_TEXT,
+	SECTION_RELA_DATA,
+	SECTION_SYMTAB,
+	SECTION_STRTAB,
+	SECTION_SHSTRTAB,
+	SECTION_NOTE,
+	SECTION_COUNT,
+};
+
+// the file symbol and the section symbol of .rodata, which strings are relative to
+enum {
+	SYMBOL_FILE = 1,
+	SYMBOL_RODATA,
+	FIRST_GLOBAL,
+};
+
+static const char section_names[] =
+	"\0.text\0.rodata\0.data\0.bss\0.rela.text\0.rela.data\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+
+// the symbol of each declaration, sorted by declaration
+struct Binding {
+	const void *declaration;
+	int symbol;
+};
+
+static
+int compare_bindings(const void *a, const void *b) {
+	uintptr_t x = (uintptr_t)((const struct Binding *)a)->declaration;
+	uintptr_t y = (uintptr_t)((const struct Binding *)b)->declaration;
+	return (x > y) - (x < y);
+}
+
+static
+int find_symbol(struct Vec *bindings, const void *declaration) {
+	struct Binding key = { .declaration = declaration };
+	struct Binding *binding = bsearch(&key, bindings->mem, bindings->length, sizeof key, compare_bindings);
+
+	assert(binding);
+	return binding->symbol;
+}
+
+static
+int align_to(int offset, int align) {
+	return (offset + align - 1) / align * align;
+}
+
+static
+int add_name(struct Vec *names, const char *text) {
+	int offset = names->length;
+	vec_append(names, text, strlen(text) + 1);
+	return offset;
+}
+
+static
+int section_name(const char *name) {
+	for (int i = 1; i < (int)sizeof section_names; i++) {
+		if (section_names[i - 1] == 0 && strcmp(section_names + i, name) == 0) return i;
+	}
+
+	assert(0 && "unreachable");
+	return 0;
+}
+
+void emit_object(const char *path, const char *source, struct TypeTable *types,
+                 struct AST_Declaration **declarations, int count, unsigned features) {
+	struct Assembler as;
+	init_assembler(&as, NULL);
+	generate_code(&as, types, declarations, count, features);
+
+	struct CodeSymbol *functions = as.functions.mem;
+
+	struct Vec symbols = vec(Elf64_Sym);
+	struct Vec names = vec(char);
+	struct Vec bindings = vec(struct Binding);
+	struct Vec data = vec(uint8_t);
+	struct Vec data_relocations = vec(Elf64_Rela);
+	int bss = 0, defined = 0;
+
+	Elf64_Sym null = { 0 };
+	vec_push(&symbols, &null);
+	vec_push(&names, &null.st_name);
+
+	Elf64_Sym file = {
+		.st_name = add_name(&names, source),
+		.st_info = ELF64_ST_INFO(STB_LOCAL, STT_FILE),
+		.st_shndx = SHN_ABS,
+	};
+
+	Elf64_Sym rodata = {
+		.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION),
+		.st_shndx = SECTION_RODATA,
+	};
+
+	vec_push(&symbols, &file);
+	vec_push(&symbols, &rodata);
+
+	// strings are numbered as they are found, string initialisers add some
+	struct Vec initialisers = vec(int);
+
+	for (int i = 0; i < count; i++) {
+		struct AST_Declaration *decl = declarations[i];
+		if (decl->function && !decl->body) continue;
+
+		struct Binding binding = { decl, symbols.length };
+
+		Elf64_Sym symbol = {
+			.st_name = add_name(&names, decl->token->text),
+			.st_info = ELF64_ST_INFO(STB_GLOBAL, decl->function ? STT_FUNC : STT_OBJECT),
+		};
+
+		if (decl->function) {
+			symbol.st_shndx = SECTION_TEXT;
+			symbol.st_value = functions[defined].offset;
+			symbol.st_size = functions[defined].size;
+			defined++;
+		} else {
+			int size = type_size(types, decl->type.id);
+			int align = type_align(types, decl->type.id);
+			symbol.st_size = size;
+
+			if (decl->value == NULL) {
+				bss = align_to(bss, align);
+				symbol.st_shndx = SECTION_BSS;
+				symbol.st_value = bss;
+				bss += size;
+			} else {
+				uint8_t zero = 0;
+				while (data.length % align) vec_push(&data, &zero);
+
+				symbol.st_shndx = SECTION_DATA;
+				symbol.st_value = data.length;
+
+				uint64_t bits;
+				int string = global_value(&as, types, decl, &bits);
+
+				if (string >= 0) {
+					int at[2] = { data.length, string };
+					vec_append(&initialisers, at, 2);
+				}
+
+				vec_append(&data, &bits, size);
+			}
+		}
+
+		vec_push(&symbols, &symbol);
+		vec_push(&bindings, &binding);
+	}
+
+	// calls name the declaration in scope, which may be a prototype: it
+	// shares the symbol of the definition or of the first prototype
+	for (int i = 0; i < count; i++) {
+		struct AST_Declaration *decl = declarations[i];
+		if (!decl->function || decl->body) continue;
+
+		struct Binding *bound = bindings.mem;
+		struct Binding binding = { decl, -1 };
+
+		for (int j = 0; j < bindings.length && binding.symbol < 0; j++) {
+			struct AST_Declaration *other = (struct AST_Declaration *)bound[j].declaration;
+			if (other->function && strcmp(other->token->text, decl->token->text) == 0) binding.symbol = bound[j].symbol;
+		}
+
+		if (binding.symbol < 0) {
+			Elf64_Sym symbol = {
+				.st_name = add_name(&names, decl->token->text),
+				.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE),
+				.st_shndx = SHN_UNDEF,
+			};
+
+			binding.symbol = symbols.length;
+			vec_push(&symbols, &symbol);
+		}
+
+		vec_push(&bindings, &binding);
+	}
+
+	qsort(bindings.mem, bindings.length, sizeof(struct Binding), compare_bindings);
+
+	// .rodata is the blob of the literal pool
+	layout_literals(&as.strings);
+	struct Vec *text = &as.strings.blob;
+
+	int *initialiser = initialisers.mem;
+
+	for (int i = 0; i < initialisers.length; i += 2) {
+		Elf64_Rela rela = {
+			.r_offset = initialiser[i],
+			.r_info = ELF64_R_INFO(SYMBOL_RODATA, R_X86_64_64),
+			.r_addend = literal_offset(&as.strings, initialiser[i + 1]),
+		};
+
+		vec_push(&data_relocations, &rela);
+	}
+
+	// .rela.text
+	struct Relocation *relocations = as.relocations.mem;
+	Elf64_Rela *text_relocations = malloc((as.relocations.length + 1) * sizeof *text_relocations);
+	if (!text_relocations) errx("out of memory: failed to allocate %d relocations", as.relocations.length);
+
+	for (int i = 0; i < as.relocations.length; i++) {
+		struct Relocation *relocation = &relocations[i];
+		int type = relocation->type == RELOCATION_PLT32 ? R_X86_64_PLT32 : R_X86_64_PC32;
+		int symbol = SYMBOL_RODATA;
+		int64_t addend = relocation->addend;
+
+		if (relocation->kind == TARGET_STRING) addend += literal_offset(&as.strings, relocation->string);
+		else                                   symbol = find_symbol(&bindings, relocation->symbol);
+
+		text_relocations[i] = (Elf64_Rela) {
+			.r_offset = relocation->offset,
+			.r_info = ELF64_R_INFO(symbol, type),
+			.r_addend = addend,
+		};
+	}
+
+	// the whole file: header, section contents, section headers
+	Elf64_Shdr sections[SECTION_COUNT] = { 0 };
+
+	struct {
+		const char *name;
+		int type, flags, align, entry;
+		const void *contents;
+		int size;
+	} layout[SECTION_COUNT] = {
+		[SECTION_TEXT]      = { ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16, 0, as.code.mem, as.code.length },
+		[SECTION_RODATA]    = { ".rodata", SHT_PROGBITS, SHF_ALLOC, 1, 0, text->mem, text->length },
+		[SECTION_DATA]      = { ".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 8, 0, data.mem, data.length },
+		[SECTION_BSS]       = { ".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 8, 0, NULL, bss },
+		[SECTION_RELA_TEXT] = { ".rela.text", SHT_RELA, SHF_INFO_LINK, 8, sizeof(Elf64_Rela),
+		                        text_relocations, as.relocations.length * sizeof(Elf64_Rela) },
+		[SECTION_RELA_DATA] = { ".rela.data", SHT_RELA, SHF_INFO_LINK, 8, sizeof(Elf64_Rela),
+		                        data_relocations.mem, data_relocations.length * sizeof(Elf64_Rela) },
+		[SECTION_SYMTAB]    = { ".symtab", SHT_SYMTAB, 0, 8, sizeof(Elf64_Sym), symbols.mem, symbols.length * sizeof(Elf64_Sym) },
+		[SECTION_STRTAB]    = { ".strtab", SHT_STRTAB, 0, 1, 0, names.mem, names.length },
+		[SECTION_SHSTRTAB]  = { ".shstrtab", SHT_STRTAB, 0, 1, 0, section_names, sizeof section_names },
+		[SECTION_NOTE]      = { ".note.GNU-stack", SHT_PROGBITS, 0, 1, 0, NULL, 0 },
+	};
+
+	int size = sizeof(Elf64_Ehdr);
+
+	for (int i = 1; i < SECTION_COUNT; i++) {
+		size = align_to(size, layout[i].align);
+
+		sections[i] = (Elf64_Shdr) {
+			.sh_name = section_name(layout[i].name),
+			.sh_type = layout[i].type,
+			.sh_flags = layout[i].flags,
+			.sh_offset = size,
+			.sh_size = layout[i].size,
+			.sh_addralign = layout[i].align,
+			.sh_entsize = layout[i].entry,
+		};
+
+		if (layout[i].type != SHT_NOBITS) size += layout[i].size;
+	}
+
+	sections[SECTION_RELA_TEXT].sh_link = SECTION_SYMTAB;
+	sections[SECTION_RELA_TEXT].sh_info = SECTION_TEXT;
+	sections[SECTION_RELA_DATA].sh_link = SECTION_SYMTAB;
+	sections[SECTION_RELA_DATA].sh_info = SECTION_DATA;
+	sections[SECTION_SYMTAB].sh_link = SECTION_STRTAB;
+	sections[SECTION_SYMTAB].sh_info = FIRST_GLOBAL;
+
+	int headers = align_to(size, 8);
+	size = headers + sizeof sections;
+
+	uint8_t *buffer = calloc(size, 1);
+	if (!buffer) errx("out of memory: failed to allocate %d bytes", size);
+
+	Elf64_Ehdr header = {
+		.e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV },
+		.e_type = ET_REL,
+		.e_machine = EM_X86_64,
+		.e_version = EV_CURRENT,
+		.e_shoff = headers,
+		.e_ehsize = sizeof(Elf64_Ehdr),
+		.e_shentsize = sizeof(Elf64_Shdr),
+		.e_shnum = SECTION_COUNT,
+		.e_shstrndx = SECTION_SHSTRTAB,
+	};
+
+	memcpy(buffer, &header, sizeof header);
+
+	for (int i = 1; i < SECTION_COUNT; i++) {
+		if (layout[i].contents) memcpy(buffer + sections[i].sh_offset, layout[i].contents, layout[i].size);
+	}
+
+	memcpy(buffer + headers, sections, sizeof sections);
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) errx("cannot open `%s` for writing", path);
+
+	for (int written = 0; written < size;) {
+		ssize_t length = write(fd, buffer + written, size - written);
+		if (length < 0) errx("failed to write `%s`", path);
+		written += length;
+	}
+
+	if (close(fd) != 0) errx("failed to write `%s`", path);
+
+	free(buffer);
+	free(text_relocations);
+	vec_free(&initialisers);
+	vec_free(&data_relocations);
+	vec_free(&data);
+	vec_free(&bindings);
+	vec_free(&names);
+	vec_free(&symbols);
+	free_assembler(&as);
+}
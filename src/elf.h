@@ -0,0 +1,19 @@
+#ifndef ELF_H_
+#define ELF_H_
+
+#include "ast.h"
+#include "types.h"
+
+// relocatable object writer:
+//
+// the x86-64 backend's machine code is written as an ELF64 object that the
+// system linker takes as is: .text, strings in .rodata, globals in .data
+// and .bss, a symbol table and the relocations of calls and references to
+// globals and strings. every section is laid out up front into one buffer,
+// which is written with a single write(2).
+//
+
+// errors are fatal. source names the input in the file symbol
+void emit_object(const char *path, const char *source, struct TypeTable *, struct AST_Declaration **, int count, unsigned features);
+
+#endif //ELF_H_
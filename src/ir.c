@@ -0,0 +1,1527 @@
+#include "ir.h"
+
+#include "allocator.h"
+#include "ast.h"
+#include "parser.h"
+#include "switch.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// definitions of variables, keyed by (block, declaration). a NULL block
+// marks a local of the function: slot is -1 for SSA values, otherwise the
+// frame slot of a variable whose address is taken
+
+enum {
+	SSA_VARIABLE = -1,
+	ADDRESS_TAKEN = -2, // found by the scan, no slot yet
+};
+
+struct Definition {
+	struct IR_Block *block;
+	struct AST_Declaration *declaration;
+	struct IR_Instruction *value;
+	int slot;
+};
+
+struct Incomplete {
+	struct IR_Block *block;
+	struct AST_Declaration *declaration;
+	struct IR_Instruction *phi;
+};
+
+struct Builder {
+	struct IR_Function *function;
+	struct Allocator *allocator;
+	struct TypeTable *types;
+
+	struct IR_Block *block;    // being appended to
+	struct IR_Block *loop_end; // target of break
+	struct IR_Block **labels;  // of the innermost switch
+
+	struct Definition *definitions;
+	int definition_count, definition_capacity;
+
+	struct Vec incomplete; // struct Incomplete, phis of blocks not sealed yet
+};
+
+
+// instructions and blocks
+
+static
+void *grow_array(struct Allocator *allocator, void *array, int *capacity, int size) {
+	int old = *capacity;
+	*capacity = max(4, old * 2);
+
+	void *grown = allocate_object(allocator, *capacity * size);
+	if (old) memcpy(grown, array, old * size);
+	return grown;
+}
+
+void add_operand(struct IR_Function *function, struct IR_Instruction *inst, struct IR_Instruction *operand) {
+	if (inst->operand_count == inst->operand_capacity) {
+		inst->operands = grow_array(function->allocator, inst->operands, &inst->operand_capacity, sizeof *inst->operands);
+	}
+
+	inst->operands[inst->operand_count++] = operand;
+}
+
+static
+struct IR_Instruction *new_instruction(struct IR_Function *function, enum IR_Opcode op, enum IR_Width width) {
+	struct IR_Instruction *inst = allocate_object(function->allocator, sizeof *inst);
+
+	inst->op = op;
+	inst->width = width;
+	inst->id = function->values++;
+	return inst;
+}
+
+static
+void append(struct IR_Block *block, struct IR_Instruction *inst) {
+	inst->block = block;
+	inst->prev = block->last;
+
+	if (block->last) block->last->next = inst;
+	else             block->first = inst;
+
+	block->last = inst;
+}
+
+// phis go before everything else
+static
+void prepend(struct IR_Block *block, struct IR_Instruction *inst) {
+	inst->block = block;
+	inst->next = block->first;
+
+	if (block->first) block->first->prev = inst;
+	else              block->last = inst;
+
+	block->first = inst;
+}
+
+void remove_instruction(struct IR_Instruction *inst) {
+	struct IR_Block *block = inst->block;
+
+	if (inst->prev) inst->prev->next = inst->next;
+	else            block->first = inst->next;
+
+	if (inst->next) inst->next->prev = inst->prev;
+	else            block->last = inst->prev;
+
+	inst->prev = inst->next = NULL;
+}
+
+static
+struct IR_Block *new_block(struct IR_Function *function) {
+	struct IR_Block *block = allocate_object(function->allocator, sizeof *block);
+
+	if (function->block_count == function->block_capacity) {
+		function->blocks = grow_array(function->allocator, function->blocks, &function->block_capacity, sizeof *function->blocks);
+	}
+
+	block->id = function->block_count;
+	function->blocks[function->block_count++] = block;
+	return block;
+}
+
+static
+void add_edge(struct IR_Function *function, struct IR_Block *pred, struct IR_Block *block) {
+	assert(!block->sealed);
+
+	if (block->pred_count == block->pred_capacity) {
+		block->preds = grow_array(function->allocator, block->preds, &block->pred_capacity, sizeof *block->preds);
+	}
+
+	block->preds[block->pred_count++] = pred;
+}
+
+void remove_edge(struct IR_Block *pred, struct IR_Block *block) {
+	int index = 0;
+	while (block->preds[index] != pred) index++;
+
+	block->pred_count--;
+	memmove(&block->preds[index], &block->preds[index + 1], (block->pred_count - index) * sizeof *block->preds);
+
+	for (struct IR_Instruction *phi = block->first; phi && phi->op == IR_PHI; phi = phi->next) {
+		phi->operand_count--;
+		memmove(&phi->operands[index], &phi->operands[index + 1], (phi->operand_count - index) * sizeof *phi->operands);
+	}
+}
+
+static
+struct IR_Instruction *find(struct IR_Instruction *inst) {
+	while (inst->forward) inst = inst->forward;
+	return inst;
+}
+
+void resolve_forwards(struct IR_Function *function) {
+	for (int i = 0; i < function->block_count; i++) {
+		for (struct IR_Instruction *inst = function->blocks[i]->first; inst; inst = inst->next) {
+			for (int j = 0; j < inst->operand_count; j++) {
+				inst->operands[j] = find(inst->operands[j]);
+			}
+		}
+	}
+}
+
+// a phi whose operands are itself or one other value is that value,
+// removing one can make others trivial
+static
+void remove_trivial_phis(struct IR_Function *function) {
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+
+		for (int i = 0; i < function->block_count; i++) {
+			struct IR_Instruction *phi = function->blocks[i]->first;
+
+			while (phi && phi->op == IR_PHI) {
+				struct IR_Instruction *next = phi->next, *same = NULL;
+				bool trivial = true;
+
+				for (int j = 0; j < phi->operand_count; j++) {
+					struct IR_Instruction *operand = find(phi->operands[j]);
+					if (operand == phi || operand == same) continue;
+
+					if (same) trivial = false;
+					same = operand;
+				}
+
+				// no operand other than itself: only reachable through itself
+				if (trivial && same) {
+					phi->forward = same;
+					remove_instruction(phi);
+					changed = true;
+				}
+
+				phi = next;
+			}
+		}
+	}
+
+	resolve_forwards(function);
+}
+
+void order_blocks(struct IR_Function *function) {
+	int count = function->block_count;
+	struct IR_Block **order = malloc(count * sizeof *order);
+	struct IR_Block **stack = malloc(count * sizeof *stack);
+	int *next_target = calloc(count, sizeof *next_target);
+
+	if (!order || !stack || !next_target) errx("out of memory: failed to order %d blocks", count);
+
+	for (int i = 0; i < count; i++) {
+		function->blocks[i]->order = -1;
+		function->blocks[i]->id = i;
+	}
+
+	// depth first from the entry, postorder into the end of `order`
+	int depth = 0, visited = count;
+	stack[depth++] = function->blocks[0];
+	function->blocks[0]->order = 0;
+
+	while (depth) {
+		struct IR_Block *block = stack[depth - 1];
+		struct IR_Instruction *last = block->last;
+		int targets = last->op == IR_JUMP ? 1 : last->op == IR_BRANCH ? 2 : 0;
+		int *next = &next_target[block->id];
+
+		if (*next < targets) {
+			struct IR_Block *target = last->targets[(*next)++];
+
+			if (target->order < 0) {
+				target->order = 0;
+				stack[depth++] = target;
+			}
+
+			continue;
+		}
+
+		order[--visited] = block;
+		depth--;
+	}
+
+	// unreachable blocks take their edges with them
+	for (int i = 0; i < count; i++) {
+		struct IR_Block *block = function->blocks[i];
+		if (block->order >= 0) continue;
+
+		struct IR_Instruction *last = block->last;
+		if (last->op == IR_JUMP || last->op == IR_BRANCH) remove_edge(block, last->targets[0]);
+		if (last->op == IR_BRANCH) remove_edge(block, last->targets[1]);
+	}
+
+	function->block_count = count - visited;
+	memmove(function->blocks, order + visited, function->block_count * sizeof *order);
+
+	for (int i = 0; i < function->block_count; i++) {
+		function->blocks[i]->order = i;
+	}
+
+	free(order);
+	free(stack);
+	free(next_target);
+
+	remove_trivial_phis(function);
+}
+
+
+// lowering
+
+static
+enum IR_Width width_of(struct Builder *b, unsigned type) {
+	char buffer[256];
+
+	if (type == VOID) return IR_VOID;
+	if (is_pointer(b->types, type)) return IR_I64;
+
+	switch (type_size(b->types, type)) {
+		case 1: return IR_I8;
+		case 2: return IR_I16;
+		case 4: return IR_I32;
+		case 8: return IR_I64;
+	}
+
+	errx("values of type `%s` are not supported by the IR", print_type(b->types, type, buffer, sizeof buffer));
+}
+
+static
+struct IR_Instruction *emit(struct Builder *b, enum IR_Opcode op, enum IR_Width width) {
+	struct IR_Instruction *inst = new_instruction(b->function, op, width);
+	append(b->block, inst);
+	return inst;
+}
+
+static
+struct IR_Instruction *constant(struct Builder *b, enum IR_Width width, uint64_t value) {
+	struct IR_Instruction *inst = emit(b, IR_CONST, width);
+	inst->value = wrap_value(value, width);
+	return inst;
+}
+
+static
+struct IR_Instruction *unary(struct Builder *b, enum IR_Opcode op, enum IR_Width width, struct IR_Instruction *operand) {
+	struct IR_Instruction *inst = emit(b, op, width);
+	add_operand(b->function, inst, operand);
+	return inst;
+}
+
+static
+struct IR_Instruction *binary(struct Builder *b, enum IR_Opcode op, enum IR_Width width,
+                              struct IR_Instruction *lhs, struct IR_Instruction *rhs) {
+	struct IR_Instruction *inst = emit(b, op, width);
+	add_operand(b->function, inst, lhs);
+	add_operand(b->function, inst, rhs);
+	return inst;
+}
+
+// ends the current block
+static
+void jump(struct Builder *b, struct IR_Block *target) {
+	emit(b, IR_JUMP, IR_VOID)->targets[0] = target;
+	add_edge(b->function, b->block, target);
+}
+
+static
+void branch(struct Builder *b, struct IR_Instruction *condition, struct IR_Block *then, struct IR_Block *otherwise) {
+	struct IR_Instruction *inst = emit(b, IR_BRANCH, IR_VOID);
+	add_operand(b->function, inst, condition);
+
+	inst->targets[0] = then;
+	inst->targets[1] = otherwise;
+
+	add_edge(b->function, b->block, then);
+	add_edge(b->function, b->block, otherwise);
+}
+
+// code after a return or break goes to a block nothing jumps to
+static
+void start_unreachable(struct Builder *b) {
+	b->block = new_block(b->function);
+	b->block->sealed = true;
+}
+
+// int extends with its sign, everything else with zeros
+static
+struct IR_Instruction *resize(struct Builder *b, struct IR_Instruction *value, unsigned from, enum IR_Width width) {
+	if (width == value->width || width == IR_VOID || value->width == IR_VOID) return value;
+	if (width < value->width) return unary(b, IR_TRUNC, width, value);
+	return unary(b, from == INT ? IR_SEXT : IR_ZEXT, width, value);
+}
+
+static
+struct IR_Instruction *convert(struct Builder *b, struct IR_Instruction *value, unsigned from, unsigned to) {
+	return resize(b, value, from, width_of(b, to));
+}
+
+
+// variables
+
+static
+unsigned definition_hash(struct IR_Block *block, struct AST_Declaration *decl) {
+	return (unsigned)(((uintptr_t)block >> 4) * 31 + ((uintptr_t)decl >> 4)) * 0x9e3779b1u;
+}
+
+static
+struct Definition *find_definition(struct Builder *b, struct IR_Block *block, struct AST_Declaration *decl) {
+	if (b->definition_capacity == 0) return NULL;
+
+	for (unsigned i = definition_hash(block, decl);; i++) {
+		struct Definition *definition = &b->definitions[i & (b->definition_capacity - 1)];
+
+		if (definition->declaration == decl && definition->block == block) return definition;
+		if (definition->declaration == NULL) return NULL;
+	}
+}
+
+static
+struct Definition *define(struct Builder *b, struct IR_Block *block, struct AST_Declaration *decl) {
+	struct Definition *definition = find_definition(b, block, decl);
+	if (definition) return definition;
+
+	if (2 * (b->definition_count + 1) > b->definition_capacity) {
+		struct Definition *old = b->definitions;
+		int capacity = b->definition_capacity;
+
+		b->definition_capacity = max(256, capacity * 2);
+		b->definitions = calloc(b->definition_capacity, sizeof *b->definitions);
+		if (!b->definitions) errx("out of memory: failed to allocate %d definitions", b->definition_capacity);
+
+		for (int i = 0; i < capacity; i++) {
+			if (old[i].declaration == NULL) continue;
+
+			unsigned index = definition_hash(old[i].block, old[i].declaration);
+			while (b->definitions[index & (b->definition_capacity - 1)].declaration) index++;
+			b->definitions[index & (b->definition_capacity - 1)] = old[i];
+		}
+
+		free(old);
+	}
+
+	unsigned index = definition_hash(block, decl);
+	while (b->definitions[index & (b->definition_capacity - 1)].declaration) index++;
+
+	definition = &b->definitions[index & (b->definition_capacity - 1)];
+	*definition = (struct Definition) { block, decl, NULL, 0 };
+	b->definition_count++;
+	return definition;
+}
+
+static
+void write_variable(struct Builder *b, struct IR_Block *block, struct AST_Declaration *decl, struct IR_Instruction *value) {
+	define(b, block, decl)->value = value;
+}
+
+static
+struct IR_Instruction *new_phi(struct Builder *b, struct IR_Block *block, struct AST_Declaration *decl) {
+	struct IR_Instruction *phi = new_instruction(b->function, IR_PHI, width_of(b, decl->type.id));
+	prepend(block, phi);
+	return phi;
+}
+
+static
+struct IR_Instruction *read_variable(struct Builder *, struct IR_Block *, struct AST_Declaration *);
+
+static
+void add_phi_operands(struct Builder *b, struct IR_Block *block, struct AST_Declaration *decl, struct IR_Instruction *phi) {
+	for (int i = 0; i < block->pred_count; i++) {
+		add_operand(b->function, phi, read_variable(b, block->preds[i], decl));
+	}
+}
+
+// the definition that reaches the end of the block: local, or found through
+// the predecessors. a phi in a block that is not sealed gets its operands
+// when it is
+static
+struct IR_Instruction *read_variable(struct Builder *b, struct IR_Block *block, struct AST_Declaration *decl) {
+	struct Definition *definition = find_definition(b, block, decl);
+	if (definition) return definition->value;
+
+	struct IR_Instruction *value;
+
+	if (!block->sealed) {
+		value = new_phi(b, block, decl);
+
+		struct Incomplete incomplete = { block, decl, value };
+		vec_push(&b->incomplete, &incomplete);
+	}
+
+	// only in code nothing reaches
+	else if (block->pred_count == 0) {
+		value = new_instruction(b->function, IR_CONST, width_of(b, decl->type.id));
+		prepend(block, value);
+	}
+
+	else if (block->pred_count == 1) {
+		value = read_variable(b, block->preds[0], decl);
+	}
+
+	// the phi is defined first, so that loops find it
+	else {
+		value = new_phi(b, block, decl);
+		write_variable(b, block, decl, value);
+		add_phi_operands(b, block, decl, value);
+	}
+
+	write_variable(b, block, decl, value);
+	return value;
+}
+
+static
+void seal(struct Builder *b, struct IR_Block *block) {
+	struct Incomplete *incomplete = b->incomplete.mem;
+
+	for (int i = 0; i < b->incomplete.length; i++) {
+		if (incomplete[i].block != block) continue;
+
+		add_phi_operands(b, block, incomplete[i].declaration, incomplete[i].phi);
+		incomplete = b->incomplete.mem; // reading may have pushed more
+
+		incomplete[i] = incomplete[b->incomplete.length - 1];
+		vec_truncate(&b->incomplete, b->incomplete.length - 1);
+		i--;
+	}
+
+	block->sealed = true;
+}
+
+static
+bool is_variable(struct Builder *b, struct AST_Declaration *decl) {
+	struct Definition *local = find_definition(b, NULL, decl);
+	return local && local->slot == SSA_VARIABLE;
+}
+
+static
+void declare_local(struct Builder *b, struct AST_Declaration *decl) {
+	struct Definition *local = define(b, NULL, decl);
+
+	// aggregates always live in memory
+	if (local->slot != ADDRESS_TAKEN && !is_aggregate(b->types, decl->type.id)) {
+		local->slot = SSA_VARIABLE;
+		return;
+	}
+
+	struct IR_Function *function = b->function;
+
+	if (function->slot_count == function->slot_capacity) {
+		function->slots = grow_array(b->allocator, function->slots, &function->slot_capacity, sizeof *function->slots);
+	}
+
+	function->slots[function->slot_count] = (struct IR_Slot) {
+		.declaration = decl,
+		.size = type_size(b->types, decl->type.id),
+		.align = type_align(b->types, decl->type.id),
+	};
+
+	local->slot = function->slot_count++;
+}
+
+static
+void scan_expression(struct Builder *b, struct AST_Expression *expr);
+
+static
+void scan_statements(struct Builder *b, struct AST_Statement *statement) {
+	for (; statement; statement = statement->next) {
+		switch (statement->type) {
+			case STMT_EXPRESSION:
+			case STMT_RETURN:
+				if (statement->expression) scan_expression(b, statement->expression);
+				break;
+
+			case STMT_DECLARATION:
+				if (statement->declaration->value) scan_expression(b, statement->declaration->value);
+				break;
+
+			case STMT_BLOCK:
+				scan_statements(b, statement->block.body);
+				break;
+
+			case STMT_IF:
+				scan_expression(b, statement->conditional.condition);
+				scan_statements(b, statement->conditional.then);
+				scan_statements(b, statement->conditional.otherwise);
+				break;
+
+			case STMT_WHILE:
+			case STMT_DO:
+				scan_expression(b, statement->loop.condition);
+				scan_statements(b, statement->loop.body);
+				break;
+
+			case STMT_SWITCH:
+				scan_expression(b, statement->selection.condition);
+				scan_statements(b, statement->selection.body);
+				break;
+
+			case STMT_BREAK:
+			case STMT_CASE:
+				break;
+		}
+	}
+}
+
+// finds the variables whose address is taken, they stay in memory
+static
+void scan_expression(struct Builder *b, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case LITERAL: case STRING: case IDENTIFIER:
+			break;
+
+		case UNARY_OP: {
+			struct AST_ExprUnaryOp *op = &expr->unary_op;
+
+			if (op->token->type == PUNCTUATION && op->token->value == '*' && op->rhs->type == IDENTIFIER) {
+				define(b, NULL, op->rhs->identifier.declaration)->slot = ADDRESS_TAKEN;
+			}
+
+			scan_expression(b, op->rhs);
+			break;
+		}
+
+		case BINARY_OP:
+			scan_expression(b, expr->binary_op.lhs);
+			scan_expression(b, expr->binary_op.rhs);
+			break;
+
+		case TYPE_CAST:
+			scan_expression(b, expr->type_cast.rhs);
+			break;
+
+		case FUNC_CALL:
+			if (expr->func_call.args) scan_expression(b, expr->func_call.args);
+			break;
+	}
+}
+
+
+// expressions
+
+static
+struct IR_Instruction *lower_expression(struct Builder *, struct AST_Expression *);
+
+// the value widened or truncated for an operation of that width
+static
+struct IR_Instruction *operand(struct Builder *b, struct AST_Expression *expr, enum IR_Width width) {
+	return resize(b, lower_expression(b, expr), expression_type(expr).id, width);
+}
+
+// what pointer arithmetic and indexing scale by, void * counts bytes
+static
+int element_size(struct Builder *b, unsigned type) {
+	unsigned element = pointee(b->types, type);
+	return element == VOID ? 1 : type_size(b->types, element);
+}
+
+// p + i or p - i, the index is extended and scaled
+static
+struct IR_Instruction *offset_pointer(struct Builder *b, enum IR_Opcode op, struct IR_Instruction *pointer, unsigned type,
+                                      struct AST_Expression *index) {
+	struct IR_Instruction *offset = operand(b, index, IR_I64);
+	int size = element_size(b, type);
+
+	if (size != 1) offset = binary(b, IR_MUL, IR_I64, offset, constant(b, IR_I64, size));
+	return binary(b, op, IR_I64, pointer, offset);
+}
+
+static
+struct IR_Instruction *address(struct Builder *b, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case IDENTIFIER: {
+			struct AST_Declaration *decl = expr->identifier.declaration;
+			struct Definition *local = find_definition(b, NULL, decl);
+			struct IR_Instruction *inst;
+
+			// globals may be marked by the scan too, but are never declared
+			if (local && local->slot >= 0) {
+				inst = emit(b, IR_SLOT, IR_I64);
+				inst->value = local->slot;
+			} else {
+				inst = emit(b, IR_GLOBAL, IR_I64);
+				inst->symbol = decl;
+			}
+
+			return inst;
+		}
+
+		// <<p
+		case UNARY_OP:
+			return lower_expression(b, expr->unary_op.rhs);
+
+		// p[i], a[i] and s.f
+		case BINARY_OP: {
+			struct AST_ExprBinaryOp *op = &expr->binary_op;
+			unsigned type = expression_type(op->lhs).id;
+
+			if (op->token->value == '.') {
+				struct Field *field = find_field(b->types, type, op->rhs->identifier.token->text);
+				struct IR_Instruction *base;
+				int64_t offset = field->offset;
+
+				// a[i].f of a soa array: the ith of the array of f
+				if (get_type(b->types, type)->soa) {
+					struct AST_ExprBinaryOp *element = &op->lhs->binary_op;
+					struct IR_Instruction *index = operand(b, element->rhs, IR_I64);
+					int size = type_size(b->types, field->type);
+
+					if (size != 1) index = binary(b, IR_MUL, IR_I64, index, constant(b, IR_I64, size));
+					base = binary(b, IR_ADD, IR_I64, address(b, element->lhs), index);
+					offset *= get_type(b->types, expression_type(element->lhs).id)->length;
+				} else {
+					base = address(b, op->lhs);
+				}
+
+				return offset ? binary(b, IR_ADD, IR_I64, base, constant(b, IR_I64, offset)) : base;
+			}
+
+			// an array is indexed in place, by its element size
+			if (is_array(b->types, type)) {
+				struct IR_Instruction *base = address(b, op->lhs);
+				struct IR_Instruction *index = operand(b, op->rhs, IR_I64);
+				int size = element_size(b, type);
+
+				if (size != 1) index = binary(b, IR_MUL, IR_I64, index, constant(b, IR_I64, size));
+				return binary(b, IR_ADD, IR_I64, base, index);
+			}
+
+			struct IR_Instruction *pointer = lower_expression(b, op->lhs);
+			return offset_pointer(b, IR_ADD, pointer, type, op->rhs);
+		}
+
+		default:
+			assert(0 && "unreachable");
+			return NULL;
+	}
+}
+
+static
+struct IR_Instruction *load(struct Builder *b, struct IR_Instruction *from, unsigned type) {
+	return unary(b, IR_LOAD, width_of(b, type), from);
+}
+
+static
+void store(struct Builder *b, struct IR_Instruction *to, struct IR_Instruction *value) {
+	binary(b, IR_STORE, IR_VOID, to, value);
+}
+
+// the bit builtins compute at the width of their operand, the counts are
+// widened to the u32 they are. a prefetch is a hint the IR has no use for,
+// only its pointer is evaluated
+static
+struct IR_Instruction *lower_builtin(struct Builder *b, struct AST_ExprFuncCall *call) {
+	static const enum IR_Opcode opcodes[] = {
+		[BUILTIN_CLZ] = IR_CLZ, [BUILTIN_CTZ] = IR_CTZ, [BUILTIN_POPCOUNT] = IR_POPCOUNT,
+		[BUILTIN_BSWAP] = IR_BSWAP, [BUILTIN_ROTATE] = IR_ROTL,
+	};
+
+	struct AST_Expression *args[MAX_PARAMS];
+	call_arguments(call->args, args);
+
+	unsigned type = expression_type(args[0]).id;
+	struct IR_Instruction *value;
+
+	switch (call->builtin) {
+		case BUILTIN_CLZ: case BUILTIN_CTZ: case BUILTIN_POPCOUNT: case BUILTIN_BSWAP:
+			value = unary(b, opcodes[call->builtin], width_of(b, type), lower_expression(b, args[0]));
+			break;
+
+		case BUILTIN_ROTATE: {
+			enum IR_Width width = width_of(b, type);
+			value = binary(b, IR_ROTL, width, lower_expression(b, args[0]), operand(b, args[1], width));
+			break;
+		}
+
+		case BUILTIN_PREFETCH:
+			return lower_expression(b, args[0]);
+
+		default: {
+			struct Token *name = call->func->identifier.token;
+			errx("%s:%d:%d: builtin `%s` is not supported by the IR", name->filename, name->line, name->col, name->text);
+		}
+	}
+
+	return convert(b, value, type, call->type.id);
+}
+
+static
+struct IR_Instruction *lower_call(struct Builder *b, struct AST_ExprFuncCall *call) {
+	if (call->builtin) return lower_builtin(b, call);
+
+	struct AST_Declaration *decl = call->func->identifier.declaration;
+	struct AST_Expression *args[MAX_PARAMS];
+	struct IR_Instruction *values[MAX_PARAMS];
+
+	int count = call_arguments(call->args, args);
+
+	for (int i = 0; i < count; i++) {
+		values[i] = convert(b, lower_expression(b, args[i]), expression_type(args[i]).id, decl->params[i]->type.id);
+	}
+
+	struct IR_Instruction *inst = emit(b, IR_CALL, width_of(b, decl->type.id));
+	inst->symbol = decl;
+
+	for (int i = 0; i < count; i++) add_operand(b->function, inst, values[i]);
+	return inst;
+}
+
+// ++x, x--: variables are redefined, anything else is loaded and stored
+static
+struct IR_Instruction *lower_increment(struct Builder *b, struct AST_ExprUnaryOp *op) {
+	unsigned type = expression_type(op->rhs).id;
+	enum IR_Width width = width_of(b, type);
+	bool post = op->token->value == POST_INC || op->token->value == POST_DEC;
+
+	int64_t step = is_pointer(b->types, type) ? element_size(b, type) : 1;
+	if (op->token->value == DEC || op->token->value == POST_DEC) step = -step;
+
+	struct IR_Instruction *place = NULL, *old;
+	struct AST_Declaration *variable = NULL;
+
+	if (op->rhs->type == IDENTIFIER && is_variable(b, op->rhs->identifier.declaration)) {
+		variable = op->rhs->identifier.declaration;
+		old = read_variable(b, b->block, variable);
+	} else {
+		place = address(b, op->rhs);
+		old = load(b, place, type);
+	}
+
+	struct IR_Instruction *new = binary(b, IR_ADD, width, old, constant(b, width, step));
+
+	if (variable) write_variable(b, b->block, variable, new);
+	else          store(b, place, new);
+
+	return post ? old : new;
+}
+
+static
+struct IR_Instruction *lower_unary(struct Builder *b, struct AST_ExprUnaryOp *op) {
+	enum IR_Width width = width_of(b, op->type.id);
+
+	if (op->token->type == KEYWORD_SIZEOF) {
+		return constant(b, width, type_size(b->types, expression_type(op->rhs).id));
+	}
+
+	switch (op->token->value) {
+		case '+':
+			return operand(b, op->rhs, width);
+
+		case '-':
+			return unary(b, IR_NEG, width, operand(b, op->rhs, width));
+
+		case '~':
+			return unary(b, IR_NOT, width, operand(b, op->rhs, width));
+
+		case '!': {
+			struct IR_Instruction *value = lower_expression(b, op->rhs);
+			return binary(b, IR_EQ, width, value, constant(b, value->width, 0));
+		}
+
+		case INC: case DEC:
+		case POST_INC: case POST_DEC:
+			return lower_increment(b, op);
+
+		// address of
+		case '*':
+			return address(b, op->rhs);
+
+		// dereference
+		case SHL:
+			return load(b, lower_expression(b, op->rhs), op->type.id);
+
+		default:
+			assert(0 && "unreachable");
+			return NULL;
+	}
+}
+
+// ends the current block in a jump to `end` and returns a phi there: of
+// `skipped` on the edge from `skip`, which bypassed the current block, and
+// of `value` from the current block
+static
+struct IR_Instruction *join(struct Builder *b, struct IR_Block *skip, struct IR_Instruction *skipped,
+                            struct IR_Instruction *value, struct IR_Block *end) {
+	jump(b, end);
+	seal(b, end);
+	b->block = end;
+
+	struct IR_Instruction *phi = new_instruction(b->function, IR_PHI, value->width);
+	prepend(end, phi);
+
+	// in the order the edges were added
+	for (int i = 0; i < end->pred_count; i++) {
+		add_operand(b->function, phi, end->preds[i] == skip ? skipped : value);
+	}
+
+	return phi;
+}
+
+// a && b, a || b: 0 or 1 without evaluating b when a decides
+static
+struct IR_Instruction *lower_logical(struct Builder *b, struct AST_ExprBinaryOp *op, bool and) {
+	enum IR_Width width = width_of(b, op->type.id);
+	struct IR_Block *rhs = new_block(b->function), *end = new_block(b->function);
+
+	struct IR_Instruction *lhs = lower_expression(b, op->lhs);
+	struct IR_Instruction *decided = constant(b, width, and ? 0 : 1);
+	struct IR_Block *skip = b->block;
+
+	if (and) branch(b, lhs, rhs, end);
+	else     branch(b, lhs, end, rhs);
+	seal(b, rhs);
+
+	b->block = rhs;
+	struct IR_Instruction *value = lower_expression(b, op->rhs);
+	value = binary(b, IR_NE, width, value, constant(b, value->width, 0));
+
+	return join(b, skip, decided, value, end);
+}
+
+// a else b: a unless it is 0
+static
+struct IR_Instruction *lower_else(struct Builder *b, struct AST_ExprBinaryOp *op) {
+	struct IR_Block *rhs = new_block(b->function), *end = new_block(b->function);
+
+	struct IR_Instruction *lhs = lower_expression(b, op->lhs);
+	struct IR_Block *skip = b->block;
+
+	branch(b, lhs, end, rhs);
+	seal(b, rhs);
+
+	b->block = rhs;
+	struct IR_Instruction *value = convert(b, lower_expression(b, op->rhs), expression_type(op->rhs).id, op->type.id);
+
+	return join(b, skip, lhs, value, end);
+}
+
+static
+bool is_signed(struct Builder *b, unsigned lhs, unsigned rhs) {
+	if (is_pointer(b->types, lhs) || is_pointer(b->types, rhs)) return false;
+	return max(max(lhs, rhs), U32) == INT;
+}
+
+static
+int log2_of(int size) {
+	return 31 - __builtin_clz(size);
+}
+
+static
+struct IR_Instruction *lower_binary(struct Builder *b, struct AST_Expression *expr) {
+	struct AST_ExprBinaryOp *op = &expr->binary_op;
+	unsigned type = op->type.id;
+	unsigned lhs = expression_type(op->lhs).id;
+	unsigned rhs = expression_type(op->rhs).id;
+	enum IR_Width width = width_of(b, type);
+
+	if (op->token->type == KEYWORD_ELSE) return lower_else(b, op);
+
+	switch (op->token->value) {
+		case ',':
+			lower_expression(b, op->lhs);
+			return lower_expression(b, op->rhs);
+
+		case '=': {
+			if (op->lhs->type == IDENTIFIER && is_variable(b, op->lhs->identifier.declaration)) {
+				struct IR_Instruction *value = convert(b, lower_expression(b, op->rhs), rhs, lhs);
+				write_variable(b, b->block, op->lhs->identifier.declaration, value);
+				return value;
+			}
+
+			struct IR_Instruction *place = address(b, op->lhs);
+			struct IR_Instruction *value = convert(b, lower_expression(b, op->rhs), rhs, lhs);
+
+			store(b, place, value);
+			return value;
+		}
+
+		case AND: case OR:
+			return lower_logical(b, op, op->token->value == AND);
+
+		case '[': case '.':
+			return load(b, address(b, expr), type);
+	}
+
+	bool pointers = is_pointer(b->types, lhs) || is_pointer(b->types, rhs);
+
+	// pointer arithmetic
+	if (pointers && (op->token->value == '+' || op->token->value == '-')) {
+		if (is_pointer(b->types, lhs) && is_pointer(b->types, rhs)) {
+			struct IR_Instruction *difference = binary(b, IR_SUB, IR_I64, lower_expression(b, op->lhs), lower_expression(b, op->rhs));
+			int size = element_size(b, lhs);
+
+			if (size & (size - 1)) difference = binary(b, IR_IDIV, IR_I64, difference, constant(b, IR_I64, size));
+			else if (size != 1)    difference = binary(b, IR_SAR, IR_I64, difference, constant(b, IR_I64, log2_of(size)));
+
+			return resize(b, difference, lhs, width);
+		}
+
+		enum IR_Opcode code = op->token->value == '+' ? IR_ADD : IR_SUB;
+
+		if (is_pointer(b->types, lhs)) return offset_pointer(b, code, lower_expression(b, op->lhs), lhs, op->rhs);
+		return offset_pointer(b, code, lower_expression(b, op->rhs), rhs, op->lhs);
+	}
+
+	bool sign = is_signed(b, lhs, rhs);
+	enum IR_Opcode code;
+
+	switch (op->token->value) {
+		case '+': code = IR_ADD; break;
+		case '-': code = IR_SUB; break;
+		case '*': code = IR_MUL; break;
+		case '/': code = sign ? IR_IDIV : IR_DIV; break;
+		case '%': code = sign ? IR_IMOD : IR_MOD; break;
+		case '&': code = IR_AND; break;
+		case '|': code = IR_OR;  break;
+		case '^': code = IR_XOR; break;
+
+		// shifts take the signedness of the lhs alone
+		case SHL: code = IR_SHL; break;
+		case SHR: code = lhs == INT ? IR_SAR : IR_SHR; break;
+
+		case EQ:  code = IR_EQ; break;
+		case NEQ: code = IR_NE; break;
+		case '<': code = sign ? IR_ILT : IR_LT; break;
+		case LEQ: code = sign ? IR_ILE : IR_LE; break;
+		case '>': code = sign ? IR_IGT : IR_GT; break;
+		case GEQ: code = sign ? IR_IGE : IR_GE; break;
+
+		case CHECK_INDEX: code = IR_CHECK; break;
+
+		default:
+			assert(0 && "unreachable");
+			return NULL;
+	}
+
+	// comparisons are done at the width of the operands
+	enum IR_Width operands = code >= IR_EQ ? (pointers ? IR_I64 : IR_I32) : width;
+
+	struct IR_Instruction *left = operand(b, op->lhs, operands);
+	struct IR_Instruction *right = operand(b, op->rhs, operands);
+	return binary(b, code, width, left, right);
+}
+
+static
+struct IR_Instruction *lower_expression(struct Builder *b, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case LITERAL:
+			return constant(b, width_of(b, expr->literal.type.id), expr->literal.value);
+
+		case STRING: {
+			struct IR_Instruction *inst = emit(b, IR_STRING, IR_I64);
+			inst->symbol = expr->string.token;
+			return inst;
+		}
+
+		case IDENTIFIER: {
+			struct AST_Declaration *decl = expr->identifier.declaration;
+			struct Token *name = expr->identifier.token;
+
+			if (decl->function) {
+				errx("%s:%d:%d: function `%s` cannot be used as a value", name->filename, name->line, name->col, name->text);
+			}
+
+			if (is_variable(b, decl)) return read_variable(b, b->block, decl);
+			return load(b, address(b, expr), expr->identifier.type.id);
+		}
+
+		case UNARY_OP:
+			return lower_unary(b, &expr->unary_op);
+
+		case BINARY_OP:
+			return lower_binary(b, expr);
+
+		case TYPE_CAST:
+			return convert(b, lower_expression(b, expr->type_cast.rhs), expression_type(expr->type_cast.rhs).id, expr->type_cast.type.id);
+
+		case FUNC_CALL:
+			return lower_call(b, &expr->func_call);
+	}
+
+	assert(0 && "unreachable");
+	return NULL;
+}
+
+
+// statements
+
+static
+void lower_statement(struct Builder *, struct AST_Statement *);
+
+static
+void lower_body(struct Builder *b, struct AST_Statement *body) {
+	for (struct AST_Statement *statement = body; statement; statement = statement->next) {
+		lower_statement(b, statement);
+	}
+}
+
+// branches to `then` if the condition holds, otherwise goes on in a new block
+static
+void test(struct Builder *b, struct IR_Instruction *condition, struct IR_Block *then) {
+	struct IR_Block *next = new_block(b->function);
+
+	branch(b, condition, then, next);
+	seal(b, next);
+	b->block = next;
+}
+
+static
+struct IR_Block *case_target(struct Builder *b, int label, struct IR_Block *otherwise) {
+	return label < 0 ? otherwise : b->labels[label];
+}
+
+// there is no indirect branch, so the plan has no tables
+static
+void lower_cases(struct Builder *b, struct SwitchPlan *plan, int node, struct IR_Instruction *value, struct IR_Block *otherwise) {
+	for (; node >= 0; node = switch_node(plan, node)->next) {
+		struct SwitchNode *n = switch_node(plan, node);
+		struct IR_Block *label = case_target(b, n->label, otherwise);
+
+		if (n->always && (n->test == SWITCH_EQUAL || n->test == SWITCH_RANGE)) {
+			jump(b, label);
+			return;
+		}
+
+		// ranges compare value - low unsigned
+		struct IR_Instruction *offset = value, *in_range = NULL;
+
+		if (n->test == SWITCH_RANGE || n->test == SWITCH_BITS) {
+			if (n->low) offset = binary(b, IR_SUB, IR_I32, value, constant(b, IR_I32, n->low));
+			if (!n->always) in_range = binary(b, IR_LE, IR_I32, offset, constant(b, IR_I32, n->high - n->low));
+		}
+
+		switch (n->test) {
+			case SWITCH_EQUAL:
+				test(b, binary(b, IR_EQ, IR_I32, value, constant(b, IR_I32, n->low)), label);
+				break;
+
+			case SWITCH_RANGE:
+				test(b, in_range, label);
+				break;
+
+			// out of range goes on to the next test, in range but in no mask to the default
+			case SWITCH_BITS: {
+				struct IR_Block *next = NULL;
+
+				if (!n->always) {
+					struct IR_Block *bits = new_block(b->function);
+					next = new_block(b->function);
+
+					branch(b, in_range, bits, next);
+					seal(b, bits);
+					seal(b, next);
+					b->block = bits;
+				}
+
+				for (int i = 0; i < n->count; i++) {
+					struct SwitchMask *mask = (struct SwitchMask *)plan->masks.mem + n->first + i;
+					struct IR_Instruction *bit = binary(b, IR_SHR, IR_I32, constant(b, IR_I32, mask->bits), offset);
+
+					test(b, binary(b, IR_AND, IR_I32, bit, constant(b, IR_I32, 1)), case_target(b, mask->label, otherwise));
+				}
+
+				jump(b, otherwise);
+
+				if (!next) return;
+				b->block = next;
+				break;
+			}
+
+			case SWITCH_TABLE:
+				assert(0 && "unreachable");
+				break;
+
+			case SWITCH_SPLIT: {
+				struct IR_Block *less = new_block(b->function), *more = new_block(b->function);
+				enum IR_Opcode op = plan->sign ? IR_ILT : IR_LT;
+
+				branch(b, binary(b, op, IR_I32, value, constant(b, IR_I32, n->low)), less, more);
+				seal(b, less);
+				seal(b, more);
+
+				b->block = less;
+				lower_cases(b, plan, n->less, value, otherwise);
+				b->block = more;
+				lower_cases(b, plan, n->more, value, otherwise);
+				return;
+			}
+		}
+	}
+
+	jump(b, otherwise);
+}
+
+// a block per label, each sealed when the body reaches it: the dispatch
+// is all before, and the statement above falls in
+static
+void lower_switch(struct Builder *b, struct AST_StmtSwitch *s) {
+	struct IR_Instruction *value = operand(b, s->condition, IR_I32);
+	struct IR_Block **labels = b->labels, *loop_end = b->loop_end;
+	struct IR_Block *end = new_block(b->function);
+
+	b->labels = allocate_object(b->allocator, max(s->label_count, 1) * sizeof *b->labels);
+	for (int i = 0; i < s->label_count; i++) b->labels[i] = new_block(b->function);
+
+	struct SwitchPlan plan;
+	plan_switch(&plan, s, false);
+	lower_cases(b, &plan, plan.root, value, s->otherwise >= 0 ? b->labels[s->otherwise] : end);
+	free_switch_plan(&plan);
+
+	start_unreachable(b);
+	b->loop_end = end;
+	lower_body(b, s->body);
+
+	jump(b, end);
+	seal(b, end);
+	b->block = end;
+	b->labels = labels;
+	b->loop_end = loop_end;
+}
+
+// the value of a declaration or parameter becomes its first definition
+static
+void initialise(struct Builder *b, struct AST_Declaration *decl, struct IR_Instruction *value) {
+	declare_local(b, decl);
+
+	if (is_variable(b, decl)) {
+		write_variable(b, b->block, decl, value);
+		return;
+	}
+
+	struct IR_Instruction *slot = emit(b, IR_SLOT, IR_I64);
+	slot->value = find_definition(b, NULL, decl)->slot;
+	store(b, slot, value);
+}
+
+// aggregates start zeroed, by the widest stores that fit
+static
+void clear(struct Builder *b, struct AST_Declaration *decl) {
+	static const enum IR_Width widths[] = { IR_I64, IR_I32, IR_I16, IR_I8 };
+	int size = type_size(b->types, decl->type.id);
+	int offset = 0;
+
+	declare_local(b, decl);
+
+	for (int i = 0; i < 4; i++) {
+		for (int bytes = 8 >> i; offset + bytes <= size; offset += bytes) {
+			struct IR_Instruction *slot = emit(b, IR_SLOT, IR_I64);
+			slot->value = find_definition(b, NULL, decl)->slot;
+
+			if (offset) slot = binary(b, IR_ADD, IR_I64, slot, constant(b, IR_I64, offset));
+			store(b, slot, constant(b, widths[i], 0));
+		}
+	}
+}
+
+static
+void lower_statement(struct Builder *b, struct AST_Statement *statement) {
+	switch (statement->type) {
+		case STMT_EXPRESSION:
+			lower_expression(b, statement->expression);
+			break;
+
+		case STMT_DECLARATION: {
+			struct AST_Declaration *decl = statement->declaration;
+			struct IR_Instruction *value;
+
+			if (is_aggregate(b->types, decl->type.id)) {
+				clear(b, decl);
+				break;
+			}
+
+			if (decl->value) value = convert(b, lower_expression(b, decl->value), expression_type(decl->value).id, decl->type.id);
+			else             value = constant(b, width_of(b, decl->type.id), 0);
+
+			initialise(b, decl, value);
+			break;
+		}
+
+		case STMT_BLOCK:
+			lower_body(b, statement->block.body);
+			break;
+
+		case STMT_IF: {
+			struct AST_StmtIf *conditional = &statement->conditional;
+			struct IR_Block *then = new_block(b->function), *end = new_block(b->function);
+			struct IR_Block *otherwise = conditional->otherwise ? new_block(b->function) : end;
+
+			branch(b, lower_expression(b, conditional->condition), then, otherwise);
+			seal(b, then);
+
+			b->block = then;
+			lower_body(b, conditional->then);
+			jump(b, end);
+
+			if (conditional->otherwise) {
+				seal(b, otherwise);
+
+				b->block = otherwise;
+				lower_body(b, conditional->otherwise);
+				jump(b, end);
+			}
+
+			seal(b, end);
+			b->block = end;
+			break;
+		}
+
+		// the condition is the loop header, sealed once the body jumps back
+		case STMT_WHILE: {
+			struct IR_Block *header = new_block(b->function);
+			struct IR_Block *body = new_block(b->function), *end = new_block(b->function);
+			struct IR_Block *loop_end = b->loop_end;
+
+			jump(b, header);
+			b->block = header;
+			branch(b, lower_expression(b, statement->loop.condition), body, end);
+			seal(b, body);
+
+			b->block = body;
+			b->loop_end = end;
+			lower_body(b, statement->loop.body);
+			b->loop_end = loop_end;
+
+			jump(b, header);
+			seal(b, header);
+			seal(b, end);
+			b->block = end;
+			break;
+		}
+
+		// the body is the loop header
+		case STMT_DO: {
+			struct IR_Block *body = new_block(b->function), *condition = new_block(b->function);
+			struct IR_Block *end = new_block(b->function);
+			struct IR_Block *loop_end = b->loop_end;
+
+			jump(b, body);
+			b->block = body;
+			b->loop_end = end;
+			lower_body(b, statement->loop.body);
+			b->loop_end = loop_end;
+
+			jump(b, condition);
+			seal(b, condition);
+
+			b->block = condition;
+			branch(b, lower_expression(b, statement->loop.condition), body, end);
+			seal(b, body);
+			seal(b, end);
+			b->block = end;
+			break;
+		}
+
+		case STMT_RETURN: {
+			struct AST_Expression *result = statement->expression;
+			struct IR_Instruction *inst;
+
+			if (result) {
+				struct IR_Instruction *value = convert(b, lower_expression(b, result), expression_type(result).id, b->function->declaration->type.id);
+				inst = emit(b, IR_RETURN, IR_VOID);
+				add_operand(b->function, inst, value);
+			} else {
+				emit(b, IR_RETURN, IR_VOID);
+			}
+
+			start_unreachable(b);
+			break;
+		}
+
+		case STMT_BREAK:
+			jump(b, b->loop_end);
+			start_unreachable(b);
+			break;
+
+		case STMT_SWITCH:
+			lower_switch(b, &statement->selection);
+			break;
+
+		case STMT_CASE: {
+			struct IR_Block *label = b->labels[statement->label];
+
+			jump(b, label);
+			seal(b, label);
+			b->block = label;
+			break;
+		}
+	}
+}
+
+struct IR_Function *lower_function(struct Allocator *allocator, struct TypeTable *types, struct AST_Declaration *decl) {
+	struct IR_Function *function = allocate_object(allocator, sizeof *function);
+	function->declaration = decl;
+	function->allocator = allocator;
+
+	struct Builder b = {
+		.function = function,
+		.allocator = allocator,
+		.types = types,
+		.incomplete = vec(struct Incomplete),
+	};
+
+	scan_statements(&b, decl->body);
+
+	b.block = new_block(function);
+	b.block->sealed = true;
+
+	for (int i = 0; i < decl->param_count; i++) {
+		struct IR_Instruction *param = emit(&b, IR_PARAM, width_of(&b, decl->params[i]->type.id));
+		param->value = i;
+		initialise(&b, decl->params[i], param);
+	}
+
+	lower_body(&b, decl->body);
+
+	// falling off the end returns 0
+	enum IR_Width width = width_of(&b, decl->type.id);
+	struct IR_Instruction *zero = width == IR_VOID ? NULL : constant(&b, width, 0);
+	struct IR_Instruction *ret = emit(&b, IR_RETURN, IR_VOID);
+	if (zero) add_operand(function, ret, zero);
+
+	assert(b.incomplete.length == 0);
+	free(b.definitions);
+	vec_free(&b.incomplete);
+
+	order_blocks(function);
+	return function;
+}
+
+
+// dump
+
+static const char *const opcode_names[IR_OPCODE_COUNT] = {
+	[IR_CONST] = "const", [IR_PARAM] = "param", [IR_PHI] = "phi",
+	[IR_SLOT] = "slot", [IR_GLOBAL] = "global", [IR_STRING] = "string",
+	[IR_LOAD] = "load", [IR_STORE] = "store", [IR_CALL] = "call",
+	[IR_ADD] = "add", [IR_SUB] = "sub", [IR_MUL] = "mul",
+	[IR_DIV] = "div", [IR_IDIV] = "idiv", [IR_MOD] = "mod", [IR_IMOD] = "imod",
+	[IR_AND] = "and", [IR_OR] = "or", [IR_XOR] = "xor",
+	[IR_SHL] = "shl", [IR_SHR] = "shr", [IR_SAR] = "sar",
+	[IR_EQ] = "eq", [IR_NE] = "ne",
+	[IR_LT] = "lt", [IR_LE] = "le", [IR_GT] = "gt", [IR_GE] = "ge",
+	[IR_ILT] = "ilt", [IR_ILE] = "ile", [IR_IGT] = "igt", [IR_IGE] = "ige",
+	[IR_NEG] = "neg", [IR_NOT] = "not",
+	[IR_ZEXT] = "zext", [IR_SEXT] = "sext", [IR_TRUNC] = "trunc",
+	[IR_CLZ] = "clz", [IR_CTZ] = "ctz", [IR_POPCOUNT] = "popcount", [IR_BSWAP] = "bswap",
+	[IR_ROTL] = "rotl", [IR_CHECK] = "check",
+	[IR_JUMP] = "jump", [IR_BRANCH] = "branch", [IR_RETURN] = "return",
+};
+
+static const char *const width_names[] = { "", ".i8", ".i16", ".i32", ".i64" };
+
+static PRINTF(2,3)
+void put_format(struct Vec *out, const char *fmt, ...) {
+	char line[512];
+
+	va_list args;
+	va_start(args, fmt);
+	int length = vsnprintf(line, sizeof line, fmt, args);
+	va_end(args);
+
+	vec_append(out, line, min(length, sizeof line - 1));
+}
+
+static
+void put_string(struct Vec *out, struct Token *token) {
+	vec_append(out, "\"", 1);
+
+	for (int i = 0; i < token->length; i++) {
+		unsigned char c = token->text[i];
+
+		if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') put_format(out, "\\x%02x", c);
+		else vec_append(out, &c, 1);
+	}
+
+	vec_append(out, "\"", 1);
+}
+
+static
+void dump_instruction(struct Vec *out, struct IR_Instruction *inst) {
+	vec_append(out, "\t", 1);
+	if (inst->width != IR_VOID) put_format(out, "%%%d = ", inst->id);
+	put_format(out, "%s%s", opcode_names[inst->op], width_names[inst->width]);
+
+	switch (inst->op) {
+		case IR_CONST: case IR_PARAM: case IR_SLOT:
+			put_format(out, " %llu", (unsigned long long)inst->value);
+			break;
+
+		case IR_GLOBAL:
+			put_format(out, " %s", ((struct AST_Declaration *)inst->symbol)->token->text);
+			break;
+
+		case IR_STRING:
+			vec_append(out, " ", 1);
+			put_string(out, (struct Token *)inst->symbol);
+			break;
+
+		case IR_CALL:
+			put_format(out, " %s", ((struct AST_Declaration *)inst->symbol)->token->text);
+			break;
+
+		case IR_PHI:
+			for (int i = 0; i < inst->operand_count; i++) {
+				put_format(out, "%s [%%%d, b%d]", i ? "," : "", inst->operands[i]->id, inst->block->preds[i]->id);
+			}
+
+			vec_append(out, "\n", 1);
+			return;
+
+		default:
+			break;
+	}
+
+	for (int i = 0; i < inst->operand_count; i++) {
+		put_format(out, "%s %%%d", i ? "," : "", inst->operands[i]->id);
+	}
+
+	if (inst->op == IR_JUMP)   put_format(out, " b%d", inst->targets[0]->id);
+	if (inst->op == IR_BRANCH) put_format(out, ", b%d, b%d", inst->targets[0]->id, inst->targets[1]->id);
+
+	vec_append(out, "\n", 1);
+}
+
+void dump_function(struct Vec *out, struct TypeTable *types, struct IR_Function *function) {
+	struct AST_Declaration *decl = function->declaration;
+	char buffer[256];
+
+	put_format(out, "function %s %s(", print_type(types, decl->type.id, buffer, sizeof buffer), decl->token->text);
+
+	for (int i = 0; i < decl->param_count; i++) {
+		put_format(out, "%s%s %s", i ? ", " : "", print_type(types, decl->params[i]->type.id, buffer, sizeof buffer), decl->params[i]->token->text);
+	}
+
+	put_format(out, ")\n");
+
+	for (int i = 0; i < function->slot_count; i++) {
+		struct IR_Slot *slot = &function->slots[i];
+		put_format(out, "\tslot %d: %s, %d bytes\n", i, slot->declaration->token->text, slot->size);
+	}
+
+	for (int i = 0; i < function->block_count; i++) {
+		struct IR_Block *block = function->blocks[i];
+		block->id = i;
+	}
+
+	for (int i = 0; i < function->block_count; i++) {
+		struct IR_Block *block = function->blocks[i];
+
+		put_format(out, "b%d:", block->id);
+
+		for (int j = 0; j < block->pred_count; j++) {
+			put_format(out, "%s b%d", j ? "," : " ; preds", block->preds[j]->id);
+		}
+
+		vec_append(out, "\n", 1);
+
+		for (struct IR_Instruction *inst = block->first; inst; inst = inst->next) {
+			dump_instruction(out, inst);
+		}
+	}
+
+	vec_append(out, "\n", 1);
+}
@@ -0,0 +1,177 @@
+#ifndef IR_H_
+#define IR_H_
+
+#include "allocator.h"
+#include "ast.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// intermediate representation:
+//
+// a function is a graph of basic blocks of instructions in SSA form, each
+// instruction is also the value it defines. values are untyped integers of
+// 8, 16, 32 or 64 bits, pointers are 64-bit; where signedness matters the
+// opcode says so. locals whose address is never taken become SSA values as
+// the function is lowered, phis are placed on the fly and trivial ones are
+// removed at the end. other locals live in frame slots and are loaded and
+// stored like globals.
+//
+// phis come first in a block and have one operand per predecessor, in the
+// order of `preds`. every block ends in one terminator: jump, branch or
+// return. nodes are allocated in an arena and never freed one by one,
+// passes unlink what they remove.
+//
+
+enum IR_Width {
+	IR_VOID,
+	IR_I8,
+	IR_I16,
+	IR_I32,
+	IR_I64,
+};
+
+enum IR_Opcode {
+	IR_CONST,   // value
+	IR_PARAM,   // value: index
+	IR_PHI,
+	IR_SLOT,    // value: index into slots, -> address
+	IR_GLOBAL,  // symbol: declaration, -> address
+	IR_STRING,  // symbol: token, -> address
+	IR_LOAD,    // address
+	IR_STORE,   // address value
+	IR_CALL,    // symbol: declaration, arguments
+
+	// a b -> a op b
+	IR_ADD, IR_SUB, IR_MUL,
+	IR_DIV, IR_IDIV, IR_MOD, IR_IMOD,
+	IR_AND, IR_OR, IR_XOR,
+	IR_SHL, IR_SHR, IR_SAR,
+	IR_EQ, IR_NE,
+	IR_LT, IR_LE, IR_GT, IR_GE,
+	IR_ILT, IR_ILE, IR_IGT, IR_IGE,
+
+	// a -> op a
+	IR_NEG, IR_NOT,
+	IR_ZEXT, IR_SEXT, IR_TRUNC,
+	IR_CLZ, IR_CTZ, IR_POPCOUNT, IR_BSWAP, // at the width of a
+
+	IR_ROTL, // a b -> a rotated left by b
+	IR_CHECK, // a b -> a, traps unless a is below b as unsigned
+
+	// terminators
+	IR_JUMP,   // targets[0]
+	IR_BRANCH, // condition, targets[0] if not zero else targets[1]
+	IR_RETURN, // value, or nothing
+
+	IR_OPCODE_COUNT,
+};
+
+struct IR_Block;
+
+struct IR_Instruction {
+	enum IR_Opcode op;
+	enum IR_Width width;
+	int id; // %id in dumps
+
+	struct IR_Block *block;
+	struct IR_Instruction *prev, *next;
+
+	uint64_t value;
+	const void *symbol;
+
+	struct IR_Instruction **operands;
+	int operand_count, operand_capacity;
+
+	struct IR_Block *targets[2];
+
+	// scratch for passes: what this is replaced with, or a mark
+	struct IR_Instruction *forward;
+	int mark;
+};
+
+struct IR_Block {
+	int id; // b<id> in dumps
+	struct IR_Instruction *first, *last;
+
+	struct IR_Block **preds;
+	int pred_count, pred_capacity;
+
+	// construction: no more predecessors will be added
+	bool sealed;
+
+	// analysis: reverse postorder index, -1 if unreachable, and the immediate dominator
+	int order;
+	struct IR_Block *idom;
+	int depth;
+};
+
+struct IR_Slot {
+	struct AST_Declaration *declaration;
+	int size, align;
+};
+
+struct IR_Function {
+	struct AST_Declaration *declaration;
+
+	struct IR_Block **blocks; // the entry block first
+	int block_count, block_capacity;
+
+	struct IR_Slot *slots;
+	int slot_count, slot_capacity;
+
+	int values; // ids handed out
+	struct Allocator *allocator;
+};
+
+// lowers a function definition, allocating from the arena
+struct IR_Function *lower_function(struct Allocator *, struct TypeTable *, struct AST_Declaration *);
+
+// appends a text dump (chars): one instruction per line
+void dump_function(struct Vec *, struct TypeTable *, struct IR_Function *);
+
+// blocks in reverse postorder, drops unreachable ones and their edges
+void order_blocks(struct IR_Function *);
+
+// sparse conditional constant propagation: folds values that are constant
+// along every executable path and removes branches and blocks never taken
+void propagate_constants(struct IR_Function *);
+
+// global value numbering: an instruction computing the same pure value as
+// one that dominates it is replaced by it
+void number_values(struct IR_Function *);
+
+// removes instructions whose values are never used and have no effect,
+// and joins blocks to the only predecessor that jumps to them
+void eliminate_dead_code(struct IR_Function *);
+
+// all three in order
+void optimize_function(struct IR_Function *);
+
+// building blocks shared by the lowering and the passes
+
+void add_operand(struct IR_Function *, struct IR_Instruction *, struct IR_Instruction *operand);
+void remove_instruction(struct IR_Instruction *);
+
+// replaces every operand by what it was forwarded to
+void resolve_forwards(struct IR_Function *);
+
+// removes the edge from `pred` to `block` and the matching phi operands
+void remove_edge(struct IR_Block *pred, struct IR_Block *block);
+
+static inline
+bool is_terminator(enum IR_Opcode op) { return op >= IR_JUMP; }
+
+static inline
+int width_bits(enum IR_Width width) { return width == IR_VOID ? 0 : 4 << width; }
+
+// truncates to the width
+static inline
+uint64_t wrap_value(uint64_t value, enum IR_Width width) {
+	int bits = width_bits(width);
+	return bits == 64 ? value : value & ((UINT64_C(1) << bits) - 1);
+}
+
+#endif //IR_H_
@@ -0,0 +1,207 @@
+#include "jit.h"
+
+#ifdef HAVE_JIT
+
+#include "assembler.h"
+#include "ast.h"
+#include "literals.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+#include "x86.h"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+enum {
+	STUB_SIZE = 8, // jmp *slot(%rip), padded
+};
+
+// where a declaration ended up, sorted by declaration
+struct Address {
+	const void *declaration;
+	uint8_t *address;
+	uint8_t **slot; // of a function outside the program
+};
+
+static
+int compare_addresses(const void *a, const void *b) {
+	uintptr_t x = (uintptr_t)((const struct Address *)a)->declaration;
+	uintptr_t y = (uintptr_t)((const struct Address *)b)->declaration;
+	return (x > y) - (x < y);
+}
+
+static
+struct Address *find_address(struct Vec *addresses, const void *declaration) {
+	struct Address key = { .declaration = declaration };
+	return bsearch(&key, addresses->mem, addresses->length, sizeof key, compare_addresses);
+}
+
+static
+int align_to(int offset, int align) {
+	return (offset + align - 1) / align * align;
+}
+
+uint32_t jit_program(struct TypeTable *types, struct AST_Declaration **declarations, int count, unsigned features) {
+	struct Assembler as;
+	init_assembler(&as, NULL);
+	generate_code(&as, types, declarations, count, features);
+
+	struct CodeSymbol *functions = as.functions.mem;
+	struct AST_Declaration *main = NULL;
+
+	for (int i = 0; i < as.functions.length; i++) {
+		if (strcmp(functions[i].declaration->token->text, "main") == 0) main = functions[i].declaration;
+	}
+
+	if (main == NULL) errx("no function `main` to run");
+	if (main->param_count != 0) errx("`main` must take no parameters to be run");
+
+	// initial values first, string initialisers add strings
+	struct Vec values = vec(uint64_t);
+	struct Vec pointers = vec(int); // string index of each global, or -1
+
+	for (int i = 0; i < count; i++) {
+		if (declarations[i]->function) continue;
+
+		uint64_t bits;
+		int string = global_value(&as, types, declarations[i], &bits);
+
+		vec_push(&values, &bits);
+		vec_push(&pointers, &string);
+	}
+
+	int externs = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (declarations[i]->function && !declarations[i]->body) externs++;
+	}
+
+	// [code, stubs] [strings, slots] [globals], each part on its own pages
+	long page = sysconf(_SC_PAGESIZE);
+	int stubs = align_to(as.code.length, STUB_SIZE);
+	int rodata = align_to(stubs + externs * STUB_SIZE, page);
+
+	layout_literals(&as.strings);
+
+	int slots = align_to(rodata + as.strings.blob.length, 8);
+	int data = align_to(slots + externs * 8, page);
+
+	int offset = data;
+	for (int i = 0; i < count; i++) {
+		if (declarations[i]->function) continue;
+		offset = align_to(offset, type_align(types, declarations[i]->type.id)) + type_size(types, declarations[i]->type.id);
+	}
+
+	int size = align_to(max(offset, data + 1), page);
+
+	uint8_t *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) errx("failed to map %d bytes for the program", size);
+
+	memcpy(memory, as.code.mem, as.code.length);
+	memset(memory + as.code.length, 0xcc, rodata - as.code.length);
+
+	memcpy(memory + rodata, as.strings.blob.mem, as.strings.blob.length);
+
+	// every declaration gets an address: definitions where they were put,
+	// prototypes that of the definition with their name or a stub
+	struct Vec addresses = vec(struct Address);
+	uint64_t *value = values.mem;
+	int *pointer = pointers.mem;
+	int global = 0, defined = 0, external = 0;
+
+	offset = data;
+
+	for (int i = 0; i < count; i++) {
+		struct AST_Declaration *decl = declarations[i];
+		struct Address address = { decl, NULL, NULL };
+
+		if (!decl->function) {
+			int bytes = type_size(types, decl->type.id);
+			offset = align_to(offset, type_align(types, decl->type.id));
+			address.address = memory + offset;
+
+			// the pages are zero already, only scalars have initialisers
+			if (pointer[global] >= 0) value[global] = (uintptr_t)(memory + rodata + literal_offset(&as.strings, pointer[global]));
+			if (decl->value) memcpy(address.address, &value[global], bytes);
+
+			offset += bytes;
+			global++;
+		}
+
+		// in the order they were generated
+		else if (decl->body) {
+			address.address = memory + functions[defined++].offset;
+		}
+
+		else {
+			for (int j = 0; j < as.functions.length && !address.address; j++) {
+				if (strcmp(functions[j].declaration->token->text, decl->token->text) == 0) {
+					address.address = memory + functions[j].offset;
+				}
+			}
+
+			if (address.address == NULL) {
+				uint8_t *stub = memory + stubs + external * STUB_SIZE;
+				uint8_t **slot = (uint8_t **)(memory + slots) + external;
+				int32_t displacement = (uint8_t *)slot - (stub + 6);
+
+				stub[0] = 0xff;
+				stub[1] = 0x25;
+				memcpy(stub + 2, &displacement, 4);
+
+				*slot = dlsym(RTLD_DEFAULT, decl->token->text);
+				address.address = stub;
+				address.slot = slot;
+				external++;
+			}
+		}
+
+		vec_push(&addresses, &address);
+	}
+
+	qsort(addresses.mem, addresses.length, sizeof(struct Address), compare_addresses);
+
+	struct Relocation *relocations = as.relocations.mem;
+
+	for (int i = 0; i < as.relocations.length; i++) {
+		struct Relocation *relocation = &relocations[i];
+		uint8_t *target;
+
+		if (relocation->kind == TARGET_STRING) {
+			target = memory + rodata + literal_offset(&as.strings, relocation->string);
+		} else {
+			struct Address *address = find_address(&addresses, relocation->symbol);
+			assert(address && address->address);
+
+			if (address->slot && *address->slot == NULL) {
+				struct Token *name = ((struct AST_Declaration *)relocation->symbol)->token;
+				errx("%s:%d:%d: function `%s` is called but never defined", name->filename, name->line, name->col, name->text);
+			}
+
+			target = address->address;
+		}
+
+		int32_t displacement = target + relocation->addend - (memory + relocation->offset);
+		memcpy(memory + relocation->offset, &displacement, 4);
+	}
+
+	if (mprotect(memory, rodata, PROT_READ | PROT_EXEC) || mprotect(memory + rodata, data - rodata, PROT_READ)) {
+		errx("failed to make the program executable");
+	}
+
+	uint32_t (*entry)(void) = (uint32_t (*)(void))find_address(&addresses, main)->address;
+	uint32_t result = entry();
+
+	munmap(memory, size);
+	vec_free(&addresses);
+	vec_free(&values);
+	vec_free(&pointers);
+	free_assembler(&as);
+	return result;
+}
+
+#endif
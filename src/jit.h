@@ -0,0 +1,32 @@
+#ifndef JIT_H_
+#define JIT_H_
+
+#include "ast.h"
+#include "types.h"
+
+#include <stdint.h>
+
+// in-process compilation:
+//
+// the x86-64 backend encodes every function into memory mapped from the
+// kernel, laid out as code, then read-only data (strings, and the slots of
+// functions found in the process), then the globals. relocations are
+// patched in place, the code is made executable and main is called
+// directly. functions that are only declared are looked up with dlsym and
+// reached through a stub that jumps through their slot, since they can be
+// anywhere in the address space.
+//
+
+#if defined(__x86_64__) && defined(__linux__)
+#define HAVE_JIT
+#endif
+
+#ifdef HAVE_JIT
+
+// runs main and returns its result, errors are fatal. the features, of
+// enum Feature, must be ones the host has
+uint32_t jit_program(struct TypeTable *, struct AST_Declaration **, int count, unsigned features);
+
+#endif
+
+#endif //JIT_H_
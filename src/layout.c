@@ -0,0 +1,149 @@
+#include "layout.h"
+
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static PRINTF(2,3)
+void put_format(struct Vec *out, const char *fmt, ...) {
+	char line[512];
+
+	va_list args;
+	va_start(args, fmt);
+	int length = vsnprintf(line, sizeof line, fmt, args);
+	va_end(args);
+
+	vec_append(out, line, min(length, sizeof line - 1));
+}
+
+static
+void put_field(struct Vec *out, struct TypeTable *types, struct Field *field) {
+	char buffer[256];
+	put_format(out, "\t%6d %5d  %s %s\n", field->offset, type_size(types, field->type),
+	           print_type(types, field->type, buffer, sizeof buffer), field->token->text);
+}
+
+static
+void put_padding(struct Vec *out, int offset, int size) {
+	put_format(out, "\t%6d %5d  (padding)\n", offset, size);
+}
+
+// the first cache line boundary inside the field, 0 if it spans no more
+// lines than its size needs
+static
+int straddled_line(int offset, int size) {
+	if (size == 0) return 0;
+
+	int first = offset / CACHE_LINE_SIZE, last = (offset + size - 1) / CACHE_LINE_SIZE;
+	if (last - first + 1 <= (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) return 0;
+
+	return (first + 1) * CACHE_LINE_SIZE;
+}
+
+// the size of the struct with its fields in that order
+static
+int ordered_size(struct TypeTable *types, struct TypeEntry *T, int *order) {
+	int offset = 0;
+
+	for (int i = 0; i < T->length; i++) {
+		unsigned type = T->fields[order[i]].type;
+		int align = type_align(types, type);
+
+		offset = (offset + align - 1) / align * align + type_size(types, type);
+	}
+
+	return (offset + T->align - 1) / T->align * T->align;
+}
+
+// fields are stored by alignment, each as an array of n
+static
+void report_soa(struct Vec *out, struct TypeTable *types, unsigned id, int *order) {
+	struct TypeEntry *T = get_type(types, id);
+	char buffer[256];
+
+	put_format(out, "soa %s: %d bytes per element, align %d, one array per field\n",
+	           print_type(types, id, buffer, sizeof buffer), T->size, T->align);
+
+	order_fields(types, T->fields, T->length, order);
+
+	for (int i = 0; i < T->length; i++) {
+		struct Field *field = &T->fields[order[i]];
+		put_format(out, "\t%4d*n %5d  %s %s\n", field->offset, type_size(types, field->type),
+		           print_type(types, field->type, buffer, sizeof buffer), field->token->text);
+	}
+}
+
+void report_layout(struct Vec *out, struct TypeTable *types, unsigned id) {
+	struct TypeEntry *T = get_type(types, id);
+	char buffer[256];
+
+	int *order = malloc(max(T->length, 1) * sizeof *order);
+	if (!order) errx("out of memory: failed to allocate %zu bytes", T->length * sizeof *order);
+
+	if (T->soa) {
+		report_soa(out, types, id, order);
+		free(order);
+		return;
+	}
+
+	put_format(out, "%s: %d bytes, align %d\n", print_type(types, id, buffer, sizeof buffer), T->size, T->align);
+
+	// union members all start at 0, the padding is what the largest leaves
+	int end = 0, padding = 0;
+
+	for (int i = 0; i < T->length; i++) {
+		struct Field *field = &T->fields[i];
+
+		if (field->offset > end) {
+			put_padding(out, end, field->offset - end);
+			padding += field->offset - end;
+		}
+
+		put_field(out, types, field);
+		end = max(end, field->offset + type_size(types, field->type));
+	}
+
+	if (T->size > end) {
+		put_padding(out, end, T->size - end);
+		padding += T->size - end;
+	}
+
+	if (padding) put_format(out, "\t%d of %d bytes are padding\n", padding, T->size);
+
+	for (int i = 0; i < T->length; i++) {
+		struct Field *field = &T->fields[i];
+		int line = straddled_line(field->offset, type_size(types, field->type));
+
+		if (line) put_format(out, "\t`%s` straddles the cache line at byte %d\n", field->token->text, line);
+	}
+
+	if (T->kind == TYPE_STRUCT && padding) {
+		order_fields(types, T->fields, T->length, order);
+		int size = ordered_size(types, T, order);
+
+		if (size < T->size) {
+			put_format(out, "\treordered as");
+			for (int i = 0; i < T->length; i++) put_format(out, "%s %s", i ? "," : "", T->fields[order[i]].token->text);
+			put_format(out, ": %d bytes, saves %d\n", size, T->size - size);
+		}
+	}
+
+	free(order);
+}
+
+void report_layouts(struct Vec *out, struct TypeTable *types) {
+	bool first = true;
+
+	for (int id = 0; id < types->count; id++) {
+		struct TypeEntry *T = get_type(types, id);
+		if ((T->kind != TYPE_STRUCT && T->kind != TYPE_UNION) || T->incomplete) continue;
+
+		if (!first) put_format(out, "\n");
+		report_layout(out, types, id);
+		first = false;
+	}
+}
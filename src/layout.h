@@ -0,0 +1,30 @@
+#ifndef LAYOUT_H_
+#define LAYOUT_H_
+
+#include "types.h"
+#include "util.h"
+
+// layout reports:
+//
+// for tuning hot data structures by hand. every struct and union defined
+// is listed with the offset and size of its fields and the padding
+// between them. fields are flagged when they straddle a 64-byte cache
+// line of an object that starts on one, and a struct whose fields waste
+// padding is given the order that needs the least: by decreasing
+// alignment, which leaves no padding but at the end when every size is a
+// multiple of its alignment. soa structs are listed by the arrays they
+// store, which need no padding.
+//
+
+enum {
+	CACHE_LINE_SIZE = 64,
+};
+
+// appends the report of one struct or union (chars)
+void report_layout(struct Vec *, struct TypeTable *, unsigned id);
+
+// appends the reports of every defined struct and union, in the order
+// they were declared
+void report_layouts(struct Vec *, struct TypeTable *);
+
+#endif //LAYOUT_H_
@@ -12,18 +12,6 @@
 #include "allocator.h"
 #include "util.h"
 
-enum {
-	MAX_BUFFER_SIZE = 1024,
-	MAX_LINE_LENGTH = 120,
-};
-
-enum LexerErrorType {
-	NOTE, WARNING, ERROR,
-};
-
-// offset is location of error, if NULL, then lexer->col is used instead
-void lexer_err(struct Lexer *lexer, enum LexerErrorType, const char *offset, const char *fmt, ...) PRINTF(4,5);
-
 static
 const char multichar[][2] = {
 	"<<", ">>", "==", "!=", "<=", ">=", "&&", "||", "++", "--", "::",
@@ -209,12 +197,13 @@ struct KeywordEntry {
 
 #define SIZE 256
 
-static_assert(KEYWORD_COUNT == 19, "update table to add/remove keyword");
+static_assert(KEYWORD_COUNT == 23, "update table to add/remove keyword");
 
 static
 struct KeywordEntry keywords[SIZE] = {
 	[0xdf] = { .keyword = "break",      .length = 5,   KEYWORD_BREAK,      .hash = 0x64facedf },
 	[0x1d] = { .keyword = "case",       .length = 4,   KEYWORD_CASE,       .hash = 0xf61c661d },
+	[0xe3] = { .keyword = "default",    .length = 7,   KEYWORD_DEFAULT,    .hash = 0x198ec3e3 },
 	[0xd8] = { .keyword = "do",         .length = 2,   KEYWORD_DO,         .hash = 0x54df01d8 },
 	[0x27] = { .keyword = "else",       .length = 4,   KEYWORD_ELSE,       .hash = 0xc3248327 },
 	[0x0a] = { .keyword = "enum",       .length = 4,   KEYWORD_ENUM,       .hash = 0x5acab70a },
@@ -223,6 +212,7 @@ struct KeywordEntry keywords[SIZE] = {
 	[0xa3] = { .keyword = "int",        .length = 3,   KEYWORD_INT,        .hash = 0xda41e7a3 },
 	[0x5c] = { .keyword = "return",     .length = 6,   KEYWORD_RETURN,     .hash = 0xb217c05c },
 	[0x6b] = { .keyword = "sizeof",     .length = 6,   KEYWORD_SIZEOF,     .hash = 0xb6ffd66b },
+	[0x55] = { .keyword = "soa",        .length = 3,   KEYWORD_SOA,        .hash = 0xd0641655 },
 	[0x07] = { .keyword = "struct",     .length = 6,   KEYWORD_STRUCT,     .hash = 0x029c0107 },
 	[0x47] = { .keyword = "switch",     .length = 6,   KEYWORD_SWITCH,     .hash = 0x11b08047 },
 	[0x9d] = { .keyword = "true",       .length = 4,   KEYWORD_TRUE,       .hash = 0x506b889d },
@@ -230,20 +220,24 @@ struct KeywordEntry keywords[SIZE] = {
 	[0x23] = { .keyword = "u8",         .length = 2,   KEYWORD_U8,         .hash = 0x06f4f723 },
 	[0x31] = { .keyword = "u16",        .length = 3,   KEYWORD_U16,        .hash = 0x33d14a31 },
 	[0x60] = { .keyword = "u32",        .length = 3,   KEYWORD_U32,        .hash = 0x3f0e5960 },
+	[0xec] = { .keyword = "u8x16",      .length = 5,   KEYWORD_U8X16,      .hash = 0xb68614ec },
+	[0xc2] = { .keyword = "u32x4",      .length = 5,   KEYWORD_U32X4,      .hash = 0x1d2234c2 },
 	[0xa7] = { .keyword = "void",       .length = 4,   KEYWORD_VOID,       .hash = 0x85859ea7 },
 	[0xd6] = { .keyword = "while",      .length = 5,   KEYWORD_WHILE,      .hash = 0xe80392d6 },
 };
 
-static_assert(PREPROC_COUNT == 7, "updated table to add/remove preprocessor directive");
+static_assert(PREPROC_COUNT == 9, "updated table to add/remove preprocessor directive");
 
 static
-struct KeywordEntry preprocs[] = {
+struct KeywordEntry preprocs[SIZE] = {
+	[0x74] = { .keyword = "define",     .length = 6,   PREPROC_DEFINE,     .hash = 0x4406fb74 },
 	[0x15] = { .keyword = "elif",       .length = 4,   PREPROC_ELIF,       .hash = 0x39112d15 },
 	[0x27] = { .keyword = "else",       .length = 4,   PREPROC_ELSE,       .hash = 0xc3248327 },
 	[0xe1] = { .keyword = "endif",      .length = 5,   PREPROC_ENDIF,      .hash = 0x6688b4e1 },
 	[0xa3] = { .keyword = "error",      .length = 5,   PREPROC_ERROR,      .hash = 0x3baebaa3 },
 	[0x9a] = { .keyword = "if",         .length = 2,   PREPROC_IF,         .hash = 0xa268309a },
 	[0xd3] = { .keyword = "include",    .length = 7,   PREPROC_INCLUDE,    .hash = 0x0ad7a1d3 },
+	[0x8e] = { .keyword = "pragma",     .length = 6,   PREPROC_PRAGMA,     .hash = 0xd30a808e },
 	[0x7d] = { .keyword = "warning",    .length = 7,   PREPROC_WARNING,    .hash = 0x6b8db27d },
 };
 
@@ -319,7 +313,8 @@ void chop_token(struct Lexer *lexer, struct Vec *tokens) {
 			length = chop_string(lexer, '"', buffer);
 			if (length < 0) return; //string error
 
-			token.text = store_string(lexer->allocator, buffer, length);
+			token.length = length;
+			token.text = intern_literal(lexer->literals, lexer->allocator, buffer, length);
 			break;
 
 		case '\'':
@@ -378,6 +373,27 @@ void chop_token(struct Lexer *lexer, struct Vec *tokens) {
 }
 
 
+// reads `#name` at the start of a line without storing a token, so that
+// directives in skipped code allocate nothing
+enum TokenType lex_directive(struct Lexer *lexer) {
+	char buffer[MAX_BUFFER_SIZE];
+
+	while (isspace(peek_next(lexer))) chop_next(lexer);
+	assert(peek_next(lexer) == '#');
+	chop_next(lexer);
+
+	while (isspace(peek_next(lexer))) chop_next(lexer);
+
+	int length = chop_identifier(lexer, buffer);
+	enum TokenType type = lookup_keyword(buffer, length, PREPROC);
+
+	if (type == NONE) {
+		lexer_err(lexer, ERROR, lexer->stream - length, "invalid preprocessor directive");
+	}
+
+	return type;
+}
+
 void lex_line(struct Lexer *lexer, struct Vec *tokens) {
 	while (peek_next(lexer) != '\0') {
 		// skip whitespace
@@ -399,103 +415,37 @@ void lex_line(struct Lexer *lexer, struct Vec *tokens) {
 }
 
 
-void lex_file(const char *filename, struct Allocator *allocator, struct Vec *tokens) {
-	// open file for reading
-	FILE *file = fopen(filename, "r");
-
-	if (!file) {
-		errx("file `%s` not found", filename);
-	}
-
-	// initialise lexer
-	char buffer[MAX_BUFFER_SIZE];
-
-	struct Lexer lexer = {
-		.filename = filename,
-		.start = buffer,
-		.line = 1, .col = 1,
-		.errors = 0,
-		.allocator = allocator,
-	};
-
-	// iterate lines
-	while (fgets(buffer, sizeof buffer, file)) {
-		int length = strcspn(buffer, "\n");
-		buffer[length] = 0;
-
-		if (length == MAX_BUFFER_SIZE - 1) {
-			lexer_err(&lexer, ERROR, NULL, "line is too long");
-		}
-
-		else if (length > MAX_LINE_LENGTH) {
-			lexer_err(&lexer, WARNING, NULL, "line exceeds %d chars", MAX_LINE_LENGTH);
-		}
-
-		// replace tabs with spaces to align error context
-		//for (int i = 0; i < length; i++)
-		//	if (buffer[i] == '\t') buffer[i] = ' ';
-
-		lexer.stream = lexer.start;
-		lex_line(&lexer, tokens);
-
-		lexer.line += 1;
-		lexer.col = 1;
-	}
-
-	struct Token end_of_file = {
-		.type = TOK_EOF,
-		.filename = filename,
-		.line = lexer.line,
-		.col = lexer.col,
-	};
-
-	vec_push(tokens, &end_of_file);
-
-	if (lexer.errors > 0)
-		errx("too many errors");
-}
-
-
 // LEXER ERRORS //
 
 void lexer_err(struct Lexer *lexer, enum LexerErrorType type, const char *offset, const char *fmt, ...) {
-	// print location info
-	int column = offset ? lexer->col - (lexer->stream - offset) : lexer->col;
-	printf(WHITE"%s:%d:%d: ", lexer->filename, lexer->line, column);
-
-	// print coloured error type
-	switch (type) {
-		case NOTE:
-			printf(GREY "note: " RESET);
-			break;
+	static const char *const labels[] = {
+		[NOTE] = GREY "note: " RESET,
+		[WARNING] = MAGENTA "warning: " RESET,
+		[ERROR] = RED "error: " RESET,
+	};
 
-		case WARNING:
-			printf(MAGENTA "warning: " RESET);
-			break;
+	if (type == ERROR) lexer->errors++;
 
-		case ERROR:
-			printf(RED "error: " RESET);
-			lexer->errors++;
-			break;
-	}
+	// location info and coloured error type
+	char buffer[1024];
+	int column = offset ? lexer->col - (lexer->stream - offset) : lexer->col;
+	int length = snprintf(buffer, sizeof buffer, WHITE "%s:%d:%d: %s", lexer->filename, lexer->line, column, labels[type]);
+	length = min(length, sizeof buffer - 1);
 
-	// print message
+	// message, formatted whole so that messages of other threads do not interleave
 	va_list args;
 	va_start(args, fmt);
-	vprintf(fmt, args);
+	length += vsnprintf(buffer + length, sizeof buffer - length, fmt, args);
 	va_end(args);
 
-	// print context
-	//printf("\n%5d | %s\n", lexer->line, lexer->start);
-	//printf("      | ");
+	length = min(length, sizeof buffer - 2);
+	buffer[length++] = '\n';
+	buffer[length] = 0;
 
-	//int indent = (offset ?: lexer->stream) - lexer->start;
-	//int length = offset ? (lexer->stream - offset - 1) : 0;
-
-	//for (int i = 0; i < indent; i++) putchar(' ');
-	//putchar('^');
+	if (lexer->diagnostics == NULL) {
+		fputs(buffer, stdout);
+		return;
+	}
 
-	//for (int i = 0; i < length; i++) putchar('~');
-	//putchar('\n');
-	putchar('\n');
+	vec_append(lexer->diagnostics, buffer, length);
 }
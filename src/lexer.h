@@ -3,9 +3,19 @@
 
 #include <stdbool.h>
 
+#include "literals.h"
 #include "tokens.h"
 #include "util.h"
 
+enum {
+	MAX_BUFFER_SIZE = 1024,
+	MAX_LINE_LENGTH = 120,
+};
+
+enum LexerErrorType {
+	NOTE, WARNING, ERROR,
+};
+
 struct Lexer {
 	const char *filename;
 	const char *stream, *start;
@@ -13,9 +23,14 @@ struct Lexer {
 	int errors;
 
 	struct Allocator *allocator;
+	struct LiteralPool *literals; // string literals are interned
+	struct Vec *diagnostics;      // buffered messages (chars), NULL prints directly
 };
 
 void lex_line(struct Lexer *, struct Vec *tokens);
-void lex_file(const char *filename, struct Allocator *, struct Vec *tokens);
+enum TokenType lex_directive(struct Lexer *);
+
+// offset is location of error, if NULL, then lexer->col is used instead
+void lexer_err(struct Lexer *lexer, enum LexerErrorType, const char *offset, const char *fmt, ...) PRINTF(4,5);
 
 #endif //LEXER_H_
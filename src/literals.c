@@ -0,0 +1,129 @@
+#include "literals.h"
+
+#include "allocator.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void init_literal_pool(struct LiteralPool *pool) {
+	*pool = (struct LiteralPool) {
+		.literals = vec(struct Literal),
+		.blob = vec(char),
+	};
+}
+
+void free_literal_pool(struct LiteralPool *pool) {
+	vec_free(&pool->literals);
+	vec_free(&pool->blob);
+	free(pool->index);
+}
+
+static
+void grow_index(struct LiteralPool *pool) {
+	pool->capacity = max(256, pool->capacity * 2);
+	free(pool->index);
+
+	pool->index = calloc(pool->capacity, sizeof *pool->index);
+	if (!pool->index) errx("out of memory: failed to allocate %d slots", pool->capacity);
+
+	struct Literal *literals = pool->literals.mem;
+
+	for (int i = 0; i < pool->literals.length; i++) {
+		unsigned slot = literals[i].key;
+		while (pool->index[slot & (pool->capacity - 1)]) slot++;
+		pool->index[slot & (pool->capacity - 1)] = i + 1;
+	}
+}
+
+// the id of the literal, or -1 with *slot where it would go
+static
+int find_literal(struct LiteralPool *pool, const char *text, int length, unsigned key, unsigned *slot) {
+	if (2 * (pool->literals.length + 1) > pool->capacity) grow_index(pool);
+
+	struct Literal *literals = pool->literals.mem;
+
+	for (unsigned i = key;; i++) {
+		int id = pool->index[i & (pool->capacity - 1)] - 1;
+
+		if (id < 0) {
+			*slot = i & (pool->capacity - 1);
+			return -1;
+		}
+
+		struct Literal *literal = &literals[id];
+		if (literal->key == key && literal->length == length && memcmp(literal->text, text, length) == 0) return id;
+	}
+}
+
+static
+int insert_literal(struct LiteralPool *pool, const char *text, int length, unsigned key, unsigned slot) {
+	struct Literal literal = { text, length, key, -1 };
+
+	vec_push(&pool->literals, &literal);
+	pool->index[slot] = pool->literals.length;
+	return pool->literals.length - 1;
+}
+
+int add_literal(struct LiteralPool *pool, const char *text, int length) {
+	unsigned key = hash(text, length), slot;
+	int id = find_literal(pool, text, length, key, &slot);
+
+	return id >= 0 ? id : insert_literal(pool, text, length, key, slot);
+}
+
+const char *intern_literal(struct LiteralPool *pool, struct Allocator *allocator, const char *text, int length) {
+	unsigned key = hash(text, length), slot;
+	int id = find_literal(pool, text, length, key, &slot);
+
+	if (id < 0) id = insert_literal(pool, store_string(allocator, text, length), length, key, slot);
+	return ((struct Literal *)pool->literals.mem)[id].text;
+}
+
+
+// layout
+
+// by content read backwards, greatest first, so that a literal comes right
+// after the ones it ends
+static
+int compare_tails(const void *a, const void *b) {
+	const struct Literal *x = *(struct Literal *const *)a, *y = *(struct Literal *const *)b;
+	int length = min(x->length, y->length);
+
+	for (int i = 1; i <= length; i++) {
+		unsigned char p = x->text[x->length - i], q = y->text[y->length - i];
+		if (p != q) return q - p;
+	}
+
+	return y->length - x->length;
+}
+
+void layout_literals(struct LiteralPool *pool) {
+	int count = pool->literals.length;
+	struct Literal *literals = pool->literals.mem;
+	struct Literal **order = malloc((count + 1) * sizeof *order);
+	if (!order) errx("out of memory: failed to lay out %d literals", count);
+
+	for (int i = 0; i < count; i++) order[i] = &literals[i];
+	qsort(order, count, sizeof *order, compare_tails);
+
+	vec_truncate(&pool->blob, 0);
+	struct Literal *last = NULL;
+
+	for (int i = 0; i < count; i++) {
+		struct Literal *literal = order[i];
+		int start = last ? last->length - literal->length : -1;
+
+		if (start >= 0 && memcmp(last->text + start, literal->text, literal->length) == 0) {
+			literal->offset = last->offset + start;
+		} else {
+			literal->offset = pool->blob.length;
+			vec_append(&pool->blob, literal->text, literal->length);
+			vec_append(&pool->blob, "", 1);
+		}
+
+		last = literal;
+	}
+
+	free(order);
+}
@@ -0,0 +1,53 @@
+#ifndef LITERALS_H_
+#define LITERALS_H_
+
+#include "allocator.h"
+#include "util.h"
+
+#include <stdint.h>
+
+// string literal pool:
+//
+// literals are kept once per content, found by hash. the lexer interns the
+// text of every string token, so equal literals share one arena copy. the
+// backends collect the literals their code uses in a pool of their own and
+// lay it out as one read-only blob: a literal that ends another is placed
+// inside it, the way linkers merge string tails, so "world" costs nothing
+// next to "hello world". literals are NUL-terminated in the blob and may
+// hold NULs of their own.
+//
+
+struct Literal {
+	const char *text;
+	int length;
+	unsigned key;
+	int offset; // in the blob, -1 until laid out
+};
+
+struct LiteralPool {
+	struct Vec literals; // struct Literal, by id in the order they were added
+	int *index;          // open addressing: id + 1, 0 if empty
+	int capacity;
+
+	struct Vec blob; // char, once laid out
+};
+
+void init_literal_pool(struct LiteralPool *);
+void free_literal_pool(struct LiteralPool *);
+
+// the id of the literal with this content, added if it is new. the text
+// is not copied and must outlive the pool
+int add_literal(struct LiteralPool *, const char *text, int length);
+
+// the arena copy of the text, shared by every literal with its content
+const char *intern_literal(struct LiteralPool *, struct Allocator *, const char *text, int length);
+
+// builds the blob, literals added afterwards need another layout
+void layout_literals(struct LiteralPool *);
+
+static inline
+int literal_offset(struct LiteralPool *pool, int id) {
+	return ((struct Literal *)pool->literals.mem)[id].offset;
+}
+
+#endif //LITERALS_H_
@@ -0,0 +1,405 @@
+#include "macro.h"
+
+#include "allocator.h"
+#include "lexer.h"
+#include "preproc.h"
+#include "tokens.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// one run of the expander: over the frames above `base`, into `out`.
+// collecting an argument, it stops at a `,` or `)` of the invocation's
+// own tokens, those of frames owned below `raw`
+struct Context {
+	struct Vec *out;
+	int base, raw, depth;
+	bool argument;
+	struct Context *parent;
+};
+
+
+// definitions
+
+static
+bool is_punctuation(const struct Token *token, unsigned value) {
+	return token->type == PUNCTUATION && token->value == value;
+}
+
+static
+bool same_token(const struct Token *a, const struct Token *b) {
+	if (a->type != b->type) return false;
+
+	if (a->type == SYMBOL || a->type == STRING_LITERAL) {
+		return a->length == b->length && memcmp(a->text, b->text, a->length) == 0;
+	}
+
+	return a->value == b->value && a->is_char == b->is_char;
+}
+
+bool same_macro(struct Macro *a, struct Macro *b) {
+	if (a->function != b->function || a->param_count != b->param_count || a->body_length != b->body_length) {
+		return false;
+	}
+
+	for (int i = 0; i < a->body_length; i++) {
+		if (!same_token(&a->body[i], &b->body[i])) return false;
+		if (a->function && a->parameters[i] != b->parameters[i]) return false;
+	}
+
+	return true;
+}
+
+bool parse_macro(struct Lexer *lexer, struct Allocator *allocator, struct Token *args, int count, struct Macro *macro) {
+	struct Token *name = &args[0];
+	struct Token *params[MAX_MACRO_PARAMETERS];
+	int i = 1;
+
+	*macro = (struct Macro) { .name = name->text, .length = name->length };
+
+	// function-like when the parenthesis follows the name without a space
+	if (count > 1 && is_punctuation(&args[1], '(') && args[1].col == name->col + name->length) {
+		macro->function = true;
+		i = 2;
+
+		if (i < count && is_punctuation(&args[i], ')')) {
+			i++;
+		}
+
+		else for (;;) {
+			if (i == count || args[i].type != SYMBOL) {
+				lexer_err(lexer, ERROR, NULL, "expected parameter name in macro `%s`", name->text);
+				return false;
+			}
+
+			for (int j = 0; j < macro->param_count; j++) {
+				if (strcmp(params[j]->text, args[i].text) == 0) {
+					lexer_err(lexer, ERROR, NULL, "duplicate parameter `%s` in macro `%s`", args[i].text, name->text);
+					return false;
+				}
+			}
+
+			if (macro->param_count == MAX_MACRO_PARAMETERS) {
+				lexer_err(lexer, ERROR, NULL, "macro `%s` has too many parameters (limit is %d)",
+				          name->text, MAX_MACRO_PARAMETERS);
+				return false;
+			}
+
+			params[macro->param_count++] = &args[i++];
+
+			if (i < count && is_punctuation(&args[i], ')')) {
+				i++;
+				break;
+			}
+
+			if (i == count || !is_punctuation(&args[i], ',')) {
+				lexer_err(lexer, ERROR, NULL, "expected `,` or `)` in parameters of macro `%s`", name->text);
+				return false;
+			}
+
+			i++;
+		}
+	}
+
+	macro->body_length = count - i;
+	if (macro->body_length == 0) return true;
+
+	macro->body = store_object(allocator, args + i, macro->body_length * sizeof(struct Token));
+	if (!macro->function) return true;
+
+	short parameters[macro->body_length];
+
+	for (int j = 0; j < macro->body_length; j++) {
+		parameters[j] = 0;
+		if (macro->body[j].type != SYMBOL) continue;
+
+		for (int k = 0; k < macro->param_count; k++) {
+			if (strcmp(params[k]->text, macro->body[j].text) == 0) parameters[j] = k + 1;
+		}
+	}
+
+	macro->parameters = store_object(allocator, parameters, sizeof parameters);
+	return true;
+}
+
+
+// expansion
+
+// the arguments of nested invocations are collected at the same time, so
+// each depth has its own list
+static
+struct Vec *argument_list(struct Preprocessor *pp, int level) {
+	while (pp->arguments.length <= level) {
+		struct Vec *list = malloc(sizeof *list);
+		if (!list) errx("out of memory: failed to allocate argument list");
+
+		*list = vec(struct Token);
+		vec_push(&pp->arguments, &list);
+	}
+
+	return ((struct Vec **)pp->arguments.mem)[level];
+}
+
+static
+struct Frame *top_frame(struct Preprocessor *pp) {
+	return (struct Frame *)pp->frames.mem + pp->frames.length - 1;
+}
+
+static
+void push_frame(struct Preprocessor *pp, struct Context *ctx, struct Frame frame) {
+	frame.owner = pp->frames.length;
+	frame.context = ctx->depth;
+	frame.uses = pp->uses.length;
+
+	if (frame.macro) {
+		frame.macro->active = pp->frames.length + 1;
+		frame.start = ctx->out->length;
+		pp->expansions++;
+	}
+
+	vec_push(&pp->frames, &frame);
+}
+
+static
+void macro_error(struct Preprocessor *pp, const struct Token *at, const char *message, struct Macro *macro) {
+	struct Lexer lexer = { .filename = at->filename, .line = at->line, .col = at->col, .diagnostics = pp->diagnostics };
+	lexer_err(&lexer, ERROR, NULL, message, macro->length, macro->name);
+	pp->errors += lexer.errors;
+}
+
+// keeps an object-like expansion and the macros it expanded, once each
+static
+void record(struct Preprocessor *pp, struct Frame *frame, struct Vec *out) {
+	struct Macro *macro = frame->macro;
+	struct Macro **uses = (struct Macro **)pp->uses.mem + frame->uses;
+	int count = 0;
+
+	pp->stamp++;
+
+	for (int i = 0; i < pp->uses.length - frame->uses; i++) {
+		if (uses[i]->stamp == pp->stamp) continue;
+
+		uses[i]->stamp = pp->stamp;
+		uses[count++] = uses[i];
+	}
+
+	vec_truncate(&pp->uses, frame->uses + count);
+
+	macro->expansion_length = out->length - frame->start;
+	macro->expansion = macro->expansion_length
+		? store_object(pp->allocator, (struct Token *)out->mem + frame->start, macro->expansion_length * sizeof(struct Token))
+		: NULL;
+
+	macro->use_count = count;
+	macro->uses = count ? store_object(pp->allocator, uses, count * sizeof *uses) : NULL;
+	macro->generation = pp->generation;
+}
+
+// an expansion is only kept if it was written by the run that started it,
+// and not while looking ahead for the `(` of an invocation
+static
+void pop_frame(struct Preprocessor *pp, struct Context *ctx, bool peeking) {
+	struct Frame frame = *top_frame(pp);
+	vec_truncate(&pp->frames, pp->frames.length - 1);
+
+	if (frame.macro) {
+		frame.macro->active = 0;
+
+		if (!frame.macro->function && !frame.tainted && !peeking && frame.context == ctx->depth &&
+		    frame.macro->generation != pp->generation) {
+			record(pp, &frame, ctx->out);
+		}
+	}
+
+	for (struct Context *c = ctx; c; c = c->parent) {
+		c->raw = min(c->raw, pp->frames.length);
+	}
+}
+
+// the next token, closing finished frames and opening arguments. the
+// pointer is only valid until the next frame is pushed
+static
+const struct Token *peek(struct Preprocessor *pp, struct Context *ctx, bool peeking) {
+	while (pp->frames.length > ctx->base) {
+		struct Frame *frame = top_frame(pp);
+
+		if (frame->cursor == frame->end) {
+			pop_frame(pp, ctx, peeking);
+			continue;
+		}
+
+		int parameter = frame->macro && frame->macro->function ? frame->macro->parameters[frame->cursor] : 0;
+
+		if (parameter == 0) {
+			const struct Token *tokens = frame->tokens ? frame->tokens : argument_list(pp, frame->level)->mem;
+			return &tokens[frame->cursor];
+		}
+
+		frame->cursor++;
+
+		struct Range range = ((struct Range *)pp->ranges.mem)[frame->arguments + parameter - 1];
+		struct Frame argument = { .cursor = range.start, .end = range.end, .level = range.level };
+		int owner = frame->owner;
+
+		push_frame(pp, ctx, argument);
+		top_frame(pp)->owner = owner;
+	}
+
+	return NULL;
+}
+
+static
+bool expand(struct Preprocessor *pp, struct Context *ctx, struct Token *delimiter);
+
+static
+void invoke(struct Preprocessor *pp, struct Context *ctx, struct Macro *macro, struct Token *name) {
+	const struct Token *open = peek(pp, ctx, true);
+
+	if (open == NULL || !is_punctuation(open, '(')) {
+		vec_push(ctx->out, name);
+		return;
+	}
+
+	top_frame(pp)->cursor++;
+
+	struct Context arguments = {
+		.out = argument_list(pp, ctx->depth),
+		.base = ctx->base,
+		.raw = pp->frames.length,
+		.depth = ctx->depth + 1,
+		.argument = true,
+		.parent = ctx,
+	};
+
+	// nested invocations add their own ranges meanwhile
+	struct Range ranges[MAX_MACRO_PARAMETERS];
+	struct Token delimiter;
+	int count = 0;
+
+	do {
+		struct Range range = { arguments.out->length, 0, ctx->depth };
+
+		if (!expand(pp, &arguments, &delimiter)) {
+			macro_error(pp, name, "unterminated argument list invoking macro `%.*s`", macro);
+			return;
+		}
+
+		range.end = arguments.out->length;
+		if (count < MAX_MACRO_PARAMETERS) ranges[count] = range;
+		count++;
+	} while (delimiter.value == ',');
+
+	// `f()` passes no arguments
+	if (count == 1 && macro->param_count == 0 && ranges[0].start == ranges[0].end) count = 0;
+
+	if (count != macro->param_count) {
+		struct Lexer lexer = {
+			.filename = name->filename, .line = name->line, .col = name->col,
+			.diagnostics = pp->diagnostics,
+		};
+		lexer_err(&lexer, ERROR, NULL, "macro `%.*s` takes %d argument%s, got %d",
+		          macro->length, macro->name, macro->param_count, macro->param_count == 1 ? "" : "s", count);
+		pp->errors += lexer.errors;
+		return;
+	}
+
+	int first = pp->ranges.length;
+	vec_append(&pp->ranges, ranges, count);
+
+	vec_push(&pp->uses, &macro);
+	push_frame(pp, ctx, (struct Frame) { .macro = macro, .tokens = macro->body, .end = macro->body_length, .arguments = first });
+}
+
+static
+bool is_reusable(struct Preprocessor *pp, struct Macro *macro) {
+	if (macro->generation != pp->generation) return false;
+
+	for (int i = 0; i < macro->use_count; i++) {
+		if (macro->uses[i]->active) return false;
+	}
+
+	return true;
+}
+
+static
+bool expand(struct Preprocessor *pp, struct Context *ctx, struct Token *delimiter) {
+	int depth = 0; // of parentheses in an argument
+
+	for (;;) {
+		const struct Token *next = peek(pp, ctx, false);
+		if (next == NULL) return false;
+
+		struct Token token = *next;
+		struct Frame *frame = top_frame(pp);
+		frame->cursor++;
+
+		if (ctx->argument && frame->owner < ctx->raw && token.type == PUNCTUATION) {
+			if (token.value == '(') {
+				depth++;
+			}
+
+			else if (token.value == ')' && depth > 0) {
+				depth--;
+			}
+
+			else if (depth == 0 && (token.value == ')' || token.value == ',')) {
+				*delimiter = token;
+				return true;
+			}
+		}
+
+		struct Macro *macro = token.type == SYMBOL ? lookup_macro(pp, token.text, token.length) : NULL;
+
+		if (macro == NULL) {
+			vec_push(ctx->out, &token);
+		}
+
+		// every expansion above the frame of the active macro depends on it
+		else if (macro->active) {
+			for (int i = macro->active; i < pp->frames.length; i++) {
+				((struct Frame *)pp->frames.mem)[i].tainted = true;
+			}
+
+			vec_push(ctx->out, &token);
+		}
+
+		else if (macro->function) {
+			invoke(pp, ctx, macro, &token);
+		}
+
+		else if (is_reusable(pp, macro)) {
+			vec_append(ctx->out, macro->expansion, macro->expansion_length);
+			vec_push(&pp->uses, &macro);
+			vec_append(&pp->uses, macro->uses, macro->use_count);
+			pp->expansions++;
+		}
+
+		else {
+			vec_push(&pp->uses, &macro);
+			push_frame(pp, ctx, (struct Frame) { .macro = macro, .tokens = macro->body, .end = macro->body_length });
+		}
+	}
+}
+
+int expand_macros(struct Preprocessor *pp, const struct Token *tokens, int count, struct Vec *out) {
+	if (pp->macros.length == 0) {
+		vec_append(out, tokens, count);
+		return 0;
+	}
+
+	int expansions = pp->expansions;
+	struct Context ctx = { .out = out, .base = pp->frames.length };
+
+	push_frame(pp, &ctx, (struct Frame) { .tokens = tokens, .end = count });
+	expand(pp, &ctx, NULL);
+
+	for (int i = 0; i < pp->arguments.length; i++) {
+		vec_truncate(((struct Vec **)pp->arguments.mem)[i], 0);
+	}
+
+	vec_truncate(&pp->ranges, 0);
+	vec_truncate(&pp->uses, 0);
+
+	return pp->expansions - expansions;
+}
@@ -0,0 +1,57 @@
+#ifndef MACRO_H_
+#define MACRO_H_
+
+#include "allocator.h"
+#include "lexer.h"
+#include "preproc.h"
+#include "tokens.h"
+#include "util.h"
+
+// macro expansion:
+//
+// expansion reads from a stack of frames, each a range of tokens: the
+// input, a macro body, or an argument. bodies are never copied, a body
+// token naming a parameter pushes a frame over that argument instead.
+// arguments are expanded once, when collected. a macro is marked active
+// while its frame is open and its name is not expanded again, so every
+// token is produced once. an object-like expansion that only read its own
+// body is kept and appended whole the next time the macro is met.
+//
+// invocations of function-like macros cannot span lines
+//
+
+enum {
+	MAX_MACRO_PARAMETERS = 127,
+};
+
+// expansion state, kept in the preprocessor between lines
+
+struct Frame {
+	struct Macro *macro;        // NULL for the input and arguments
+	const struct Token *tokens; // NULL for an argument
+	int cursor, end;
+	int level;                  // arguments: which of pp->arguments
+	int arguments;              // first struct Range of the invocation
+	int owner;                  // the frame whose tokens these replace
+
+	// recording the expansion of an object-like macro
+	int context, start, uses;
+	bool tainted; // a name was left as is because of an enclosing macro
+};
+
+struct Range {
+	int start, end;
+	int level; // of the argument list
+};
+
+// reads `NAME body` or `NAME(params) body` after #define
+bool parse_macro(struct Lexer *, struct Allocator *, struct Token *args, int count, struct Macro *);
+
+// same name, parameters and body
+bool same_macro(struct Macro *, struct Macro *);
+
+// appends tokens to `out` with macros expanded, returns the number of
+// expansions. errors are counted in pp->errors
+int expand_macros(struct Preprocessor *, const struct Token *tokens, int count, struct Vec *out);
+
+#endif //MACRO_H_
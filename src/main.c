@@ -1,71 +1,515 @@
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <assert.h>
+#include <sys/stat.h>
 
 #include "allocator.h"
 #include "ast.h"
-#include "lexer.h"
+#include "bounds.h"
+#include "bytecode.h"
+#include "dump.h"
+#include "elf.h"
+#include "ir.h"
+#include "jit.h"
+#include "layout.h"
 #include "parser.h"
+#include "pch.h"
+#include "pool.h"
+#include "preproc.h"
+#include "reduce.h"
+#include "scope.h"
+#include "session.h"
+#include "snapshot.h"
 #include "tokens.h"
+#include "types.h"
+#include "unit.h"
 #include "util.h"
+#include "vm.h"
+#include "x86.h"
 
-void print_expr(struct AST_Expression *expr, int depth) {
-	if (expr == NULL) {
-		printf("NULL\n");
+// what to do with every input
+struct Options {
+	int threads; // for the declarations of each input
+	bool syntax_only, reduce, bounds;
+	bool run, bench, interpret;
+	const char *snapshot, *dumped_snapshot;
+	bool assembly, object;                     // -emit-asm and -emit-obj
+	const char *assembly_path, *object_path; // NULL: the input's name with .s or .o
+	bool emit_ir, optimize, layouts;
+	const char *emit_pch, *include_pch;
+	unsigned features;
+	bool targeted; // features were given, the JIT uses the host's otherwise
+	bool watch;
+};
+
+struct Input {
+	const char *path;
+	struct Vec *out; // diagnostics and output (chars), NULL prints directly
+	int status;
+};
+
+struct Driver {
+	struct Options *options;
+	struct Input *inputs;
+};
+
+static
+void put_output(struct Input *input, struct Vec *text) {
+	if (input->out == NULL) fwrite(text->mem, 1, text->length, stdout);
+	else                    vec_append(input->out, text->mem, text->length);
+}
+
+// the path of an output next to the input
+static
+const char *output_path(char *buffer, const char *path, const char *input, const char *extension) {
+	if (path) return path;
+
+	int length = snprintf(buffer, PATH_MAX, "%s%s", input, extension);
+	if (length >= PATH_MAX) errx("output path for `%s` is too long", input);
+	return buffer;
+}
+
+// compiles one input with its own allocator, tokens, preprocessor and parser
+static
+void compile_input(struct Options *options, struct Input *input) {
+	struct Vec tokens = vec(struct Token);
+	struct Allocator allocator = init_allocator();
+
+	struct Preprocessor pp;
+	init_preprocessor(&pp, &allocator);
+	pp.diagnostics = input->out;
+
+	const struct PchHeader *pch = options->include_pch ? load_pch(options->include_pch, &pp, &tokens) : NULL;
+
+	if (!lex_file(&pp, input->path, &tokens)) {
+		if (pp.errors) append_error(input->out, "too many errors");
+		else           append_error(input->out, "file `%s` not found", input->path);
+
+		input->status = 1;
+		free_preprocessor(&pp);
+		vec_free(&tokens);
+		free_allocator(&allocator);
+		if (pch) unmap_pch(pch);
+		return;
+	}
+
+	// the header is written without its end of file
+	if (options->emit_pch) {
+		write_pch(options->emit_pch, &pp, tokens.mem, tokens.length - 1);
+
+		free_preprocessor(&pp);
+		vec_free(&tokens);
+		free_allocator(&allocator);
+		if (pch) unmap_pch(pch);
+		return;
 	}
 
-	for (int i = 0; i < depth; i++) {
-		putchar('\t');
+	free_preprocessor(&pp);
+
+	struct Token *buffer = tokens.mem;
+	int count = tokens.length;
+
+	struct Scope scope = init_scope();
+	struct AST_Expression scratch[MAX_EXPRESSION_DEPTH];
+	struct TypeTable types;
+	init_type_table(&types);
+
+	struct Parser parser = {
+		.tokens = buffer,
+		.length = count,
+		.allocator = &allocator,
+		.scope = &scope,
+		.types = &types,
+		.syntax_only = options->syntax_only,
+		.scratch = scratch,
+		.diagnostics = input->out,
+	};
+
+	struct Unit unit;
+	parse_unit(&unit, &parser, options->threads);
+
+	// so that scripts can tell a file with errors from a clean one
+	if (unit.errors) input->status = 1;
+
+	bool syntax_only = options->syntax_only, run = options->run, bench = options->bench;
+	bool emit_ir = options->emit_ir, assembly = options->assembly, object = options->object;
+	bool jit = false;
+
+#ifdef HAVE_JIT
+	jit = run && !options->interpret;
+#endif
+
+	bool native = jit || (!run && !bench && !emit_ir && (assembly || object));
+
+	// before strength reduction, which hides the ranges of indices
+	if (options->bounds && (run || bench || emit_ir || assembly || object) && !syntax_only && unit.errors == 0) {
+		check_bounds(&allocator, &types, unit.declarations.mem, unit.declarations.length);
 	}
 
-	switch (expr->type) {
-		case LITERAL:
-			printf("%u\n", expr->literal.value);
-			break;
+	// only the native backends are rewritten, the others are not faster for it
+	if (native && options->reduce && !syntax_only && unit.errors == 0) {
+		reduce_strength(&allocator, &types, unit.declarations.mem, unit.declarations.length);
+	}
 
-		case STRING:
-			printf("\"%s\"\n", expr->string.token->text);
-			break;
+	// the report needs only the types, it replaces any other output
+	if (options->layouts && unit.errors == 0) {
+		struct Vec report = vec(char);
+		report_layouts(&report, &types);
 
-		case IDENTIFIER:
-			printf("ID(%s)\n", expr->identifier.token->text);
-			break;
+		put_output(input, &report);
+		vec_free(&report);
+	}
 
-		case UNARY_OP:
-			assert(0 && "unimplemented!");
-			break;
+	// -run exits with the result of main
+	else
+#ifdef HAVE_JIT
+	if (jit && !syntax_only && unit.errors == 0) {
+		input->status = jit_program(&types, unit.declarations.mem, unit.declarations.length,
+		                            options->targeted ? options->features : host_features()) & 0xff;
+	}
 
-		case BINARY_OP:
-			printf("%c\n", expr->binary_op.token->value);
-			print_expr(expr->binary_op.lhs, depth + 1);
-			print_expr(expr->binary_op.rhs, depth + 1);
-			break;
+	else
+#endif
+	if ((run || bench) && !syntax_only && unit.errors == 0) {
+		struct Program program;
+		compile_program(&program, &types, unit.declarations.mem, unit.declarations.length);
 
-		case TYPE_CAST:
-			assert(0 && "unimplemented!");
-			break;
+		if (bench) benchmark_program(&program);
+		else       input->status = run_program(&program) & 0xff;
 
-		case FUNC_CALL:
-			assert(0 && "unimplemented!");
-			break;
+		free_program(&program);
 	}
+
+	else if (emit_ir && !syntax_only && unit.errors == 0) {
+		struct AST_Declaration **declarations = unit.declarations.mem;
+		struct Allocator arena = init_allocator();
+		struct Vec dump = vec(char);
+
+		for (int i = 0; i < unit.declarations.length; i++) {
+			if (!declarations[i]->function || !declarations[i]->body) continue;
+
+			struct IR_Function *function = lower_function(&arena, &types, declarations[i]);
+			if (options->optimize) optimize_function(function);
+			dump_function(&dump, &types, function);
+		}
+
+		put_output(input, &dump);
+		vec_free(&dump);
+		free_allocator(&arena);
+	}
+
+	else if (assembly && !syntax_only && unit.errors == 0) {
+		char path[PATH_MAX];
+		emit_assembly(output_path(path, options->assembly_path, input->path, ".s"), input->path,
+		              &types, unit.declarations.mem, unit.declarations.length, options->features);
+	}
+
+	else if (object && !syntax_only && unit.errors == 0) {
+		char path[PATH_MAX];
+		emit_object(output_path(path, options->object_path, input->path, ".o"), input->path,
+		            &types, unit.declarations.mem, unit.declarations.length, options->features);
+	}
+
+	else if (!syntax_only && unit.errors == 0) {
+		struct AST_Declaration **declarations = unit.declarations.mem;
+		struct Vec dump = vec(char);
+
+		for (int i = 0; i < unit.declarations.length; i++) {
+			dump_declaration(&dump, &types, declarations[i], 0);
+		}
+
+		put_output(input, &dump);
+		vec_free(&dump);
+
+		if (options->snapshot) {
+			write_snapshot(options->snapshot, input->path, &types, declarations, unit.declarations.length);
+		}
+	}
+
+	free_unit(&unit);
+	free_type_table(&types);
+	free_scope(&scope);
+	vec_free(&tokens);
+	free_allocator(&allocator);
+	if (pch) unmap_pch(pch);
+}
+
+static
+double seconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// the session keeps tokens between versions, their filenames must outlive
+// the preprocessor of the version that lexed them
+static
+void keep_filenames(struct Vec *names, struct Allocator *allocator, struct Token *tokens, int count) {
+	const char *from = NULL, *to = NULL;
+
+	for (int i = 0; i < count; i++) {
+		if (tokens[i].filename != from) {
+			const char **name = names->mem;
+			int j = 0;
+
+			from = tokens[i].filename;
+			while (j < names->length && strcmp(name[j], from) != 0) j++;
+
+			if (j == names->length) {
+				const char *copy = store_string(allocator, from, strlen(from));
+				vec_push(names, &copy);
+			}
+
+			to = ((const char **)names->mem)[j];
+		}
+
+		tokens[i].filename = to;
+	}
+}
+
+// -watch checks the input again whenever it changes, reparsing only the
+// declarations whose tokens changed, until killed
+static
+void watch_input(const char *path) {
+	struct Session session;
+	init_session(&session);
+
+	struct Allocator filenames = init_allocator();
+	struct Vec names = vec(const char *);
+
+	struct timespec modified = { 0 };
+	off_t size = -1;
+
+	while (true) {
+		struct stat info;
+
+		if (stat(path, &info) != 0 || (info.st_mtim.tv_sec == modified.tv_sec &&
+		    info.st_mtim.tv_nsec == modified.tv_nsec && info.st_size == size)) {
+			nanosleep(&(struct timespec) { .tv_nsec = 100000000 }, NULL);
+			continue;
+		}
+
+		modified = info.st_mtim;
+		size = info.st_size;
+
+		struct Vec tokens = vec(struct Token);
+		struct Allocator allocator = init_allocator();
+
+		struct Preprocessor pp;
+		init_preprocessor(&pp, &allocator);
+
+		double start = seconds();
+
+		if (lex_file(&pp, path, &tokens)) {
+			keep_filenames(&names, &filenames, tokens.mem, tokens.length);
+			update_session(&session, tokens.mem, tokens.length);
+
+			fwrite(session.output.mem, 1, session.output.length, stdout);
+			printf("%d errors, %d definitions reparsed in %.3f ms\n", session.errors, session.reparsed,
+			       (seconds() - start) * 1e3);
+		}
+
+		else if (pp.errors) append_error(NULL, "too many errors");
+		else                append_error(NULL, "file `%s` not found", path);
+
+		fflush(stdout);
+
+		free_preprocessor(&pp);
+		vec_free(&tokens);
+		free_allocator(&allocator);
+	}
+}
+
+// an errx while compiling fails only this input. what it allocated is not
+// freed, the compiler exits soon after
+static
+void compile_job(void *context, int job, int worker) {
+	(void)worker;
+	struct Driver *driver = context;
+	struct Input *input = &driver->inputs[job];
+	struct Recovery point = { .out = input->out };
+
+	if (setjmp(point.jump) == 0) {
+		recovery = &point;
+		compile_input(driver->options, input);
+	} else {
+		input->status = 1;
+	}
+
+	recovery = NULL;
 }
 
 int main(int argc, char **argv) {
-	set_program(argv[0]);
 	assert(argc >= 1);
 
-	struct Vec tokens = vec(struct Token);
-	struct Allocator allocator = init_allocator();
+	int threads = cpu_count();
+	struct Options options = {
+		.reduce = true,
+		.optimize = true,
+	};
 
-	lex_file("test", &allocator, &tokens);
+	struct Vec paths = vec(const char *);
 
-	struct Token *buffer = tokens.mem;
-	int count = tokens.length;
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] != '-') {
+			vec_push(&paths, &argv[i]);
+		}
 
-	struct Parser parser = { buffer, count, &allocator, 0 };
-	struct AST_Expression *expr = parse_expression(&parser);
-	if (parser.errors == 0) print_expr(expr, 0);
+		else if (strncmp(argv[i], "-j", 2) == 0) {
+			threads = atoi(argv[i] + 2);
+			if (threads < 1) errx("invalid thread count `%s`", argv[i]);
+		}
 
-	vec_free(&tokens);
-	free_allocator(&allocator);
+		else if (strcmp(argv[i], "-fsyntax-only") == 0) {
+			options.syntax_only = true;
+		}
+
+		else if (strcmp(argv[i], "-fno-strength-reduce") == 0) {
+			options.reduce = false;
+		}
+
+		else if (strcmp(argv[i], "-fbounds-check") == 0) {
+			options.bounds = true;
+		}
+
+		else if (strcmp(argv[i], "-flayout-report") == 0) {
+			options.layouts = true;
+		}
+
+		else if (strncmp(argv[i], "-fsave-ast=", 11) == 0) {
+			options.snapshot = argv[i] + 11;
+		}
+
+		else if (strncmp(argv[i], "-fdump-ast=", 11) == 0) {
+			options.dumped_snapshot = argv[i] + 11;
+		}
+
+		// -run=vm interprets bytecode where the JIT is available too
+		else if (strcmp(argv[i], "-run") == 0 || strcmp(argv[i], "-run=vm") == 0) {
+			options.run = true;
+			options.interpret = argv[i][4] != 0;
+		}
+
+		else if (strcmp(argv[i], "-watch") == 0) {
+			options.watch = true;
+		}
+
+		else if (strcmp(argv[i], "-bench") == 0) {
+			options.bench = true;
+		}
+
+		// -emit-ir=raw skips the passes
+		else if (strcmp(argv[i], "-emit-ir") == 0 || strcmp(argv[i], "-emit-ir=raw") == 0) {
+			options.emit_ir = true;
+			options.optimize = argv[i][8] == 0;
+		}
+
+		// without a path, each input is written next to it as .s or .o
+		else if (strcmp(argv[i], "-emit-asm") == 0 || strncmp(argv[i], "-emit-asm=", 10) == 0) {
+			options.assembly = true;
+			options.assembly_path = argv[i][9] ? argv[i] + 10 : NULL;
+		}
+
+		else if (strcmp(argv[i], "-emit-obj") == 0 || strncmp(argv[i], "-emit-obj=", 10) == 0) {
+			options.object = true;
+			options.object_path = argv[i][9] ? argv[i] + 10 : NULL;
+		}
+
+		// instructions beyond baseline x86-64, -march=native for all the host has
+		else if (strcmp(argv[i], "-march=native") == 0 || strcmp(argv[i], "-march=x86-64") == 0) {
+			options.features = argv[i][7] == 'n' ? host_features() : 0;
+			options.targeted = true;
+		}
+
+		else if (strcmp(argv[i], "-mpopcnt") == 0 || strcmp(argv[i], "-mlzcnt") == 0 || strcmp(argv[i], "-mbmi") == 0 ||
+		         strcmp(argv[i], "-mssse3") == 0) {
+			options.features |= argv[i][2] == 'p' ? FEATURE_POPCNT : argv[i][2] == 'l' ? FEATURE_LZCNT :
+			                    argv[i][2] == 's' ? FEATURE_SSSE3 : FEATURE_BMI;
+			options.targeted = true;
+		}
+
+		else if (strncmp(argv[i], "-emit-pch=", 10) == 0) {
+			options.emit_pch = argv[i] + 10;
+		}
+
+		else if (strncmp(argv[i], "-include-pch=", 13) == 0) {
+			options.include_pch = argv[i] + 13;
+		}
+
+		else errx("unknown option `%s`", argv[i]);
+	}
+
+	// prints what the compile that saved the snapshot printed
+	if (options.dumped_snapshot) {
+		if (paths.length) errx("-fdump-ast takes no inputs");
+
+		const struct SnapHeader *header = map_snapshot(options.dumped_snapshot);
+		struct Vec dump = vec(char);
+
+		dump_snapshot(&dump, header);
+		fwrite(dump.mem, 1, dump.length, stdout);
+
+		vec_free(&dump);
+		unmap_snapshot(header);
+		vec_free(&paths);
+		return 0;
+	}
+
+	if (paths.length == 0) {
+		const char *path = "test";
+		vec_push(&paths, &path);
+	}
+
+	int count = paths.length;
+
+	// these produce one result, or name one output
+	if (count > 1) {
+		if (options.run || options.bench) errx("-run and -bench take a single input");
+		if (options.snapshot || options.emit_pch) errx("-fsave-ast and -emit-pch take a single input");
+		if (options.watch) errx("-watch takes a single input");
+		if (options.assembly_path || options.object_path) errx("-emit-asm= and -emit-obj= take a single input, leave out the path");
+	}
+
+	if (options.watch) watch_input(((const char **)paths.mem)[0]);
+
+	// files on the pool, the declarations of each on its share of the threads
+	options.threads = max(1, threads / count);
+
+	struct Input *inputs = calloc(count, sizeof *inputs);
+	struct Vec *outputs = calloc(count, sizeof *outputs);
+	if (!inputs || !outputs) errx("out of memory: failed to allocate %d inputs", count);
+
+	const char **names = paths.mem;
+
+	for (int i = 0; i < count; i++) {
+		inputs[i].path = names[i];
+
+		// a single input prints as it goes, several are buffered and printed in order
+		if (count > 1) {
+			outputs[i] = vec(char);
+			inputs[i].out = &outputs[i];
+		}
+	}
+
+	struct Driver driver = { &options, inputs };
+	parallel_for(threads, count, compile_job, &driver);
+
+	int status = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (count > 1) {
+			fwrite(outputs[i].mem, 1, outputs[i].length, stdout);
+			vec_free(&outputs[i]);
+		}
+
+		if (status == 0) status = inputs[i].status;
+	}
+
+	free(outputs);
+	free(inputs);
+	vec_free(&paths);
+	return status;
 }
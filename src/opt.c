@@ -0,0 +1,674 @@
+#include "ir.h"
+
+#include "util.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static
+struct IR_Instruction *resolve(struct IR_Instruction *inst) {
+	while (inst->forward) inst = inst->forward;
+	return inst;
+}
+
+static
+void *allocate(int count, int size) {
+	void *mem = calloc(max(count, 1), size);
+	if (!mem) errx("out of memory: failed to allocate %d objects of %d bytes", count, size);
+	return mem;
+}
+
+
+// folding
+
+static
+uint64_t sign_extend(uint64_t value, enum IR_Width width) {
+	int shift = 64 - width_bits(width);
+	return (uint64_t)((int64_t)(value << shift) >> shift);
+}
+
+// false if the instruction has no constant value, or would fault
+static
+bool fold(struct IR_Instruction *inst, const uint64_t *operands, uint64_t *result) {
+	enum IR_Width width = inst->operand_count ? inst->operands[0]->width : inst->width;
+	uint64_t a = operands[0], b = inst->operand_count > 1 ? operands[1] : 0;
+	int64_t sa = sign_extend(a, width), sb = sign_extend(b, width);
+	unsigned count = b & (width_bits(width) - 1);
+	uint64_t value;
+
+	switch (inst->op) {
+		case IR_ADD: value = a + b; break;
+		case IR_SUB: value = a - b; break;
+		case IR_MUL: value = a * b; break;
+
+		case IR_DIV: case IR_MOD:
+			if (b == 0) return false;
+			value = inst->op == IR_DIV ? a / b : a % b;
+			break;
+
+		// the most negative value divided by -1 wraps
+		case IR_IDIV: case IR_IMOD:
+			if (b == 0) return false;
+
+			if (sb == -1) value = inst->op == IR_IDIV ? 0 - a : 0;
+			else          value = inst->op == IR_IDIV ? (uint64_t)(sa / sb) : (uint64_t)(sa % sb);
+			break;
+
+		case IR_AND: value = a & b; break;
+		case IR_OR:  value = a | b; break;
+		case IR_XOR: value = a ^ b; break;
+
+		case IR_SHL: value = a << count; break;
+		case IR_SHR: value = a >> count; break;
+		case IR_SAR: value = (uint64_t)(sa >> count); break;
+
+		case IR_EQ:  value = a == b; break;
+		case IR_NE:  value = a != b; break;
+		case IR_LT:  value = a < b;  break;
+		case IR_LE:  value = a <= b; break;
+		case IR_GT:  value = a > b;  break;
+		case IR_GE:  value = a >= b; break;
+		case IR_ILT: value = sa < sb;  break;
+		case IR_ILE: value = sa <= sb; break;
+		case IR_IGT: value = sa > sb;  break;
+		case IR_IGE: value = sa >= sb; break;
+
+		case IR_NEG:   value = 0 - a; break;
+		case IR_NOT:   value = ~a; break;
+		case IR_SEXT:  value = (uint64_t)sa; break;
+		case IR_ZEXT:  value = a; break;
+		case IR_TRUNC: value = a; break;
+
+		case IR_CLZ:      value = leading_zeros(a, width_bits(width)); break;
+		case IR_CTZ:      value = trailing_zeros(a, width_bits(width)); break;
+		case IR_POPCOUNT: value = count_ones(a); break;
+		case IR_BSWAP:    value = swap_bytes(a, width_bits(width)); break;
+		case IR_ROTL:     value = rotate_left(a, count, width_bits(width)); break;
+
+		// an index known to be in bounds needs no check
+		case IR_CHECK:
+			if (a >= b) return false;
+			value = a;
+			break;
+
+		default:
+			return false;
+	}
+
+	*result = wrap_value(value, inst->width);
+	return true;
+}
+
+
+// users of every value, by id
+
+struct Uses {
+	int *start; // users of id i are users[start[i] .. start[i + 1]]
+	struct IR_Instruction **users;
+};
+
+static
+struct Uses find_uses(struct IR_Function *function) {
+	struct Uses uses = { allocate(function->values + 1, sizeof(int)), NULL };
+	int total = 0;
+
+	for (int i = 0; i < function->block_count; i++) {
+		for (struct IR_Instruction *inst = function->blocks[i]->first; inst; inst = inst->next) {
+			for (int j = 0; j < inst->operand_count; j++) uses.start[inst->operands[j]->id + 1]++;
+			total += inst->operand_count;
+		}
+	}
+
+	for (int i = 0; i < function->values; i++) uses.start[i + 1] += uses.start[i];
+
+	int *fill = allocate(function->values, sizeof(int));
+	uses.users = allocate(total, sizeof *uses.users);
+
+	for (int i = 0; i < function->block_count; i++) {
+		for (struct IR_Instruction *inst = function->blocks[i]->first; inst; inst = inst->next) {
+			for (int j = 0; j < inst->operand_count; j++) {
+				int id = inst->operands[j]->id;
+				uses.users[uses.start[id] + fill[id]++] = inst;
+			}
+		}
+	}
+
+	free(fill);
+	return uses;
+}
+
+static
+void free_uses(struct Uses *uses) {
+	free(uses->start);
+	free(uses->users);
+}
+
+
+// sparse conditional constant propagation
+
+enum Lattice {
+	UNKNOWN,  // no executable definition seen yet
+	CONSTANT,
+	VARYING,
+};
+
+struct Edge {
+	struct IR_Block *block;
+	int pred; // index into preds
+};
+
+struct Propagation {
+	struct IR_Function *function;
+	struct Uses uses;
+
+	uint8_t *state;      // by id
+	uint64_t *constants; // by id
+
+	bool *executable; // by block order
+	bool **feasible;  // by block order, then predecessor
+
+	struct Vec edges;  // struct Edge
+	struct Vec values; // struct IR_Instruction *
+};
+
+// the edge of the nth target of a terminator: a branch to the same block
+// twice has two
+static
+void add_edge(struct Propagation *p, struct IR_Instruction *terminator, int target) {
+	struct IR_Block *block = terminator->targets[target];
+	int occurrence = target == 1 && terminator->targets[0] == block;
+
+	for (int i = 0; i < block->pred_count; i++) {
+		if (block->preds[i] != terminator->block || occurrence--) continue;
+
+		if (!p->feasible[block->order][i]) {
+			p->feasible[block->order][i] = true;
+
+			struct Edge edge = { block, i };
+			vec_push(&p->edges, &edge);
+		}
+
+		return;
+	}
+}
+
+static
+void evaluate_terminator(struct Propagation *p, struct IR_Instruction *inst) {
+	switch (inst->op) {
+		case IR_JUMP:
+			add_edge(p, inst, 0);
+			break;
+
+		case IR_BRANCH: {
+			int condition = inst->operands[0]->id;
+
+			if (p->state[condition] == CONSTANT) {
+				add_edge(p, inst, p->constants[condition] ? 0 : 1);
+			} else if (p->state[condition] == VARYING) {
+				add_edge(p, inst, 0);
+				add_edge(p, inst, 1);
+			}
+
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+static
+void evaluate(struct Propagation *p, struct IR_Instruction *inst) {
+	if (is_terminator(inst->op)) {
+		evaluate_terminator(p, inst);
+		return;
+	}
+
+	if (inst->width == IR_VOID || p->state[inst->id] == VARYING) return;
+
+	enum Lattice state = VARYING;
+	uint64_t value = 0;
+
+	switch (inst->op) {
+		case IR_CONST:
+			state = CONSTANT;
+			value = inst->value;
+			break;
+
+		// meet of the operands on executable edges
+		case IR_PHI:
+			state = UNKNOWN;
+
+			for (int i = 0; i < inst->operand_count; i++) {
+				int id = inst->operands[i]->id;
+				if (!p->feasible[inst->block->order][i] || p->state[id] == UNKNOWN) continue;
+
+				if (p->state[id] == VARYING || (state == CONSTANT && p->constants[id] != value)) {
+					state = VARYING;
+					break;
+				}
+
+				state = CONSTANT;
+				value = p->constants[id];
+			}
+
+			break;
+
+		case IR_PARAM: case IR_SLOT: case IR_GLOBAL: case IR_STRING:
+		case IR_LOAD: case IR_CALL:
+			break;
+
+		default: {
+			uint64_t operands[2] = { 0, 0 }; // an instruction may have fewer
+			state = CONSTANT;
+
+			for (int i = 0; i < inst->operand_count; i++) {
+				int id = inst->operands[i]->id;
+
+				if (p->state[id] == VARYING) state = VARYING;
+				else if (p->state[id] == UNKNOWN && state != VARYING) state = UNKNOWN;
+
+				operands[i] = p->constants[id];
+			}
+
+			if (state == CONSTANT && !fold(inst, operands, &value)) state = VARYING;
+			break;
+		}
+	}
+
+	if (state == p->state[inst->id] && (state != CONSTANT || value == p->constants[inst->id])) return;
+
+	p->state[inst->id] = state;
+	p->constants[inst->id] = value;
+
+	for (int i = p->uses.start[inst->id]; i < p->uses.start[inst->id + 1]; i++) {
+		vec_push(&p->values, &p->uses.users[i]);
+	}
+}
+
+static
+void propagate(struct Propagation *p) {
+	struct IR_Block *entry = p->function->blocks[0];
+
+	p->executable[0] = true;
+	for (struct IR_Instruction *inst = entry->first; inst; inst = inst->next) evaluate(p, inst);
+
+	while (p->edges.length || p->values.length) {
+		if (p->edges.length) {
+			struct Edge edge = ((struct Edge *)p->edges.mem)[p->edges.length - 1];
+			vec_truncate(&p->edges, p->edges.length - 1);
+			struct IR_Block *block = edge.block;
+
+			// a block is evaluated in full the first time it is reached,
+			// after that a new edge only changes its phis
+			bool first = !p->executable[block->order];
+			p->executable[block->order] = true;
+
+			for (struct IR_Instruction *inst = block->first; inst; inst = inst->next) {
+				if (!first && inst->op != IR_PHI) break;
+				evaluate(p, inst);
+			}
+
+			continue;
+		}
+
+		struct IR_Instruction *inst = ((struct IR_Instruction **)p->values.mem)[p->values.length - 1];
+		vec_truncate(&p->values, p->values.length - 1);
+		if (p->executable[inst->block->order]) evaluate(p, inst);
+	}
+}
+
+void propagate_constants(struct IR_Function *function) {
+	order_blocks(function);
+
+	struct Propagation p = {
+		.function = function,
+		.uses = find_uses(function),
+		.state = allocate(function->values, sizeof *p.state),
+		.constants = allocate(function->values, sizeof *p.constants),
+		.executable = allocate(function->block_count, sizeof *p.executable),
+		.feasible = allocate(function->block_count, sizeof *p.feasible),
+		.edges = vec(struct Edge),
+		.values = vec(struct IR_Instruction *),
+	};
+
+	for (int i = 0; i < function->block_count; i++) {
+		p.feasible[i] = allocate(function->blocks[i]->pred_count, sizeof **p.feasible);
+	}
+
+	propagate(&p);
+
+	// constants are folded where they are, except phis, which must stay at
+	// the start of their block: those go to the entry
+	struct IR_Block *entry = function->blocks[0];
+
+	for (int i = 0; i < function->block_count; i++) {
+		struct IR_Block *block = function->blocks[i];
+		if (!p.executable[i]) continue;
+
+		struct IR_Instruction *inst = block->first;
+
+		while (inst) {
+			struct IR_Instruction *next = inst->next;
+
+			if (inst->op != IR_CONST && inst->width != IR_VOID && p.state[inst->id] == CONSTANT) {
+				if (inst->op == IR_PHI) {
+					remove_instruction(inst);
+
+					inst->next = entry->first;
+					entry->first->prev = inst;
+					entry->first = inst;
+					inst->block = entry;
+				}
+
+				inst->op = IR_CONST;
+				inst->value = p.constants[inst->id];
+				inst->operand_count = 0;
+			}
+
+			// a branch decided by a constant jumps, the edge not taken goes
+			if (inst->op == IR_BRANCH && p.state[inst->operands[0]->id] == CONSTANT) {
+				int taken = p.constants[inst->operands[0]->id] ? 0 : 1;
+
+				remove_edge(block, inst->targets[1 - taken]);
+
+				inst->op = IR_JUMP;
+				inst->targets[0] = inst->targets[taken];
+				inst->targets[1] = NULL;
+				inst->operand_count = 0;
+			}
+
+			inst = next;
+		}
+	}
+
+	for (int i = 0; i < function->block_count; i++) free(p.feasible[i]);
+	free(p.feasible);
+	free(p.executable);
+	free(p.constants);
+	free(p.state);
+	free_uses(&p.uses);
+	vec_free(&p.edges);
+	vec_free(&p.values);
+
+	// blocks never executed are unreachable now
+	order_blocks(function);
+}
+
+
+// global value numbering
+
+static
+struct IR_Block *intersect(struct IR_Block *a, struct IR_Block *b) {
+	while (a != b) {
+		while (a->order > b->order) a = a->idom;
+		while (b->order > a->order) b = b->idom;
+	}
+
+	return a;
+}
+
+// iterates to a fixed point over blocks in reverse postorder, as in Cooper,
+// Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+static
+void find_dominators(struct IR_Function *function) {
+	struct IR_Block *entry = function->blocks[0];
+
+	for (int i = 0; i < function->block_count; i++) function->blocks[i]->idom = NULL;
+	entry->idom = entry;
+
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+
+		for (int i = 1; i < function->block_count; i++) {
+			struct IR_Block *block = function->blocks[i];
+			struct IR_Block *idom = NULL;
+
+			for (int j = 0; j < block->pred_count; j++) {
+				struct IR_Block *pred = block->preds[j];
+				if (pred->idom == NULL) continue;
+
+				idom = idom ? intersect(pred, idom) : pred;
+			}
+
+			if (idom != block->idom) {
+				block->idom = idom;
+				changed = true;
+			}
+		}
+	}
+
+	entry->depth = 0;
+	for (int i = 1; i < function->block_count; i++) {
+		struct IR_Block *block = function->blocks[i];
+		block->depth = block->idom->depth + 1;
+	}
+}
+
+static
+bool dominates(struct IR_Block *a, struct IR_Block *b) {
+	while (b->depth > a->depth) b = b->idom;
+	return a == b;
+}
+
+static
+bool is_pure(enum IR_Opcode op) {
+	switch (op) {
+		case IR_LOAD: case IR_STORE: case IR_CALL:
+			return false;
+
+		default:
+			return !is_terminator(op);
+	}
+}
+
+static
+bool is_commutative(enum IR_Opcode op) {
+	switch (op) {
+		case IR_ADD: case IR_MUL:
+		case IR_AND: case IR_OR: case IR_XOR:
+		case IR_EQ: case IR_NE:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+// phis are only equal within a block
+static
+const void *value_symbol(struct IR_Instruction *inst) {
+	return inst->op == IR_PHI ? (const void *)inst->block : inst->symbol;
+}
+
+static
+unsigned value_hash(struct IR_Instruction *inst) {
+	uint64_t hash = inst->op * 31 + inst->width;
+	hash = hash * 0x9e3779b97f4a7c15u + inst->value;
+	hash = hash * 0x9e3779b97f4a7c15u + (uintptr_t)value_symbol(inst);
+
+	for (int i = 0; i < inst->operand_count; i++) {
+		hash = hash * 0x9e3779b97f4a7c15u + inst->operands[i]->id;
+	}
+
+	return (unsigned)(hash >> 32);
+}
+
+static
+bool same_value(struct IR_Instruction *a, struct IR_Instruction *b) {
+	if (a->op != b->op || a->width != b->width || a->value != b->value) return false;
+	if (value_symbol(a) != value_symbol(b) || a->operand_count != b->operand_count) return false;
+
+	for (int i = 0; i < a->operand_count; i++) {
+		if (a->operands[i] != b->operands[i]) return false;
+	}
+
+	return true;
+}
+
+void number_values(struct IR_Function *function) {
+	order_blocks(function);
+	find_dominators(function);
+
+	int capacity = 64;
+	while (capacity < 2 * function->values) capacity *= 2;
+
+	// open addressing, a value may be in several times from blocks that do
+	// not dominate each other
+	struct IR_Instruction **table = allocate(capacity, sizeof *table);
+
+	// dominators come first in reverse postorder
+	for (int i = 0; i < function->block_count; i++) {
+		struct IR_Instruction *inst = function->blocks[i]->first;
+
+		while (inst) {
+			struct IR_Instruction *next = inst->next;
+
+			for (int j = 0; j < inst->operand_count; j++) inst->operands[j] = resolve(inst->operands[j]);
+
+			if (!is_pure(inst->op)) {
+				inst = next;
+				continue;
+			}
+
+			if (is_commutative(inst->op) && inst->operands[0]->id > inst->operands[1]->id) {
+				struct IR_Instruction *swap = inst->operands[0];
+				inst->operands[0] = inst->operands[1];
+				inst->operands[1] = swap;
+			}
+
+			unsigned index = value_hash(inst);
+			struct IR_Instruction *found = NULL;
+
+			for (;; index++) {
+				struct IR_Instruction *entry = table[index & (capacity - 1)];
+				if (entry == NULL) break;
+
+				if (same_value(entry, inst) && dominates(entry->block, inst->block)) {
+					found = entry;
+					break;
+				}
+			}
+
+			if (found) {
+				inst->forward = found;
+				remove_instruction(inst);
+			} else {
+				table[index & (capacity - 1)] = inst;
+			}
+
+			inst = next;
+		}
+	}
+
+	free(table);
+
+	// phis may refer to values later in the order
+	resolve_forwards(function);
+}
+
+
+// dead code elimination
+
+static
+void merge_blocks(struct IR_Function *);
+
+static
+bool has_effect(enum IR_Opcode op) {
+	return op == IR_STORE || op == IR_CALL || op == IR_CHECK || is_terminator(op);
+}
+
+// marks what the effects need, transitively, and removes the rest
+void eliminate_dead_code(struct IR_Function *function) {
+	struct Vec work = vec(struct IR_Instruction *);
+
+	for (int i = 0; i < function->block_count; i++) {
+		for (struct IR_Instruction *inst = function->blocks[i]->first; inst; inst = inst->next) {
+			inst->mark = has_effect(inst->op);
+			if (inst->mark) vec_push(&work, &inst);
+		}
+	}
+
+	while (work.length) {
+		struct IR_Instruction *inst = ((struct IR_Instruction **)work.mem)[work.length - 1];
+		vec_truncate(&work, work.length - 1);
+
+		for (int i = 0; i < inst->operand_count; i++) {
+			struct IR_Instruction *operand = inst->operands[i];
+			if (operand->mark) continue;
+
+			operand->mark = true;
+			vec_push(&work, &operand);
+		}
+	}
+
+	for (int i = 0; i < function->block_count; i++) {
+		struct IR_Instruction *inst = function->blocks[i]->first;
+
+		while (inst) {
+			struct IR_Instruction *next = inst->next;
+			if (!inst->mark) remove_instruction(inst);
+			inst = next;
+		}
+	}
+
+	vec_free(&work);
+	merge_blocks(function);
+}
+
+// a block whose only predecessor jumps to it is appended to that predecessor
+static
+void merge_blocks(struct IR_Function *function) {
+	for (int i = 0; i < function->block_count; i++) {
+		struct IR_Block *block = function->blocks[i];
+		if (block->first == NULL) continue; // merged already
+
+		while (block->last->op == IR_JUMP) {
+			struct IR_Block *next = block->last->targets[0];
+
+			if (next->pred_count != 1 || next == block || next == function->blocks[0]) break;
+			if (next->first->op == IR_PHI) break;
+
+			remove_instruction(block->last);
+
+			for (struct IR_Instruction *inst = next->first; inst; inst = inst->next) inst->block = block;
+
+			if (block->last) block->last->next = next->first;
+			else             block->first = next->first;
+
+			next->first->prev = block->last;
+			block->last = next->last;
+			next->first = next->last = NULL;
+
+			// the successors of `next` are reached from `block` now
+			struct IR_Instruction *last = block->last;
+			int targets = last->op == IR_JUMP ? 1 : last->op == IR_BRANCH ? 2 : 0;
+
+			for (int j = 0; j < targets; j++) {
+				struct IR_Block *target = last->targets[j];
+
+				for (int k = 0; k < target->pred_count; k++) {
+					if (target->preds[k] == next) target->preds[k] = block;
+				}
+			}
+		}
+	}
+
+	int count = 0;
+
+	for (int i = 0; i < function->block_count; i++) {
+		struct IR_Block *block = function->blocks[i];
+		if (block->first) function->blocks[count++] = block;
+	}
+
+	function->block_count = count;
+}
+
+void optimize_function(struct IR_Function *function) {
+	propagate_constants(function);
+	number_values(function);
+	eliminate_dead_code(function);
+}
@@ -2,20 +2,19 @@
 
 #include "allocator.h"
 #include "ast.h"
+#include "bounds.h"
+#include "scope.h"
 #include "tokens.h"
 #include "util.h"
+#include "vm.h"
 
 #include <assert.h>
 #include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-void parser_error(struct Parser *parser, struct Token *, const char *fmt, ...) PRINTF(3,4);
-void parser_warning(struct Parser *parser, struct Token *, const char *fmt, ...) PRINTF(3,4);
-
-const char *print_token(struct Token *);
-const char *print_type(struct ExpressionType type, char *);
 
 static inline
 struct Token *peek_next(struct Parser *parser) {
@@ -32,13 +31,15 @@ struct Token *chop_next(struct Parser *parser) {
 	return parser->length--, parser->tokens++;
 }
 
+// after an error the parser stops wherever it is and unwinds, the tokens
+// the enclosing constructs expect then are not missing
 static inline
 void expect_next(struct Parser *parser, unsigned char c) {
 	struct Token *tok = peek_next(parser);
 
 	if (tok != NULL && tok->type == PUNCTUATION && tok->value == c) {
 		chop_next(parser);
-	} else {
+	} else if (!parser->errors) {
 		parser_error(parser, NULL, "expected `%c`, got %s.", c, print_token(tok));
 	}
 }
@@ -54,10 +55,39 @@ unsigned char expect_next_either(struct Parser *parser, unsigned char a, unsigne
 		}
 	}
 
-	parser_error(parser, NULL, "expected `%c` or `%c`, got %s.", a, b, print_token(tok));
+	if (!parser->errors) parser_error(parser, NULL, "expected `%c` or `%c`, got %s.", a, b, print_token(tok));
 	return 0;
 }
 
+static inline
+bool next_is(struct Parser *parser, unsigned char c) {
+	struct Token *tok = peek_next(parser);
+	return tok != NULL && tok->type == PUNCTUATION && tok->value == c;
+}
+
+static inline
+bool next_is_type(struct Parser *parser, enum TokenType type) {
+	struct Token *tok = peek_next(parser);
+	return tok != NULL && tok->type == type;
+}
+
+static
+struct Token *expect_identifier(struct Parser *parser) {
+	struct Token *tok = peek_next(parser);
+
+	if (tok != NULL && tok->type == SYMBOL) {
+		return chop_next(parser);
+	}
+
+	parser_error(parser, NULL, "expected identifier, got %s.", print_token(tok));
+	return NULL;
+}
+
+static inline
+bool is_operator(struct Token *token, unsigned punctuation) {
+	return token->type == PUNCTUATION && token->value == punctuation;
+}
+
 // precedence rules for expressions
 #define MIN_PRECEDENCE -1
 
@@ -66,8 +96,10 @@ int precedence[] = {
 	// closing parens always end sub-expressions
 	[')'] = MIN_PRECEDENCE,
 	[']'] = MIN_PRECEDENCE,
+	[':'] = MIN_PRECEDENCE, // and so do case labels
 
 	[','] = 0,
+	['='] = 1, // right associative
 
 	[OR]  = 3, [AND] = 4,
 	['|'] = 5, ['^'] = 6, ['&'] = 7,
@@ -122,6 +154,8 @@ enum AST_ExpressionType get_token_type(struct Token *token) {
 
 		case KEYWORD_VOID: case KEYWORD_INT:
 		case KEYWORD_U8: case KEYWORD_U16: case KEYWORD_U32:
+		case KEYWORD_U8X16: case KEYWORD_U32X4:
+		case KEYWORD_STRUCT: case KEYWORD_UNION:
 			return TYPE;
 
 		case PUNCTUATION: switch (token->value) {
@@ -155,47 +189,214 @@ enum AST_ExpressionType get_token_type(struct Token *token) {
 }
 
 
+// `struct name` or `union name`, declared earlier at file scope
+static
+unsigned parse_tag(struct Parser *parser, struct Token *keyword) {
+	const char *kind = keyword->type == KEYWORD_STRUCT ? "struct" : "union";
+	struct Token *name = peek_next(parser);
+
+	if (name == NULL || name->type != SYMBOL) {
+		parser_error(parser, NULL, "expected %s name, got %s.", kind, print_token(name));
+		return VOID;
+	}
+
+	chop_next(parser);
+	struct Symbol *symbol = lookup_symbol(parser->scope, name->text, name->length);
+
+	if (symbol == NULL || symbol->kind != SYM_TYPE) {
+		parser_error(parser, name, "Unknown %s `%s`.", kind, name->text);
+		return VOID;
+	}
+
+	if (get_type(parser->types, symbol->type.id)->kind != (keyword->type == KEYWORD_STRUCT ? TYPE_STRUCT : TYPE_UNION)) {
+		parser_error(parser, name, "`%s` is not a %s.", name->text, kind);
+		return VOID;
+	}
+
+	return symbol->type.id;
+}
+
 static
 struct ExpressionType parse_type(struct Parser *parser) {
 	struct Token *basic_type = chop_next(parser);
 	struct ExpressionType type = {0};
 
 	switch (basic_type->type) {
-		case KEYWORD_VOID: type.type = VOID; break;
-		case KEYWORD_INT:  type.type = INT;  break;
-		case KEYWORD_U8:   type.type = U8;   break;
-		case KEYWORD_U16:  type.type = U16;  break;
-		case KEYWORD_U32:  type.type = U32;  break;
+		case KEYWORD_VOID: type.id = VOID; break;
+		case KEYWORD_INT:  type.id = INT;  break;
+		case KEYWORD_U8:   type.id = U8;   break;
+		case KEYWORD_U16:  type.id = U16;  break;
+		case KEYWORD_U32:  type.id = U32;  break;
+		case KEYWORD_U8X16: type.id = U8X16; break;
+		case KEYWORD_U32X4: type.id = U32X4; break;
+
+		case KEYWORD_STRUCT: case KEYWORD_UNION:
+			type.id = parse_tag(parser, basic_type);
+			break;
+
 		default: assert(0 && "unreachable");
 	}
 
 	while (peek_next(parser) && peek_next(parser)->type == PUNCTUATION
 	                         && peek_next(parser)->value == '*') {
+		// the fields of a soa element are apart from each other
+		if (get_type(parser->types, type.id)->soa) {
+			parser_error(parser, NULL, "Cannot point to an element of soa struct `%s`.", get_type(parser->types, type.id)->token->text);
+		}
+
 		chop_next(parser);
-		type.pointers++;
+		type.id = pointer_to(parser->types, type.id);
 	}
 
 	return type;
 }
 
 
+// type queries on the parser's table
+static inline
+bool pointer(struct Parser *parser, struct ExpressionType type) {
+	return is_pointer(parser->types, type.id);
+}
+
+static inline
+struct ExpressionType dereference(struct Parser *parser, struct ExpressionType type) {
+	return (struct ExpressionType) { .id = pointee(parser->types, type.id) };
+}
+
+static inline
+bool vector(struct Parser *parser, struct ExpressionType type) {
+	return is_vector(parser->types, type.id);
+}
+
+static inline
+bool array(struct Parser *parser, struct ExpressionType type) {
+	return is_array(parser->types, type.id);
+}
+
+static inline
+bool aggregate(struct Parser *parser, struct ExpressionType type) {
+	return is_aggregate(parser->types, type.id);
+}
+
+// pointer arithmetic needs the size of what is pointed to
+static inline
+bool incomplete_pointee(struct Parser *parser, struct ExpressionType type) {
+	return pointer(parser, type) && get_type(parser->types, pointee(parser->types, type.id))->incomplete;
+}
+
+
 static
-int sizeof_type(struct ExpressionType type) {
-	if (type.pointers > 0) return 4;
+struct ExpressionType check_node(struct AST_Expression *, struct Parser *);
 
-	switch (type.type) {
-		case VOID: return 0;
-		case U8:   return 1;
-		case U16:  return 2;
-		case U32:  return 4;
-		case INT:  return 4;
-		default: assert(0 && "unreachable");
+// an index whose range is known is checked against the length. in
+// syntax-only mode only literals are, the operands of others are gone
+static
+void check_index(struct Parser *parser, struct AST_ExprBinaryOp *op, struct ExpressionType array) {
+	uint32_t length = get_type(parser->types, array.id)->length;
+	if (parser->syntax_only && op->rhs->type != LITERAL) return;
+
+	struct IndexRange range = index_range(parser->types, op->rhs);
+
+	if (range.low >= length) {
+		parser_error(parser, op->token, "Array index %u is out of bounds (length %u).", range.low, length);
+	}
+
+	else if (range.bounded && range.high >= length) {
+		parser_warning(parser, op->token, "Array index may be out of bounds (up to %u, length %u).", range.high, length);
+	}
+}
+
+// nodes are stored in the arena, in syntax-only mode they are checked at
+// once and kept in the scratch slot of their nesting depth instead: only
+// the types of a node's operands are needed to check it. nodes nested
+// deeper than the slots go to the arena after all
+static
+struct AST_Expression *emit_node(struct Parser *parser, struct AST_Expression *node) {
+	if (parser->syntax_only && !parser->errors) check_node(node, parser);
+
+	if (!parser->syntax_only || parser->depth > MAX_EXPRESSION_DEPTH) {
+		return store_object(parser->allocator, node, sizeof *node);
+	}
+
+	struct AST_Expression *slot = &parser->scratch[parser->depth - 1];
+	*slot = *node;
+	return slot;
+}
+
+static
+struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precedence);
+
+static
+struct AST_Expression *parse_expression_2(struct Parser *parser, int min_precedence);
+
+// in syntax-only mode the argument nodes of a call are gone by the time it
+// is checked, their types are kept as they are parsed
+static
+void record_argument(struct Parser *parser, struct AST_Expression *arg) {
+	if (parser->argument_count < MAX_PARAMS) parser->arguments[parser->argument_count] = expression_type(arg);
+	parser->argument_count++;
+}
+
+// the arguments after `(`, as one `,` expression
+static
+struct AST_Expression *parse_call(struct Parser *parser, struct Token *op, struct AST_Expression *func) {
+	// the types of the arguments of enclosing calls stay on the stack
+	struct ExpressionType arguments[MAX_PARAMS];
+	struct ExpressionType *outer = parser->arguments;
+	int outer_count = parser->argument_count, outer_depth = parser->argument_depth;
+
+	parser->arguments = arguments;
+	parser->argument_count = 0;
+	parser->argument_depth = parser->depth + 1;
+
+	struct AST_Expression call = {
+		.type = FUNC_CALL,
+		.func_call = { .token = op, .func = func },
+	};
+
+	// `f()` has no arguments
+	if (!next_is(parser, ')')) call.func_call.args = parse_expression_1(parser, MIN_PRECEDENCE);
+	expect_next(parser, ')');
+
+	// a single argument has no `,`
+	if (parser->syntax_only && call.func_call.args && parser->argument_count == 0) {
+		record_argument(parser, call.func_call.args);
 	}
+
+	struct AST_Expression *node = emit_node(parser, &call);
+
+	parser->arguments = outer;
+	parser->argument_count = outer_count;
+	parser->argument_depth = outer_depth;
+	return node;
 }
 
+// the types of up to MAX_PARAMS arguments of a call, returns how many there are
+static
+int argument_types(struct Parser *parser, struct AST_ExprFuncCall *call, struct ExpressionType *types) {
+	if (parser->syntax_only) {
+		memcpy(types, parser->arguments, min(parser->argument_count, MAX_PARAMS) * sizeof *types);
+		return parser->argument_count;
+	}
+
+	struct AST_Expression *args[MAX_PARAMS];
+	int count = call_arguments(call->args, args);
+
+	for (int i = 0; i < min(count, MAX_PARAMS); i++) types[i] = expression_type(args[i]);
+	return count;
+}
 
 static
 struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precedence) {
+	parser->depth++;
+	struct AST_Expression *expr = parse_expression_2(parser, min_precedence);
+	parser->depth--;
+
+	return expr;
+}
+
+static
+struct AST_Expression *parse_expression_2(struct Parser *parser, int min_precedence) {
 	struct AST_Expression *lhs = NULL;
 	int type = get_token_type(peek_next(parser)) & EXPRESSION;
 
@@ -218,12 +419,17 @@ struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precede
 					}
 				};
 
-				lhs = store_object(parser->allocator, &type_cast, sizeof type_cast);
+				lhs = emit_node(parser, &type_cast);
 			}
 
 			else {
 				lhs = parse_expression_1(parser, MIN_PRECEDENCE);
 				expect_next(parser, ')');
+
+				// keep the operand out of the slot of the next one
+				if (parser->syntax_only && lhs && parser->depth <= MAX_EXPRESSION_DEPTH) {
+					lhs = memcpy(&parser->scratch[parser->depth - 1], lhs, sizeof *lhs);
+				}
 			}
 
 			break;
@@ -255,11 +461,11 @@ struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precede
 						.literal = {
 							.token = op.unary_op.token,
 							.type = T,
-							.value = sizeof_type(T),
+							.value = type_size(parser->types, T.id),
 						},
 					};
 
-					lhs = store_object(parser->allocator, &static_sizeof, sizeof static_sizeof);
+					lhs = emit_node(parser, &static_sizeof);
 					break; // success
 				}
 
@@ -269,7 +475,7 @@ struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precede
 			}
 
 			op.unary_op.rhs = parse_expression_1(parser, PREC_UNARY_OP);
-			lhs = store_object(parser->allocator, &op, sizeof op);
+			lhs = emit_node(parser, &op);
 			break;
 		}
 
@@ -282,7 +488,7 @@ struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precede
 				             .value = token->value },
 			};
 
-			lhs = store_object(parser->allocator, &literal, sizeof literal);
+			lhs = emit_node(parser, &literal);
 			break;
 		}
 
@@ -292,7 +498,7 @@ struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precede
 				.string = { chop_next(parser) },
 			};
 
-			lhs = store_object(parser->allocator, &string, sizeof string);
+			lhs = emit_node(parser, &string);
 			break;
 		}
 
@@ -302,7 +508,7 @@ struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precede
 				.identifier = { .token = chop_next(parser) },
 			};
 
-			lhs = store_object(parser->allocator, &identifier, sizeof identifier);
+			lhs = emit_node(parser, &identifier);
 			break;
 		}
 
@@ -319,44 +525,55 @@ struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precede
 
 		struct Token *op = chop_next(parser);
 		enum AST_ExpressionType type = get_token_type(op) & CONTINUE;
-		struct AST_Expression operator = { .type = type };
+		struct AST_Expression operator = { .type = type }, name;
 
 		if (type == POST_UNARY_OP) {
 			op->value += 1; // convert operator to post-fix
+			operator.type = UNARY_OP;
 			operator.unary_op.token = op;
-			operator.unary_op.rhs = parse_expression_1(parser, MIN_PRECEDENCE);
+			operator.unary_op.rhs = lhs;
+		}
+
+		// `s.name`: the name is no expression of its own, in syntax-only
+		// mode it is only read while the node is checked
+		else if (is_operator(op, '.')) {
+			name = (struct AST_Expression) {
+				.type = IDENTIFIER,
+				.identifier = { .token = expect_identifier(parser) },
+			};
+
+			operator.binary_op.token = op;
+			operator.binary_op.lhs = lhs;
+			operator.binary_op.rhs = parser->syntax_only ? &name : store_object(parser->allocator, &name, sizeof name);
+		}
+
+		else if (is_operator(op, '(')) {
+			lhs = parse_call(parser, op, lhs);
+			continue;
 		}
 
 		else {
-			bool func_call = op->value == '(';
 			bool array_sub = op->value == '[';
 
 			int prec = precedence[op->value];
-			if (func_call || array_sub) prec = MIN_PRECEDENCE;
+			if (array_sub) prec = MIN_PRECEDENCE;
+			if (op->value == '=') prec -= 1;
 
 			operator.binary_op.token = op;
 			operator.binary_op.lhs = lhs;
 			operator.binary_op.rhs = parse_expression_1(parser, prec);
 
-			if (func_call) expect_next(parser, ')');
 			if (array_sub) expect_next(parser, ']');
 
-			if (func_call) {
-				struct AST_Expression func_call = {
-					.type = FUNC_CALL,
-					.func_call = {
-						.token = operator.binary_op.token,
-						.func  = operator.binary_op.lhs,
-						.args  = operator.binary_op.rhs,
-					},
-				};
-
-				lhs = store_object(parser->allocator, &func_call, sizeof func_call);
-				continue;
+			// a `,` between arguments, its lhs is the first or a `,` itself
+			if (parser->syntax_only && is_operator(op, ',') && parser->depth == parser->argument_depth
+			    && lhs && operator.binary_op.rhs) {
+				if (parser->argument_count == 0) record_argument(parser, lhs);
+				record_argument(parser, operator.binary_op.rhs);
 			}
 		}
 
-		lhs = store_object(parser->allocator, &operator, sizeof operator);
+		lhs = emit_node(parser, &operator);
 	}
 
 	return lhs;
@@ -365,62 +582,410 @@ struct AST_Expression *parse_expression_1(struct Parser *parser, int min_precede
 static
 struct ExpressionType type_check_expression(struct AST_Expression *expr, struct Parser *parser);
 
+static
+void check_assignment(struct Parser *, struct Token *, struct ExpressionType to, struct ExpressionType from);
+
 struct AST_Expression *parse_expression(struct Parser *parser) {
+	struct Token *token = peek_next(parser);
 	struct AST_Expression *expr = parse_expression_1(parser, MIN_PRECEDENCE);
-	if (!parser->errors) type_check_expression(expr, parser);
+
+	// syntax-only nodes were checked as they were built
+	if (!parser->errors && !parser->syntax_only) type_check_expression(expr, parser);
+
+	// aggregates are only ever operands of `.`, `[`, `*` and sizeof
+	if (!parser->errors && aggregate(parser, expression_type(expr))) {
+		char buffer[1024];
+		parser_error(parser, token, "Expression of type " WHITE "'%s'" RESET " is not a value.",
+		             print_type(parser->types, expression_type(expr).id, buffer, sizeof buffer));
+	}
+
 	return expr;
 }
 
 
+// post-order walk over a finished tree
 static
 struct ExpressionType type_check_expression(struct AST_Expression *expr, struct Parser *parser) {
+	switch (expr->type) {
+		case UNARY_OP:
+			type_check_expression(expr->unary_op.rhs, parser);
+			break;
+
+		// the rhs of `.` is a field name
+		case BINARY_OP:
+			type_check_expression(expr->binary_op.lhs, parser);
+			if (!is_operator(expr->binary_op.token, '.')) type_check_expression(expr->binary_op.rhs, parser);
+			break;
+
+		case TYPE_CAST:
+			type_check_expression(expr->type_cast.rhs, parser);
+			break;
+
+		case FUNC_CALL:
+			type_check_expression(expr->func_call.func, parser);
+			if (expr->func_call.args) type_check_expression(expr->func_call.args, parser);
+			break;
+
+		default:
+			break;
+	}
+
+	if (parser->errors) return (struct ExpressionType) {0};
+	return check_node(expr, parser);
+}
+
+
+// vectors combine lane by lane with vectors of their own type, comparisons
+// set every bit of the lanes they hold for. sse2 has no byte shifts or
+// products, only lanes wider than a byte shift by a scalar or multiply
+static
+unsigned vector_operation(struct Parser *parser, struct Token *token,
+                          struct ExpressionType lhs, struct ExpressionType rhs) {
+	char lbuff[1024], rbuff[1024];
+	bool wide = vector(parser, lhs) && lane_type(parser->types, lhs.id) != U8;
+	bool valid = false;
+
+	if (token->type == PUNCTUATION) switch (token->value) {
+		case SHL: case SHR:
+			valid = wide && !vector(parser, rhs) && !pointer(parser, rhs);
+			break;
+
+		case '*':
+			valid = wide && lhs.id == rhs.id;
+			break;
+
+		case '+': case '-':
+		case '&': case '|': case '^':
+		case EQ: case NEQ:
+		case '<': case LEQ: case '>': case GEQ:
+			valid = lhs.id == rhs.id;
+			break;
+	}
+
+	if (!valid) {
+		parser_error(parser, token,
+			"Invalid operands to binary %s (have "
+			WHITE "'%s'" RESET " and "
+			WHITE "'%s'" RESET ").",
+			print_token(token),
+			print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+			print_type(parser->types, rhs.id, rbuff, sizeof rbuff)
+		);
+
+		return VOID;
+	}
+
+	return lhs.id;
+}
+
+
+// builtins
+
+static const struct {
+	const char *name;
+	int params;
+} builtins[] = {
+	[BUILTIN_SHUFFLE]  = { "shuffle",  2 },
+	[BUILTIN_MOVEMASK] = { "movemask", 1 },
+	[BUILTIN_CLZ]      = { "clz",      1 },
+	[BUILTIN_CTZ]      = { "ctz",      1 },
+	[BUILTIN_POPCOUNT] = { "popcount", 1 },
+	[BUILTIN_BSWAP]    = { "bswap",    1 },
+	[BUILTIN_ROTATE]   = { "rotate",   2 },
+	[BUILTIN_PREFETCH] = { "prefetch", 1 },
+};
+
+static
+enum Builtin find_builtin(struct Token *name) {
+	for (unsigned i = BUILTIN_NONE + 1; i < sizeof builtins / sizeof *builtins; i++) {
+		if (strcmp(builtins[i].name, name->text) == 0) return i;
+	}
+
+	return BUILTIN_NONE;
+}
+
+// a declaration of the name hides the builtin
+static
+bool is_builtin(struct Parser *parser, struct Token *name) {
+	return find_builtin(name) != BUILTIN_NONE && lookup_symbol(parser->scope, name->text, name->length) == NULL;
+}
+
+static inline
+bool integer(struct ExpressionType type) {
+	return type.id >= U8 && type.id <= INT;
+}
+
+static
+void builtin_operands_error(struct Parser *parser, struct AST_ExprFuncCall *call,
+                            struct ExpressionType lhs, struct ExpressionType *rhs) {
+	char lbuff[1024], rbuff[1024];
+	const char *name = builtins[call->builtin].name;
+
+	if (rhs == NULL) {
+		parser_error(parser, call->token,
+			"Invalid operand to builtin `%s` (have "
+			WHITE "'%s'" RESET ").",
+			name, print_type(parser->types, lhs.id, lbuff, sizeof lbuff)
+		);
+		return;
+	}
+
+	parser_error(parser, call->token,
+		"Invalid operands to builtin `%s` (have "
+		WHITE "'%s'" RESET " and "
+		WHITE "'%s'" RESET ").",
+		name,
+		print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+		print_type(parser->types, rhs->id, rbuff, sizeof rbuff)
+	);
+}
+
+static
+struct ExpressionType check_builtin(struct Parser *parser, struct AST_ExprFuncCall *call) {
+	struct ExpressionType type = { .id = U32, .temporary = true };
+
+	const char *name = builtins[call->builtin].name;
+	int params = builtins[call->builtin].params;
+
+	struct ExpressionType args[MAX_PARAMS];
+	int count = argument_types(parser, call, args);
+
+	if (count != params) {
+		parser_error(parser, call->token,
+			"Builtin `%s` expects %d argument%s, got %d.",
+			name, params, params == 1 ? "" : "s", count);
+		return type;
+	}
+
+	struct ExpressionType lhs = args[0], rhs = args[params - 1];
+
+	switch (call->builtin) {
+		// lane i of the result is lane indices[i] of the vector, taken
+		// modulo the number of lanes
+		case BUILTIN_SHUFFLE:
+			if (!vector(parser, lhs) || lhs.id != rhs.id) builtin_operands_error(parser, call, lhs, &rhs);
+			type.id = lhs.id;
+			break;
+
+		// bit i of the result is the top bit of lane i
+		case BUILTIN_MOVEMASK:
+			if (!vector(parser, lhs)) builtin_operands_error(parser, call, lhs, NULL);
+			break;
+
+		case BUILTIN_CLZ: case BUILTIN_CTZ: case BUILTIN_POPCOUNT:
+			if (!integer(lhs)) builtin_operands_error(parser, call, lhs, NULL);
+			break;
+
+		// u8 and u16 rotate within their width, the result is a u32 like
+		// that of arithmetic on them
+		case BUILTIN_ROTATE:
+			if (!integer(lhs) || !integer(rhs)) builtin_operands_error(parser, call, lhs, &rhs);
+			break;
+
+		case BUILTIN_BSWAP:
+			if (!integer(lhs)) builtin_operands_error(parser, call, lhs, NULL);
+			else               type.id = lhs.id;
+			break;
+
+		case BUILTIN_PREFETCH:
+			if (!pointer(parser, lhs)) builtin_operands_error(parser, call, lhs, NULL);
+			type.id = VOID;
+			break;
+
+		case BUILTIN_NONE:
+			assert(0 && "unreachable");
+	}
+
+	return type;
+}
+
+uint32_t evaluate_builtin(enum Builtin builtin, int bits, uint32_t value, uint32_t count) {
+	switch (builtin) {
+		case BUILTIN_CLZ:      return leading_zeros(value, bits);
+		case BUILTIN_CTZ:      return trailing_zeros(value, bits);
+		case BUILTIN_POPCOUNT: return count_ones(value);
+		case BUILTIN_BSWAP:    return swap_bytes(value, bits);
+		case BUILTIN_ROTATE:   return rotate_left(value, count, bits);
+
+		default:
+			assert(0 && "unreachable");
+			return 0;
+	}
+}
+
+// a scalar builtin of literals is a literal, like sizeof of a type
+static
+void fold_builtin(struct Parser *parser, struct AST_Expression *expr) {
+	struct AST_ExprFuncCall call = expr->func_call;
+	struct AST_Expression *args[MAX_PARAMS];
+
+	if (parser->syntax_only || parser->errors) return;
+	if (call.builtin < BUILTIN_CLZ || call.builtin == BUILTIN_PREFETCH) return;
+
+	int count = call_arguments(call.args, args);
+	if (count == 0) return;
+
+	for (int i = 0; i < count; i++) {
+		if (args[i]->type != LITERAL) return;
+	}
+
+	int bits = 8 * type_size(parser->types, expression_type(args[0]).id);
+	uint32_t value = args[0]->literal.value, by = count > 1 ? args[1]->literal.value : 0;
+
+	*expr = (struct AST_Expression) {
+		.type = LITERAL,
+		.literal = {
+			.token = call.token,
+			.value = evaluate_builtin(call.builtin, bits, value, by),
+		},
+	};
+}
+
+
+// `s.name` is assignable when s is
+static
+struct ExpressionType check_member(struct Parser *parser, struct AST_ExprBinaryOp op) {
+	struct ExpressionType lhs = expression_type(op.lhs), type = {0};
+	struct TypeEntry *T = get_type(parser->types, lhs.id);
+	struct Token *name = op.rhs->identifier.token;
+	char buffer[1024];
+
+	if (T->kind != TYPE_STRUCT && T->kind != TYPE_UNION) {
+		parser_error(parser, op.token,
+			"Member `%s` of non-struct type "
+			WHITE "'%s'" RESET ".", name->text, print_type(parser->types, lhs.id, buffer, sizeof buffer));
+		return type;
+	}
+
+	if (T->incomplete) {
+		parser_error(parser, op.token,
+			"Member `%s` of incomplete type "
+			WHITE "'%s'" RESET ".", name->text, print_type(parser->types, lhs.id, buffer, sizeof buffer));
+		return type;
+	}
+
+	struct Field *field = find_field(parser->types, lhs.id, name->text);
+
+	if (field == NULL) {
+		parser_error(parser, name, WHITE "'%s'" RESET " has no member `%s`.",
+		             print_type(parser->types, lhs.id, buffer, sizeof buffer), name->text);
+		return type;
+	}
+
+	type.id = field->type;
+	type.temporary = lhs.temporary;
+	return type;
+}
+
+// computes the type of a node whose operands are already checked
+static
+struct ExpressionType check_node(struct AST_Expression *expr, struct Parser *parser) {
 	struct ExpressionType type = {0};
-	static char lbuff[1024], rbuff[1024];
+	char lbuff[1024], rbuff[1024];
 
 	switch (expr->type) {
 		case LITERAL:
 			type.temporary = true;
-			type.type = (expr->literal.token->is_char) ? U8 : U32;
+			type.id = (expr->literal.token->is_char) ? U8 : U32;
 			break;
 
 		case STRING:
-			type.type = U8;
-			type.pointers = 1;
+			type.id = pointer_to(parser->types, U8);
 			type.temporary = true;
 			break;
 
-		case IDENTIFIER:
-			// TODO: lookup variable in scope
-			errx("variables are not implemented yet!");
+		case IDENTIFIER: {
+			struct Token *name = expr->identifier.token;
+			struct Symbol *symbol = lookup_symbol(parser->scope, name->text, name->length);
+
+			// the call checks a builtin
+			if (symbol == NULL && find_builtin(name) != BUILTIN_NONE) {
+				type.temporary = true;
+				break;
+			}
+
+			// file scope names the expression depends on
+			if (parser->dependencies && (symbol == NULL || symbol->depth == 0)) {
+				unsigned key = symbol ? symbol->hash : hash(name->text, name->length);
+				vec_push(parser->dependencies, &key);
+			}
+
+			if (symbol == NULL) {
+				parser_error(parser, name, "Use of undeclared identifier `%s`.", name->text);
+				break;
+			}
+
+			if (symbol->kind == SYM_TYPE) {
+				parser_error(parser, name, "`%s` is a type, not a value.", name->text);
+				break;
+			}
+
+			// the callee of a call, the only use a function name has, is
+			// the identifier right before its `(`
+			if (symbol->kind == SYM_FUNCTION && !is_operator(name + 1, '(')) {
+				parser_error(parser, name, "`%s` is a function, not a value.", name->text);
+				break;
+			}
+
+			expr->identifier.declaration = symbol->declaration;
+			type = symbol->type;
+			type.temporary = (symbol->kind == SYM_FUNCTION);
 			break;
+		}
 
 		case UNARY_OP: {
 			struct AST_ExprUnaryOp op = expr->unary_op;
-			struct ExpressionType rhs = type_check_expression(op.rhs, parser);
-			if (parser->errors) break;
+			struct ExpressionType rhs = expression_type(op.rhs);
 
 			if (op.token->type == KEYWORD_SIZEOF) {
-				type.type = U32;
+				type.id = U32;
 				type.temporary = true;
 				break;
 			}
 
 			assert(op.token->type == PUNCTUATION);
+
+			// aggregates are no values, only their address is
+			if (aggregate(parser, rhs) && op.token->value != '*') {
+				parser_error(parser, op.token,
+					"Invalid operand to unary %s (have "
+					WHITE "'%s'" RESET ").",
+					print_token(op.token),
+					print_type(parser->types, rhs.id, lbuff, sizeof lbuff)
+				);
+				break;
+			}
 			switch (op.token->value) {
 				case '+': case '-': case '~':
-					if (rhs.pointers > 0 || rhs.type == VOID) {
+					if (pointer(parser, rhs) || rhs.id == VOID) {
 						parser_error(parser, op.token,
 							"Invalid operand to unary %s (have "
 							WHITE "'%s'" RESET ").",
 							print_token(op.token),
-							print_type(rhs, lbuff)
+							print_type(parser->types, rhs.id, lbuff, sizeof lbuff)
 						);
 					}
 
-					// '+' and '-' always makes value signed
-					if (op.token->value != '~') type.type = INT;
-					else                        type.type = max(rhs.type, U32);
+					// '+' and '-' always makes value signed, vectors keep their type
+					     if (vector(parser, rhs))        type.id = rhs.id;
+					else if (op.token->value != '~') type.id = INT;
+					else                             type.id = max(rhs.id, U32);
+
+					type.temporary = true;
+					break;
+
+				// logical
+				case '!':
+					if (rhs.id == VOID || vector(parser, rhs)) {
+						parser_error(parser, op.token,
+							"Invalid operand to unary %s (have "
+							WHITE "'%s'" RESET ").",
+							print_token(op.token),
+							print_type(parser->types, rhs.id, lbuff, sizeof lbuff)
+						);
+					}
 
+					type.id = U8;
 					type.temporary = true;
 					break;
 
@@ -430,27 +995,46 @@ struct ExpressionType type_check_expression(struct AST_Expression *expr, struct
 						parser_error(parser, op.token, "Cannot assign to temporary expression.");
 					}
 
+					else if (vector(parser, rhs)) {
+						parser_error(parser, op.token,
+							"Invalid operand to unary %s (have "
+							WHITE "'%s'" RESET ").",
+							op.token->value == INC || op.token->value == POST_INC ? "`++`" : "`--`",
+							print_type(parser->types, rhs.id, lbuff, sizeof lbuff)
+						);
+					}
+
+					else if (incomplete_pointee(parser, rhs)) {
+						parser_error(parser, op.token,
+							"Arithmetic on pointer to incomplete type "
+							WHITE "'%s'" RESET ".", print_type(parser->types, pointee(parser->types, rhs.id), lbuff, sizeof lbuff));
+					}
+
 					type = rhs;
 					type.temporary = true;
 					break;
 
 				case '*':
-					if (rhs.temporary || rhs.type == VOID) {
+					if (rhs.temporary || rhs.id == VOID) {
 						parser_error(parser, op.token, "Cannot reference temporary expression.");
 					}
 
-					type = rhs;
-					type.pointers++;
+					// the fields of a soa element are apart from each other
+					else if (get_type(parser->types, rhs.id)->soa) {
+						parser_error(parser, op.token, "Elements of soa struct `%s` have no address.",
+						             get_type(parser->types, rhs.id)->token->text);
+					}
+
+					type.id = pointer_to(parser->types, rhs.id);
 					break;
 
 				case SHL:
-					if (rhs.pointers == 0) {
+					if (!pointer(parser, rhs)) {
 						parser_error(parser, op.token, "Cannot dereference non-pointer.");
+						break;
 					}
 
-					type = rhs;
-					type.pointers--;
-					type.temporary = false;
+					type = dereference(parser, rhs);
 					break;
 
 				default:
@@ -462,28 +1046,64 @@ struct ExpressionType type_check_expression(struct AST_Expression *expr, struct
 
 		case BINARY_OP: {
 			struct AST_ExprBinaryOp op = expr->binary_op;
-			struct ExpressionType lhs = type_check_expression(op.lhs, parser);
-			struct ExpressionType rhs = type_check_expression(op.rhs, parser);
-			if (parser->errors) break;
+
+			if (is_operator(op.token, '.')) {
+				type = check_member(parser, op);
+				break;
+			}
+
+			struct ExpressionType lhs = expression_type(op.lhs);
+			struct ExpressionType rhs = expression_type(op.rhs);
 
 			bool shift = false;
 
 			// check binary arguments are not void
-			if ((lhs.pointers == 0 && lhs.type == VOID) ||
-			    (rhs.pointers == 0 && rhs.type == VOID)) {
+			if (lhs.id == VOID || rhs.id == VOID) {
 				parser_error(parser, op.token,
 					"Invalid operands to binary %s (have "
 					WHITE "'%s'" RESET " and "
 					WHITE "'%s'" RESET ").",
 					print_token(op.token),
-					print_type(lhs, lbuff),
-					print_type(rhs, rbuff)
+					print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+					print_type(parser->types, rhs.id, rbuff, sizeof rbuff)
 				);
 				break;
 			}
 
+			// arrays are only indexed, other aggregates are no operands at all
+			if ((aggregate(parser, lhs) && !(array(parser, lhs) && is_operator(op.token, '['))) || aggregate(parser, rhs)) {
+				parser_error(parser, op.token,
+					"Invalid operands to binary %s (have "
+					WHITE "'%s'" RESET " and "
+					WHITE "'%s'" RESET ").",
+					print_token(op.token),
+					print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+					print_type(parser->types, rhs.id, rbuff, sizeof rbuff)
+				);
+				break;
+			}
+
+			// pointer arithmetic needs the size of what is pointed to
+			if ((is_operator(op.token, '+') || is_operator(op.token, '-') || is_operator(op.token, '[')) &&
+			    (incomplete_pointee(parser, lhs) || incomplete_pointee(parser, rhs))) {
+				parser_error(parser, op.token,
+					"Arithmetic on pointer to incomplete type "
+					WHITE "'%s'" RESET ".",
+					print_type(parser->types, pointee(parser->types, (pointer(parser, lhs) ? lhs : rhs).id), lbuff, sizeof lbuff)
+				);
+				break;
+			}
+
+			// lane by lane, assignment and indexing are checked below
+			if ((vector(parser, lhs) || vector(parser, rhs)) && !is_operator(op.token, ',') &&
+			    !is_operator(op.token, '=') && !is_operator(op.token, '[')) {
+				type.id = vector_operation(parser, op.token, lhs, rhs);
+				type.temporary = true;
+				break;
+			}
+
 			if (op.token->type == KEYWORD_ELSE) {
-				if ((lhs.pointers > 0) != (rhs.pointers > 0)) {
+				if (pointer(parser, lhs) != pointer(parser, rhs)) {
 					parser_warning(parser, op.token, "Type mismatch in else expression.");
 				}
 
@@ -497,9 +1117,19 @@ struct ExpressionType type_check_expression(struct AST_Expression *expr, struct
 					type = rhs;
 					break;
 
+				case '=':
+					if (lhs.temporary) {
+						parser_error(parser, op.token, "Cannot assign to temporary expression.");
+					}
+
+					check_assignment(parser, op.token, lhs, rhs);
+					type = lhs;
+					type.temporary = true;
+					break;
+
 				// logical
 				case OR: case AND:
-					type.type = U8;
+					type.id = U8;
 					type.temporary = true;
 					break;
 
@@ -509,107 +1139,128 @@ struct ExpressionType type_check_expression(struct AST_Expression *expr, struct
 
 				case '|': case '^': case '&':
 				case '*': case '/': case '%':
-					if (lhs.pointers > 0 || rhs.pointers > 0) {
+					if (pointer(parser, lhs) || pointer(parser, rhs)) {
 						parser_error(parser, op.token,
 							"Invalid operands to binary %s (have "
 							WHITE "'%s'" RESET " and "
 							WHITE "'%s'" RESET ").",
 							print_token(op.token),
-							print_type(lhs, lbuff),
-							print_type(rhs, rbuff)
+							print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+							print_type(parser->types, rhs.id, rbuff, sizeof rbuff)
 						);
 					}
 
 					type.temporary = true;
-					type.type = shift ? max(lhs.type, U32)
-					                  : max(max(lhs.type, rhs.type), U32);
+					type.id = shift ? max(lhs.id, U32)
+					                : max(max(lhs.id, rhs.id), U32);
 					break;
 
 				// comparison
 				case EQ: case NEQ:
 				case '<': case LEQ: case '>': case GEQ:
-					if (lhs.pointers != rhs.pointers ||
-					    (lhs.pointers > 0 && lhs.type != rhs.type)) {
+					if ((pointer(parser, lhs) || pointer(parser, rhs)) && lhs.id != rhs.id) {
 						parser_warning(parser, op.token,
 							"Comparison between differing pointer types (have "
 							WHITE "'%s'" RESET " and "
 							WHITE "'%s'" RESET ").",
-							print_type(lhs, lbuff),
-							print_type(rhs, rbuff)
+							print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+							print_type(parser->types, rhs.id, rbuff, sizeof rbuff)
 						);
 					}
 
-					if (lhs.pointers == 0 && rhs.pointers == 0 && ((lhs.type == INT) != (rhs.type == INT))) {
+					if (!pointer(parser, lhs) && !pointer(parser, rhs) && ((lhs.id == INT) != (rhs.id == INT))) {
 						parser_warning(parser, op.token,
 							"Comparison between different signedness (have "
 							WHITE "'%s'" RESET " and "
 							WHITE "'%s'" RESET ").",
-							print_type(lhs, lbuff),
-							print_type(rhs, rbuff)
+							print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+							print_type(parser->types, rhs.id, rbuff, sizeof rbuff)
 						);
 					}
 
-					type.type = U32;
+					type.id = U32;
 					type.temporary = true;
 					break;
 
 				// (pointer) arithmetic
 				case '+':
-					if (lhs.pointers > 0 && rhs.pointers > 0) {
+					if (pointer(parser, lhs) && pointer(parser, rhs)) {
 						parser_error(parser, op.token,
 							"Invalid operands to binary %s (have "
 							WHITE "'%s'" RESET " and "
 							WHITE "'%s'" RESET ").",
 							print_token(op.token),
-							print_type(lhs, lbuff),
-							print_type(rhs, rbuff)
+							print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+							print_type(parser->types, rhs.id, rbuff, sizeof rbuff)
 						);
 					}
 
-					     if (lhs.pointers > 0) type = lhs;
-					else if (rhs.pointers > 0) type = rhs;
-					else                       type.type = max(max(lhs.type, rhs.type), U32);
+					     if (pointer(parser, lhs)) type = lhs;
+					else if (pointer(parser, rhs)) type = rhs;
+					else                           type.id = max(max(lhs.id, rhs.id), U32);
 
 					type.temporary = true;
 					break;
 
 				case '-':
-					if (lhs.pointers > 0 && rhs.pointers > 0) {
-						if (lhs.pointers != rhs.pointers || lhs.type != rhs.type) {
+					if (pointer(parser, lhs) && pointer(parser, rhs)) {
+						if (lhs.id != rhs.id) {
 							parser_warning(parser, op.token,
 								"Offset between differing pointer types (have "
 								WHITE "'%s'" RESET " and "
 								WHITE "'%s'" RESET ").",
-								print_type(lhs, lbuff),
-								print_type(rhs, rbuff)
+								print_type(parser->types, lhs.id, lbuff, sizeof lbuff),
+								print_type(parser->types, rhs.id, rbuff, sizeof rbuff)
 							);
 						}
 
-						type.type = U32;
+						type.id = U32;
 					}
 
-					else if (lhs.pointers > 0) type = lhs;
-					else if (rhs.pointers > 0) type = rhs;
-					else                       type.type = max(max(lhs.type, rhs.type), U32);
+					else if (pointer(parser, lhs)) type = lhs;
+					else if (pointer(parser, rhs)) type = rhs;
+					else                           type.id = max(max(lhs.id, rhs.id), U32);
 
 					type.temporary = true;
 					break;
 
 				// index
 				case '[':
-					if (lhs.pointers == 0) {
+					if (!pointer(parser, lhs) && !vector(parser, lhs) && !array(parser, lhs)) {
 						parser_error(parser, op.token,
 							"Cannot index into non-pointer type (have "
-							WHITE "'%s'" RESET ").", print_type(lhs, lbuff));
+							WHITE "'%s'" RESET ").", print_type(parser->types, lhs.id, lbuff, sizeof lbuff));
+						break;
 					}
 
-					if (rhs.pointers > 0) {
+					if (pointer(parser, rhs)) {
 						parser_error(parser, op.token,
 							"Cannot index using a pointer type (have "
-							WHITE "'%s'" RESET ").", print_type(rhs, rbuff));
+							WHITE "'%s'" RESET ").", print_type(parser->types, rhs.id, rbuff, sizeof rbuff));
+					}
+
+					else if (vector(parser, rhs)) {
+						parser_error(parser, op.token,
+							"Cannot index using a vector type (have "
+							WHITE "'%s'" RESET ").", print_type(parser->types, rhs.id, rbuff, sizeof rbuff));
+					}
+
+					// an element is assignable when its array is, and so is a lane
+					if (array(parser, lhs)) {
+						if (!pointer(parser, rhs) && !vector(parser, rhs)) check_index(parser, &op, lhs);
+
+						type.id = pointee(parser->types, lhs.id);
+						type.temporary = lhs.temporary;
+						break;
 					}
 
+					if (vector(parser, lhs)) {
+						type.id = lane_type(parser->types, lhs.id);
+						type.temporary = lhs.temporary;
+						break;
+					}
 
+					type = dereference(parser, lhs);
 					break;
 
 				default:
@@ -621,25 +1272,36 @@ struct ExpressionType type_check_expression(struct AST_Expression *expr, struct
 
 		case TYPE_CAST: {
 			struct AST_ExprTypeCast cast = expr->type_cast;
-			struct ExpressionType rhs = type_check_expression(cast.rhs, parser);
-			if (parser->errors) break;
+			struct ExpressionType rhs = expression_type(cast.rhs);
 
-			if (rhs.type == VOID && rhs.pointers == 0) {
-				if (cast.type.type != VOID || cast.type.pointers > 0) {
+			if (rhs.id == VOID) {
+				if (cast.type.id != VOID) {
 					parser_error(parser, cast.token,
 						"Cannot cast expression of type 'void' to '%s'",
-						print_type(cast.type, lbuff)
+						print_type(parser->types, cast.type.id, lbuff, sizeof lbuff)
 					);
 				}
 			}
 
-			if (cast.type.type == rhs.type && cast.type.pointers == rhs.pointers) {
+			// scalars are broadcast to every lane, vectors keep their bits
+			else if (((vector(parser, cast.type) || vector(parser, rhs)) &&
+			          (!vector(parser, cast.type) || pointer(parser, rhs))) ||
+			         aggregate(parser, cast.type) || aggregate(parser, rhs)) {
+				parser_error(parser, cast.token,
+					"Invalid cast from "
+					WHITE "'%s'" RESET " to "
+					WHITE "'%s'" RESET ".",
+					print_type(parser->types, rhs.id, rbuff, sizeof rbuff),
+					print_type(parser->types, cast.type.id, lbuff, sizeof lbuff));
+			}
+
+			if (cast.type.id == rhs.id) {
 				parser_warning(parser, cast.token,
 					"Unnecessary cast of identical types ("
 					WHITE "'%s'" RESET " to "
 					WHITE "'%s'" RESET ").",
-					print_type(rhs, rbuff),
-					print_type(cast.type, lbuff));
+					print_type(parser->types, rhs.id, rbuff, sizeof rbuff),
+					print_type(parser->types, cast.type.id, lbuff, sizeof lbuff));
 			}
 
 			type = cast.type;
@@ -647,14 +1309,987 @@ struct ExpressionType type_check_expression(struct AST_Expression *expr, struct
 			break;
 		}
 
+		case FUNC_CALL: {
+			struct AST_ExprFuncCall call = expr->func_call;
+			struct AST_Declaration *function = NULL;
+
+			// the others are operands of `,`, which takes no aggregates
+			if (call.args && aggregate(parser, expression_type(call.args))) {
+				parser_error(parser, call.token,
+					"Invalid argument of type "
+					WHITE "'%s'" RESET ".", print_type(parser->types, expression_type(call.args).id, lbuff, sizeof lbuff));
+				break;
+			}
+
+			if (call.func->type == IDENTIFIER) function = call.func->identifier.declaration;
+
+			if (call.func->type == IDENTIFIER && is_builtin(parser, call.func->identifier.token)) {
+				expr->func_call.builtin = find_builtin(call.func->identifier.token);
+				type = check_builtin(parser, &expr->func_call);
+				fold_builtin(parser, expr);
+				break;
+			}
+
+			if (function == NULL || !function->function) {
+				parser_error(parser, call.token, "Called object is not a function.");
+				break;
+			}
+
+			struct ExpressionType args[MAX_PARAMS];
+			int count = argument_types(parser, &expr->func_call, args);
+
+			if (count != function->param_count) {
+				parser_error(parser, call.token,
+					"Function `%s` expects %d argument%s, got %d.",
+					function->token->text, function->param_count,
+					function->param_count == 1 ? "" : "s", count);
+				break;
+			}
+
+			for (int i = 0; i < count; i++) {
+				check_assignment(parser, call.token, function->params[i]->type, args[i]);
+			}
+
+			type = function->type;
+			type.temporary = true;
+			break;
+		}
+	}
+
+	switch (expr->type) {
+		case LITERAL:    expr->literal.type    = type; break;
+		case STRING:     expr->string.type     = type; break;
+		case IDENTIFIER: expr->identifier.type = type; break;
+		case UNARY_OP:   expr->unary_op.type   = type; break;
+		case BINARY_OP:  expr->binary_op.type  = type; break;
+		case TYPE_CAST:  expr->type_cast.type  = type; break;
+		case FUNC_CALL:  expr->func_call.type  = type; break;
+	}
+
+	return type;
+}
+
+struct ExpressionType expression_type(struct AST_Expression *expr) {
+	switch (expr->type) {
+		case LITERAL:    return expr->literal.type;
+		case STRING:     return expr->string.type;
+		case IDENTIFIER: return expr->identifier.type;
+		case UNARY_OP:   return expr->unary_op.type;
+		case BINARY_OP:  return expr->binary_op.type;
+		case TYPE_CAST:  return expr->type_cast.type;
+		case FUNC_CALL:  return expr->func_call.type;
+	}
+
+	assert(0 && "unreachable");
+}
+
+static inline
+bool is_comma(struct AST_Expression *expr) {
+	return expr->type == BINARY_OP && expr->binary_op.token->type == PUNCTUATION
+	                               && expr->binary_op.token->value == ',';
+}
+
+int call_arguments(struct AST_Expression *args, struct AST_Expression **out) {
+	if (args == NULL) return 0;
+
+	int count = 1;
+	for (struct AST_Expression *arg = args; is_comma(arg); arg = arg->binary_op.lhs) count++;
+
+	// `,` is left associative, the last argument is the outermost rhs
+	struct AST_Expression *arg = args;
+
+	for (int i = count - 1; i > 0; i--, arg = arg->binary_op.lhs) {
+		if (i < MAX_PARAMS) out[i] = arg->binary_op.rhs;
+	}
+
+	out[0] = arg;
+	return count;
+}
+
+
+// values flowing into a variable through `=`, an initialiser or `return`
+static
+void check_assignment(struct Parser *parser, struct Token *token,
+                      struct ExpressionType to, struct ExpressionType from) {
+	char lbuff[1024], rbuff[1024];
+
+	// void * converts to and from any other pointer
+	bool generic = pointer(parser, to) && pointer(parser, from) &&
+	               (dereference(parser, to).id == VOID || dereference(parser, from).id == VOID);
+
+	if (from.id == VOID) {
+		parser_error(parser, token, "Cannot assign expression of type 'void'.");
+	}
+
+	else if (aggregate(parser, to) || aggregate(parser, from)) {
+		parser_error(parser, token,
+			"Cannot assign aggregate type "
+			WHITE "'%s'" RESET ".",
+			print_type(parser->types, aggregate(parser, to) ? to.id : from.id, lbuff, sizeof lbuff)
+		);
+	}
+
+	else if (to.id != from.id && (vector(parser, to) || vector(parser, from))) {
+		parser_error(parser, token,
+			"Incompatible types in assignment (have "
+			WHITE "'%s'" RESET " and "
+			WHITE "'%s'" RESET ").",
+			print_type(parser->types, to.id, lbuff, sizeof lbuff),
+			print_type(parser->types, from.id, rbuff, sizeof rbuff)
+		);
+	}
+
+	else if (to.id != from.id && (pointer(parser, to) || pointer(parser, from)) && !generic) {
+		parser_warning(parser, token,
+			"Incompatible types in assignment (have "
+			WHITE "'%s'" RESET " and "
+			WHITE "'%s'" RESET ").",
+			print_type(parser->types, to.id, lbuff, sizeof lbuff),
+			print_type(parser->types, from.id, rbuff, sizeof rbuff)
+		);
+	}
+}
+
+
+// STATEMENTS //
+
+static
+struct AST_Expression *parse_condition(struct Parser *parser) {
+	expect_next(parser, '(');
+	struct AST_Expression *condition = parse_expression(parser);
+	expect_next(parser, ')');
+
+	if (!parser->errors) {
+		struct ExpressionType type = expression_type(condition);
+
+		if (type.id == VOID) {
+			parser_error(parser, NULL, "Condition has type 'void'.");
+		}
+
+		else if (vector(parser, type)) {
+			char buffer[64];
+			parser_error(parser, NULL, "Condition has vector type '%s'.", print_type(parser->types, type.id, buffer, sizeof buffer));
+		}
+	}
+
+	return condition;
+}
+
+// the return and parameter types of two declarations of a function
+static
+bool same_signature(struct AST_Declaration *a, struct AST_Declaration *b) {
+	if (a->type.id != b->type.id || a->param_count != b->param_count) return false;
+
+	for (int i = 0; i < a->param_count; i++) {
+		if (a->params[i]->type.id != b->params[i]->type.id) return false;
+	}
+
+	return true;
+}
+
+static
+struct Symbol *declare(struct Parser *parser, struct AST_Declaration *decl, enum SymbolKind kind, bool defines) {
+	struct Token *name = decl->token;
+	struct Symbol *symbol = lookup_symbol(parser->scope, name->text, name->length);
+
+	// functions may be declared any number of times, but defined only once,
+	// and so may structs and unions as long as they name the same type
+	if (symbol != NULL && symbol->depth == scope_depth(parser->scope) && symbol->kind == kind &&
+	    (kind == SYM_FUNCTION || (kind == SYM_TYPE && symbol->type.id == decl->type.id)) &&
+	    !(symbol->defined && defines)) {
+		if (kind == SYM_FUNCTION && !same_signature(symbol->declaration, decl)) {
+			parser_error(parser, name, "Conflicting types for `%s`.", name->text);
+			return NULL;
+		}
+
+		if (defines) {
+			symbol->declaration = decl;
+			symbol->defined = true;
+		}
+
+		return symbol;
+	}
+
+	symbol = declare_symbol(parser->scope, name, kind, decl->type);
+
+	if (symbol == NULL) {
+		parser_error(parser, name, "Redefinition of `%s`.", name->text);
+		return NULL;
+	}
+
+	symbol->declaration = decl;
+	symbol->defined = defines;
+	return symbol;
+}
+
+static
+bool calls_function(struct AST_Expression *);
+
+static
+bool evaluate(struct Parser *, struct Token *, const char *what, struct AST_Expression *, uint32_t *value);
+
+// the initialiser of a global is a constant, evaluated here like array
+// lengths and case labels so that the backends only see its value
+static
+void parse_initialiser(struct Parser *parser, struct AST_Declaration *decl, bool global) {
+	if (next_is(parser, '=')) {
+		struct Token *token = chop_next(parser);
+
+		bool syntax_only = parser->syntax_only;
+		if (global) parser->syntax_only = false;
+		decl->value = parse_expression(parser);
+		parser->syntax_only = syntax_only;
+
+		if (!parser->errors) {
+			check_assignment(parser, token, decl->type, expression_type(decl->value));
+		}
+
+		uint32_t constant;
+		struct AST_Expression *value = decl->value;
+
+		if (global && !parser->errors && value->type != LITERAL && value->type != STRING &&
+		    !(syntax_only && calls_function(value)) && evaluate(parser, token, "Initialiser", value, &constant) &&
+		    !syntax_only) {
+			decl->value = store_object(parser->allocator, &(struct AST_Expression) {
+				.type = LITERAL,
+				.literal = { .token = token, .type = expression_type(value), .value = constant },
+			}, sizeof *value);
+		}
+
+		if (syntax_only) decl->value = NULL;
+	}
+
+	expect_next(parser, ';');
+}
+
+// whether the expression calls a function, which is evaluated by running it
+static
+bool calls_function(struct AST_Expression *expr) {
+	switch (expr->type) {
+		case LITERAL: case STRING: case IDENTIFIER:
+			return false;
+
+		case UNARY_OP:  return calls_function(expr->unary_op.rhs);
+		case BINARY_OP: return calls_function(expr->binary_op.lhs) || calls_function(expr->binary_op.rhs);
+		case TYPE_CAST: return calls_function(expr->type_cast.rhs);
+
 		case FUNC_CALL:
-			errx("function calls are not supported yet!");
+			return !expr->func_call.builtin || (expr->func_call.args && calls_function(expr->func_call.args));
+	}
+
+	return false;
+}
+
+// the value of a constant in a declaration or statement, functions it
+// calls run at compile time
+static
+bool evaluate(struct Parser *parser, struct Token *token, const char *what, struct AST_Expression *expr, uint32_t *value) {
+	char fault[CONSTANT_FAULT_SIZE];
+
+	if (expr->type == LITERAL) {
+		*value = expr->literal.value;
+		return true;
+	}
+
+	if (evaluate_constant(parser->types, expr, parser->callees, value, fault)) return true;
+
+	if (fault[0]) parser_error(parser, token, "%s is not a constant: %s.", what, fault);
+	else          parser_error(parser, token, "%s is not a constant.", what);
+	return false;
+}
+
+// `[length]`, a positive integer constant. the length is part of the
+// type, so it is evaluated even when no tree is kept, but for calls: no
+// bodies are kept to run then, and the length is taken as 1
+static
+uint32_t parse_length(struct Parser *parser) {
+	struct Token *token = chop_next(parser);
+	char buffer[1024];
+
+	bool syntax_only = parser->syntax_only;
+	parser->syntax_only = false;
+	struct AST_Expression *length = parse_expression(parser);
+	parser->syntax_only = syntax_only;
+
+	expect_next(parser, ']');
+	if (parser->errors) return 0;
+
+	struct ExpressionType type = expression_type(length);
+
+	if (!integer(type)) {
+		parser_error(parser, token, "Array length has type " WHITE "'%s'" RESET ", not an integer type.",
+		             print_type(parser->types, type.id, buffer, sizeof buffer));
+		return 0;
+	}
+
+	if (syntax_only && calls_function(length)) return 1;
+
+	uint32_t constant;
+	if (!evaluate(parser, token, "Array length", length, &constant)) return 0;
+
+	if (constant == 0 || (type.id == INT && (int32_t)constant < 0)) {
+		parser_error(parser, token, "Array length %d is not positive.", (int32_t)constant);
+		return 0;
+	}
+
+	return constant;
+}
+
+// `name[n][m]` is an array of n arrays of m
+static
+struct ExpressionType parse_dimensions(struct Parser *parser, struct ExpressionType type, struct Token *name) {
+	struct Vec lengths = vec(uint32_t);
+	char buffer[1024];
+
+	while (!parser->errors && next_is(parser, '[')) {
+		uint32_t length = parse_length(parser);
+		vec_push(&lengths, &length);
+	}
+
+	if (!parser->errors && lengths.length && (type.id == VOID || get_type(parser->types, type.id)->incomplete)) {
+		parser_error(parser, name, "Array `%s` has incomplete element type " WHITE "'%s'" RESET ".",
+		             name->text, print_type(parser->types, type.id, buffer, sizeof buffer));
+	}
+
+	for (int i = lengths.length - 1; i >= 0 && !parser->errors; i--) {
+		uint32_t length = ((uint32_t *)lengths.mem)[i];
+
+		if ((uint64_t)type_size(parser->types, type.id) * length > INT32_MAX) {
+			parser_error(parser, name, "Array `%s` is too large.", name->text);
 			break;
+		}
+
+		type.id = array_of(parser->types, type.id, length);
 	}
 
+	vec_free(&lengths);
 	return type;
 }
 
+// variables need the size of their type
+static
+void check_variable_type(struct Parser *parser, struct Token *name, const char *what, struct ExpressionType type) {
+	char buffer[1024];
+
+	if (type.id == VOID) {
+		parser_error(parser, name, "%s `%s` declared void.", what, name->text);
+	}
+
+	else if (get_type(parser->types, type.id)->incomplete) {
+		parser_error(parser, name, "%s `%s` has incomplete type " WHITE "'%s'" RESET ".",
+		             what, name->text, print_type(parser->types, type.id, buffer, sizeof buffer));
+	}
+}
+
+// syntax-only mode keeps no statements, parse_statement returns NULL
+static
+struct AST_Statement *emit_statement(struct Parser *parser, struct AST_Statement *statement) {
+	if (parser->syntax_only) return NULL;
+	return store_object(parser->allocator, statement, sizeof *statement);
+}
+
+static
+struct AST_Declaration *parse_variable(struct Parser *parser, struct ExpressionType type, struct Token *name) {
+	struct AST_Declaration declaration = {
+		.token = name,
+		.type = parse_dimensions(parser, type, name),
+	};
+
+	if (!parser->errors) check_variable_type(parser, name, "Variable", declaration.type);
+
+	struct AST_Declaration *decl = parser->syntax_only ? &declaration
+	                             : store_object(parser->allocator, &declaration, sizeof declaration);
+	parse_initialiser(parser, decl, false);
+
+	// declared after the initialiser, which still sees any shadowed name
+	if (!parser->errors) {
+		struct Symbol *symbol = declare(parser, decl, SYM_VARIABLE, true);
+
+		// nothing refers back to locals when no tree is kept
+		if (symbol && parser->syntax_only) symbol->declaration = NULL;
+	}
+
+	return parser->syntax_only ? NULL : decl;
+}
+
+static
+void parse_parameters(struct Parser *parser, struct AST_Declaration *decl) {
+	struct AST_Declaration *params[MAX_PARAMS];
+	int count = 0;
+
+	// scope only used to catch duplicate names
+	enter_scope(parser->scope);
+	expect_next(parser, '(');
+
+	// (void) is an empty parameter list
+	if (next_is_type(parser, KEYWORD_VOID) && peek_next2(parser)->type == PUNCTUATION
+	                                       && peek_next2(parser)->value == ')') {
+		chop_next(parser);
+	}
+
+	while (!parser->errors && !next_is(parser, ')')) {
+		if (count > 0) expect_next(parser, ',');
+
+		if (get_token_type(peek_next(parser)) != TYPE) {
+			parser_error(parser, NULL, "expected parameter type, got %s.", print_token(peek_next(parser)));
+			break;
+		}
+
+		if (count == MAX_PARAMS) {
+			parser_error(parser, NULL, "Function `%s` has more than %d parameters.", decl->token->text, MAX_PARAMS);
+			break;
+		}
+
+		struct AST_Declaration param = { .type = parse_type(parser) };
+		param.token = expect_identifier(parser);
+		if (parser->errors) break;
+
+		// aggregates are passed by pointer
+		if (next_is(parser, '[')) {
+			parser_error(parser, param.token, "Parameter `%s` cannot be an array.", param.token->text);
+			break;
+		}
+
+		if (aggregate(parser, param.type)) {
+			char buffer[1024];
+			parser_error(parser, param.token, "Parameter `%s` cannot have type " WHITE "'%s'" RESET ".",
+			             param.token->text, print_type(parser->types, param.type.id, buffer, sizeof buffer));
+			break;
+		}
+
+		check_variable_type(parser, param.token, "Parameter", param.type);
+
+		params[count] = store_object(parser->allocator, &param, sizeof param);
+		declare(parser, params[count++], SYM_VARIABLE, true);
+	}
+
+	expect_next(parser, ')');
+	exit_scope(parser->scope);
+
+	decl->param_count = count;
+	decl->params = store_object(parser->allocator, params, count * sizeof *params);
+}
+
+static
+struct AST_Statement *parse_block_body(struct Parser *parser);
+
+bool starts_aggregate(struct Token *tokens, int length) {
+	if (length > 0 && tokens[0].type == KEYWORD_SOA) return true;
+	if (length < 3 || (tokens[0].type != KEYWORD_STRUCT && tokens[0].type != KEYWORD_UNION)) return false;
+
+	return tokens[1].type == SYMBOL && tokens[2].type == PUNCTUATION &&
+	       (tokens[2].value == '{' || tokens[2].value == ';');
+}
+
+// `{ type name; ... }`, every field complete and named once
+static
+void parse_fields(struct Parser *parser, struct AST_Declaration *decl) {
+	struct Vec fields = vec(struct Field);
+	char buffer[1024];
+
+	expect_next(parser, '{');
+
+	while (!parser->errors && !next_is(parser, '}')) {
+		if (get_token_type(peek_next(parser)) != TYPE) {
+			parser_error(parser, NULL, "expected field type, got %s.", print_token(peek_next(parser)));
+			break;
+		}
+
+		struct ExpressionType type = parse_type(parser);
+		struct Token *name = expect_identifier(parser);
+		if (parser->errors) break;
+
+		type = parse_dimensions(parser, type, name);
+		expect_next(parser, ';');
+		if (parser->errors) break;
+
+		check_variable_type(parser, name, "Field", type);
+		struct Field field = { .token = name, .type = type.id };
+
+		for (int i = 0; i < fields.length; i++) {
+			if (strcmp(((struct Field *)fields.mem)[i].token->text, field.token->text) == 0) {
+				parser_error(parser, field.token, "Duplicate field `%s` in " WHITE "'%s'" RESET ".",
+				             field.token->text, print_type(parser->types, decl->type.id, buffer, sizeof buffer));
+			}
+		}
+
+		vec_push(&fields, &field);
+	}
+
+	expect_next(parser, '}');
+
+	if (!parser->errors && fields.length == 0) {
+		parser_error(parser, decl->token, WHITE "'%s'" RESET " has no fields.", print_type(parser->types, decl->type.id, buffer, sizeof buffer));
+	}
+
+	if (!parser->errors) define_aggregate(parser->types, decl->type.id, fields.mem, fields.length);
+	vec_free(&fields);
+}
+
+// `struct name { fields };`, or `struct name;` which only declares it. the
+// name is declared first, so that fields can point to the struct itself
+static
+struct AST_Declaration *parse_aggregate(struct Parser *parser) {
+	bool soa = next_is_type(parser, KEYWORD_SOA);
+	if (soa) chop_next(parser);
+
+	if (soa && !next_is_type(parser, KEYWORD_STRUCT)) {
+		parser_error(parser, NULL, "expected `struct` after `soa`, got %s.", print_token(peek_next(parser)));
+		return NULL;
+	}
+
+	enum TypeKind kind = chop_next(parser)->type == KEYWORD_STRUCT ? TYPE_STRUCT : TYPE_UNION;
+	struct Token *name = expect_identifier(parser);
+	if (parser->errors) return NULL;
+
+	struct AST_Declaration declaration = { .token = name, .aggregate = true };
+	struct Symbol *symbol = lookup_symbol(parser->scope, name->text, name->length);
+
+	// a later declaration of the same name is of the same type
+	if (symbol != NULL && symbol->kind == SYM_TYPE && symbol->depth == scope_depth(parser->scope) &&
+	    get_type(parser->types, symbol->type.id)->kind == kind && get_type(parser->types, symbol->type.id)->soa == soa) {
+		declaration.type = symbol->type;
+	} else {
+		declaration.type.id = declare_aggregate(parser->types, kind, name, soa);
+	}
+
+	struct AST_Declaration *decl = store_object(parser->allocator, &declaration, sizeof declaration);
+	decl->defined = next_is(parser, '{');
+
+	if (declare(parser, decl, SYM_TYPE, false) == NULL) return NULL;
+
+	if (decl->defined && !get_type(parser->types, decl->type.id)->incomplete) {
+		parser_error(parser, name, "Redefinition of `%s`.", name->text);
+		return NULL;
+	}
+
+	if (decl->defined) parse_fields(parser, decl);
+	expect_next(parser, ';');
+
+	return decl;
+}
+
+struct AST_Declaration *parse_prototype(struct Parser *parser) {
+	if (starts_aggregate(parser->tokens, parser->length)) return parse_aggregate(parser);
+
+	if (get_token_type(peek_next(parser)) != TYPE) {
+		parser_error(parser, NULL, "expected declaration, got %s.", print_token(peek_next(parser)));
+		return NULL;
+	}
+
+	struct AST_Declaration declaration = { .type = parse_type(parser) };
+	declaration.token = expect_identifier(parser);
+	if (parser->errors) return NULL;
+
+	declaration.type = parse_dimensions(parser, declaration.type, declaration.token);
+	if (parser->errors) return NULL;
+
+	struct AST_Declaration *decl = store_object(parser->allocator, &declaration, sizeof declaration);
+
+	if (next_is(parser, '(')) {
+		decl->function = true;
+
+		if (aggregate(parser, decl->type)) {
+			char buffer[1024];
+			parser_error(parser, decl->token, "Function `%s` cannot return " WHITE "'%s'" RESET ".",
+			             decl->token->text, print_type(parser->types, decl->type.id, buffer, sizeof buffer));
+		}
+
+		parse_parameters(parser, decl);
+	}
+
+	else check_variable_type(parser, decl->token, "Variable", decl->type);
+
+	decl->defined = !decl->function || next_is(parser, '{');
+	return decl;
+}
+
+void declare_signature(struct Parser *parser, struct AST_Declaration *decl) {
+	declare(parser, decl, decl->aggregate ? SYM_TYPE : decl->function ? SYM_FUNCTION : SYM_VARIABLE, decl->defined);
+}
+
+struct AST_Declaration *parse_signature(struct Parser *parser) {
+	struct AST_Declaration *decl = parse_prototype(parser);
+
+	// declared before the definition so that functions can recurse
+	if (decl != NULL) declare_signature(parser, decl);
+	return decl;
+}
+
+void parse_definition(struct Parser *parser, struct AST_Declaration *decl) {
+	// structs and unions are parsed whole by their signature
+	if (decl->aggregate) return;
+
+	if (!decl->function) {
+		parse_initialiser(parser, decl, true);
+		return;
+	}
+
+	if (next_is(parser, ';')) {
+		chop_next(parser);
+		return;
+	}
+
+	// parameters share the outermost block of the body
+	expect_next(parser, '{');
+	if (parser->errors) return;
+
+	enter_scope(parser->scope);
+
+	for (int i = 0; i < decl->param_count; i++) {
+		declare(parser, decl->params[i], SYM_VARIABLE, true);
+	}
+
+	parser->function = decl;
+
+	struct AST_Statement body = {
+		.type = STMT_BLOCK,
+		.token = decl->token,
+		.block = { parse_block_body(parser) },
+	};
+
+	decl->body = emit_statement(parser, &body);
+	parser->function = NULL;
+
+	exit_scope(parser->scope);
+}
+
+struct AST_Declaration *parse_declaration(struct Parser *parser) {
+	struct AST_Declaration *decl = parse_signature(parser);
+	if (decl != NULL && !parser->errors) parse_definition(parser, decl);
+
+	return decl;
+}
+
+
+// statements: `}` is consumed by parse_block_body
+static
+struct AST_Statement *parse_block_body(struct Parser *parser) {
+	struct AST_Statement *first = NULL;
+	struct AST_Statement **link = &first;
+
+	while (!parser->errors && !next_is(parser, '}') && !next_is_type(parser, TOK_EOF)) {
+		struct AST_Statement *statement = parse_statement(parser);
+		if (statement == NULL) continue;
+
+		*link = statement;
+		link = &statement->next;
+	}
+
+	expect_next(parser, '}');
+	return first;
+}
+
+// body of if/while/do gets its own block scope
+static
+struct AST_Statement *parse_substatement(struct Parser *parser) {
+	enter_scope(parser->scope);
+	struct AST_Statement *statement = parse_statement(parser);
+	exit_scope(parser->scope);
+
+	return statement;
+}
+
+// a case value while the body of its switch is parsed
+struct Case {
+	unsigned key; // the value, ordered as the condition's type
+	int label;
+	struct Token *token;
+};
+
+static
+int compare_cases(const void *a, const void *b) {
+	unsigned x = ((const struct Case *)a)->key, y = ((const struct Case *)b)->key;
+	return (x > y) - (x < y);
+}
+
+// `case value:` or `default:`, the values are kept unless no tree is
+static
+void parse_label(struct Parser *parser, struct AST_StmtSwitch *s, struct ExpressionType type, int label, struct Vec *cases) {
+	struct Token *token = chop_next(parser);
+	char buffer[1024];
+
+	if (token->type == KEYWORD_DEFAULT) {
+		if (s->otherwise >= 0) parser_error(parser, token, "Multiple default labels in one switch.");
+		s->otherwise = label;
+
+		expect_next(parser, ':');
+		return;
+	}
+
+	// kept even in syntax-only mode, so that labels are checked the same
+	bool syntax_only = parser->syntax_only;
+	parser->syntax_only = false;
+	struct AST_Expression *value = parse_expression(parser);
+	parser->syntax_only = syntax_only;
+
+	expect_next(parser, ':');
+	if (parser->errors) return;
+
+	struct ExpressionType value_type = expression_type(value);
+
+	if (value_type.id < U8 || value_type.id > INT) {
+		parser_error(parser, token, "Case value has type " WHITE "'%s'" RESET ", not an integer type.",
+		             print_type(parser->types, value_type.id, buffer, sizeof buffer));
+		return;
+	}
+
+	// no bodies are kept to run calls then
+	if (syntax_only && calls_function(value)) return;
+
+	uint32_t constant;
+	if (!evaluate(parser, token, "Case value", value, &constant)) return;
+
+	// narrow conditions are compared zero-extended
+	int size = type_size(parser->types, type.id);
+	if (size < 4 && constant >> 8 * size) {
+		parser_warning(parser, token, "Case value %d is out of range of " WHITE "'%s'" RESET " and never matches.",
+		               (int32_t)constant, print_type(parser->types, type.id, buffer, sizeof buffer));
+	}
+
+	struct Case c = {
+		.key = type.id == INT ? constant ^ 0x80000000u : constant,
+		.label = label,
+		.token = token,
+	};
+
+	vec_push(cases, &c);
+}
+
+// labels are only allowed at the top level of the body, so that every
+// backend lowers a switch as a dispatch followed by the body in order
+static
+void parse_switch(struct Parser *parser, struct AST_Statement *statement) {
+	struct AST_StmtSwitch *s = &statement->selection;
+	char buffer[1024];
+
+	s->condition = parse_condition(parser);
+	s->otherwise = -1;
+	if (parser->errors) return;
+
+	struct ExpressionType type = expression_type(s->condition);
+
+	if (type.id < U8 || type.id > INT) {
+		parser_error(parser, statement->token, "Switch condition has type " WHITE "'%s'" RESET ", not an integer type.",
+		             print_type(parser->types, type.id, buffer, sizeof buffer));
+		return;
+	}
+
+	struct Vec cases = vec(struct Case);
+	struct Vec labels = vec(struct AST_Statement *);
+	struct AST_Statement **link = &s->body;
+	bool warned = false;
+
+	expect_next(parser, '{');
+	enter_scope(parser->scope);
+	parser->loops++;
+
+	while (!parser->errors && !next_is(parser, '}') && !next_is_type(parser, TOK_EOF)) {
+		struct AST_Statement *next;
+
+		if (next_is_type(parser, KEYWORD_CASE) || next_is_type(parser, KEYWORD_DEFAULT)) {
+			struct AST_Statement label = {
+				.type = STMT_CASE,
+				.token = peek_next(parser),
+				.label = s->label_count++,
+			};
+
+			while (!parser->errors && (next_is_type(parser, KEYWORD_CASE) || next_is_type(parser, KEYWORD_DEFAULT))) {
+				parse_label(parser, s, type, label.label, &cases);
+			}
+
+			next = emit_statement(parser, &label);
+			vec_push(&labels, &next);
+		}
+
+		else {
+			if (s->label_count == 0 && !warned && get_token_type(peek_next(parser)) != TYPE) {
+				parser_warning(parser, peek_next(parser), "Statement before the first case label is never executed.");
+				warned = true;
+			}
+
+			next = parse_statement(parser);
+		}
+
+		if (next == NULL) continue;
+
+		*link = next;
+		link = &next->next;
+	}
+
+	expect_next(parser, '}');
+	parser->loops--;
+	exit_scope(parser->scope);
+
+	struct Case *sorted = cases.mem;
+	qsort(sorted, cases.length, sizeof *sorted, compare_cases);
+
+	for (int i = 1; i < cases.length && !parser->errors; i++) {
+		if (sorted[i].key != sorted[i - 1].key) continue;
+
+		// reported where it comes second
+		struct Token *token = sorted[i].token < sorted[i - 1].token ? sorted[i - 1].token : sorted[i].token;
+		uint32_t value = type.id == INT ? sorted[i].key ^ 0x80000000u : sorted[i].key;
+
+		if (type.id == INT) parser_error(parser, token, "Duplicate case value %d.", (int32_t)value);
+		else                parser_error(parser, token, "Duplicate case value %u.", value);
+	}
+
+	if (!parser->syntax_only && !parser->errors) {
+		s->case_count = cases.length;
+		s->cases = allocate_object(parser->allocator, max(cases.length, 1) * sizeof *s->cases);
+
+		for (int i = 0; i < cases.length; i++) {
+			s->cases[i] = (struct AST_SwitchCase) {
+				.value = type.id == INT ? sorted[i].key ^ 0x80000000u : sorted[i].key,
+				.label = sorted[i].label,
+			};
+		}
+
+		s->labels = allocate_object(parser->allocator, max(labels.length, 1) * sizeof *s->labels);
+		if (labels.length) memcpy(s->labels, labels.mem, labels.length * sizeof *s->labels);
+	}
+
+	vec_free(&cases);
+	vec_free(&labels);
+}
+
+struct AST_Statement *parse_statement(struct Parser *parser) {
+	struct Token *token = peek_next(parser);
+	struct AST_Statement statement = { .token = token };
+
+	if (get_token_type(token) == TYPE) {
+		statement.type = STMT_DECLARATION;
+
+		struct ExpressionType type = parse_type(parser);
+		struct Token *name = expect_identifier(parser);
+
+		if (name != NULL) {
+			statement.declaration = parse_variable(parser, type, name);
+		}
+	}
+
+	else switch (token->type) {
+		case KEYWORD_IF:
+			chop_next(parser);
+			statement.type = STMT_IF;
+			statement.conditional.condition = parse_condition(parser);
+			if (parser->errors) break;
+
+			statement.conditional.then = parse_substatement(parser);
+
+			if (next_is_type(parser, KEYWORD_ELSE)) {
+				chop_next(parser);
+				statement.conditional.otherwise = parse_substatement(parser);
+			}
+
+			break;
+
+		case KEYWORD_WHILE:
+			chop_next(parser);
+			statement.type = STMT_WHILE;
+			statement.loop.condition = parse_condition(parser);
+			if (parser->errors) break;
+
+			parser->loops++;
+			statement.loop.body = parse_substatement(parser);
+			parser->loops--;
+			break;
+
+		case KEYWORD_DO:
+			chop_next(parser);
+			statement.type = STMT_DO;
+
+			parser->loops++;
+			statement.loop.body = parse_substatement(parser);
+			parser->loops--;
+
+			if (!next_is_type(parser, KEYWORD_WHILE)) {
+				parser_error(parser, NULL, "expected `while` after do statement, got %s.", print_token(peek_next(parser)));
+				break;
+			}
+
+			chop_next(parser);
+			statement.loop.condition = parse_condition(parser);
+			expect_next(parser, ';');
+			break;
+
+		case KEYWORD_RETURN: {
+			chop_next(parser);
+			statement.type = STMT_RETURN;
+
+			struct AST_Declaration *function = parser->function;
+			assert(function != NULL);
+
+			bool returns_void = function->type.id == VOID;
+
+			if (!next_is(parser, ';')) {
+				statement.expression = parse_expression(parser);
+
+				if (returns_void && !parser->errors) {
+					parser_error(parser, token, "Returning a value from void function `%s`.", function->token->text);
+				} else if (!parser->errors) {
+					check_assignment(parser, token, function->type, expression_type(statement.expression));
+				}
+			}
+
+			else if (!returns_void) {
+				parser_warning(parser, token, "Non-void function `%s` should return a value.", function->token->text);
+			}
+
+			expect_next(parser, ';');
+			break;
+		}
+
+		case KEYWORD_SWITCH:
+			chop_next(parser);
+			statement.type = STMT_SWITCH;
+			parse_switch(parser, &statement);
+			break;
+
+		// parsed anyway, so that nothing else is reported
+		case KEYWORD_CASE:
+		case KEYWORD_DEFAULT:
+			chop_next(parser);
+			parser_error(parser, token, "%s label not directly within a switch.", token->type == KEYWORD_CASE ? "case" : "default");
+
+			if (token->type == KEYWORD_CASE) parse_expression(parser);
+			expect_next(parser, ':');
+			return NULL;
+
+		case KEYWORD_BREAK:
+			chop_next(parser);
+			statement.type = STMT_BREAK;
+
+			if (parser->loops == 0) {
+				parser_error(parser, token, "break statement not within loop or switch.");
+			}
+
+			expect_next(parser, ';');
+			break;
+
+		case PUNCTUATION:
+			if (token->value == '{') {
+				chop_next(parser);
+				statement.type = STMT_BLOCK;
+
+				enter_scope(parser->scope);
+				statement.block.body = parse_block_body(parser);
+				exit_scope(parser->scope);
+				break;
+			}
+
+			// fallthrough
+		default:
+			statement.type = STMT_EXPRESSION;
+			statement.expression = parse_expression(parser);
+			expect_next(parser, ';');
+			break;
+	}
+
+	return emit_statement(parser, &statement);
+}
+
 
 const char *print_token(struct Token *token) {
 	switch (token->type) {
@@ -691,10 +2326,17 @@ const char *print_token(struct Token *token) {
 				case OR:    return "`||`";
 				case COM:   return "`::`";
 
+				// single characters, indexed by value
 				default: {
-					static char buffer[4] = "` `";
-					buffer[1] = token->value;
-					return buffer;
+					static const char quoted[128][4] = {
+						['!'] = "`!`", ['#'] = "`#`", ['%'] = "`%`", ['&'] = "`&`", ['('] = "`(`",
+						[')'] = "`)`", ['*'] = "`*`", ['+'] = "`+`", [','] = "`,`", ['-'] = "`-`",
+						['.'] = "`.`", ['/'] = "`/`", [':'] = "`:`", [';'] = "`;`", ['<'] = "`<`",
+						['='] = "`=`", ['>'] = "`>`", ['?'] = "`?`", ['['] = "`[`", [']'] = "`]`",
+						['^'] = "`^`", ['{'] = "`{`", ['|'] = "`|`", ['}'] = "`}`", ['~'] = "`~`",
+					};
+
+					return token->value < 128 && quoted[token->value][0] ? quoted[token->value] : "punctuation";
 				}
 			}
 
@@ -704,58 +2346,52 @@ const char *print_token(struct Token *token) {
 }
 
 
-const char *print_type(struct ExpressionType type, char *buffer) {
-	const char *T = NULL;
-	int L = 0;
-
-	switch (type.type) {
-		case VOID: T = "void"; L = 4; break;
-		case U8:   T = "u8";   L = 2; break;
-		case U16:  T = "u16";  L = 3; break;
-		case U32:  T = "u32";  L = 3; break;
-		case INT:  T = "int";  L = 3; break;
+// diagnostics go to stdout, or to the parser's buffer when compiling in parallel
+static
+void vemit(struct Parser *parser, const char *fmt, va_list args) {
+	if (parser->diagnostics == NULL) {
+		vprintf(fmt, args);
+		return;
 	}
 
-	assert(T && L && "unreachable");
-
-	char *write = buffer;
-	strncpy(write, T, L + 1);
-	write += L;
+	char buffer[1024];
+	int length = vsnprintf(buffer, sizeof buffer, fmt, args);
 
-	if (type.pointers)
-		*write++ = ' ';
-
-	while (type.pointers --> 0)
-		*write++ = '*';
+	vec_append(parser->diagnostics, buffer, min(length, sizeof buffer - 1));
+}
 
-	*write++ = 0;
-	return buffer;
+static PRINTF(2,3)
+void emit(struct Parser *parser, const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	vemit(parser, fmt, args);
+	va_end(args);
 }
 
 void parser_error(struct Parser *parser, struct Token *token, const char *fmt, ...) {
 	if (token == NULL) token = parser->tokens;
-	printf(WHITE "%s:%d:%d: " RED "error: " RESET, token->filename, token->line, token->col);
+	emit(parser, WHITE "%s:%d:%d: " RED "error: " RESET, token->filename, token->line, token->col);
 
 	va_list args;
 	va_start(args, fmt);
 
-	vprintf(fmt, args);
+	vemit(parser, fmt, args);
 	va_end(args);
 
-	putchar('\n');
+	emit(parser, "\n");
 	parser->errors++;
 }
 
 
 void parser_warning(struct Parser *parser, struct Token *token, const char *fmt, ...) {
 	if (token == NULL) token = parser->tokens;
-	printf(WHITE "%s:%d:%d: " MAGENTA "warning: " RESET, token->filename, token->line, token->col);
+	emit(parser, WHITE "%s:%d:%d: " MAGENTA "warning: " RESET, token->filename, token->line, token->col);
 
 	va_list args;
 	va_start(args, fmt);
 
-	vprintf(fmt, args);
+	vemit(parser, fmt, args);
 	va_end(args);
 
-	putchar('\n');
+	emit(parser, "\n");
 }
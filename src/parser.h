@@ -3,9 +3,26 @@
 
 #include "allocator.h"
 #include "ast.h"
+#include "scope.h"
 #include "tokens.h"
+#include "types.h"
+#include "util.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+
+enum {
+	MAX_EXPRESSION_DEPTH = 256,
+	MAX_PARAMS = 64,
+};
+
+// the functions constant expressions may call: `definition` gives the
+// definition of a function once its body is complete, NULL before, and may
+// wait for it to be parsed
+struct Callees {
+	struct AST_Declaration *(*definition)(void *context, struct AST_Declaration *);
+	void *context;
+};
 
 struct Parser {
 	struct Token *tokens;
@@ -13,9 +30,59 @@ struct Parser {
 
 	struct Allocator *allocator;
 	int errors;
+
+	struct Scope *scope;
+	struct TypeTable *types;
+	struct AST_Declaration *function; // function being parsed, NULL at file scope
+	int loops; // nesting depth of breakable statements
+
+	struct Vec *diagnostics;  // buffered messages (chars), NULL prints directly
+	struct Vec *dependencies; // hashes of file scope names used (unsigned), or NULL
+	struct Callees *callees;  // NULL takes the bodies declarations have
+
+	// syntax-only mode: nodes are type checked as soon as they are built and
+	// kept in `scratch`, one slot per level of nesting, so no tree is stored.
+	// nodes nested deeper than the slots are stored in the arena
+	bool syntax_only;
+	struct AST_Expression *scratch; // MAX_EXPRESSION_DEPTH nodes
+	int depth;
+
+	// the types of the arguments of the innermost call being parsed, taken
+	// as the `,` at the depth of its argument list are built
+	struct ExpressionType *arguments; // MAX_PARAMS types
+	int argument_count, argument_depth;
 };
 
 struct AST_Expression *parse_expression(struct Parser *);
-//struct DeclNode *parse_declaration(struct Parser *);
+struct ExpressionType expression_type(struct AST_Expression *);
+
+// the arguments of a call are one `,` expression: stores up to MAX_PARAMS
+// of them in order and returns how many there are
+int call_arguments(struct AST_Expression *args, struct AST_Expression **out);
+
+// a builtin on integers applied to constants, for an operand type of `bits`
+// bits. the count only matters to rotate
+uint32_t evaluate_builtin(enum Builtin, int bits, uint32_t value, uint32_t count);
+
+struct AST_Statement *parse_statement(struct Parser *);
+struct AST_Declaration *parse_declaration(struct Parser *);
+
+// file scope declarations in two steps: parse_signature declares the name
+// and stops before the initialiser or body, parse_definition parses it.
+// parse_signature is parse_prototype followed by declare_signature
+struct AST_Declaration *parse_signature(struct Parser *);
+void parse_definition(struct Parser *, struct AST_Declaration *);
+
+struct AST_Declaration *parse_prototype(struct Parser *);
+void declare_signature(struct Parser *, struct AST_Declaration *);
+
+// struct and union declarations are whole signatures, from the optional
+// soa up to and including their `;`
+bool starts_aggregate(struct Token *, int length);
+
+void parser_error(struct Parser *parser, struct Token *, const char *fmt, ...) PRINTF(3,4);
+void parser_warning(struct Parser *parser, struct Token *, const char *fmt, ...) PRINTF(3,4);
+
+const char *print_token(struct Token *);
 
 #endif //PARSER_H_
@@ -0,0 +1,412 @@
+#include "pch.h"
+
+#include "allocator.h"
+#include "macro.h"
+#include "preproc.h"
+#include "tokens.h"
+#include "util.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// string section: every distinct text is written once
+
+struct InternedString {
+	uint32_t offset;
+	int length;
+	unsigned key;
+};
+
+struct Strings {
+	struct Vec data;    // chars
+	struct Vec entries; // struct InternedString
+	int *index;         // open addressing: index + 1, 0 if empty
+	int capacity;
+};
+
+static
+void grow_strings(struct Strings *strings) {
+	strings->capacity = max(256, strings->capacity * 2);
+	free(strings->index);
+
+	strings->index = calloc(strings->capacity, sizeof *strings->index);
+	if (!strings->index) errx("out of memory: failed to allocate %d slots", strings->capacity);
+
+	struct InternedString *entries = strings->entries.mem;
+
+	for (int i = 0; i < strings->entries.length; i++) {
+		unsigned slot = entries[i].key;
+		while (strings->index[slot & (strings->capacity - 1)]) slot++;
+		strings->index[slot & (strings->capacity - 1)] = i + 1;
+	}
+}
+
+static
+uint32_t intern(struct Strings *strings, const char *text, int length) {
+	if (text == NULL) return 0;
+
+	if (2 * (strings->entries.length + 1) > strings->capacity) {
+		grow_strings(strings);
+	}
+
+	struct InternedString *entries = strings->entries.mem;
+	unsigned key = hash(text, length);
+	unsigned i = key;
+
+	for (;; i++) {
+		int slot = strings->index[i & (strings->capacity - 1)];
+		if (slot == 0) break;
+
+		struct InternedString *entry = &entries[slot - 1];
+		const char *data = (const char *)strings->data.mem + entry->offset;
+
+		if (entry->key == key && entry->length == length && memcmp(data, text, length) == 0) {
+			return entry->offset;
+		}
+	}
+
+	struct InternedString entry = { strings->data.length, length, key };
+	vec_append(&strings->data, text, length);
+	vec_append(&strings->data, "", 1);
+
+	vec_push(&strings->entries, &entry);
+	strings->index[i & (strings->capacity - 1)] = strings->entries.length;
+	return entry.offset;
+}
+
+static
+bool has_text(enum TokenType type) {
+	return type == SYMBOL || type == STRING_LITERAL;
+}
+
+// tokens refer to the name of the file they come from
+static
+int file_of(struct Preprocessor *pp, const char *filename, int *last) {
+	struct SourceFile **files = pp->files.mem;
+	if (filename == NULL) return 0;
+
+	if (*last < pp->files.length && files[*last]->name == filename) return *last + 1;
+
+	for (int i = 0; i < pp->files.length; i++) {
+		if (files[i]->name == filename) {
+			*last = i;
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+static
+struct PchToken pack_token(struct Preprocessor *pp, struct Strings *strings, struct Token *token, int *last) {
+	bool text = has_text(token->type);
+
+	return (struct PchToken) {
+		.type = token->type,
+		.is_char = text ? 0 : token->is_char,
+		.file = file_of(pp, token->filename, last),
+		.value = text ? (uint32_t)token->length : token->value,
+		.text = text ? intern(strings, token->text, token->length) : 0,
+		.line = token->line,
+		.col = token->col,
+	};
+}
+
+static
+struct Token unpack_token(const struct PchToken *record, const char *strings, const char **names) {
+	struct Token token = {
+		.type = record->type,
+		.filename = record->file ? names[record->file - 1] : NULL,
+		.line = record->line,
+		.col = record->col,
+	};
+
+	if (has_text(token.type)) {
+		token.length = record->value;
+		token.text = strings + record->text;
+	} else {
+		token.value = record->value;
+		token.is_char = record->is_char;
+	}
+
+	return token;
+}
+
+void write_pch(const char *path, struct Preprocessor *pp, struct Token *tokens, int count) {
+	struct Strings strings = { .data = vec(char), .entries = vec(struct InternedString) };
+	vec_append(&strings.data, "", 1);
+
+	if (pp->files.length > UINT16_MAX) {
+		errx("too many files for a precompiled header (limit is %d)", UINT16_MAX);
+	}
+
+	struct Vec files = vec(struct PchFile);
+	struct SourceFile **sources = pp->files.mem;
+
+	for (int i = 0; i < pp->files.length; i++) {
+		struct SourceFile *file = sources[i];
+
+		struct PchFile record = {
+			.path = intern(&strings, file->path, strlen(file->path)),
+			.name = intern(&strings, file->name, strlen(file->name)),
+			.size = file->size,
+			.digest = hash(file->source, file->size),
+			.lines = file->lines,
+			.guard = intern(&strings, file->guard, file->guard_length),
+			.once = file->once,
+		};
+
+		vec_push(&files, &record);
+	}
+
+	struct Vec macros = vec(struct PchMacro);
+	struct Vec bodies = vec(struct PchToken);
+	struct Vec parameters = vec(uint16_t);
+	struct Macro *defined = pp->macros.mem;
+	int last = 0;
+
+	for (int i = 0; i < pp->macros.length; i++) {
+		struct Macro *macro = &defined[i];
+
+		struct PchMacro record = {
+			.name = intern(&strings, macro->name, macro->length),
+			.length = macro->length,
+			.function = macro->function,
+			.param_count = macro->param_count,
+			.body = bodies.length,
+			.body_length = macro->body_length,
+		};
+
+		for (int j = 0; j < macro->body_length; j++) {
+			struct PchToken token = pack_token(pp, &strings, &macro->body[j], &last);
+			uint16_t parameter = macro->function ? macro->parameters[j] : 0;
+
+			vec_push(&bodies, &token);
+			vec_push(&parameters, &parameter);
+		}
+
+		vec_push(&macros, &record);
+	}
+
+	struct PchToken *records = malloc((count + 1) * sizeof *records);
+	if (!records) errx("out of memory: failed to allocate %d tokens", count);
+
+	for (int i = 0; i < count; i++) {
+		records[i] = pack_token(pp, &strings, &tokens[i], &last);
+	}
+
+	// the string section goes last, every other record is 4-byte aligned
+	struct PchHeader header = {
+		.version = PCH_VERSION,
+		.file_count = files.length,
+		.macro_count = macros.length,
+		.token_count = count,
+		.body_count = bodies.length,
+		.strings_size = strings.data.length,
+	};
+
+	memcpy(header.magic, PCH_MAGIC, sizeof header.magic);
+
+	header.files = sizeof header;
+	header.macros = header.files + files.length * sizeof(struct PchFile);
+	header.tokens = header.macros + macros.length * sizeof(struct PchMacro);
+	header.bodies = header.tokens + count * sizeof(struct PchToken);
+	header.parameters = header.bodies + bodies.length * sizeof(struct PchToken);
+	header.strings = header.parameters + parameters.length * sizeof(uint16_t);
+	header.size = header.strings + header.strings_size;
+
+	FILE *file = fopen(path, "wb");
+	if (!file) errx("cannot open `%s` for writing", path);
+
+	bool written =
+		fwrite(&header, sizeof header, 1, file) == 1 &&
+		fwrite(files.mem, sizeof(struct PchFile), files.length, file) == (size_t)files.length &&
+		fwrite(macros.mem, sizeof(struct PchMacro), macros.length, file) == (size_t)macros.length &&
+		fwrite(records, sizeof *records, count, file) == (size_t)count &&
+		fwrite(bodies.mem, sizeof(struct PchToken), bodies.length, file) == (size_t)bodies.length &&
+		fwrite(parameters.mem, sizeof(uint16_t), parameters.length, file) == (size_t)parameters.length &&
+		fwrite(strings.data.mem, 1, strings.data.length, file) == (size_t)strings.data.length;
+
+	if (fclose(file) != 0 || !written) {
+		errx("failed to write precompiled header `%s`", path);
+	}
+
+	free(records);
+	free(strings.index);
+	vec_free(&strings.data);
+	vec_free(&strings.entries);
+	vec_free(&files);
+	vec_free(&macros);
+	vec_free(&bodies);
+	vec_free(&parameters);
+}
+
+static
+bool fits(const struct PchHeader *header, uint32_t offset, uint32_t count, uint32_t size) {
+	return offset <= header->size && count <= (header->size - offset) / size;
+}
+
+// a string of the string section, `length` bytes of it for texts that
+// have one. the section ends the file, which ends with a NUL
+static
+bool is_string(const struct PchHeader *header, uint32_t offset, uint32_t length) {
+	return offset < header->strings_size && length < header->strings_size - offset;
+}
+
+// as the lexer makes them: the value of punctuation is a printable character
+// or a lexed enum MultiChar, other tokens but literals have none
+static
+bool is_valid_value(const struct PchToken *record) {
+	if (has_text(record->type) || record->type == INT_LITERAL) return true;
+	if (record->type != PUNCTUATION) return record->value == 0;
+
+	switch (record->value) {
+		case INC: case DEC: case SHL: case SHR: case EQ: case NEQ:
+		case LEQ: case GEQ: case AND: case OR: case COM:
+			return true;
+	}
+
+	return record->value > ' ' && record->value < 127;
+}
+
+static
+bool is_valid(const struct PchHeader *header, const struct PchToken *record) {
+	return record->type < NONE && record->file <= header->file_count && is_valid_value(record) &&
+	       is_string(header, record->text, has_text(record->type) ? record->value : 0);
+}
+
+const struct PchHeader *load_pch(const char *path, struct Preprocessor *pp, struct Vec *tokens) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) errx("file `%s` not found", path);
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(struct PchHeader)) {
+		errx("`%s` is not a precompiled header", path);
+	}
+
+	const struct PchHeader *header = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (header == MAP_FAILED) errx("cannot map `%s`", path);
+
+	if (memcmp(header->magic, PCH_MAGIC, sizeof header->magic) != 0 ||
+	    header->size != (size_t)info.st_size) {
+		errx("`%s` is not a precompiled header", path);
+	}
+
+	if (header->version != PCH_VERSION) {
+		errx("`%s` is a version %u precompiled header, expected version %d", path, header->version, PCH_VERSION);
+	}
+
+	if (!fits(header, header->files, header->file_count, sizeof(struct PchFile)) ||
+	    !fits(header, header->macros, header->macro_count, sizeof(struct PchMacro)) ||
+	    !fits(header, header->tokens, header->token_count, sizeof(struct PchToken)) ||
+	    !fits(header, header->bodies, header->body_count, sizeof(struct PchToken)) ||
+	    !fits(header, header->parameters, header->body_count, sizeof(uint16_t)) ||
+	    !fits(header, header->strings, header->strings_size, 1) ||
+	    header->strings_size == 0 || ((const char *)header)[header->size - 1] != 0) {
+		errx("precompiled header `%s` is corrupted", path);
+	}
+
+	const char *base = (const char *)header;
+	const char *strings = base + header->strings;
+
+	// every input must be unchanged, its contents are kept for later includes
+	const struct PchFile *files = (const void *)(base + header->files);
+	const char **names = malloc((header->file_count + 1) * sizeof *names);
+	if (!names) errx("out of memory: failed to allocate %u files", header->file_count);
+
+	for (uint32_t i = 0; i < header->file_count; i++) {
+		const struct PchFile *record = &files[i];
+
+		if (!is_string(header, record->path, 0) || !is_string(header, record->name, 0) ||
+		    !is_string(header, record->guard, 0)) {
+			errx("precompiled header `%s` is corrupted", path);
+		}
+
+		struct SourceFile *file = find_file(pp, strings + record->path, NULL);
+
+		if (!file || !read_source(file) || (uint32_t)file->size != record->size ||
+		    hash(file->source, file->size) != record->digest) {
+			errx("precompiled header `%s` is out of date: `%s` has changed", path, strings + record->name);
+		}
+
+		file->name = strings + record->name;
+		file->lines = record->lines;
+		file->once = record->once;
+		file->processed = true;
+
+		if (record->guard) {
+			file->guard = strings + record->guard;
+			file->guard_length = strlen(file->guard);
+		}
+
+		names[i] = file->name;
+	}
+
+	const struct PchMacro *macros = (const void *)(base + header->macros);
+
+	const struct PchToken *bodies = (const void *)(base + header->bodies);
+	const uint16_t *parameters = (const void *)(base + header->parameters);
+
+	// bodies are rebuilt in the arena, the expander needs struct Token
+	for (uint32_t i = 0; i < header->macro_count; i++) {
+		const struct PchMacro *record = &macros[i];
+
+		if (record->body > header->body_count || (uint32_t)record->body_length > header->body_count - record->body ||
+		    record->length < 0 || !is_string(header, record->name, record->length) ||
+		    record->param_count > (record->function ? MAX_MACRO_PARAMETERS : 0)) {
+			errx("precompiled header `%s` is corrupted", path);
+		}
+
+		struct Macro macro = {
+			.name = strings + record->name,
+			.length = record->length,
+			.function = record->function,
+			.param_count = record->param_count,
+			.body_length = record->body_length,
+		};
+
+		// in the arena directly, a body may be as long as the file allows
+		if (macro.body_length) {
+			macro.body = allocate_object(pp->allocator, macro.body_length * sizeof *macro.body);
+			if (macro.function) macro.parameters = allocate_object(pp->allocator, macro.body_length * sizeof *macro.parameters);
+
+			for (int j = 0; j < macro.body_length; j++) {
+				uint16_t parameter = parameters[record->body + j];
+
+				// an index + 1 into the arguments of an invocation, which has param_count
+				if (!is_valid(header, &bodies[record->body + j]) || parameter > macro.param_count ||
+				    (parameter && !macro.function)) {
+					errx("precompiled header `%s` is corrupted", path);
+				}
+
+				macro.body[j] = unpack_token(&bodies[record->body + j], strings, names);
+				if (macro.function) macro.parameters[j] = parameter;
+			}
+		}
+
+		define_macro(pp, &macro);
+	}
+
+	const struct PchToken *records = (const void *)(base + header->tokens);
+
+	for (uint32_t i = 0; i < header->token_count; i++) {
+		if (!is_valid(header, &records[i])) errx("precompiled header `%s` is corrupted", path);
+
+		struct Token token = unpack_token(&records[i], strings, names);
+		vec_push(tokens, &token);
+	}
+
+	free(names);
+	return header;
+}
+
+void unmap_pch(const struct PchHeader *header) {
+	munmap((void *)header, header->size);
+}
@@ -0,0 +1,84 @@
+#ifndef PCH_H_
+#define PCH_H_
+
+#include "preproc.h"
+#include "tokens.h"
+#include "util.h"
+
+#include <stdint.h>
+
+// precompiled headers:
+//
+// the tokens of a header and the preprocessor state after it (macros with
+// their bodies, and every file it read with its include guard) written as
+// one block that is mapped read-only. token text and file names are
+// offsets into a section of interned strings, so loading rebuilds each
+// struct Token with pointers into the mapping and copies no strings. every
+// file is recorded with its size and a hash of its contents, a snapshot is
+// rejected if any changed.
+//
+// bump PCH_VERSION whenever a record changes
+//
+
+#define PCH_MAGIC "UCPH"
+
+enum {
+	PCH_VERSION = 5,
+};
+
+// sections are offsets from the start of the file
+struct PchHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t size; // of the whole snapshot, in bytes
+
+	uint32_t file_count;
+	uint32_t files;  // struct PchFile[file_count], the header first
+	uint32_t macro_count;
+	uint32_t macros; // struct PchMacro[macro_count]
+	uint32_t token_count;
+	uint32_t tokens; // struct PchToken[token_count]
+	uint32_t body_count;
+	uint32_t bodies;     // struct PchToken[body_count], of every macro
+	uint32_t parameters; // uint16_t[body_count]
+	uint32_t strings, strings_size; // NUL-terminated, offset 0 is none
+};
+
+struct PchFile {
+	uint32_t path; // canonical
+	uint32_t name;
+	uint32_t size, digest;
+	int32_t lines;
+	uint32_t guard; // include guard macro
+	uint8_t once;
+	uint8_t reserved[3];
+};
+
+struct PchMacro {
+	uint32_t name;
+	int32_t length;
+	uint8_t function;
+	uint8_t param_count;
+	uint16_t reserved;
+	uint32_t body; // first of body_length in bodies
+	int32_t body_length;
+};
+
+struct PchToken {
+	uint8_t type; // enum TokenType
+	uint8_t is_char;
+	uint16_t file; // index + 1, 0 for none
+	uint32_t value; // or length of the text
+	uint32_t text;
+	int32_t line, col;
+};
+
+// writes `count` tokens and the state of the preprocessor that lexed them
+void write_pch(const char *path, struct Preprocessor *, struct Token *tokens, int count);
+
+// maps a snapshot, restores its preprocessor state and appends its tokens,
+// which point into the mapping until unmap_pch. errors are fatal
+const struct PchHeader *load_pch(const char *path, struct Preprocessor *, struct Vec *tokens);
+void unmap_pch(const struct PchHeader *);
+
+#endif //PCH_H_
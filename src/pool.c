@@ -0,0 +1,88 @@
+#include "pool.h"
+#include "util.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+struct Pool {
+	void (*task)(void *, int, int);
+	void *context;
+
+	int jobs;
+	atomic_int next;
+};
+
+struct Worker {
+	struct Pool *pool;
+	int index;
+};
+
+static
+void *run_worker(void *argument) {
+	struct Worker *worker = argument;
+	struct Pool *pool = worker->pool;
+
+	for (int job; (job = atomic_fetch_add(&pool->next, 1)) < pool->jobs;) {
+		pool->task(pool->context, job, worker->index);
+	}
+
+	return NULL;
+}
+
+enum {
+	MAX_THREADS = 256,
+	MIN_STACK = 8 << 20,
+};
+
+// workers recurse as deep as the calling thread does, give them its stack
+// size. glibc falls back to 2MB when the limit is unlimited
+static
+size_t stack_size() {
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_STACK, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) return MIN_STACK;
+	return limit.rlim_cur > MIN_STACK ? limit.rlim_cur : MIN_STACK;
+}
+
+void parallel_for(int threads, int jobs, void (*task)(void *, int, int), void *context) {
+	struct Pool pool = {
+		.task = task,
+		.context = context,
+		.jobs = jobs,
+	};
+
+	atomic_init(&pool.next, 0);
+
+	threads = max(1, min(min(threads, jobs), MAX_THREADS));
+
+	pthread_t handles[MAX_THREADS];
+	struct Worker workers[MAX_THREADS];
+
+	// the calling thread is worker 0
+	for (int i = 0; i < threads; i++) {
+		workers[i] = (struct Worker) { &pool, i };
+	}
+
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	pthread_attr_setstacksize(&attributes, stack_size());
+
+	for (int i = 1; i < threads; i++) {
+		if (pthread_create(&handles[i], &attributes, run_worker, &workers[i]) != 0)
+			errx("failed to create thread");
+	}
+
+	pthread_attr_destroy(&attributes);
+
+	run_worker(&workers[0]);
+
+	for (int i = 1; i < threads; i++) {
+		pthread_join(handles[i], NULL);
+	}
+}
+
+int cpu_count() {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? count : 1;
+}
@@ -0,0 +1,11 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+// run task(context, job, worker) for every job in [0, jobs) on up to
+// `threads` threads, jobs are handed out in order from a shared counter
+void parallel_for(int threads, int jobs, void (*task)(void *context, int job, int worker), void *context);
+
+// number of online processors, at least 1
+int cpu_count();
+
+#endif //POOL_H_
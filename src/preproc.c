@@ -0,0 +1,802 @@
+#include "preproc.h"
+
+#include "allocator.h"
+#include "ast.h"
+#include "lexer.h"
+#include "macro.h"
+#include "parser.h"
+#include "scope.h"
+#include "tokens.h"
+#include "util.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// include guards are recognised while a file is first processed
+enum GuardState {
+	GUARD_START,  // nothing seen yet
+	GUARD_INSIDE, // in the `#if !defined X` that opened the file
+	GUARD_CLOSED, // after its #endif
+	GUARD_NONE,
+};
+
+struct Source {
+	struct SourceFile *file;
+	struct Lexer lexer;
+	int conditions; // depth of the condition stack when the file started
+
+	enum GuardState guard;
+	const char *guard_name;
+	int guard_length, guard_level;
+
+	bool pure; // no directives but the guard and #pragma once
+};
+
+
+// open addressing over a vector: slots hold index + 1, 0 if empty
+
+static
+void rehash(int **index, int *capacity, struct Vec *entries, unsigned (*key_of)(void *)) {
+	*capacity = max(16, *capacity * 2);
+	free(*index);
+
+	*index = calloc(*capacity, sizeof **index);
+	if (!*index) errx("out of memory: failed to allocate %d slots", *capacity);
+
+	for (int i = 0; i < entries->length; i++) {
+		unsigned slot = key_of((char *)entries->mem + i * entries->elem_size);
+		while ((*index)[slot & (*capacity - 1)]) slot++;
+		(*index)[slot & (*capacity - 1)] = i + 1;
+	}
+}
+
+static
+unsigned file_key(void *entry) { return (*(struct SourceFile **)entry)->hash; }
+
+static
+unsigned macro_key(void *entry) { return ((struct Macro *)entry)->hash; }
+
+static
+int *probe_file(struct Preprocessor *pp, const char *path, unsigned key) {
+	struct SourceFile **files = pp->files.mem;
+
+	for (unsigned i = key;; i++) {
+		int *slot = &pp->file_index[i & (pp->file_capacity - 1)];
+		if (*slot == 0) return slot;
+
+		struct SourceFile *file = files[*slot - 1];
+		if (file->hash == key && strcmp(file->path, path) == 0) return slot;
+	}
+}
+
+static
+int *probe_macro(struct Preprocessor *pp, const char *name, int length, unsigned key) {
+	struct Macro *macros = pp->macros.mem;
+
+	for (unsigned i = key;; i++) {
+		int *slot = &pp->macro_index[i & (pp->macro_capacity - 1)];
+		if (*slot == 0) return slot;
+
+		struct Macro *macro = &macros[*slot - 1];
+		if (macro->hash == key && macro->length == length && memcmp(macro->name, name, length) == 0)
+			return slot;
+	}
+}
+
+struct Macro *lookup_macro(struct Preprocessor *pp, const char *name, int length) {
+	int *slot = probe_macro(pp, name, length, hash(name, length));
+	return *slot ? (struct Macro *)pp->macros.mem + *slot - 1 : NULL;
+}
+
+void define_macro(struct Preprocessor *pp, struct Macro *macro) {
+	if (2 * (pp->macros.length + 1) > pp->macro_capacity) {
+		rehash(&pp->macro_index, &pp->macro_capacity, &pp->macros, macro_key);
+	}
+
+	macro->hash = hash(macro->name, macro->length);
+	int *slot = probe_macro(pp, macro->name, macro->length, macro->hash);
+
+	// kept expansions may refer to the old definition, or to none
+	pp->generation++;
+
+	if (*slot) {
+		((struct Macro *)pp->macros.mem)[*slot - 1] = *macro;
+		return;
+	}
+
+	vec_push(&pp->macros, macro);
+	*slot = pp->macros.length;
+}
+
+
+// files
+
+static
+char *read_file(const char *path, int *size) {
+	FILE *file = fopen(path, "rb");
+	if (!file) return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	// directories open too, their length is nonsense
+	if (length < 0 || length >= INT_MAX) {
+		fclose(file);
+		return NULL;
+	}
+
+	char *source = malloc(length + 1);
+	if (!source) errx("out of memory: failed to allocate %ld bytes", length + 1);
+
+	*size = fread(source, 1, length, file);
+	source[*size] = 0;
+
+	fclose(file);
+	return source;
+}
+
+bool read_source(struct SourceFile *file) {
+	if (file->source == NULL) file->source = read_file(file->path, &file->size);
+	return file->source != NULL;
+}
+
+struct SourceFile *find_file(struct Preprocessor *pp, const char *path, struct SourceFile *from) {
+	char joined[PATH_MAX], canonical[PATH_MAX];
+	const char *slash = from ? strrchr(from->name, '/') : NULL;
+
+	if (slash && path[0] != '/') {
+		snprintf(joined, sizeof joined, "%.*s/%s", (int)(slash - from->name), from->name, path);
+	} else {
+		snprintf(joined, sizeof joined, "%s", path);
+	}
+
+	if (!realpath(joined, canonical)) return NULL;
+
+	if (2 * (pp->files.length + 1) > pp->file_capacity) {
+		rehash(&pp->file_index, &pp->file_capacity, &pp->files, file_key);
+	}
+
+	unsigned key = hash(canonical, strlen(canonical));
+	int *slot = probe_file(pp, canonical, key);
+
+	if (*slot) return ((struct SourceFile **)pp->files.mem)[*slot - 1];
+
+	struct SourceFile *file = calloc(1, sizeof *file);
+	if (!file) errx("out of memory: failed to allocate source file");
+
+	file->path = store_string(pp->allocator, canonical, strlen(canonical));
+	file->name = store_string(pp->allocator, joined, strlen(joined));
+	file->hash = key;
+
+	vec_push(&pp->files, &file);
+	*slot = pp->files.length;
+	return file;
+}
+
+
+// conditionals
+
+static
+bool is_active(struct Preprocessor *pp) {
+	return pp->conditions.length == 0 ||
+	       ((struct Condition *)pp->conditions.mem)[pp->conditions.length - 1].active;
+}
+
+static
+bool is_punctuation(struct Token *token, unsigned value) {
+	return token->type == PUNCTUATION && token->value == value;
+}
+
+// `defined NAME` or `defined(NAME)`, returns the number of tokens used
+static
+int match_defined(struct Token *args, int count, struct Token **name) {
+	if (count < 2 || args[0].type != SYMBOL || strcmp(args[0].text, "defined") != 0) return 0;
+
+	if (args[1].type == SYMBOL) {
+		*name = &args[1];
+		return 2;
+	}
+
+	if (count >= 4 && is_punctuation(&args[1], '(') && args[2].type == SYMBOL && is_punctuation(&args[3], ')')) {
+		*name = &args[2];
+		return 4;
+	}
+
+	return 0;
+}
+
+// constant folding of #if expressions, in 64-bit signed arithmetic
+static
+bool fold(struct Parser *parser, struct AST_Expression *expr, long long *value) {
+	long long lhs = 0, rhs = 0;
+
+	// every kind of node starts with its token
+	struct Token *token = expr->literal.token;
+
+	switch (expr->type) {
+		case LITERAL:
+			*value = expr->literal.value;
+			return true;
+
+		case TYPE_CAST: {
+			if (!fold(parser, expr->type_cast.rhs, &rhs)) return false;
+
+			int size = type_size(parser->types, expr->type_cast.type.id);
+			if (size == 0 || size > (int)sizeof(int)) break;
+
+			rhs &= (1ll << 8 * size) - 1;
+			if (expr->type_cast.type.id == INT) rhs = (int)rhs;
+
+			*value = rhs;
+			return true;
+		}
+
+		case UNARY_OP:
+			if (token->type != PUNCTUATION) break;
+			if (!fold(parser, expr->unary_op.rhs, &rhs)) return false;
+
+			switch (token->value) {
+				case '+': *value = +rhs; return true;
+				case '-': *value = -rhs; return true;
+				case '~': *value = ~rhs; return true;
+				case '!': *value = !rhs; return true;
+			}
+			break;
+
+		case BINARY_OP:
+			if (!fold(parser, expr->binary_op.lhs, &lhs)) return false;
+
+			// `a else b` is `a ?: b`, the right operand is only folded when needed
+			if (token->type == KEYWORD_ELSE) {
+				*value = lhs;
+				return lhs || fold(parser, expr->binary_op.rhs, value);
+			}
+
+			bool or = is_punctuation(token, OR);
+
+			if (or || is_punctuation(token, AND)) {
+				if ((lhs != 0) == or) {
+					*value = or;
+					return true;
+				}
+
+				if (!fold(parser, expr->binary_op.rhs, &rhs)) return false;
+				*value = (rhs != 0);
+				return true;
+			}
+
+			if (token->type != PUNCTUATION) break;
+			if (!fold(parser, expr->binary_op.rhs, &rhs)) return false;
+
+			switch (token->value) {
+				case '/':
+				case '%':
+					if (rhs == 0) {
+						parser_error(parser, token, "division by zero in #if.");
+						return false;
+					}
+
+					*value = (token->value == '/') ? lhs / rhs : lhs % rhs;
+					return true;
+
+				case '+': *value = lhs + rhs;  return true;
+				case '-': *value = lhs - rhs;  return true;
+				case '*': *value = lhs * rhs;  return true;
+				case '&': *value = lhs & rhs;  return true;
+				case '|': *value = lhs | rhs;  return true;
+				case '^': *value = lhs ^ rhs;  return true;
+				case ',': *value = rhs;        return true;
+				case SHL: *value = lhs << (rhs & 63); return true;
+				case SHR: *value = lhs >> (rhs & 63); return true;
+				case '<': *value = lhs < rhs;  return true;
+				case '>': *value = lhs > rhs;  return true;
+				case LEQ: *value = lhs <= rhs; return true;
+				case GEQ: *value = lhs >= rhs; return true;
+				case EQ:  *value = lhs == rhs; return true;
+				case NEQ: *value = lhs != rhs; return true;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	parser_error(parser, token, "expression in #if is not constant.");
+	return false;
+}
+
+// #if expressions: `defined NAME` becomes 1 or 0, macros are expanded and
+// any other identifier becomes 0. the line is then parsed as an expression,
+// with the usual literal rules
+static
+bool evaluate(struct Preprocessor *pp, struct Lexer *lexer, struct Token *args, int count) {
+	struct Vec *tokens = &pp->expression;
+	vec_truncate(tokens, 0);
+
+	for (int i = 0; i < count; i++) {
+		struct Token token = args[i], *name = NULL;
+		int used = match_defined(args + i, count - i, &name);
+
+		if (used) {
+			token = (struct Token){ .type = INT_LITERAL, .value = lookup_macro(pp, name->text, name->length) != NULL };
+			token.filename = args[i].filename;
+			token.line = args[i].line;
+			token.col = args[i].col;
+			i += used - 1;
+		}
+
+		vec_push(tokens, &token);
+	}
+
+	struct Vec *expanded = &pp->expanded;
+	vec_truncate(expanded, 0);
+	expand_macros(pp, tokens->mem, tokens->length, expanded);
+
+	tokens = expanded;
+
+	for (int i = 0; i < tokens->length; i++) {
+		struct Token *token = (struct Token *)tokens->mem + i;
+
+		if (token->type == SYMBOL || token->type == KEYWORD_TRUE || token->type == KEYWORD_FALSE) {
+			token->value = token->type == KEYWORD_TRUE;
+			token->is_char = false;
+			token->type = INT_LITERAL;
+		}
+	}
+
+	if (tokens->length == 0) {
+		lexer_err(lexer, ERROR, NULL, "expected expression after #if");
+		return false;
+	}
+
+	struct Token end = { .type = TOK_EOF, .filename = lexer->filename, .line = lexer->line, .col = lexer->col };
+	vec_push(tokens, &end);
+
+	struct Parser parser = {
+		.tokens = tokens->mem,
+		.length = tokens->length,
+		.allocator = &pp->arena,
+		.scope = &pp->scope,
+		.types = &pp->types,
+		.diagnostics = pp->diagnostics,
+	};
+
+	struct AST_Expression *expr = parse_expression(&parser);
+	long long value = 0;
+
+	if (!parser.errors && parser.tokens->type != TOK_EOF) {
+		parser_error(&parser, parser.tokens, "unexpected %s in #if.", print_token(parser.tokens));
+	}
+
+	if (!parser.errors) fold(&parser, expr, &value);
+
+	lexer->errors += parser.errors;
+	return value != 0;
+}
+
+// the first line of a file is `#if !defined X`
+static
+bool is_guard_test(struct Token *args, int count, struct Token **name) {
+	return count > 1 && is_punctuation(args, '!') && match_defined(args + 1, count - 1, name) == count - 1;
+}
+
+
+// directives
+
+static
+void directive(struct Preprocessor *pp, struct Source *source, struct Vec *tokens) {
+	struct Lexer *lexer = &source->lexer;
+	struct Token location = { .filename = lexer->filename, .line = lexer->line, .col = lexer->col };
+
+	enum TokenType type = lex_directive(lexer);
+	if (type == NONE) return;
+
+	bool active = is_active(pp);
+	bool guard = false; // part of the include guard
+
+	// conditionals are tracked in skipped code, other directives ignored
+	if (!active && type != PREPROC_IF && type != PREPROC_ELIF && type != PREPROC_ELSE && type != PREPROC_ENDIF) {
+		return;
+	}
+
+	struct Condition *top = pp->conditions.length > source->conditions
+		? (struct Condition *)pp->conditions.mem + pp->conditions.length - 1
+		: NULL;
+
+	struct Vec *line = &pp->line;
+	struct Token *args = NULL;
+	int count = 0;
+
+	// message directives take the rest of the line as it is, skipped
+	// conditionals are never evaluated
+	bool evaluated = active || (type == PREPROC_ELIF && top && !top->taken);
+
+	if (evaluated && type != PREPROC_ERROR && type != PREPROC_WARNING) {
+		vec_truncate(line, 0);
+		lex_line(lexer, line);
+
+		args = line->mem;
+		count = line->length;
+	}
+
+	switch (type) {
+		case PREPROC_IF: {
+			struct Token *name = NULL;
+
+			if (source->guard == GUARD_START && is_guard_test(args, count, &name)) {
+				source->guard = GUARD_INSIDE;
+				source->guard_name = name->text;
+				source->guard_length = name->length;
+				source->guard_level = pp->conditions.length;
+				guard = true;
+			}
+
+			bool value = active && evaluate(pp, lexer, args, count);
+			struct Condition condition = { location, value, value || !active };
+			vec_push(&pp->conditions, &condition);
+			break;
+		}
+
+		case PREPROC_ELIF:
+		case PREPROC_ELSE:
+			if (top == NULL) {
+				lexer_err(lexer, ERROR, NULL, "#%s without #if", type == PREPROC_ELIF ? "elif" : "else");
+				break;
+			}
+
+			if (top->taken) {
+				top->active = false;
+				break;
+			}
+
+			top->active = (type == PREPROC_ELSE) || evaluate(pp, lexer, args, count);
+			top->taken = top->active;
+			break;
+
+		case PREPROC_ENDIF:
+			if (top == NULL) {
+				lexer_err(lexer, ERROR, NULL, "#endif without #if");
+				break;
+			}
+
+			vec_truncate(&pp->conditions, pp->conditions.length - 1);
+
+			if (source->guard == GUARD_INSIDE && pp->conditions.length == source->guard_level) {
+				source->guard = GUARD_CLOSED;
+				guard = true;
+			}
+			break;
+
+		case PREPROC_INCLUDE:
+			if (count != 1 || args[0].type != STRING_LITERAL) {
+				lexer_err(lexer, ERROR, NULL, "expected \"file\" after #include");
+				break;
+			}
+
+			if (!include_file(pp, args[0].text, source->file, tokens)) {
+				lexer_err(lexer, ERROR, NULL, "file `%s` not found", args[0].text);
+			}
+			break;
+
+		case PREPROC_DEFINE: {
+			if (count == 0 || args[0].type != SYMBOL) {
+				lexer_err(lexer, ERROR, NULL, "expected macro name after #define");
+				break;
+			}
+
+			struct Macro macro;
+			if (!parse_macro(lexer, pp->allocator, args, count, &macro)) break;
+
+			struct Macro *old = lookup_macro(pp, macro.name, macro.length);
+
+			if (old && !same_macro(old, &macro)) {
+				lexer_err(lexer, WARNING, NULL, "macro `%s` redefined", macro.name);
+			}
+
+			define_macro(pp, &macro);
+
+			guard = source->guard == GUARD_INSIDE && pp->conditions.length == source->guard_level + 1 &&
+			        args[0].length == source->guard_length &&
+			        memcmp(args[0].text, source->guard_name, args[0].length) == 0;
+			break;
+		}
+
+		case PREPROC_PRAGMA:
+			if (count == 1 && args[0].type == SYMBOL && strcmp(args[0].text, "once") == 0) {
+				source->file->once = true;
+				return;
+			}
+
+			lexer_err(lexer, WARNING, NULL, "unknown #pragma ignored");
+			return;
+
+		case PREPROC_ERROR:
+		case PREPROC_WARNING:
+			while (isspace(*lexer->stream)) lexer->stream++;
+			lexer_err(lexer, type == PREPROC_ERROR ? ERROR : WARNING, NULL, "%s", lexer->stream);
+			break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+
+	// an #else of the guard's #if means it does not cover the whole file
+	bool branch = (type == PREPROC_ELIF || type == PREPROC_ELSE) &&
+	              pp->conditions.length == source->guard_level + 1;
+
+	if (!guard) {
+		source->pure = false;
+		if (source->guard != GUARD_INSIDE || branch) source->guard = GUARD_NONE;
+	}
+}
+
+static
+bool is_directive(const char *name, int length, const char *directive) {
+	return length == (int)strlen(directive) && memcmp(name, directive, length) == 0;
+}
+
+// lines of a skipped branch, up to the directive that ends it: returns
+// the start of that line, or the end of the file
+static
+const char *skip_inactive(struct Lexer *lexer, const char *cursor, const char *end) {
+	int depth = 0;
+
+	while (cursor < end) {
+		const char *c = cursor;
+		while (c < end && (*c == ' ' || *c == '\t')) c++;
+
+		if (c < end && *c == '#') {
+			do c++; while (c < end && (*c == ' ' || *c == '\t'));
+
+			const char *name = c;
+			while (c < end && (isalnum(*c) || *c == '_')) c++;
+			int length = c - name;
+
+			if (is_directive(name, length, "if")) {
+				depth++;
+			}
+
+			else if (is_directive(name, length, "endif")) {
+				if (depth == 0) return cursor;
+				depth--;
+			}
+
+			else if (depth == 0 && (is_directive(name, length, "elif") || is_directive(name, length, "else"))) {
+				return cursor;
+			}
+		}
+
+		const char *newline = memchr(c, '\n', end - c);
+		lexer->line += 1;
+
+		if (!newline) return end;
+		cursor = newline + 1;
+	}
+
+	return end;
+}
+
+static
+void process_file(struct Preprocessor *pp, struct SourceFile *file, struct Vec *tokens, bool first) {
+	char buffer[MAX_BUFFER_SIZE];
+
+	struct Source source = {
+		.file = file,
+		.lexer = {
+			.filename = file->name,
+			.start = buffer,
+			.line = 1, .col = 1,
+			.allocator = pp->allocator,
+			.literals = &pp->literals,
+			.diagnostics = pp->diagnostics,
+		},
+		.conditions = pp->conditions.length,
+		.guard = first ? GUARD_START : GUARD_NONE,
+		.pure = first,
+	};
+
+	struct Lexer *lexer = &source.lexer;
+	const char *cursor = file->source, *end = file->source + file->size;
+
+	// iterate lines
+	while (cursor < end) {
+		if (!is_active(pp)) {
+			cursor = skip_inactive(lexer, cursor, end);
+			if (cursor == end) break;
+		}
+
+		const char *newline = memchr(cursor, '\n', end - cursor);
+		if (!newline) newline = end;
+
+		int length = newline - cursor;
+		lexer->stream = lexer->start;
+		lexer->col = 1;
+
+		if (length >= MAX_BUFFER_SIZE) {
+			lexer_err(lexer, ERROR, NULL, "line is too long");
+			length = MAX_BUFFER_SIZE - 1;
+		}
+
+		else if (length > MAX_LINE_LENGTH) {
+			lexer_err(lexer, WARNING, NULL, "line exceeds %d chars", MAX_LINE_LENGTH);
+		}
+
+		memcpy(buffer, cursor, length);
+		buffer[length] = 0;
+
+		const char *first_char = buffer;
+		while (isspace(*first_char)) first_char++;
+
+		if (*first_char == '#') {
+			directive(pp, &source, tokens);
+		}
+
+		else if (is_active(pp)) {
+			int before = tokens->length;
+
+			if (pp->macros.length == 0) {
+				lex_line(lexer, tokens);
+			}
+
+			// the output of a file that expands macros depends on them
+			else {
+				vec_truncate(&pp->line, 0);
+				lex_line(lexer, &pp->line);
+
+				if (expand_macros(pp, pp->line.mem, pp->line.length, tokens)) source.pure = false;
+			}
+
+			// anything outside the guard's #if means there is no guard
+			if (tokens->length > before && source.guard != GUARD_INSIDE) {
+				source.guard = GUARD_NONE;
+			}
+		}
+
+		lexer->line += 1;
+		cursor = newline + 1;
+	}
+
+	while (pp->conditions.length > source.conditions) {
+		struct Condition *open = (struct Condition *)pp->conditions.mem + pp->conditions.length - 1;
+		struct Lexer at = {
+			.filename = open->token.filename, .line = open->token.line, .col = open->token.col,
+			.diagnostics = pp->diagnostics,
+		};
+
+		lexer_err(&at, ERROR, NULL, "unterminated #if");
+		pp->errors += at.errors;
+
+		vec_truncate(&pp->conditions, pp->conditions.length - 1);
+	}
+
+	pp->errors += lexer->errors;
+	file->lines = lexer->line;
+
+	if (first) {
+		file->pure = source.pure;
+
+		if (source.guard == GUARD_CLOSED) {
+			file->guard = source.guard_name;
+			file->guard_length = source.guard_length;
+		}
+	}
+}
+
+bool include_file(struct Preprocessor *pp, const char *path, struct SourceFile *from, struct Vec *tokens) {
+	struct SourceFile *file = find_file(pp, path, from);
+	if (file == NULL) return false;
+
+	// repeated includes
+	if (file->processed) {
+		if (file->once) return true;
+		if (file->guard && lookup_macro(pp, file->guard, file->guard_length)) return true;
+
+		if (file->pure) {
+			expand_macros(pp, file->tokens.mem, file->tokens.length, tokens);
+			return true;
+		}
+	}
+
+	if (pp->depth == MAX_INCLUDE_DEPTH) {
+		errx("#include nested too deeply in `%s` (limit is %d)", file->name, MAX_INCLUDE_DEPTH);
+	}
+
+	if (!read_source(file)) return false;
+
+	bool first = !file->processed;
+	int start = tokens->length;
+
+	pp->depth++;
+	process_file(pp, file, tokens, first);
+	pp->depth--;
+
+	file->processed = true;
+
+	if (first && file->pure) {
+		file->tokens = vec(struct Token);
+		vec_append(&file->tokens, (struct Token *)tokens->mem + start, tokens->length - start);
+	}
+
+	return true;
+}
+
+
+void init_preprocessor(struct Preprocessor *pp, struct Allocator *allocator) {
+	*pp = (struct Preprocessor) {
+		.allocator = allocator,
+		.files = vec(struct SourceFile *),
+		.macros = vec(struct Macro),
+		.conditions = vec(struct Condition),
+		.line = vec(struct Token),
+		.expression = vec(struct Token),
+		.expanded = vec(struct Token),
+		.frames = vec(struct Frame),
+		.arguments = vec(struct Vec *),
+		.ranges = vec(struct Range),
+		.uses = vec(struct Macro *),
+		.generation = 1,
+		.scope = init_scope(),
+	};
+
+	init_type_table(&pp->types);
+	init_literal_pool(&pp->literals);
+
+	rehash(&pp->file_index, &pp->file_capacity, &pp->files, file_key);
+	rehash(&pp->macro_index, &pp->macro_capacity, &pp->macros, macro_key);
+}
+
+void free_preprocessor(struct Preprocessor *pp) {
+	struct SourceFile **files = pp->files.mem;
+
+	for (int i = 0; i < pp->files.length; i++) {
+		if (files[i]->pure && files[i]->processed) vec_free(&files[i]->tokens);
+		free(files[i]->source);
+		free(files[i]);
+	}
+
+	free(pp->file_index);
+	free(pp->macro_index);
+	free_literal_pool(&pp->literals);
+
+	vec_free(&pp->files);
+	vec_free(&pp->macros);
+	vec_free(&pp->conditions);
+	vec_free(&pp->line);
+	vec_free(&pp->expression);
+	vec_free(&pp->expanded);
+	vec_free(&pp->frames);
+	for (int i = 0; i < pp->arguments.length; i++) {
+		struct Vec *list = ((struct Vec **)pp->arguments.mem)[i];
+		vec_free(list);
+		free(list);
+	}
+
+	vec_free(&pp->arguments);
+	vec_free(&pp->ranges);
+	vec_free(&pp->uses);
+
+	free_allocator(&pp->arena);
+	free_scope(&pp->scope);
+	free_type_table(&pp->types);
+}
+
+
+bool lex_file(struct Preprocessor *pp, const char *filename, struct Vec *tokens) {
+	if (!include_file(pp, filename, NULL, tokens)) return false;
+
+	struct SourceFile *main_file = find_file(pp, filename, NULL);
+
+	struct Token end_of_file = {
+		.type = TOK_EOF,
+		.filename = main_file->name,
+		.line = main_file->lines,
+		.col = 1,
+	};
+
+	vec_push(tokens, &end_of_file);
+	return pp->errors == 0;
+}
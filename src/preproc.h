@@ -0,0 +1,136 @@
+#ifndef PREPROC_H_
+#define PREPROC_H_
+
+#include <stdbool.h>
+
+#include "allocator.h"
+#include "literals.h"
+#include "scope.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+// preprocessor:
+//
+// files are read whole and lexed line by line, directives are handled as
+// they are met. every file is kept in a cache by canonical path and read
+// at most once per compilation. when a file is first processed the cache
+// records its include guard (`#if !defined X` ... `#endif` around the
+// whole file) or `#pragma once`, so that a repeated include is skipped by
+// a single lookup. a header with no other directives that expands no macro
+// always produces the same tokens: they are kept and only expanded again on
+// the next include, not re-lexed.
+//
+// #if expressions are parsed by parse_expression and folded to a constant.
+// lines of a skipped branch are only scanned for the directive that ends
+// it: they are never copied, lexed or allocated.
+//
+
+enum {
+	MAX_INCLUDE_DEPTH = 200,
+};
+
+struct SourceFile {
+	const char *path; // canonical
+	const char *name; // as first included, used in diagnostics
+	unsigned hash;
+
+	char *source;
+	int size;
+
+	int lines;
+
+	bool processed, once, pure;
+	const char *guard; // include guard macro, NULL if none
+	int guard_length;
+	struct Vec tokens; // output of a pure file
+};
+
+struct Macro {
+	const char *name;
+	int length;
+	unsigned hash;
+
+	bool function;     // takes a parenthesised argument list, maybe empty
+	int param_count;
+	struct Token *body;
+	short *parameters; // for each body token: parameter index + 1, or 0
+	int body_length;
+
+	int active; // index + 1 of the frame expanding it, its name is left as is
+
+	// object-like: the last expansion, valid while no macro it expanded is
+	// active and no macro has been defined since
+	unsigned generation; // 0 if none
+	struct Token *expansion;
+	int expansion_length;
+	struct Macro **uses;
+	int use_count;
+	unsigned stamp;
+};
+
+struct Condition {
+	struct Token token; // #if, for unterminated conditionals
+	bool active;        // tokens of the current branch are kept
+	bool taken;         // a branch has been active, or an outer one is not
+};
+
+struct Preprocessor {
+	struct Allocator *allocator;
+	struct LiteralPool literals; // texts of string literals, in the allocator
+
+	struct Vec files; // struct SourceFile *
+	int *file_index;  // open addressing: index + 1, 0 if empty
+	int file_capacity;
+
+	struct Vec macros; // struct Macro
+	int *macro_index;
+	int macro_capacity;
+
+	struct Vec conditions; // struct Condition
+	struct Vec line;       // scratch: tokens of a directive
+	struct Vec expression; // scratch: tokens of an #if expression
+	struct Vec expanded;   // scratch: the same, after macro expansion
+
+	// macro expansion
+	struct Vec frames;    // struct Frame
+	struct Vec arguments; // struct Vec *, of struct Token, per nested argument list
+	struct Vec ranges;    // struct Range, of each argument
+	struct Vec uses;      // struct Macro *, expanded by the open frames
+	unsigned generation;  // incremented by every #define
+	unsigned stamp;
+	int expansions;
+
+	// for parsing #if expressions
+	struct Allocator arena;
+	struct Scope scope;
+	struct TypeTable types;
+
+	int depth;             // of nested includes
+	int errors;
+	struct Vec *diagnostics; // buffered messages (chars), NULL prints directly
+};
+
+void init_preprocessor(struct Preprocessor *, struct Allocator *);
+void free_preprocessor(struct Preprocessor *);
+
+struct Macro *lookup_macro(struct Preprocessor *, const char *name, int length);
+// adds or replaces a macro, the hash is set here
+void define_macro(struct Preprocessor *, struct Macro *);
+
+// the cache entry of a file, relative paths are resolved against the
+// directory of `from`. returns NULL if the file cannot be found
+struct SourceFile *find_file(struct Preprocessor *, const char *path, struct SourceFile *from);
+
+// reads the contents of a file once, returns false on failure
+bool read_source(struct SourceFile *);
+
+// appends the tokens of a file, `from` is the including file or NULL.
+// returns false if the file cannot be found
+bool include_file(struct Preprocessor *, const char *path, struct SourceFile *from, struct Vec *tokens);
+
+// lexes a whole file, followed by TOK_EOF. returns false if the file cannot
+// be found or has errors
+bool lex_file(struct Preprocessor *, const char *filename, struct Vec *tokens);
+
+#endif //PREPROC_H_
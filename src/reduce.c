@@ -0,0 +1,392 @@
+#include "reduce.h"
+
+#include "allocator.h"
+#include "ast.h"
+#include "parser.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdint.h>
+
+struct Reducer {
+	struct Allocator *allocator;
+	struct TypeTable *types;
+	struct Token *at; // the operator being rewritten, new tokens copy its location
+};
+
+
+// new nodes
+
+static
+struct Token *new_token(struct Reducer *r, enum TokenType type, unsigned value) {
+	struct Token token = *r->at;
+	token.type = type;
+	token.value = value;
+	token.is_char = false;
+	return store_object(r->allocator, &token, sizeof token);
+}
+
+static
+struct AST_Expression *new_node(struct Reducer *r, struct AST_Expression *node) {
+	return store_object(r->allocator, node, sizeof *node);
+}
+
+static
+struct AST_Expression *literal(struct Reducer *r, uint32_t value) {
+	struct AST_Expression node = {
+		.type = LITERAL,
+		.literal = {
+			.token = new_token(r, INT_LITERAL, value),
+			.type = { .id = U32, .temporary = true },
+			.value = value,
+		},
+	};
+
+	return new_node(r, &node);
+}
+
+static
+struct AST_Expression *binary(struct Reducer *r, unsigned op, struct AST_Expression *lhs, struct AST_Expression *rhs, unsigned type) {
+	struct AST_Expression node = {
+		.type = BINARY_OP,
+		.binary_op = {
+			.token = new_token(r, PUNCTUATION, op),
+			.lhs = lhs,
+			.rhs = rhs,
+			.type = { .id = type, .temporary = true },
+		},
+	};
+
+	return new_node(r, &node);
+}
+
+// the value as the type of the expression it replaces
+static
+struct AST_Expression *retype(struct Reducer *r, struct AST_Expression *expr, unsigned type) {
+	if (expression_type(expr).id == type) return expr;
+
+	struct AST_Expression node = {
+		.type = TYPE_CAST,
+		.type_cast = {
+			.token = r->at,
+			.type = { .id = type, .temporary = true },
+			.rhs = expr,
+		},
+	};
+
+	return new_node(r, &node);
+}
+
+static
+struct AST_Expression *shift(struct Reducer *r, unsigned op, struct AST_Expression *lhs, int count, unsigned type) {
+	if (count == 0) return retype(r, lhs, type);
+	return binary(r, op, lhs, literal(r, count), type);
+}
+
+
+// helpers
+
+// no effects and cheap to evaluate twice
+static
+bool is_simple(struct AST_Expression *expr) {
+	if (expr->type == LITERAL) return true;
+	return expr->type == IDENTIFIER && !expr->identifier.declaration->function;
+}
+
+static
+bool is_power_of_two(uint32_t value) {
+	return value && (value & (value - 1)) == 0;
+}
+
+static
+int log2_of(uint32_t value) {
+	return 31 - __builtin_clz(value);
+}
+
+// the smallest shift s with a 32-bit magic m such that, for every x below
+// 2^(32 - pre), (x >> pre) * m >> (32 + s) is x / d. m is 2^(32 + s) / d
+// rounded up, its error e = m * d' - 2^(32 + s) must satisfy
+// e * 2^(32 - pre) <= 2^(32 + s)
+static
+bool unsigned_magic(uint32_t d, int pre, uint32_t *magic, int *shift) {
+	uint32_t divisor = d >> pre;
+
+	for (int s = 0; s < 32; s++) {
+		uint64_t power = UINT64_C(1) << (32 + s);
+		uint64_t m = (power + divisor - 1) / divisor;
+
+		if (m > UINT32_MAX) return false;
+
+		if (m * divisor - power <= UINT64_C(1) << (s + pre)) {
+			*magic = m;
+			*shift = s;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Hacker's Delight 10-1, for 2 <= d < 2^31: x / d is (x * m >> (32 + s)),
+// plus x when m is negative, plus one when x is
+static
+void signed_magic(uint32_t d, uint32_t *magic, int *shift) {
+	const uint32_t two31 = UINT32_C(1) << 31;
+	uint32_t anc = two31 - 1 - two31 % d;
+
+	uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+	uint32_t q2 = two31 / d, r2 = two31 - q2 * d;
+	uint32_t delta;
+	int p = 31;
+
+	do {
+		p++;
+
+		q1 *= 2, r1 *= 2;
+		if (r1 >= anc) q1++, r1 -= anc;
+
+		q2 *= 2, r2 *= 2;
+		if (r2 >= d) q2++, r2 -= d;
+
+		delta = d - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+
+	*magic = q2 + 1;
+	*shift = p - 32;
+}
+
+
+// rewrites, NULL when there is nothing better
+
+static
+struct AST_Expression *reduce_multiply(struct Reducer *r, struct AST_Expression *x, uint32_t c, unsigned type) {
+	if (c == 1) return retype(r, x, type);
+	if (c == 0) return NULL;
+
+	if (is_power_of_two(c)) return shift(r, SHL, x, log2_of(c), type);
+	if (!is_simple(x)) return NULL;
+
+	// 2^j + 2^k
+	uint32_t low = c & -c;
+	uint32_t high = c - low;
+
+	if (is_power_of_two(high)) {
+		return binary(r, '+', shift(r, SHL, x, log2_of(high), type), shift(r, SHL, x, log2_of(low), type), type);
+	}
+
+	// 2^k - 2^j
+	if (is_power_of_two(c + low)) {
+		return binary(r, '-', shift(r, SHL, x, log2_of(c + low), type), shift(r, SHL, x, log2_of(low), type), type);
+	}
+
+	return NULL;
+}
+
+static
+struct AST_Expression *divide_unsigned(struct Reducer *r, struct AST_Expression *x, uint32_t d, unsigned type) {
+	if (d == 1) return retype(r, x, type);
+	if (is_power_of_two(d)) return shift(r, SHR, x, log2_of(d), type);
+
+	// the quotient is 0 or 1
+	if (d > UINT32_C(1) << 31) return binary(r, GEQ, x, literal(r, d), type);
+
+	uint32_t magic;
+	int s, pre = 0;
+
+	// an even divisor can have its factors of two shifted out of x first
+	bool found = unsigned_magic(d, 0, &magic, &s);
+	if (!found && (d & 1) == 0) found = unsigned_magic(d, pre = __builtin_ctz(d), &magic, &s);
+
+	if (found) {
+		struct AST_Expression *high = binary(r, MUL_HIGH, shift(r, SHR, x, pre, type), literal(r, magic), type);
+		return shift(r, SHR, high, s, type);
+	}
+
+	// the magic needs 33 bits: t = x * (m - 2^32) >> 32, (t + ((x - t) >> 1)) >> (l - 1)
+	if (!is_simple(x)) return NULL;
+
+	int l = 32 - __builtin_clz(d - 1);
+	magic = (UINT64_C(1) << (32 + l)) / d - (UINT64_C(1) << 32) + 1;
+
+	struct AST_Expression *t = binary(r, MUL_HIGH, x, literal(r, magic), type);
+	struct AST_Expression *half = shift(r, SHR, binary(r, '-', x, t, type), 1, type);
+	return shift(r, SHR, binary(r, '+', t, half, type), l - 1, type);
+}
+
+// (x + bias) >> k with bias 2^k - 1 for negative x, toward zero
+static
+struct AST_Expression *biased(struct Reducer *r, struct AST_Expression *x, int k) {
+	struct AST_Expression *sign = retype(r, shift(r, SHR, x, 31, INT), U32);
+	return binary(r, '+', x, shift(r, SHR, sign, 32 - k, U32), INT);
+}
+
+static
+struct AST_Expression *divide_signed(struct Reducer *r, struct AST_Expression *x, uint32_t d) {
+	if (d == 1) return retype(r, x, INT);
+
+	// negative divisors do not come as literals
+	if (d > INT32_MAX || !is_simple(x)) return NULL;
+
+	if (is_power_of_two(d)) return shift(r, SHR, biased(r, x, log2_of(d)), log2_of(d), INT);
+
+	uint32_t magic;
+	int s;
+	signed_magic(d, &magic, &s);
+
+	struct AST_Expression *q = binary(r, MUL_HIGH, x, literal(r, magic), INT);
+	if ((int32_t)magic < 0) q = binary(r, '+', q, x, INT);
+
+	q = shift(r, SHR, q, s, INT);
+	return binary(r, '-', q, shift(r, SHR, x, 31, INT), INT);
+}
+
+static
+struct AST_Expression *modulo(struct Reducer *r, struct AST_Expression *x, uint32_t d, unsigned type) {
+	bool sign = type == INT;
+
+	if (d == 1 && sign) return is_simple(x) ? retype(r, literal(r, 0), INT) : NULL;
+
+	if (is_power_of_two(d) && !sign) return binary(r, '&', x, literal(r, d - 1), type);
+	if (!is_simple(x)) return NULL;
+
+	// x - (x + bias & -2^k)
+	if (is_power_of_two(d) && d <= INT32_MAX) {
+		struct AST_Expression *rounded = binary(r, '&', biased(r, x, log2_of(d)), literal(r, -d), INT);
+		return binary(r, '-', x, rounded, INT);
+	}
+
+	struct AST_Expression *q = sign ? divide_signed(r, x, d) : divide_unsigned(r, x, d, type);
+	if (q == NULL) return NULL;
+
+	struct AST_Expression *product = reduce_multiply(r, q, d, type);
+	if (product == NULL) product = binary(r, '*', q, literal(r, d), type);
+
+	return binary(r, '-', x, product, type);
+}
+
+static
+struct AST_Expression *reduce(struct Reducer *r, struct AST_ExprBinaryOp *op) {
+	unsigned type = op->type.id;
+	unsigned value = op->token->value;
+
+	if (op->token->type != PUNCTUATION || is_pointer(r->types, type)) return NULL;
+	if (is_pointer(r->types, expression_type(op->lhs).id)) return NULL;
+
+	// the constant goes on the right of a product
+	if (value == '*' && op->lhs->type == LITERAL && op->rhs->type != LITERAL) {
+		struct AST_Expression *lhs = op->lhs;
+		op->lhs = op->rhs;
+		op->rhs = lhs;
+	}
+
+	if (op->rhs->type != LITERAL) return NULL;
+
+	struct AST_Expression *x = op->lhs;
+	uint32_t c = op->rhs->literal.value;
+	r->at = op->token;
+
+	switch (value) {
+		case '*':
+			return reduce_multiply(r, x, c, type);
+
+		case '/':
+			if (c == 0) return NULL;
+			return type == INT ? divide_signed(r, x, c) : divide_unsigned(r, x, c, type);
+
+		case '%':
+			if (c == 0) return NULL;
+			return modulo(r, x, c, type);
+
+		// the count is taken mod 32 here rather than in every backend
+		case SHL: case SHR:
+			if ((c & 31) == 0) return retype(r, x, type);
+			op->rhs->literal.value = c & 31;
+			return NULL;
+
+		default:
+			return NULL;
+	}
+}
+
+
+// traversal
+
+static
+void reduce_expression(struct Reducer *r, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case LITERAL: case STRING: case IDENTIFIER:
+			return;
+
+		case UNARY_OP:
+			reduce_expression(r, expr->unary_op.rhs);
+			return;
+
+		case TYPE_CAST:
+			reduce_expression(r, expr->type_cast.rhs);
+			return;
+
+		case FUNC_CALL:
+			if (expr->func_call.args) reduce_expression(r, expr->func_call.args);
+			return;
+
+		case BINARY_OP: {
+			reduce_expression(r, expr->binary_op.lhs);
+			reduce_expression(r, expr->binary_op.rhs);
+
+			struct AST_Expression *replacement = reduce(r, &expr->binary_op);
+			if (replacement) *expr = *replacement;
+			return;
+		}
+	}
+}
+
+static
+void reduce_statements(struct Reducer *r, struct AST_Statement *statement) {
+	for (; statement; statement = statement->next) {
+		switch (statement->type) {
+			case STMT_EXPRESSION:
+			case STMT_RETURN:
+				if (statement->expression) reduce_expression(r, statement->expression);
+				break;
+
+			case STMT_DECLARATION:
+				if (statement->declaration->value) reduce_expression(r, statement->declaration->value);
+				break;
+
+			case STMT_BLOCK:
+				reduce_statements(r, statement->block.body);
+				break;
+
+			case STMT_IF:
+				reduce_expression(r, statement->conditional.condition);
+				reduce_statements(r, statement->conditional.then);
+				reduce_statements(r, statement->conditional.otherwise);
+				break;
+
+			case STMT_WHILE:
+			case STMT_DO:
+				reduce_expression(r, statement->loop.condition);
+				reduce_statements(r, statement->loop.body);
+				break;
+
+			case STMT_SWITCH:
+				reduce_expression(r, statement->selection.condition);
+				reduce_statements(r, statement->selection.body);
+				break;
+
+			case STMT_BREAK:
+			case STMT_CASE:
+				break;
+		}
+	}
+}
+
+// global initialisers are evaluated by the compiler, only bodies are rewritten
+void reduce_strength(struct Allocator *allocator, struct TypeTable *types, struct AST_Declaration **declarations, int count) {
+	struct Reducer r = { allocator, types, NULL };
+
+	for (int i = 0; i < count; i++) {
+		if (declarations[i]->function && declarations[i]->body) reduce_statements(&r, declarations[i]->body);
+	}
+}
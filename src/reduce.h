@@ -0,0 +1,28 @@
+#ifndef REDUCE_H_
+#define REDUCE_H_
+
+#include "allocator.h"
+#include "ast.h"
+#include "types.h"
+
+// strength reduction:
+//
+// rewrites typed binary operations by a literal into cheaper ones, in
+// place, for the native backends:
+//
+//     x * 2^k       x << k, and x * (2^j ± 2^k) as two shifts and an add
+//     x / 2^k       x >> k, rounded toward zero for int
+//     x % 2^k       x & (2^k - 1), with the sign fixed up for int
+//     x / d         the high half of x times a magic number, shifted
+//     x % d         x - x / d * d
+//
+// following Granlund and Montgomery, "Division by Invariant Integers using
+// Multiplication". the high half is the internal operator MUL_HIGH, signed
+// when its type is int. rewrites that need the other operand more than once
+// only apply when it is an identifier or a literal, so that it has no
+// effects and is cheap to load again; new nodes share it.
+//
+
+void reduce_strength(struct Allocator *, struct TypeTable *, struct AST_Declaration **, int count);
+
+#endif //REDUCE_H_
@@ -0,0 +1,163 @@
+#include "scope.h"
+
+#include "ast.h"
+#include "tokens.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+	DEFAULT_TABLE_SIZE = 1 << 10,
+	EMPTY_SLOT = -1,
+};
+
+static inline
+struct Symbol *get_symbol(struct Scope *scope, int index) {
+	return (struct Symbol *)scope->symbols.mem + index;
+}
+
+static
+int *allocate_table(int capacity) {
+	int *table = malloc(capacity * sizeof *table);
+
+	if (!table) {
+		errx("out of memory: failed to allocate %zu bytes", capacity * sizeof *table);
+	}
+
+	memset(table, 0xff, capacity * sizeof *table); // EMPTY_SLOT
+	return table;
+}
+
+struct Scope init_scope() {
+	struct Scope scope;
+
+	scope.capacity = DEFAULT_TABLE_SIZE;
+	scope.table = allocate_table(scope.capacity);
+	scope.symbols = vec(struct Symbol);
+	scope.marks = vec(int);
+
+	return scope;
+}
+
+// independent copy, e.g. of the file scope for each parser thread
+struct Scope clone_scope(struct Scope *scope) {
+	struct Scope clone;
+
+	clone.capacity = scope->capacity;
+	clone.table = allocate_table(clone.capacity);
+	memcpy(clone.table, scope->table, clone.capacity * sizeof *clone.table);
+
+	clone.symbols = init_vector(scope->symbols.elem_size);
+	vec_append(&clone.symbols, scope->symbols.mem, scope->symbols.length);
+
+	clone.marks = init_vector(scope->marks.elem_size);
+	vec_append(&clone.marks, scope->marks.mem, scope->marks.length);
+
+	return clone;
+}
+
+void free_scope(struct Scope *scope) {
+	free(scope->table);
+	vec_free(&scope->symbols);
+	vec_free(&scope->marks);
+	scope->capacity = 0;
+}
+
+
+// linear probing, stops at the first empty slot or matching name
+static
+int probe(struct Scope *scope, const char *name, int length, unsigned key) {
+	unsigned mask = scope->capacity - 1;
+	unsigned slot = key & mask;
+
+	while (scope->table[slot] != EMPTY_SLOT) {
+		struct Symbol *symbol = get_symbol(scope, scope->table[slot]);
+
+		if (symbol->hash == key && symbol->token->length == length &&
+		    memcmp(symbol->token->text, name, length) == 0) {
+			break;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+// rebuild the table in declaration order: bindings are only ever removed
+// in reverse order of insertion, so emptying a slot on exit can never cut
+// the probe sequence of a name that is still visible
+static
+void grow_table(struct Scope *scope) {
+	free(scope->table);
+
+	scope->capacity <<= 1;
+	scope->table = allocate_table(scope->capacity);
+
+	for (int i = 0; i < scope->symbols.length; i++) {
+		struct Symbol *symbol = get_symbol(scope, i);
+		int slot = probe(scope, symbol->token->text, symbol->token->length, symbol->hash);
+
+		scope->table[slot] = i;
+		symbol->slot = slot;
+	}
+}
+
+
+void enter_scope(struct Scope *scope) {
+	vec_push(&scope->marks, &scope->symbols.length);
+}
+
+void exit_scope(struct Scope *scope) {
+	assert(scope->marks.length > 0);
+
+	int mark = ((int *)scope->marks.mem)[scope->marks.length - 1];
+	vec_truncate(&scope->marks, scope->marks.length - 1);
+
+	for (int i = scope->symbols.length - 1; i >= mark; i--) {
+		struct Symbol *symbol = get_symbol(scope, i);
+		scope->table[symbol->slot] = symbol->shadowed;
+	}
+
+	vec_truncate(&scope->symbols, mark);
+}
+
+
+struct Symbol *declare_symbol(struct Scope *scope, struct Token *token,
+                              enum SymbolKind kind, struct ExpressionType type) {
+	// keep load factor below 1/2
+	if (2 * (scope->symbols.length + 1) > scope->capacity) {
+		grow_table(scope);
+	}
+
+	unsigned key = hash(token->text, token->length);
+	int slot = probe(scope, token->text, token->length, key);
+	int shadowed = scope->table[slot];
+
+	if (shadowed != EMPTY_SLOT && get_symbol(scope, shadowed)->depth == scope_depth(scope)) {
+		return NULL; // redeclaration
+	}
+
+	struct Symbol symbol = {
+		.token = token,
+		.hash = key,
+		.depth = scope_depth(scope),
+		.kind = kind,
+		.type = type,
+		.slot = slot,
+		.shadowed = shadowed,
+	};
+
+	scope->table[slot] = scope->symbols.length;
+	vec_push(&scope->symbols, &symbol);
+
+	return get_symbol(scope, scope->symbols.length - 1);
+}
+
+struct Symbol *lookup_symbol(struct Scope *scope, const char *name, int length) {
+	int slot = probe(scope, name, length, hash(name, length));
+	int index = scope->table[slot];
+
+	return (index == EMPTY_SLOT) ? NULL : get_symbol(scope, index);
+}
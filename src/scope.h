@@ -0,0 +1,61 @@
+#ifndef SCOPE_H_
+#define SCOPE_H_
+
+#include "ast.h"
+#include "tokens.h"
+#include "util.h"
+
+// symbol table:
+//
+// every visible name lives in one flat open-addressing table, so lookups
+// never walk a chain of scopes. declarations are pushed onto a stack that
+// doubles as the undo log: each entry remembers the slot it took and the
+// binding it shadowed, so exit_scope restores the table in time
+// proportional to the number of names the block declared.
+//
+
+// struct and union names share the namespace of variables
+enum SymbolKind {
+	SYM_VARIABLE,
+	SYM_FUNCTION,
+	SYM_TYPE,
+};
+
+struct Symbol {
+	struct Token *token;
+	unsigned hash;
+	int depth;
+
+	enum SymbolKind kind;
+	struct ExpressionType type;
+	struct AST_Declaration *declaration;
+	bool defined;
+
+	// undo information
+	int slot, shadowed;
+};
+
+struct Scope {
+	int *table; // index into symbols, -1 if empty
+	int capacity;
+
+	struct Vec symbols; // struct Symbol, in declaration order
+	struct Vec marks;   // int, length of symbols at each block entry
+};
+
+struct Scope init_scope();
+struct Scope clone_scope(struct Scope *);
+void free_scope(struct Scope *);
+
+void enter_scope(struct Scope *);
+void exit_scope(struct Scope *);
+
+static inline
+int scope_depth(struct Scope *scope) { return scope->marks.length; }
+
+// returned pointers are invalidated by the next declaration,
+// declare_symbol returns NULL if the name already exists in this block
+struct Symbol *declare_symbol(struct Scope *, struct Token *, enum SymbolKind, struct ExpressionType);
+struct Symbol *lookup_symbol(struct Scope *, const char *name, int length);
+
+#endif //SCOPE_H_
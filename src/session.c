@@ -0,0 +1,672 @@
+#include "session.h"
+
+#include "allocator.h"
+#include "ast.h"
+#include "parser.h"
+#include "scope.h"
+#include "tokens.h"
+#include "types.h"
+#include "unit.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// small open-addressing map from hashes to indices or versions,
+// keys may repeat: lookups walk every slot of the probe sequence
+struct Slot {
+	unsigned key, value;
+	bool used;
+};
+
+struct Index {
+	struct Slot *slots;
+	unsigned mask;
+};
+
+static
+struct Index init_index(int count) {
+	unsigned capacity = 16;
+	while (capacity < 2u * count) capacity <<= 1;
+
+	struct Index index = { calloc(capacity, sizeof(struct Slot)), capacity - 1 };
+	if (!index.slots) errx("out of memory: failed to allocate %u slots", capacity);
+
+	return index;
+}
+
+static
+struct Slot *index_probe(struct Index *index, unsigned key) {
+	unsigned i = key & index->mask;
+	while (index->slots[i].used && index->slots[i].key != key) i = (i + 1) & index->mask;
+	return &index->slots[i];
+}
+
+static
+void index_add(struct Index *index, unsigned key, unsigned value) {
+	unsigned i = key & index->mask;
+	while (index->slots[i].used) i = (i + 1) & index->mask;
+	index->slots[i] = (struct Slot) { key, value, true };
+}
+
+static
+unsigned combine(unsigned a, unsigned b) {
+	unsigned pair[2] = { a, b };
+	return hash((const char *)pair, sizeof pair);
+}
+
+static
+bool has_text(struct Token *token) {
+	return token->type == SYMBOL || token->type == STRING_LITERAL;
+}
+
+
+// token ranges
+
+static
+int find_split(struct Token *tokens, int length) {
+	int depth = 0;
+
+	// struct and union declarations are all prototype
+	if (starts_aggregate(tokens, length)) return length;
+
+	for (int i = 0; i < length; i++) {
+		if (tokens[i].type != PUNCTUATION) continue;
+
+		switch (tokens[i].value) {
+			case '{': case '=': case ';':
+				if (depth == 0) return i;
+				if (tokens[i].value == '{') depth++;
+				break;
+
+			case '(': case '[':
+				depth++;
+				break;
+
+			case ')': case ']': case '}':
+				depth--;
+				break;
+		}
+	}
+
+	return length;
+}
+
+// hashes are independent of where the range starts in the file,
+// so that declarations below an edit still match
+static
+void hash_range(struct Session *session, struct SessionEntry *entry, struct Token *tokens) {
+	struct Vec *words = &session->words;
+	vec_truncate(words, 0);
+
+	for (int i = 0; i < entry->length; i++) {
+		struct Token *token = &tokens[i];
+		unsigned data = has_text(token) ? hash(token->text, token->length) : token->value;
+
+		unsigned word[4] = { token->type, data, token->line - tokens[0].line, token->col };
+		vec_append(words, word, 4);
+	}
+
+	int prefix = min(entry->split + 1, entry->length);
+
+	entry->hash = hash(words->mem, entry->length * sizeof(unsigned[4]));
+	entry->signature = hash(words->mem, prefix * sizeof(unsigned[4]));
+	entry->name = 0;
+
+	for (int i = 0; i < prefix; i++) {
+		if (tokens[i].type == SYMBOL) {
+			entry->name = hash(tokens[i].text, tokens[i].length);
+			break;
+		}
+	}
+}
+
+static
+int header_count(struct SessionEntry *entry) { return min(entry->split + 1, entry->length); }
+
+static
+int body_count(struct SessionEntry *entry) { return entry->length - entry->split; }
+
+static
+bool same_token(struct Token *a, int a_line, struct Token *b, int b_line) {
+	if (a->type != b->type || a->col != b->col || a->line - a_line != b->line - b_line)
+		return false;
+
+	if (!has_text(a)) return a->value == b->value;
+	return a->length == b->length && memcmp(a->text, b->text, a->length) == 0;
+}
+
+// compares the first `count` tokens of a range against an entry
+static
+bool same_tokens(struct SessionEntry *entry, struct Token *tokens, int count) {
+	for (int i = 0; i < count; i++) {
+		struct Token *old = (i < header_count(entry)) ? &entry->header[i] : &entry->body[i - entry->split];
+		if (!same_token(old, entry->header[0].line, &tokens[i], tokens[0].line)) return false;
+	}
+
+	return true;
+}
+
+// the copy ends with an end-of-file token at the location of the next one
+static
+struct Token *copy_tokens(struct Allocator *arena, struct Token *tokens, int count) {
+	struct Token *copy = store_object(arena, tokens, (count + 1) * sizeof *tokens);
+
+	for (int i = 0; i < count; i++) {
+		if (has_text(&copy[i])) copy[i].text = store_string(arena, copy[i].text, copy[i].length);
+	}
+
+	copy[count].type = TOK_EOF;
+	return copy;
+}
+
+static
+void move_tokens(struct Token *tokens, int count, int delta) {
+	for (int i = 0; i <= count; i++) tokens[i].line += delta;
+}
+
+
+// parsing
+
+// where each new entry came from
+enum Reuse {
+	REUSE_NOTHING,
+	REUSE_PROTOTYPE,
+	REUSE_ALL,
+};
+
+// an update in progress, which the constants it parses may call into
+struct Update {
+	struct Session *session;
+	struct SessionEntry **entries;
+	struct Token **starts;
+	enum Reuse *reuse;
+	bool *current;         // the definition is up to date
+	struct Index versions; // signatures by name, of the declarations so far
+	struct Index names;    // entry indices by name
+};
+
+// a parse of entry `entry`, whose constants may call the functions defined
+// before it, as in a full compile
+struct Caller {
+	struct Update *update;
+	int entry;
+	struct Callees callees;
+	struct Vec names;   // file scope names used (unsigned)
+	struct Vec called;  // struct Dependency, on definitions
+};
+
+static
+void parse_body(struct Update *, int index);
+
+static
+bool dependencies_changed(struct Update *, struct Dependency *, int count, int before);
+
+// the body of an entry as of this update, parsed now if it changed
+static
+void make_current(struct Update *u, int index) {
+	struct SessionEntry *entry = u->entries[index];
+	if (u->current[index]) return;
+
+	if (u->reuse[index] != REUSE_ALL ||
+	    dependencies_changed(u, entry->dependencies, entry->dependency_count, index)) {
+		parse_body(u, index);
+	}
+
+	u->current[index] = true;
+}
+
+// changes whenever a definition of the name before `before` does
+static
+unsigned definition_version(struct Update *u, unsigned name, int before) {
+	unsigned version = 0;
+
+	for (struct Slot *slot = &u->names.slots[name & u->names.mask]; slot->used;
+	     slot = &u->names.slots[(slot - u->names.slots + 1) & u->names.mask]) {
+		if (slot->key != name || (int)slot->value >= before) continue;
+
+		make_current(u, slot->value);
+
+		struct SessionEntry *entry = u->entries[slot->value];
+		version += combine(entry->serial, entry->revision);
+	}
+
+	return version;
+}
+
+static
+unsigned signature_version(struct Update *u, unsigned name) {
+	struct Slot *slot = index_probe(&u->versions, name);
+	return slot->used ? slot->value : 0;
+}
+
+static
+bool dependencies_changed(struct Update *u, struct Dependency *dependencies, int count, int before) {
+	for (int i = 0; i < count; i++) {
+		struct Dependency *d = &dependencies[i];
+		unsigned version = d->definition ? definition_version(u, d->name, before) : signature_version(u, d->name);
+
+		if (version != d->version) return true;
+	}
+
+	return false;
+}
+
+// a function a constant calls: its definition is brought up to date, and
+// the caller now depends on it
+static
+struct AST_Declaration *find_definition(void *argument, struct AST_Declaration *decl) {
+	struct Caller *caller = argument;
+	struct Update *u = caller->update;
+	unsigned name = hash(decl->token->text, decl->token->length);
+
+	for (struct Slot *slot = &u->names.slots[name & u->names.mask]; slot->used;
+	     slot = &u->names.slots[(slot - u->names.slots + 1) & u->names.mask]) {
+		if (slot->key != name || (int)slot->value >= caller->entry || u->entries[slot->value]->decl != decl) continue;
+
+		struct Dependency dependency = { name, definition_version(u, name, caller->entry), true };
+		vec_push(&caller->called, &dependency);
+
+		return decl->function && decl->body ? decl : NULL;
+	}
+
+	return NULL;
+}
+
+static
+struct Caller init_caller(struct Update *u, int index) {
+	return (struct Caller) {
+		u, index, { find_definition, NULL },
+		vec(unsigned), vec(struct Dependency),
+	};
+}
+
+static
+int compare_names(const void *a, const void *b) {
+	unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+	return (x > y) - (x < y);
+}
+
+// one dependency per name used, with the version it was checked against,
+// then the definitions called
+static
+struct Dependency *keep_dependencies(struct Update *u, struct Allocator *arena, struct Caller *caller, int *count) {
+	unsigned *name = caller->names.mem;
+	qsort(name, caller->names.length, sizeof *name, compare_names);
+
+	struct Vec dependencies = vec(struct Dependency);
+
+	for (int i = 0; i < caller->names.length; i++) {
+		if (i > 0 && name[i] == name[i - 1]) continue;
+
+		struct Dependency dependency = { name[i], signature_version(u, name[i]), false };
+		vec_push(&dependencies, &dependency);
+	}
+
+	vec_append(&dependencies, caller->called.mem, caller->called.length);
+
+	*count = dependencies.length;
+	struct Dependency *kept = *count ? store_object(arena, dependencies.mem, *count * sizeof *kept) : NULL;
+
+	vec_free(&dependencies);
+	vec_free(&caller->names);
+	vec_free(&caller->called);
+	return kept;
+}
+
+static
+const char *keep_messages(struct Session *session, struct Allocator *arena, int start, int *length) {
+	*length = session->messages.length - start;
+	const char *text = *length ? store_string(arena, (char *)session->messages.mem + start, *length) : NULL;
+
+	vec_truncate(&session->messages, start);
+	return text;
+}
+
+// against the file scope so far, as the signatures of a full compile are
+static
+void parse_header(struct Update *u, int index) {
+	struct Session *session = u->session;
+	struct SessionEntry *entry = u->entries[index];
+
+	free_allocator(&entry->prototype);
+	free_allocator(&entry->definition);
+	entry->definition = (struct Allocator) {0};
+	entry->body = NULL;
+	entry->dependencies = NULL;
+	entry->dependency_count = 0;
+
+	// grows from a small block: most declarations are short
+	entry->prototype = (struct Allocator) {0};
+	entry->header = copy_tokens(&entry->prototype, u->starts[index], header_count(entry));
+
+	int start = session->messages.length;
+
+	struct Caller caller = init_caller(u, index);
+	caller.callees.context = &caller;
+
+	struct Parser parser = {
+		.tokens = entry->header,
+		.length = header_count(entry) + 1,
+		.allocator = &entry->prototype,
+		.scope = &session->scope,
+		.types = &session->types,
+		.diagnostics = &session->messages,
+		.dependencies = &caller.names,
+		.callees = &caller.callees,
+	};
+
+	entry->decl = parse_prototype(&parser);
+	if (parser.errors) entry->decl = NULL;
+
+	entry->header_errors = parser.errors;
+	entry->header_diagnostics = keep_messages(session, &entry->prototype, start, &entry->header_length);
+	entry->header_dependencies = keep_dependencies(u, &entry->prototype, &caller, &entry->header_dependency_count);
+	entry->serial = ++session->serial;
+}
+
+static
+void parse_body(struct Update *u, int index) {
+	struct Session *session = u->session;
+	struct SessionEntry *entry = u->entries[index];
+
+	free_allocator(&entry->definition);
+	entry->definition = (struct Allocator) {0};
+	entry->body = copy_tokens(&entry->definition, u->starts[index] + entry->split, body_count(entry));
+
+	entry->body_diagnostics = NULL;
+	entry->body_length = entry->body_errors = 0;
+	entry->dependencies = NULL;
+	entry->dependency_count = 0;
+	entry->revision = ++session->serial;
+
+	if (entry->decl == NULL) return;
+
+	entry->decl->value = NULL;
+	entry->decl->body = NULL;
+
+	int start = session->messages.length;
+
+	struct Caller caller = init_caller(u, index);
+	caller.callees.context = &caller;
+
+	struct Parser parser = {
+		.tokens = entry->body,
+		.length = body_count(entry) + 1,
+		.allocator = &entry->definition,
+		.scope = &session->scope,
+		.types = &session->types,
+		.diagnostics = &session->messages,
+		.dependencies = &caller.names,
+		.callees = &caller.callees,
+	};
+
+	parse_definition(&parser, entry->decl);
+	session->reparsed++;
+
+	entry->body_errors = parser.errors;
+	entry->body_diagnostics = keep_messages(session, &entry->definition, start, &entry->body_length);
+	entry->dependencies = keep_dependencies(u, &entry->definition, &caller, &entry->dependency_count);
+}
+
+static
+void free_entry(struct SessionEntry *entry) {
+	free_allocator(&entry->prototype);
+	free_allocator(&entry->definition);
+	free(entry);
+}
+
+
+// session
+
+void init_session(struct Session *session) {
+	session->entries = vec(struct SessionEntry *);
+	init_type_table(&session->types);
+	session->scope = init_scope();
+	session->serial = 0;
+	session->aggregates = 0;
+
+	session->output = vec(char);
+	session->errors = 0;
+	session->reparsed = 0;
+
+	session->words = vec(unsigned);
+	session->messages = vec(char);
+}
+
+void free_session(struct Session *session) {
+	struct SessionEntry **entries = session->entries.mem;
+
+	for (int i = 0; i < session->entries.length; i++) {
+		free_entry(entries[i]);
+	}
+
+	vec_free(&session->entries);
+	free_type_table(&session->types);
+	free_scope(&session->scope);
+
+	vec_free(&session->output);
+	vec_free(&session->words);
+	vec_free(&session->messages);
+}
+
+int update_session(struct Session *session, struct Token *tokens, int count) {
+	struct Vec ranges = vec(struct TokenRange);
+	skim_declarations(tokens, count, &ranges);
+
+	struct TokenRange *range = ranges.mem;
+	int length = ranges.length;
+
+	struct SessionEntry **old = session->entries.mem;
+	int old_length = session->entries.length;
+
+	// old entries by all tokens, and by name and signature
+	struct Index exact = init_index(old_length);
+	struct Index similar = init_index(old_length);
+
+	for (int i = 0; i < old_length; i++) {
+		index_add(&exact, old[i]->hash, i);
+		if (old[i]->decl && !old[i]->header_length)
+			index_add(&similar, combine(old[i]->name, old[i]->signature), i);
+	}
+
+	// headers hold the ids of the struct and union types they name, which
+	// are new types whenever their declarations are parsed again
+	unsigned aggregates = 0;
+
+	for (int i = 0; i < length; i++) {
+		struct Token *first = range[i].tokens;
+		int n = range[i].length - (first[range[i].length - 1].type == TOK_EOF);
+		if (!starts_aggregate(first, n)) continue;
+
+		struct SessionEntry key = { .length = n, .split = find_split(first, n) };
+		hash_range(session, &key, first);
+		aggregates = combine(aggregates, key.hash);
+	}
+
+	bool retype = aggregates != session->aggregates;
+	session->aggregates = aggregates;
+
+	// the scope refers to tokens of entries about to be freed
+	free_scope(&session->scope);
+	session->scope = init_scope();
+
+	struct Vec entries = vec(struct SessionEntry *);
+	struct Token **starts = calloc(max(length, 1), sizeof *starts);
+	enum Reuse *reuse = calloc(max(length, 1), sizeof *reuse);
+	bool *current = calloc(max(length, 1), sizeof *current);
+	int *declared = calloc(max(length, 1), sizeof(int[2]));
+
+	if (!starts || !reuse || !current || !declared) errx("out of memory: failed to allocate session state");
+
+	for (int i = 0; i < length; i++) {
+		struct Token *first = range[i].tokens;
+		int n = range[i].length;
+
+		// an unterminated declaration also takes the end-of-file token
+		if (first[n - 1].type == TOK_EOF) n--;
+		if (n == 0) continue;
+
+		struct SessionEntry key = { .length = n, .split = find_split(first, n) };
+		hash_range(session, &key, first);
+
+		struct SessionEntry *entry = NULL;
+		int matched = -1;
+
+		for (struct Slot *slot = &exact.slots[key.hash & exact.mask]; !retype && slot->used;
+		     slot = &exact.slots[(slot - exact.slots + 1) & exact.mask]) {
+			struct SessionEntry *match = old[slot->value];
+
+			if (slot->key == key.hash && match && match->length == n && match->split == key.split &&
+			    same_tokens(match, first, n)) {
+				entry = match;
+				matched = slot->value;
+				reuse[entries.length] = REUSE_ALL;
+				break;
+			}
+		}
+
+		unsigned similar_key = combine(key.name, key.signature);
+
+		for (struct Slot *slot = &similar.slots[similar_key & similar.mask]; !retype && !entry && slot->used;
+		     slot = &similar.slots[(slot - similar.slots + 1) & similar.mask]) {
+			struct SessionEntry *match = old[slot->value];
+
+			if (slot->key == similar_key && match && match->split == key.split &&
+			    same_tokens(match, first, header_count(&key))) {
+				entry = match;
+				matched = slot->value;
+				reuse[entries.length] = REUSE_PROTOTYPE;
+			}
+		}
+
+		if (entry != NULL) {
+			old[matched] = NULL;
+
+			int delta = first->line - entry->line;
+
+			// cached diagnostics carry line numbers
+			if (delta && entry->body_length && reuse[entries.length] == REUSE_ALL) {
+				reuse[entries.length] = REUSE_PROTOTYPE;
+			}
+
+			if (delta && entry->header_length) {
+				reuse[entries.length] = REUSE_NOTHING;
+			}
+
+			if (delta) {
+				move_tokens(entry->header, header_count(entry), delta);
+				if (entry->body) move_tokens(entry->body, body_count(entry), delta);
+			}
+		} else {
+			entry = calloc(1, sizeof *entry);
+			if (!entry) errx("out of memory: failed to allocate session entry");
+		}
+
+		entry->hash = key.hash;
+		entry->signature = key.signature;
+		entry->name = key.name;
+		entry->line = first->line;
+		entry->length = n;
+		entry->split = key.split;
+
+		starts[entries.length] = first;
+		vec_push(&entries, &entry);
+	}
+
+	for (int i = 0; i < old_length; i++) {
+		if (old[i]) free_entry(old[i]);
+	}
+
+	vec_free(&session->entries);
+	session->entries = entries;
+
+	struct SessionEntry **entry = entries.mem;
+
+	struct Update u = {
+		.session = session,
+		.entries = entry,
+		.starts = starts,
+		.reuse = reuse,
+		.current = current,
+		.versions = init_index(entries.length),
+		.names = init_index(entries.length),
+	};
+
+	for (int i = 0; i < entries.length; i++) {
+		index_add(&u.names, entry[i]->name, i);
+	}
+
+	// headers and the file scope, in source order. a header is parsed again
+	// when its tokens, or a name or a called function it used, changed. a
+	// name's version changes whenever any declaration of it does
+	vec_truncate(&session->messages, 0);
+	session->errors = 0;
+	session->reparsed = 0;
+
+	for (int i = 0; i < entries.length; i++) {
+		if (reuse[i] != REUSE_NOTHING &&
+		    dependencies_changed(&u, entry[i]->header_dependencies, entry[i]->header_dependency_count, i)) {
+			reuse[i] = REUSE_NOTHING;
+		}
+
+		if (reuse[i] == REUSE_NOTHING) parse_header(&u, i);
+
+		declared[2*i] = declared[2*i + 1] = session->messages.length;
+
+		if (entry[i]->decl) {
+			struct Parser parser = {
+				.tokens = entry[i]->header,
+				.length = header_count(entry[i]) + 1,
+				.scope = &session->scope,
+				.types = &session->types,
+				.diagnostics = &session->messages,
+			};
+
+			declare_signature(&parser, entry[i]->decl);
+
+			declared[2*i + 1] = session->messages.length;
+			session->errors += parser.errors;
+		}
+
+		struct Slot *slot = index_probe(&u.versions, entry[i]->name);
+
+		*slot = (struct Slot) {
+			.key = entry[i]->name,
+			.value = combine(slot->value, combine(entry[i]->signature, entry[i]->serial)),
+			.used = true,
+		};
+	}
+
+	// definitions whose tokens, moved diagnostics, used names or called
+	// functions changed, unless a constant above needed them already
+	for (int i = 0; i < entries.length; i++) {
+		make_current(&u, i);
+	}
+
+	vec_truncate(&session->output, 0);
+
+	for (int i = 0; i < entries.length; i++) {
+		struct SessionEntry *e = entry[i];
+
+		// entries without diagnostics have none to append, not even a buffer
+		if (e->header_length) vec_append(&session->output, e->header_diagnostics, e->header_length);
+		vec_append(&session->output, (char *)session->messages.mem + declared[2*i], declared[2*i + 1] - declared[2*i]);
+		if (e->body_length) vec_append(&session->output, e->body_diagnostics, e->body_length);
+
+		session->errors += e->header_errors + e->body_errors;
+	}
+
+	free(exact.slots);
+	free(similar.slots);
+	free(u.versions.slots);
+	free(u.names.slots);
+	free(starts);
+	free(reuse);
+	free(current);
+	free(declared);
+	vec_free(&ranges);
+
+	return session->errors;
+}
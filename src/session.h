@@ -0,0 +1,86 @@
+#ifndef SESSION_H_
+#define SESSION_H_
+
+#include "allocator.h"
+#include "ast.h"
+#include "scope.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+// incremental compilation:
+//
+// a session keeps the AST and diagnostics of every top-level declaration
+// between versions of a file. each declaration is keyed by a hash of its
+// tokens, and split into a prototype (up to the `{`, `=` or `;`) and a
+// definition. on update only the declarations whose tokens changed are
+// reparsed; a declaration is also rechecked when a file scope name it
+// used now refers to a different declaration, or a function one of its
+// constants ran has a different definition. the file scope itself is
+// rebuilt from the prototypes on every update, in order, which is cheap.
+// struct and union declarations are prototypes whole, when any of them
+// changes every declaration is reparsed: prototypes refer to the types
+// they name.
+//
+// token text is copied into the session, filenames are not
+//
+
+struct Dependency {
+	unsigned name;    // hash of a file scope name
+	unsigned version; // of its declarations when the definition was checked
+	bool definition;  // a function run at compile time: of their definitions
+};
+
+struct SessionEntry {
+	unsigned hash;      // all tokens, relative to the first line
+	unsigned signature; // tokens up to and including the one at `split`
+	unsigned name;      // hash of the declared name, 0 if none
+	unsigned serial;    // changes whenever `decl` is rebuilt
+	unsigned revision;  // changes whenever the definition is parsed
+
+	int line;          // of the first token
+	int length, split; // tokens in the range, index where the definition starts
+
+	// tokens [0, split], the declaration object and its parameters
+	struct Allocator prototype;
+	struct Token *header;
+	struct AST_Declaration *decl; // NULL if the prototype has errors
+	const char *header_diagnostics;
+	int header_length, header_errors;
+	struct Dependency *header_dependencies;
+	int header_dependency_count;
+
+	// tokens [split, length), the body or initialiser
+	struct Allocator definition;
+	struct Token *body;
+	const char *body_diagnostics;
+	int body_length, body_errors;
+
+	struct Dependency *dependencies;
+	int dependency_count;
+};
+
+struct Session {
+	struct Vec entries; // struct SessionEntry *, in source order
+	struct TypeTable types;
+	struct Scope scope; // file scope of the last update
+	unsigned serial;
+	unsigned aggregates; // hash of the struct and union declarations
+
+	struct Vec output; // diagnostics of the last update (chars)
+	int errors;
+	int reparsed; // definitions parsed by the last update
+
+	// scratch buffers
+	struct Vec words;    // hashed token data (unsigned)
+	struct Vec messages; // diagnostics being captured (chars)
+};
+
+void init_session(struct Session *);
+void free_session(struct Session *);
+
+// `tokens` is a whole file ending with TOK_EOF, returns the error count.
+// declarations and types stay valid until the next update
+int update_session(struct Session *, struct Token *tokens, int count);
+
+#endif //SESSION_H_
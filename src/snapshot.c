@@ -0,0 +1,590 @@
+#include "snapshot.h"
+
+#include "ast.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// records are built with absolute offsets into the buffer, then appended
+// with each reference made relative to its own field
+
+static
+int32_t relative(int record, size_t field, int target) {
+	return target ? target - (record + (int)field) : 0;
+}
+
+static
+int align_buffer(struct Vec *out) {
+	static const char zeros[4];
+	vec_append(out, zeros, -out->length & 3);
+	return out->length;
+}
+
+static
+int write_string(struct Vec *out, const char *text) {
+	if (text == NULL) return 0;
+
+	int at = out->length;
+	vec_append(out, text, strlen(text) + 1);
+	return at;
+}
+
+// an array of references, each relative to its own slot
+static
+int write_references(struct Vec *out, int *targets, int count) {
+	int at = align_buffer(out);
+
+	for (int i = 0; i < count; i++) {
+		int32_t reference = relative(at, i * sizeof(int32_t), targets[i]);
+		vec_append(out, &reference, sizeof reference);
+	}
+
+	return count ? at : 0;
+}
+
+static
+int write_expression(struct Vec *out, struct AST_Expression *expr) {
+	if (expr == NULL) return 0;
+
+	struct SnapExpression node = { .kind = expr->type };
+	struct Token *token = NULL;
+	struct ExpressionType type = {0};
+	int text = 0, lhs = 0, rhs = 0;
+
+	switch (expr->type) {
+		case LITERAL:
+			token = expr->literal.token;
+			type = expr->literal.type;
+			node.value = expr->literal.value;
+			break;
+
+		case STRING:
+			token = expr->string.token;
+			type = expr->string.type;
+			text = write_string(out, token->text);
+			break;
+
+		case IDENTIFIER:
+			token = expr->identifier.token;
+			type = expr->identifier.type;
+			text = write_string(out, token->text);
+			break;
+
+		case UNARY_OP:
+			token = expr->unary_op.token;
+			type = expr->unary_op.type;
+			rhs = write_expression(out, expr->unary_op.rhs);
+			break;
+
+		case BINARY_OP:
+			token = expr->binary_op.token;
+			type = expr->binary_op.type;
+			lhs = write_expression(out, expr->binary_op.lhs);
+			rhs = write_expression(out, expr->binary_op.rhs);
+			break;
+
+		case TYPE_CAST:
+			token = expr->type_cast.token;
+			type = expr->type_cast.type;
+			rhs = write_expression(out, expr->type_cast.rhs);
+			break;
+
+		case FUNC_CALL:
+			token = expr->func_call.token;
+			type = expr->func_call.type;
+			node.value = expr->func_call.builtin;
+			lhs = write_expression(out, expr->func_call.func);
+			rhs = write_expression(out, expr->func_call.args);
+			break;
+	}
+
+	if (expr->type == UNARY_OP || expr->type == BINARY_OP) {
+		node.value = token->value;
+	}
+
+	node.type = type.id;
+	node.temporary = type.temporary;
+	node.token_type = token->type;
+	node.line = token->line;
+	node.col = token->col;
+
+	int at = align_buffer(out);
+	node.text = relative(at, offsetof(struct SnapExpression, text), text);
+	node.lhs = relative(at, offsetof(struct SnapExpression, lhs), lhs);
+	node.rhs = relative(at, offsetof(struct SnapExpression, rhs), rhs);
+
+	vec_append(out, &node, sizeof node);
+	return at;
+}
+
+static
+int write_declaration(struct Vec *out, struct AST_Declaration *);
+
+static
+int write_statement(struct Vec *out, struct AST_Statement *stmt, int next);
+
+// statement lists are written last to first, so `next` is always known
+static
+int write_statements(struct Vec *out, struct AST_Statement *first) {
+	struct Vec list = vec(struct AST_Statement *);
+
+	for (struct AST_Statement *stmt = first; stmt; stmt = stmt->next) {
+		vec_push(&list, &stmt);
+	}
+
+	int next = 0;
+
+	for (int i = list.length - 1; i >= 0; i--) {
+		next = write_statement(out, ((struct AST_Statement **)list.mem)[i], next);
+	}
+
+	vec_free(&list);
+	return next;
+}
+
+static
+int write_statement(struct Vec *out, struct AST_Statement *stmt, int next) {
+	struct SnapStatement node = {
+		.kind = stmt->type,
+		.line = stmt->token ? stmt->token->line : 0,
+		.col = stmt->token ? stmt->token->col : 0,
+	};
+
+	int expression = 0, declaration = 0, body = 0, otherwise = 0, cases = 0;
+
+	switch (stmt->type) {
+		case STMT_EXPRESSION:
+		case STMT_RETURN:
+			expression = write_expression(out, stmt->expression);
+			break;
+
+		case STMT_DECLARATION:
+			declaration = write_declaration(out, stmt->declaration);
+			break;
+
+		case STMT_BLOCK:
+			body = write_statements(out, stmt->block.body);
+			break;
+
+		case STMT_IF:
+			expression = write_expression(out, stmt->conditional.condition);
+			body = write_statements(out, stmt->conditional.then);
+			otherwise = write_statements(out, stmt->conditional.otherwise);
+			break;
+
+		case STMT_WHILE:
+		case STMT_DO:
+			expression = write_expression(out, stmt->loop.condition);
+			body = write_statements(out, stmt->loop.body);
+			break;
+
+		case STMT_BREAK:
+			break;
+
+		case STMT_SWITCH:
+			expression = write_expression(out, stmt->selection.condition);
+			body = write_statements(out, stmt->selection.body);
+			node.label = stmt->selection.otherwise;
+			node.case_count = stmt->selection.case_count;
+
+			cases = align_buffer(out);
+			for (int i = 0; i < stmt->selection.case_count; i++) {
+				struct SnapCase snap = { stmt->selection.cases[i].value, stmt->selection.cases[i].label };
+				vec_append(out, &snap, sizeof snap);
+			}
+			break;
+
+		case STMT_CASE:
+			node.label = stmt->label;
+			break;
+	}
+
+	int at = align_buffer(out);
+	node.next = relative(at, offsetof(struct SnapStatement, next), next);
+	node.expression = relative(at, offsetof(struct SnapStatement, expression), expression);
+	node.declaration = relative(at, offsetof(struct SnapStatement, declaration), declaration);
+	node.body = relative(at, offsetof(struct SnapStatement, body), body);
+	node.otherwise = relative(at, offsetof(struct SnapStatement, otherwise), otherwise);
+	node.cases = relative(at, offsetof(struct SnapStatement, cases), node.case_count ? cases : 0);
+
+	vec_append(out, &node, sizeof node);
+	return at;
+}
+
+static
+int write_declaration(struct Vec *out, struct AST_Declaration *decl) {
+	int name = write_string(out, decl->token->text);
+	int params = 0;
+
+	if (decl->param_count) {
+		int *targets = malloc(decl->param_count * sizeof *targets);
+		if (!targets) errx("out of memory: failed to allocate %d parameters", decl->param_count);
+
+		for (int i = 0; i < decl->param_count; i++) {
+			targets[i] = write_declaration(out, decl->params[i]);
+		}
+
+		params = write_references(out, targets, decl->param_count);
+		free(targets);
+	}
+
+	int value = write_expression(out, decl->value);
+	int body = decl->body ? write_statements(out, decl->body) : 0;
+
+	struct SnapDeclaration node = {
+		.type = decl->type.id,
+		.line = decl->token->line,
+		.col = decl->token->col,
+		.function = decl->function,
+		.defined = decl->defined,
+		.param_count = decl->param_count,
+	};
+
+	int at = align_buffer(out);
+	node.name = relative(at, offsetof(struct SnapDeclaration, name), name);
+	node.params = relative(at, offsetof(struct SnapDeclaration, params), params);
+	node.value = relative(at, offsetof(struct SnapDeclaration, value), value);
+	node.body = relative(at, offsetof(struct SnapDeclaration, body), body);
+
+	vec_append(out, &node, sizeof node);
+	return at;
+}
+
+static
+int write_types(struct Vec *out, struct TypeTable *table) {
+	int *names = calloc(table->count + 1, sizeof *names);
+	int *fields = calloc(table->count + 1, sizeof *fields);
+	if (!names || !fields) errx("out of memory: failed to allocate %d types", table->count);
+
+	// names and field arrays first, the type array is indexed by id
+	for (int id = 0; id < table->count; id++) {
+		struct TypeEntry *T = get_type(table, id);
+		if (T->kind != TYPE_STRUCT && T->kind != TYPE_UNION) continue;
+
+		names[id] = T->token ? write_string(out, T->token->text) : 0;
+
+		int *field_names = calloc(T->length + 1, sizeof *field_names);
+		if (!field_names) errx("out of memory: failed to allocate %d fields", T->length);
+
+		for (int i = 0; i < T->length; i++) {
+			field_names[i] = write_string(out, T->fields[i].token->text);
+		}
+
+		fields[id] = T->length ? align_buffer(out) : 0;
+
+		for (int i = 0; i < T->length; i++) {
+			struct SnapField field = {
+				.name = relative(fields[id] + i * sizeof field, offsetof(struct SnapField, name), field_names[i]),
+				.type = T->fields[i].type,
+				.offset = T->fields[i].offset,
+			};
+
+			vec_append(out, &field, sizeof field);
+		}
+
+		free(field_names);
+	}
+
+	int at = align_buffer(out);
+
+	for (int id = 0; id < table->count; id++) {
+		struct TypeEntry *T = get_type(table, id);
+		int record = at + id * sizeof(struct SnapType);
+
+		struct SnapType type = {
+			.kind = T->kind,
+			.basic = T->basic,
+			.pointers = T->pointers,
+			.base = T->base,
+			.length = T->length,
+			.size = T->size,
+			.align = T->align,
+			.name = relative(record, offsetof(struct SnapType, name), names[id]),
+			.fields = relative(record, offsetof(struct SnapType, fields), fields[id]),
+			.soa = T->soa,
+		};
+
+		vec_append(out, &type, sizeof type);
+	}
+
+	free(names);
+	free(fields);
+	return at;
+}
+
+void write_snapshot(const char *path, const char *filename, struct TypeTable *table,
+                    struct AST_Declaration **declarations, int count) {
+	struct Vec out = vec(char);
+	struct SnapHeader header = {
+		.version = SNAPSHOT_VERSION,
+		.type_count = table->count,
+		.declaration_count = count,
+	};
+
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof header.magic);
+	vec_append(&out, &header, sizeof header);
+
+	int name = write_string(&out, filename);
+	int types = write_types(&out, table);
+
+	int *targets = malloc((count + 1) * sizeof *targets);
+	if (!targets) errx("out of memory: failed to allocate %d declarations", count);
+
+	for (int i = 0; i < count; i++) {
+		targets[i] = write_declaration(&out, declarations[i]);
+	}
+
+	int list = write_references(&out, targets, count);
+	align_buffer(&out);
+	free(targets);
+
+	header.size = out.length;
+	header.filename = relative(0, offsetof(struct SnapHeader, filename), name);
+	header.types = relative(0, offsetof(struct SnapHeader, types), types);
+	header.declarations = relative(0, offsetof(struct SnapHeader, declarations), list);
+	memcpy(out.mem, &header, sizeof header);
+
+	FILE *file = fopen(path, "wb");
+	if (!file) errx("cannot open `%s` for writing", path);
+
+	if (fwrite(out.mem, 1, out.length, file) != (size_t)out.length || fclose(file) != 0) {
+		errx("failed to write snapshot `%s`", path);
+	}
+
+	vec_free(&out);
+}
+
+// validation: the reader follows references without checks, so every one
+// is checked once when the snapshot is mapped. the writer appends what a
+// record refers to before the record, a reference must point below the
+// record that holds it, which also rules out cycles. records are checked
+// from a stack of pending references rather than by recursion, a snapshot
+// is as deep as the program it was saved from
+
+enum Pending {
+	PENDING_EXPRESSION,
+	PENDING_STATEMENTS,
+	PENDING_DECLARATION,
+};
+
+struct Reference {
+	enum Pending kind;
+	const int32_t *reference;
+	const void *record;
+};
+
+struct Validation {
+	const char *path, *base;
+	uint32_t size, type_count;
+	struct Vec pending; // struct Reference
+	uint8_t *checked;   // a bit per 4 bytes, so that shared records are checked once
+};
+
+static
+void corrupt(struct Validation *v) {
+	errx("`%s` is a corrupt AST snapshot", v->path);
+}
+
+// the target of a reference with room for `size` bytes, NULL for none
+static
+const char *follow(struct Validation *v, const void *record, const int32_t *reference, int64_t size, int align) {
+	if (*reference == 0) return NULL;
+
+	int64_t at = (const char *)reference - v->base + (int64_t)*reference;
+	int64_t end = (const char *)record - v->base;
+
+	if (at < (int64_t)sizeof(struct SnapHeader) || at + size > end || at % align) corrupt(v);
+	return v->base + at;
+}
+
+static
+bool first_visit(struct Validation *v, const void *record) {
+	uint32_t at = ((const char *)record - v->base) / 4;
+	bool first = !(v->checked[at / 8] & 1 << at % 8);
+
+	v->checked[at / 8] |= 1 << at % 8;
+	return first;
+}
+
+static
+void defer(struct Validation *v, enum Pending kind, const int32_t *reference, const void *record) {
+	if (*reference) vec_push(&v->pending, &(struct Reference) { kind, reference, record });
+}
+
+static
+void check_string(struct Validation *v, const void *record, const int32_t *reference, bool required) {
+	const char *text = follow(v, record, reference, 1, 1);
+
+	if (text == NULL && required) corrupt(v);
+	if (text && !memchr(text, 0, (const char *)record - text)) corrupt(v);
+}
+
+static
+void check_type(struct Validation *v, uint32_t id) {
+	if (id >= v->type_count) corrupt(v);
+}
+
+static
+void check_expression(struct Validation *v, const int32_t *reference, const void *record) {
+	const struct SnapExpression *expr = (const void *)follow(v, record, reference, sizeof *expr, 4);
+	if (expr == NULL || !first_visit(v, expr)) return;
+
+	if (!expr->kind || expr->kind > FUNC_CALL || (expr->kind & (expr->kind - 1))) corrupt(v);
+
+	check_type(v, expr->type);
+	check_string(v, expr, &expr->text, expr->kind == STRING || expr->kind == IDENTIFIER);
+	defer(v, PENDING_EXPRESSION, &expr->lhs, expr);
+	defer(v, PENDING_EXPRESSION, &expr->rhs, expr);
+}
+
+static
+void check_statements(struct Validation *v, const int32_t *reference, const void *record) {
+	// lists are followed in a loop, each next statement lies below the last
+	for (const struct SnapStatement *stmt; (stmt = (const void *)follow(v, record, reference, sizeof *stmt, 4));
+	     reference = &stmt->next, record = stmt) {
+		if (!first_visit(v, stmt)) return;
+		if (stmt->kind > STMT_CASE) corrupt(v);
+
+		defer(v, PENDING_EXPRESSION, &stmt->expression, stmt);
+		defer(v, PENDING_DECLARATION, &stmt->declaration, stmt);
+		defer(v, PENDING_STATEMENTS, &stmt->body, stmt);
+		defer(v, PENDING_STATEMENTS, &stmt->otherwise, stmt);
+
+		if (stmt->case_count > UINT32_MAX / sizeof(struct SnapCase)) corrupt(v);
+		if (stmt->case_count && !follow(v, stmt, &stmt->cases, stmt->case_count * sizeof(struct SnapCase), 4)) {
+			corrupt(v);
+		}
+	}
+}
+
+static
+void check_declaration(struct Validation *v, const int32_t *reference, const void *record) {
+	const struct SnapDeclaration *decl = (const void *)follow(v, record, reference, sizeof *decl, 4);
+	if (decl == NULL || !first_visit(v, decl)) return;
+
+	check_type(v, decl->type);
+	check_string(v, decl, &decl->name, true);
+
+	const int32_t *params = (const void *)follow(v, decl, &decl->params, decl->param_count * sizeof(int32_t), 4);
+	if (decl->param_count && !params) corrupt(v);
+
+	for (int i = 0; i < decl->param_count; i++) {
+		if (params[i] == 0) corrupt(v);
+		defer(v, PENDING_DECLARATION, &params[i], params);
+	}
+
+	defer(v, PENDING_EXPRESSION, &decl->value, decl);
+	defer(v, PENDING_STATEMENTS, &decl->body, decl);
+}
+
+static
+void check_pending(struct Validation *v) {
+	while (v->pending.length) {
+		struct Reference next = ((struct Reference *)v->pending.mem)[v->pending.length - 1];
+		vec_truncate(&v->pending, v->pending.length - 1);
+
+		switch (next.kind) {
+			case PENDING_EXPRESSION:  check_expression(v, next.reference, next.record); break;
+			case PENDING_STATEMENTS:  check_statements(v, next.reference, next.record); break;
+			case PENDING_DECLARATION: check_declaration(v, next.reference, next.record); break;
+		}
+	}
+}
+
+// the types refer to each other by id: pointers and arrays to a type with a
+// smaller id, which they are always created after
+static
+void check_types(struct Validation *v, const struct SnapHeader *header) {
+	const char *end = v->base + v->size;
+
+	if (header->type_count > UINT32_MAX / sizeof(struct SnapType)) corrupt(v);
+	const struct SnapType *types = (const void *)follow(v, end, &header->types, header->type_count * sizeof *types, 4);
+	if (header->type_count && !types) corrupt(v);
+
+	for (uint32_t id = 0; id < header->type_count; id++) {
+		const struct SnapType *T = &types[id];
+
+		if (T->kind > TYPE_UNION || T->basic > U32X4) corrupt(v);
+		if ((T->kind == TYPE_POINTER || T->kind == TYPE_ARRAY) && T->base >= id) corrupt(v);
+
+		check_string(v, T, &T->name, false);
+		if (T->kind != TYPE_STRUCT && T->kind != TYPE_UNION) continue;
+
+		if (T->length < 0 || (uint32_t)T->length > UINT32_MAX / sizeof(struct SnapField)) corrupt(v);
+		const struct SnapField *fields = (const void *)follow(v, T, &T->fields, T->length * sizeof *fields, 4);
+		if (T->length && !fields) corrupt(v);
+
+		for (int i = 0; i < T->length; i++) {
+			check_type(v, fields[i].type);
+			check_string(v, &fields[i], &fields[i].name, true);
+		}
+	}
+}
+
+static
+void validate_snapshot(const char *path, const struct SnapHeader *header) {
+	struct Validation v = {
+		path, (const char *)header, header->size, header->type_count,
+		vec(struct Reference), calloc(header->size / 32 + 1, 1),
+	};
+
+	if (!v.checked) errx("out of memory: failed to allocate %u bytes", header->size / 32 + 1);
+	const char *end = v.base + v.size;
+
+	check_string(&v, end, &header->filename, false);
+	check_types(&v, header);
+
+	if (header->declaration_count > UINT32_MAX / sizeof(int32_t)) corrupt(&v);
+	const int32_t *declarations = (const void *)follow(&v, end, &header->declarations,
+	                                                   header->declaration_count * sizeof(int32_t), 4);
+	if (header->declaration_count && !declarations) corrupt(&v);
+
+	for (uint32_t i = 0; i < header->declaration_count; i++) {
+		if (declarations[i] == 0) corrupt(&v);
+		defer(&v, PENDING_DECLARATION, &declarations[i], declarations);
+	}
+
+	check_pending(&v);
+	vec_free(&v.pending);
+	free(v.checked);
+}
+
+const struct SnapHeader *map_snapshot(const char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) errx("file `%s` not found", path);
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(struct SnapHeader)) {
+		errx("`%s` is not an AST snapshot", path);
+	}
+
+	const struct SnapHeader *header = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (header == MAP_FAILED) errx("cannot map `%s`", path);
+
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof header->magic) != 0 ||
+	    header->size != (size_t)info.st_size) {
+		errx("`%s` is not an AST snapshot", path);
+	}
+
+	if (header->version != SNAPSHOT_VERSION) {
+		errx("`%s` is a version %u snapshot, expected version %d", path, header->version, SNAPSHOT_VERSION);
+	}
+
+	validate_snapshot(path, header);
+	return header;
+}
+
+void unmap_snapshot(const struct SnapHeader *header) {
+	munmap((void *)header, header->size);
+}
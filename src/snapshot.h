@@ -0,0 +1,115 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include "ast.h"
+#include "types.h"
+
+#include <stdint.h>
+
+// AST snapshots:
+//
+// the typed AST of a file written as one position-independent block, so
+// that a snapshot can be mapped read-only and walked in place. every
+// reference is an offset from the field that holds it, 0 for none, and
+// every record is 4-byte aligned. strings are NUL-terminated. the type
+// table is included so that type ids resolve without the compiler.
+//
+// bump SNAPSHOT_VERSION whenever a record changes
+//
+
+#define SNAPSHOT_MAGIC "UCAS"
+
+enum {
+	SNAPSHOT_VERSION = 4,
+};
+
+struct SnapHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t size; // of the whole snapshot, in bytes
+
+	int32_t filename;
+	uint32_t type_count;
+	int32_t types;        // struct SnapType[type_count], indexed by id
+	uint32_t declaration_count;
+	int32_t declarations; // int32_t[declaration_count], to struct SnapDeclaration
+};
+
+struct SnapField {
+	int32_t name;
+	uint32_t type;
+	int32_t offset;
+};
+
+struct SnapType {
+	uint8_t kind;  // enum TypeKind
+	uint8_t basic; // enum BasicType
+	uint16_t pointers;
+	uint32_t base;
+	int32_t length;
+	int32_t size, align;
+	int32_t name;   // aggregates
+	int32_t fields; // struct SnapField[length], aggregates
+	uint8_t soa;    // struct of arrays
+	uint8_t reserved[3];
+};
+
+struct SnapExpression {
+	uint8_t kind;       // enum AST_ExpressionType
+	uint8_t temporary;
+	uint8_t token_type; // enum TokenType of the operator
+	uint8_t reserved;
+	uint32_t type;
+	uint32_t value;     // literal value, operator token value or builtin of a call
+	int32_t line, col;
+	int32_t text;       // string contents or identifier name
+	int32_t lhs, rhs;   // unary ops and casts use rhs, calls are lhs(rhs)
+};
+
+struct SnapStatement {
+	uint8_t kind; // enum AST_StatementType
+	uint8_t reserved[3];
+	int32_t line, col;
+	int32_t next;
+	int32_t expression;  // expression, return value or condition
+	int32_t declaration;
+	int32_t body;        // block and loop body, then branch
+	int32_t otherwise;
+
+	// a switch: its default label or -1, and its cases sorted by value.
+	// a case statement: the index of its label in the switch
+	int32_t label;
+	uint32_t case_count;
+	int32_t cases;       // struct SnapCase[case_count]
+};
+
+struct SnapCase {
+	uint32_t value;
+	int32_t label;
+};
+
+struct SnapDeclaration {
+	int32_t name;
+	uint32_t type;
+	int32_t line, col;
+	uint8_t function, defined;
+	uint16_t param_count;
+	int32_t params; // int32_t[param_count], to struct SnapDeclaration
+	int32_t value;
+	int32_t body;
+};
+
+static inline
+const void *snap_get(const int32_t *reference) {
+	return *reference ? (const char *)reference + *reference : NULL;
+}
+
+void write_snapshot(const char *path, const char *filename, struct TypeTable *,
+                    struct AST_Declaration **, int count);
+
+// maps and validates a snapshot, errors are fatal. every reference in a
+// mapped snapshot points inside it, every type id is below type_count
+const struct SnapHeader *map_snapshot(const char *path);
+void unmap_snapshot(const struct SnapHeader *);
+
+#endif //SNAPSHOT_H_
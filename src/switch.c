@@ -0,0 +1,269 @@
+#include "switch.h"
+
+#include "ast.h"
+#include "parser.h"
+#include "util.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// planning works on keys: values with the sign bit flipped for an int, so
+// that keys compare unsigned in the order of the values. the differences
+// of keys are those of the values
+
+struct Cluster {
+	enum SwitchTest test;
+	uint32_t low, high; // keys
+	int label;          // equal and range
+	int first, last;    // bits and tables: the ranges they replace
+};
+
+struct Planner {
+	struct SwitchPlan *plan;
+	uint32_t bias;
+
+	struct Cluster *ranges;
+	int range_count;
+
+	struct Cluster *clusters;
+	int cluster_count;
+};
+
+// one test per label for the whole run must beat a chain of comparisons
+static
+bool worth_bits(int labels, int comparisons) {
+	return (labels == 1 && comparisons >= 3) || (labels == 2 && comparisons >= 5) || (labels == 3 && comparisons >= 6);
+}
+
+// the ranges are partitioned into as few clusters as possible, each a
+// range, a bit test or a table. this is quadratic, so a window of ranges
+// is tried from each one. bit tests are preferred over tables of the same
+// ranges, they need no indirect jump
+static
+void partition(struct Planner *p, bool tables) {
+	int n = p->range_count;
+	int *best = malloc((n + 1) * sizeof *best);
+	int *end = malloc((n + 1) * sizeof *end);
+	enum SwitchTest *kind = malloc((n + 1) * sizeof *kind);
+
+	if (!best || !end || !kind) errx("out of memory: failed to plan a switch of %d cases", n);
+
+	best[n] = 0;
+
+	for (int i = n - 1; i >= 0; i--) {
+		best[i] = 1 + best[i + 1];
+		end[i] = i + 1;
+		kind[i] = p->ranges[i].test;
+
+		int labels[MAX_MASKS + 1], label_count = 0, comparisons = 0;
+		uint64_t values = 0;
+
+		for (int j = i; j < n && j - i < MAX_TABLE_RANGES; j++) {
+			struct Cluster *range = &p->ranges[j];
+			uint64_t width = (uint64_t)range->high - p->ranges[i].low + 1;
+
+			if (width > (tables ? MAX_TABLE_SIZE : MASK_BITS)) break;
+
+			values += (uint64_t)range->high - range->low + 1;
+			comparisons += range->test == SWITCH_EQUAL ? 1 : 2;
+
+			if (label_count <= MAX_MASKS) {
+				bool seen = false;
+				for (int k = 0; k < label_count; k++) seen |= labels[k] == range->label;
+				if (!seen) labels[label_count++] = range->label;
+			}
+
+			if (j == i) continue;
+
+			bool bits = width <= MASK_BITS && label_count <= MAX_MASKS && worth_bits(label_count, comparisons);
+			bool table = tables && j - i + 1 >= MIN_TABLE_CASES && values * 100 >= width * MIN_TABLE_DENSITY;
+			int cost = 1 + best[j + 1];
+
+			if (bits && (cost < best[i] || (cost == best[i] && kind[i] == SWITCH_TABLE))) {
+				best[i] = cost;
+				end[i] = j + 1;
+				kind[i] = SWITCH_BITS;
+			} else if (table && cost < best[i]) {
+				best[i] = cost;
+				end[i] = j + 1;
+				kind[i] = SWITCH_TABLE;
+			}
+		}
+	}
+
+	p->clusters = malloc(best[0] * sizeof *p->clusters);
+	if (!p->clusters) errx("out of memory: failed to plan a switch of %d cases", n);
+
+	for (int i = 0; i < n; i = end[i]) {
+		struct Cluster cluster = p->ranges[i];
+
+		if (end[i] > i + 1) {
+			cluster.test = kind[i];
+			cluster.high = p->ranges[end[i] - 1].high;
+			cluster.first = i;
+			cluster.last = end[i] - 1;
+		}
+
+		p->clusters[p->cluster_count++] = cluster;
+	}
+
+	free(best);
+	free(end);
+	free(kind);
+}
+
+static
+int add_node(struct Planner *p, struct SwitchNode node) {
+	vec_push(&p->plan->nodes, &node);
+	return p->plan->nodes.length - 1;
+}
+
+static
+int cluster_node(struct Planner *p, struct Cluster *cluster, bool always, int next) {
+	struct SwitchPlan *plan = p->plan;
+	struct SwitchNode node = {
+		.test = cluster->test,
+		.low = cluster->low ^ p->bias,
+		.high = cluster->high ^ p->bias,
+		.always = always,
+		.label = cluster->label,
+		.next = next,
+	};
+
+	if (cluster->test == SWITCH_BITS) {
+		node.first = plan->masks.length;
+
+		for (int i = cluster->first; i <= cluster->last; i++) {
+			struct Cluster *range = &p->ranges[i];
+			struct SwitchMask *masks = (struct SwitchMask *)plan->masks.mem + node.first;
+			int k = 0;
+
+			while (k < node.count && masks[k].label != range->label) k++;
+
+			if (k == node.count) {
+				struct SwitchMask mask = { 0, range->label };
+				vec_push(&plan->masks, &mask);
+				node.count++;
+			}
+
+			masks = (struct SwitchMask *)plan->masks.mem + node.first;
+			for (uint64_t key = range->low; key <= range->high; key++) masks[k].bits |= 1u << (key - cluster->low);
+		}
+	}
+
+	if (cluster->test == SWITCH_TABLE) {
+		node.first = plan->entries.length;
+		node.count = cluster->high - cluster->low + 1;
+
+		int otherwise = -1;
+		for (int i = 0; i < node.count; i++) vec_push(&plan->entries, &otherwise);
+
+		int *entries = (int *)plan->entries.mem + node.first;
+
+		for (int i = cluster->first; i <= cluster->last; i++) {
+			struct Cluster *range = &p->ranges[i];
+			for (uint64_t key = range->low; key <= range->high; key++) entries[key - cluster->low] = range->label;
+		}
+	}
+
+	return add_node(p, node);
+}
+
+// the clusters [first, last) with the keys known to be in [low, high]: a
+// few are tested in a chain, more are split in half by a comparison
+static
+int build_tree(struct Planner *p, int first, int last, uint32_t low, uint32_t high) {
+	if (last - first <= LEAF_TESTS) {
+		bool always[LEAF_TESTS];
+
+		// a test that fails rules out its range: a chain narrows from below
+		for (int i = first; i < last; i++) {
+			struct Cluster *cluster = &p->clusters[i];
+
+			always[i - first] = cluster->low <= low && cluster->high >= high;
+			if (cluster->low <= low) low = cluster->high + 1;
+		}
+
+		int next = -1;
+
+		for (int i = last - 1; i >= first; i--) {
+			next = cluster_node(p, &p->clusters[i], always[i - first], next);
+		}
+
+		return next;
+	}
+
+	int middle = first + (last - first) / 2;
+	uint32_t pivot = p->clusters[middle].low;
+
+	int node = add_node(p, (struct SwitchNode) { .test = SWITCH_SPLIT, .low = pivot ^ p->bias, .next = -1 });
+	int less = build_tree(p, first, middle, low, pivot - 1);
+	int more = build_tree(p, middle, last, pivot, high);
+
+	switch_node(p->plan, node)->less = less;
+	switch_node(p->plan, node)->more = more;
+	return node;
+}
+
+void plan_switch(struct SwitchPlan *plan, struct AST_StmtSwitch *s, bool tables) {
+	*plan = (struct SwitchPlan) {
+		.sign = expression_type(s->condition).id == INT,
+		.root = -1,
+		.nodes = vec(struct SwitchNode),
+		.masks = vec(struct SwitchMask),
+		.entries = vec(int),
+	};
+
+	if (s->case_count == 0) return;
+
+	struct Planner p = {
+		.plan = plan,
+		.bias = plan->sign ? 0x80000000u : 0,
+		.ranges = malloc(s->case_count * sizeof *p.ranges),
+	};
+
+	if (!p.ranges) errx("out of memory: failed to plan a switch of %d cases", s->case_count);
+
+	// adjacent values with the same label
+	for (int i = 0; i < s->case_count; i++) {
+		uint32_t key = s->cases[i].value ^ p.bias;
+		struct Cluster *last = p.range_count ? &p.ranges[p.range_count - 1] : NULL;
+
+		if (last && last->label == s->cases[i].label && last->high + 1 == key) {
+			last->high = key;
+			last->test = SWITCH_RANGE;
+			continue;
+		}
+
+		p.ranges[p.range_count++] = (struct Cluster) { SWITCH_EQUAL, key, key, s->cases[i].label, 0, 0 };
+	}
+
+	partition(&p, tables);
+	plan->root = build_tree(&p, 0, p.cluster_count, 0, UINT32_MAX);
+
+	free(p.ranges);
+	free(p.clusters);
+}
+
+void free_switch_plan(struct SwitchPlan *plan) {
+	vec_free(&plan->nodes);
+	vec_free(&plan->masks);
+	vec_free(&plan->entries);
+}
+
+int find_case(struct AST_StmtSwitch *s, uint32_t value) {
+	uint32_t bias = expression_type(s->condition).id == INT ? 0x80000000u : 0;
+	uint32_t key = value ^ bias;
+	int low = 0, high = s->case_count;
+
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		uint32_t other = s->cases[middle].value ^ bias;
+
+		if (other == key) return s->cases[middle].label;
+		if (other < key) low = middle + 1;
+		else             high = middle;
+	}
+
+	return s->otherwise;
+}
@@ -0,0 +1,85 @@
+#ifndef SWITCH_H_
+#define SWITCH_H_
+
+#include "ast.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// switch lowering:
+//
+// the cases of a switch are planned once into a tree of tests that each
+// backend emits in its own instructions. adjacent values with the same
+// label are merged into ranges, dense runs of cases become jump tables,
+// small runs with few labels become bit tests, and whatever is left is
+// searched by a balanced tree of comparisons, with a short chain of tests
+// at each leaf. values are 32-bit, compared signed when the condition is
+// an int; ranges are tested as `value - low <= high - low` unsigned.
+//
+// a test that fails goes on to `next`, -1 for the default. a value in the
+// range of a bit test or a table that has no case also goes to the
+// default: nothing else covers it.
+//
+
+enum SwitchTest {
+	SWITCH_EQUAL, // value == low
+	SWITCH_RANGE, // low <= value <= high
+	SWITCH_BITS,  // low <= value <= high, then one mask per label
+	SWITCH_TABLE, // low <= value <= high, then a label per value from low
+	SWITCH_SPLIT, // value < low: less, otherwise more
+};
+
+struct SwitchNode {
+	enum SwitchTest test;
+	uint32_t low, high;
+
+	// the value is known to be in range: equal and range always match,
+	// bits and tables need no range check
+	bool always;
+
+	int label;        // equal and range
+	int first, count; // bits: masks, table: entries
+	int less, more;   // split
+	int next;
+};
+
+// bit n is set for the value low + n
+struct SwitchMask {
+	uint32_t bits;
+	int label;
+};
+
+struct SwitchPlan {
+	bool sign;
+	int root; // -1 when there are no cases
+
+	struct Vec nodes;   // struct SwitchNode
+	struct Vec masks;   // struct SwitchMask
+	struct Vec entries; // int: labels of tables, -1 for the default
+};
+
+enum {
+	MIN_TABLE_CASES = 4,    // ranges a table replaces
+	MIN_TABLE_DENSITY = 40, // percent of the values in a table with a case
+	MAX_TABLE_SIZE = 1 << 16,
+	MAX_TABLE_RANGES = 4096,
+	MASK_BITS = 32,
+	MAX_MASKS = 3,          // labels one bit test tells apart
+	LEAF_TESTS = 3,         // tests chained at a leaf of the tree
+};
+
+// backends without an indirect jump plan without tables
+void plan_switch(struct SwitchPlan *, struct AST_StmtSwitch *, bool tables);
+void free_switch_plan(struct SwitchPlan *);
+
+static inline
+struct SwitchNode *switch_node(struct SwitchPlan *plan, int node) {
+	return (struct SwitchNode *)plan->nodes.mem + node;
+}
+
+// the label a value goes to by a binary search of the cases, the default
+// label when none matches
+int find_case(struct AST_StmtSwitch *, uint32_t value);
+
+#endif //SWITCH_H_
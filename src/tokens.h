@@ -20,6 +20,7 @@ enum TokenType {
 	KEYWORD_CASE,
 	// KEYWORD_CHAR,
 	// KEYWORD_CONTINUE,
+	KEYWORD_DEFAULT,
 	KEYWORD_DO,
 	KEYWORD_ELSE,
 	KEYWORD_ENUM,
@@ -28,6 +29,7 @@ enum TokenType {
 	KEYWORD_INT,
 	KEYWORD_RETURN,
 	KEYWORD_SIZEOF,
+	KEYWORD_SOA,
 	KEYWORD_STRUCT,
 	KEYWORD_SWITCH,
 	KEYWORD_TRUE,
@@ -35,17 +37,21 @@ enum TokenType {
 	KEYWORD_U8,
 	KEYWORD_U16,
 	KEYWORD_U32,
+	KEYWORD_U8X16,
+	KEYWORD_U32X4,
 	KEYWORD_VOID,
 	KEYWORD_WHILE,
 	KEYWORD_END,
 
 	PREPROC,
+	PREPROC_DEFINE,
 	PREPROC_ELIF,
 	PREPROC_ELSE,
 	PREPROC_ENDIF,
 	PREPROC_ERROR,
 	PREPROC_IF,
 	PREPROC_INCLUDE,
+	PREPROC_PRAGMA,
 	PREPROC_WARNING,
 	PREPROC_END,
 
@@ -97,6 +103,14 @@ enum MultiChar {
 
 	COM = multichar_mix(':', ':'),
 
+	// never lexed: the high half of a 32 by 32 bit product, made by strength
+	// reduction, signed when its type is int
+	MUL_HIGH = multichar_mix('*', '*'),
+
+	// never lexed: an array index checked at run time, the lhs unless it is
+	// not below the rhs as unsigned, then the program traps
+	CHECK_INDEX = multichar_mix('[', '<'),
+
 	POST_INC = INC + 1,
 	POST_DEC = DEC + 1,
 };
@@ -0,0 +1,348 @@
+#include "types.h"
+
+#include "tokens.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+	DEFAULT_INDEX_SIZE = 1 << 8,
+	POINTER_SIZE = 8, // x86-64
+};
+
+static
+unsigned *allocate_index(int capacity) {
+	unsigned *index = calloc(capacity, sizeof *index);
+
+	if (!index) {
+		errx("out of memory: failed to allocate %zu bytes", capacity * sizeof *index);
+	}
+
+	return index;
+}
+
+static
+unsigned new_type(struct TypeTable *table, struct TypeEntry *entry) {
+	unsigned id = table->count;
+
+	if (id % TYPE_CHUNK_SIZE == 0) {
+		if (id / TYPE_CHUNK_SIZE == MAX_TYPE_CHUNKS)
+			errx("too many types: limit is %d", TYPE_CHUNK_SIZE * MAX_TYPE_CHUNKS);
+
+		struct TypeEntry *chunk = malloc(TYPE_CHUNK_SIZE * sizeof *chunk);
+		if (!chunk) errx("out of memory: failed to allocate %zu bytes", TYPE_CHUNK_SIZE * sizeof *chunk);
+
+		table->chunks[id / TYPE_CHUNK_SIZE] = chunk;
+	}
+
+	*get_type(table, id) = *entry;
+	table->count++;
+
+	return id;
+}
+
+
+// derived types are keyed by (kind, base, length)
+static
+unsigned key_hash(enum TypeKind kind, unsigned base, int length) {
+	unsigned key[3] = { kind, base, length };
+	return hash((const char *)key, sizeof key);
+}
+
+static
+void grow_index(struct TypeTable *table) {
+	free(table->index);
+
+	table->capacity <<= 1;
+	table->index = allocate_index(table->capacity);
+
+	unsigned mask = table->capacity - 1;
+
+	for (int id = 0; id < table->count; id++) {
+		struct TypeEntry *entry = get_type(table, id);
+		if (entry->kind != TYPE_POINTER && entry->kind != TYPE_ARRAY) continue;
+
+		unsigned slot = entry->hash & mask;
+		while (table->index[slot]) slot = (slot + 1) & mask;
+
+		table->index[slot] = id + 1;
+	}
+}
+
+static
+unsigned intern_derived(struct TypeTable *table, struct TypeEntry *entry) {
+	pthread_mutex_lock(&table->lock);
+
+	if (2 * (table->count + 1) > table->capacity) {
+		grow_index(table);
+	}
+
+	entry->hash = key_hash(entry->kind, entry->base, entry->length);
+
+	unsigned mask = table->capacity - 1;
+	unsigned slot = entry->hash & mask;
+
+	while (table->index[slot]) {
+		struct TypeEntry *other = get_type(table, table->index[slot] - 1);
+
+		if (other->hash == entry->hash && other->kind == entry->kind &&
+		    other->base == entry->base && other->length == entry->length) {
+			pthread_mutex_unlock(&table->lock);
+			return table->index[slot] - 1;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	unsigned id = new_type(table, entry);
+	table->index[slot] = id + 1;
+
+	pthread_mutex_unlock(&table->lock);
+	return id;
+}
+
+
+void init_type_table(struct TypeTable *table) {
+	table->count = 0;
+	table->capacity = DEFAULT_INDEX_SIZE;
+	table->index = allocate_index(table->capacity);
+	pthread_mutex_init(&table->lock, NULL);
+
+	static const int sizes[] = {
+		[VOID] = 0, [U8] = 1, [U16] = 2, [U32] = 4, [INT] = 4,
+		[U8X16] = 16, [U32X4] = 16,
+	};
+
+	static const unsigned lane_types[] = {
+		[U8X16] = U8, [U32X4] = U32,
+	};
+
+	for (enum BasicType T = VOID; T <= U32X4; T++) {
+		struct TypeEntry entry = {
+			.kind = TYPE_BASIC,
+			.basic = T,
+			.size = sizes[T],
+			.align = max(sizes[T], 1),
+		};
+
+		if (T >= U8X16) {
+			entry.base = lane_types[T];
+			entry.length = sizes[T] / sizes[lane_types[T]];
+		}
+
+		unsigned id = new_type(table, &entry);
+		assert(id == T);
+	}
+}
+
+void free_type_table(struct TypeTable *table) {
+	for (int i = 0; i * TYPE_CHUNK_SIZE < table->count; i++) {
+		struct TypeEntry *chunk = table->chunks[i];
+
+		for (int j = 0; j < TYPE_CHUNK_SIZE && i * TYPE_CHUNK_SIZE + j < table->count; j++) {
+			free(chunk[j].fields);
+		}
+
+		free(chunk);
+	}
+
+	free(table->index);
+	pthread_mutex_destroy(&table->lock);
+	table->count = 0;
+	table->capacity = 0;
+}
+
+
+unsigned pointer_to(struct TypeTable *table, unsigned base) {
+	struct TypeEntry *T = get_type(table, base);
+
+	struct TypeEntry entry = {
+		.kind = TYPE_POINTER,
+		.basic = T->basic,
+		.base = base,
+		.pointers = T->pointers + 1,
+		.size = POINTER_SIZE,
+		.align = POINTER_SIZE,
+	};
+
+	return intern_derived(table, &entry);
+}
+
+unsigned array_of(struct TypeTable *table, unsigned element, int length) {
+	struct TypeEntry *T = get_type(table, element);
+
+	// only a soa struct may have a size that is not a multiple of its alignment
+	struct TypeEntry entry = {
+		.kind = TYPE_ARRAY,
+		.basic = T->basic,
+		.base = element,
+		.length = length,
+		.pointers = T->pointers,
+		.size = (T->size * length + T->align - 1) / T->align * T->align,
+		.align = T->align,
+	};
+
+	return intern_derived(table, &entry);
+}
+
+unsigned declare_aggregate(struct TypeTable *table, enum TypeKind kind, struct Token *name, bool soa) {
+	assert(kind == TYPE_STRUCT || (kind == TYPE_UNION && !soa));
+
+	struct TypeEntry entry = {
+		.kind = kind,
+		.basic = VOID,
+		.token = name,
+		.align = 1,
+		.incomplete = true,
+		.soa = soa,
+	};
+
+	pthread_mutex_lock(&table->lock);
+	unsigned id = new_type(table, &entry);
+	pthread_mutex_unlock(&table->lock);
+
+	return id;
+}
+
+int order_fields(struct TypeTable *table, struct Field *fields, int count, int *order) {
+	int placed = 0;
+
+	for (int align = 16; align >= 1; align >>= 1) {
+		for (int i = 0; i < count; i++) {
+			if (type_align(table, fields[i].type) == align) order[placed++] = i;
+		}
+	}
+
+	return placed;
+}
+
+void define_aggregate(struct TypeTable *table, unsigned id, struct Field *fields, int count) {
+	struct TypeEntry *entry = get_type(table, id);
+	assert(entry->incomplete);
+
+	struct Field *copy = NULL;
+
+	if (count > 0) {
+		copy = malloc(count * sizeof *fields);
+		if (!copy) errx("out of memory: failed to allocate %zu bytes", count * sizeof *fields);
+		memcpy(copy, fields, count * sizeof *fields);
+	}
+
+	int *order = malloc(max(count, 1) * sizeof *order);
+	if (!order) errx("out of memory: failed to allocate %zu bytes", count * sizeof *order);
+
+	int placed = count;
+	for (int i = 0; i < count; i++) order[i] = i;
+
+	// lay out fields in declaration order, union members all start at 0
+	// and soa fields one after the other by alignment
+	if (entry->soa) placed = order_fields(table, copy, count, order);
+	assert(placed == count);
+
+	int offset = 0, align = 1;
+
+	for (int i = 0; i < count; i++) {
+		struct Field *field = &copy[order[i]];
+		struct TypeEntry *T = get_type(table, field->type);
+
+		if (entry->kind == TYPE_UNION) {
+			field->offset = 0;
+			offset = max(offset, T->size);
+		} else {
+			if (!entry->soa) offset = (offset + T->align - 1) / T->align * T->align;
+			field->offset = offset;
+			offset += T->size;
+		}
+
+		align = max(align, T->align);
+	}
+
+	free(order);
+
+	pthread_mutex_lock(&table->lock);
+
+	entry->fields = copy;
+	entry->length = count;
+	entry->align = align;
+	entry->size = entry->soa ? offset : (offset + align - 1) / align * align;
+	entry->incomplete = false;
+
+	pthread_mutex_unlock(&table->lock);
+}
+
+struct Field *find_field(struct TypeTable *table, unsigned id, const char *name) {
+	struct TypeEntry *T = get_type(table, id);
+
+	for (int i = 0; i < T->length; i++) {
+		if (strcmp(T->fields[i].token->text, name) == 0) return &T->fields[i];
+	}
+
+	return NULL;
+}
+
+
+// the text written so far, past `size` it is only counted
+struct Printer {
+	char *buffer;
+	size_t size, length;
+};
+
+static
+void print_text(struct Printer *p, const char *text) {
+	for (; *text; text++, p->length++) {
+		if (p->length < p->size) p->buffer[p->length] = *text;
+	}
+}
+
+static
+void print(struct TypeTable *table, unsigned id, struct Printer *p) {
+	struct TypeEntry *T = get_type(table, id);
+
+	switch (T->kind) {
+		case TYPE_BASIC: {
+			static const char *names[] = {
+				[VOID] = "void", [U8] = "u8", [U16] = "u16", [U32] = "u32", [INT] = "int",
+				[U8X16] = "u8x16", [U32X4] = "u32x4",
+			};
+
+			print_text(p, names[T->basic]);
+			break;
+		}
+
+		case TYPE_POINTER:
+			print(table, T->base, p);
+			print_text(p, is_pointer(table, T->base) ? "*" : " *");
+			break;
+
+		case TYPE_ARRAY: {
+			char length[16];
+			snprintf(length, sizeof length, " [%d]", T->length);
+
+			print(table, T->base, p);
+			print_text(p, length);
+			break;
+		}
+
+		case TYPE_STRUCT:
+		case TYPE_UNION:
+			print_text(p, T->kind == TYPE_STRUCT ? "struct " : "union ");
+			print_text(p, T->token ? T->token->text : "<anonymous>");
+			break;
+	}
+}
+
+const char *print_type(struct TypeTable *table, unsigned id, char *buffer, size_t size) {
+	struct Printer p = { buffer, size - 1, 0 };
+	print(table, id, &p);
+
+	if (p.length > p.size) {
+		// a type too long for the buffer ends in an ellipsis
+		p.length = p.size;
+		memcpy(buffer + p.size - 3, "...", 3);
+	}
+
+	buffer[p.length] = 0;
+	return buffer;
+}
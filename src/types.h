@@ -0,0 +1,148 @@
+#ifndef TYPES_H_
+#define TYPES_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// type table:
+//
+// every distinct type is interned once and named by a 32-bit id, so type
+// equality is an integer compare. size, alignment and field offsets are
+// computed when a type is interned, or an aggregate defined, and cached on
+// its entry. the basic types are interned first, their ids are the values
+// of enum BasicType.
+// the vector types hold 16 bytes as lanes of an integer type, their entry
+// names the lane type as its base and the number of lanes as its length.
+//
+// a soa struct is laid out as a struct of arrays: an array of n of them
+// holds each field as an array of n, one after the other. the offset of a
+// field is the sum of the sizes of the fields stored before it, its array
+// starts at n times that. fields are stored by decreasing alignment, so
+// the arrays need no padding between them and the size of the struct is
+// the sum of its fields. the size of an array of n is n times that, rounded
+// up to the alignment.
+//
+
+enum BasicType {
+	VOID, U8, U16, U32, INT,
+	U8X16, U32X4,
+};
+
+// type info for AST_ExprNode
+struct ExpressionType {
+	unsigned id: 31, temporary: 1;
+};
+
+enum TypeKind {
+	TYPE_BASIC,
+	TYPE_POINTER,
+	TYPE_ARRAY,
+	TYPE_STRUCT,
+	TYPE_UNION,
+};
+
+struct Field {
+	struct Token *token;
+	unsigned type;
+	int offset;
+};
+
+struct TypeEntry {
+	enum TypeKind kind;
+	enum BasicType basic; // innermost basic type, VOID for aggregates
+	unsigned base;        // pointee, element or lane type
+	int length;           // array length, field count or lanes
+	int pointers;         // levels of indirection
+
+	int size, align;
+	struct Field *fields;
+	struct Token *token;  // aggregate name
+
+	bool incomplete; // aggregates declared but not yet defined
+	bool soa;        // struct of arrays
+
+	unsigned hash;
+};
+
+enum {
+	TYPE_CHUNK_SIZE = 1 << 10,
+	MAX_TYPE_CHUNKS = 1 << 10,
+};
+
+struct TypeTable {
+	// entries are stored in fixed size chunks and never move
+	struct TypeEntry *chunks[MAX_TYPE_CHUNKS];
+	int count;
+
+	// open addressing: id + 1, 0 if empty
+	unsigned *index;
+	int capacity;
+
+	// taken when interning, so that parsers on several threads can share
+	// a table: lookups by id need no lock as entries never move
+	pthread_mutex_t lock;
+};
+
+void init_type_table(struct TypeTable *);
+void free_type_table(struct TypeTable *);
+
+static inline
+struct TypeEntry *get_type(struct TypeTable *table, unsigned id) {
+	return &table->chunks[id / TYPE_CHUNK_SIZE][id % TYPE_CHUNK_SIZE];
+}
+
+unsigned pointer_to(struct TypeTable *, unsigned base);
+unsigned array_of(struct TypeTable *, unsigned element, int length);
+
+// aggregates are nominal: each declaration creates a new type, incomplete
+// until it is defined once with its fields, which are copied
+unsigned declare_aggregate(struct TypeTable *, enum TypeKind, struct Token *name, bool soa);
+void define_aggregate(struct TypeTable *, unsigned id, struct Field *, int count);
+
+// indices of the fields by decreasing alignment, in declaration order
+// otherwise: how soa structs store them, and the order that needs the
+// least padding in a struct. returns how many were placed
+int order_fields(struct TypeTable *, struct Field *, int count, int *order);
+
+// the field of a struct or union by name, NULL if it has none
+struct Field *find_field(struct TypeTable *, unsigned id, const char *name);
+
+static inline
+bool is_pointer(struct TypeTable *table, unsigned id) { return get_type(table, id)->kind == TYPE_POINTER; }
+
+static inline
+unsigned pointee(struct TypeTable *table, unsigned id) { return get_type(table, id)->base; }
+
+static inline
+bool is_array(struct TypeTable *table, unsigned id) { return get_type(table, id)->kind == TYPE_ARRAY; }
+
+// arrays, structs and unions: values of them are never loaded or stored whole
+static inline
+bool is_aggregate(struct TypeTable *table, unsigned id) { return get_type(table, id)->kind >= TYPE_ARRAY; }
+
+// an array of soa structs
+static inline
+bool is_soa_array(struct TypeTable *table, unsigned id) {
+	return is_array(table, id) && get_type(table, get_type(table, id)->base)->soa;
+}
+
+static inline
+bool is_vector(struct TypeTable *table, unsigned id) { return get_type(table, id)->kind == TYPE_BASIC && get_type(table, id)->length; }
+
+static inline
+unsigned lane_type(struct TypeTable *table, unsigned id) { return get_type(table, id)->base; }
+
+static inline
+int lanes(struct TypeTable *table, unsigned id) { return get_type(table, id)->length; }
+
+static inline
+int type_size(struct TypeTable *table, unsigned id) { return get_type(table, id)->size; }
+
+static inline
+int type_align(struct TypeTable *table, unsigned id) { return get_type(table, id)->align; }
+
+// writes at most size bytes, a type that does not fit ends in "..."
+const char *print_type(struct TypeTable *, unsigned id, char *buffer, size_t size);
+
+#endif //TYPES_H_
@@ -0,0 +1,363 @@
+#include "unit.h"
+
+#include "allocator.h"
+#include "ast.h"
+#include "parser.h"
+#include "pool.h"
+#include "scope.h"
+#include "tokens.h"
+#include "util.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void skim_declarations(struct Token *tokens, int count, struct Vec *ranges) {
+	int start = 0, depth = 0;
+	bool aggregate = starts_aggregate(tokens, count);
+
+	for (int i = 0; i < count && tokens[i].type != TOK_EOF; i++) {
+		if (tokens[i].type != PUNCTUATION) continue;
+
+		bool end = false;
+
+		switch (tokens[i].value) {
+			case '(': case '[': case '{':
+				depth++;
+				break;
+
+			case ')': case ']': case '}':
+				depth = max(depth - 1, 0);
+				end = (depth == 0 && tokens[i].value == '}' && !aggregate);
+				break;
+
+			case ';':
+				end = (depth == 0);
+				break;
+		}
+
+		if (end) {
+			struct TokenRange range = { tokens + start, i + 1 - start };
+			vec_push(ranges, &range);
+			start = i + 1;
+			aggregate = starts_aggregate(tokens + start, count - start);
+		}
+	}
+
+	// unterminated declaration runs to end-of-file
+	if (start < count && tokens[start].type != TOK_EOF) {
+		struct TokenRange range = { tokens + start, count - start };
+		vec_push(ranges, &range);
+	}
+}
+
+
+struct Job {
+	struct AST_Declaration *declaration;
+	struct Token *definition; // first token after the signature
+	int remaining;            // tokens left in the file from there
+
+	// diagnostics of each phase, as offsets into a buffer, the signature
+	// one for bodies parsed early
+	int worker;
+	int signature[2], body[2];
+
+	bool early;       // parsed during the signatures, for a constant
+	atomic_bool done; // the body is parsed
+};
+
+struct UnitContext;
+
+// a constant in job `job` may call the functions defined before it
+struct Caller {
+	struct UnitContext *context;
+	int job;
+	struct Callees callees;
+};
+
+struct WorkerState {
+	struct AST_Expression scratch[MAX_EXPRESSION_DEPTH];
+	struct Scope scope;
+	struct Vec diagnostics;
+	struct Caller caller;
+	int errors;
+};
+
+struct UnitContext {
+	struct Unit *unit;
+	struct Parser *parser;
+	struct Job *jobs;
+	struct TokenRange *ranges;
+	int count;
+	struct WorkerState *workers;
+
+	struct Vec *signatures; // diagnostics of the signatures (chars)
+	bool parallel;          // bodies are being parsed on the pool
+
+	// signals jobs done to workers waiting for them
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+};
+
+static
+struct AST_Declaration *find_definition(void *, struct AST_Declaration *);
+
+static
+struct Caller caller(struct UnitContext *context, int job) {
+	return (struct Caller) { context, job, { find_definition, NULL } };
+}
+
+// the job whose range holds the token
+static
+int find_job(struct UnitContext *context, struct Token *token) {
+	int low = 0, high = context->count - 1, found = -1;
+
+	while (low <= high) {
+		int middle = (low + high) / 2;
+
+		if (context->ranges[middle].tokens <= token) found = middle, low = middle + 1;
+		else                                         high = middle - 1;
+	}
+
+	return found;
+}
+
+// during the signatures, with the file scope so far. the body is dropped
+// when it has errors, they are reported when it is parsed again in turn
+static
+bool parse_early(struct UnitContext *context, int index) {
+	struct Parser *outer = context->parser;
+	struct Job *job = &context->jobs[index];
+	struct Caller inner = caller(context, index);
+	inner.callees.context = &inner;
+
+	struct Parser parser = {
+		.tokens = job->definition,
+		.length = job->remaining,
+		.allocator = outer->allocator,
+		.scope = outer->scope,
+		.types = outer->types,
+		.diagnostics = context->signatures,
+		.callees = &inner.callees,
+	};
+
+	int start = context->signatures->length;
+	parse_definition(&parser, job->declaration);
+
+	if (parser.errors) {
+		vec_truncate(context->signatures, start);
+		job->declaration->body = NULL;
+		return false;
+	}
+
+	job->worker = -1;
+	job->body[0] = start;
+	job->body[1] = context->signatures->length;
+	job->early = true;
+	atomic_store(&job->done, true);
+	return true;
+}
+
+// constants may call functions defined before them: during the signatures
+// their bodies are parsed on demand, on the pool the caller waits for the
+// job that parses them, which was handed out before its own
+static
+struct AST_Declaration *find_definition(void *argument, struct AST_Declaration *decl) {
+	struct Caller *caller = argument;
+	struct UnitContext *context = caller->context;
+
+	int index = find_job(context, decl->token);
+	if (index < 0 || index >= caller->job) return NULL;
+
+	struct Job *job = &context->jobs[index];
+	if (job->declaration != decl || !decl->function || context->parser->syntax_only) return NULL;
+
+	if (!context->parallel) {
+		if (!atomic_load(&job->done) && !parse_early(context, index)) return NULL;
+	}
+
+	else if (!atomic_load_explicit(&job->done, memory_order_acquire)) {
+		pthread_mutex_lock(&context->lock);
+		while (!atomic_load(&job->done)) pthread_cond_wait(&context->done, &context->lock);
+		pthread_mutex_unlock(&context->lock);
+	}
+
+	return decl->body ? decl : NULL;
+}
+
+static
+void finish_job(struct UnitContext *context, struct Job *job) {
+	pthread_mutex_lock(&context->lock);
+	atomic_store_explicit(&job->done, true, memory_order_release);
+	pthread_cond_broadcast(&context->done);
+	pthread_mutex_unlock(&context->lock);
+}
+
+static
+void parse_body(void *argument, int index, int worker) {
+	struct UnitContext *context = argument;
+	struct Job *job = &context->jobs[index];
+	struct WorkerState *state = &context->workers[worker];
+
+	if (job->declaration == NULL || job->early) {
+		finish_job(context, job);
+		return;
+	}
+
+	state->caller.job = index;
+
+	// the parser may run past the declaration only after an error
+	struct Parser parser = {
+		.tokens = job->definition,
+		.length = job->remaining,
+		.allocator = &context->unit->arenas[worker],
+		.scope = &state->scope,
+		.types = context->parser->types,
+		.diagnostics = &state->diagnostics,
+		.callees = &state->caller.callees,
+		.syntax_only = context->parser->syntax_only,
+		.scratch = state->scratch,
+	};
+
+	job->worker = worker;
+	job->body[0] = state->diagnostics.length;
+	parse_definition(&parser, job->declaration);
+	job->body[1] = state->diagnostics.length;
+
+	state->errors += parser.errors;
+	finish_job(context, job);
+}
+
+// the chars [start, end) of a buffer, to stdout when out is NULL
+static
+void emit_range(struct Vec *out, struct Vec *buffer, int start, int end) {
+	if (out == NULL) fwrite((char *)buffer->mem + start, 1, end - start, stdout);
+	else             vec_append(out, (char *)buffer->mem + start, end - start);
+}
+
+void parse_unit(struct Unit *unit, struct Parser *parser, int threads) {
+	struct Token *end = parser->tokens + parser->length;
+
+	struct Vec ranges = vec(struct TokenRange);
+	skim_declarations(parser->tokens, parser->length, &ranges);
+
+	int count = ranges.length;
+	struct Job *jobs = calloc(max(count, 1), sizeof *jobs);
+	if (!jobs) errx("out of memory: failed to allocate %zu bytes", count * sizeof *jobs);
+
+	// signatures, in order, on the calling parser
+	struct Vec *diagnostics = parser->diagnostics;
+	struct Vec signatures = vec(char);
+	parser->diagnostics = &signatures;
+
+	unit->declarations = vec(struct AST_Declaration *);
+	unit->errors = 0;
+
+	struct UnitContext context = {
+		.unit = unit,
+		.parser = parser,
+		.jobs = jobs,
+		.ranges = ranges.mem,
+		.count = count,
+		.signatures = &signatures,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.done = PTHREAD_COND_INITIALIZER,
+	};
+
+	struct Callees *callees = parser->callees;
+	struct Caller signature = caller(&context, 0);
+	signature.callees.context = &signature;
+	parser->callees = &signature.callees;
+
+	for (int i = 0; i < count; i++) {
+		struct TokenRange *range = (struct TokenRange *)ranges.mem + i;
+
+		parser->tokens = range->tokens;
+		parser->length = end - range->tokens;
+		parser->errors = 0;
+
+		signature.job = i;
+		jobs[i].signature[0] = signatures.length;
+		jobs[i].declaration = parse_signature(parser);
+		jobs[i].signature[1] = signatures.length;
+
+		if (parser->errors) {
+			jobs[i].declaration = NULL;
+			unit->errors += parser->errors;
+			continue;
+		}
+
+		// structs and unions are complete after their signature
+		if (jobs[i].declaration->aggregate) {
+			jobs[i].declaration = NULL;
+			continue;
+		}
+
+		jobs[i].definition = parser->tokens;
+		jobs[i].remaining = parser->length;
+		vec_push(&unit->declarations, &jobs[i].declaration);
+	}
+
+	parser->tokens = end - 1;
+	parser->length = 1;
+	parser->diagnostics = diagnostics;
+	parser->callees = callees;
+
+	// bodies and initialisers in parallel
+	threads = max(1, min(threads, count));
+
+	unit->workers = threads;
+	unit->arenas = malloc(threads * sizeof *unit->arenas);
+	struct WorkerState *workers = malloc(threads * sizeof *workers);
+
+	if (!unit->arenas || !workers)
+		errx("out of memory: failed to allocate worker state");
+
+	for (int i = 0; i < threads; i++) {
+		unit->arenas[i] = init_allocator();
+		workers[i].scope = clone_scope(parser->scope);
+		workers[i].diagnostics = vec(char);
+		workers[i].caller = caller(&context, 0);
+		workers[i].caller.callees.context = &workers[i].caller;
+		workers[i].errors = 0;
+	}
+
+	context.workers = workers;
+	context.parallel = true;
+	parallel_for(threads, count, parse_body, &context);
+
+	// merge diagnostics in source order, into the parser's buffer if it has one
+	for (int i = 0; i < count; i++) {
+		struct Job *job = &jobs[i];
+		emit_range(diagnostics, &signatures, job->signature[0], job->signature[1]);
+
+		if (job->declaration != NULL) {
+			struct Vec *buffer = job->early ? &signatures : &workers[job->worker].diagnostics;
+			emit_range(diagnostics, buffer, job->body[0], job->body[1]);
+		}
+	}
+
+	for (int i = 0; i < threads; i++) {
+		unit->errors += workers[i].errors;
+		free_scope(&workers[i].scope);
+		vec_free(&workers[i].diagnostics);
+	}
+
+	parser->errors = unit->errors;
+
+	free(workers);
+	free(jobs);
+	vec_free(&signatures);
+	vec_free(&ranges);
+}
+
+void free_unit(struct Unit *unit) {
+	for (int i = 0; i < unit->workers; i++) {
+		free_allocator(&unit->arenas[i]);
+	}
+
+	free(unit->arenas);
+	vec_free(&unit->declarations);
+	unit->workers = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef UNIT_H_
+#define UNIT_H_
+
+#include "allocator.h"
+#include "ast.h"
+#include "parser.h"
+#include "tokens.h"
+#include "util.h"
+
+// whole file compilation:
+//
+// a skim pass splits the token vector into top-level declarations by
+// matching brackets, without building any AST. signatures are then parsed
+// in order on the calling parser, so every file scope name is known, and
+// the bodies and initialisers are parsed and type checked on a thread
+// pool. each worker owns a parser, an arena and a copy of the file scope.
+// diagnostics are buffered and printed in source order, or appended to the
+// parser's buffer when it has one.
+//
+// constants may call functions defined earlier in the file. a signature
+// that needs one parses its body early, a worker that needs one waits for
+// the worker parsing it. that job was handed out first, so nothing waits
+// on a later job.
+//
+
+struct TokenRange {
+	struct Token *tokens;
+	int length;
+};
+
+struct Unit {
+	struct Vec declarations; // struct AST_Declaration *, in source order
+	struct Allocator *arenas; // one per worker, own bodies and initialisers
+	int workers;
+	int errors;
+};
+
+// ranges end after the `;` or closing `}` of each declaration, struct and
+// union declarations after the `;` that follows their fields
+void skim_declarations(struct Token *, int count, struct Vec *ranges);
+
+void parse_unit(struct Unit *, struct Parser *, int threads);
+void free_unit(struct Unit *);
+
+#endif //UNIT_H_
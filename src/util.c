@@ -1,5 +1,8 @@
+#define _GNU_SOURCE // program_invocation_name
+
 #include "util.h"
 
+#include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -72,6 +75,31 @@ void vec_push(struct Vec *vec, void *elem) {
 	vec->length++;
 }
 
+void vec_append(struct Vec *vec, const void *elems, int count) {
+	int size = count * vec->elem_size;
+
+	if (vec->used + size > vec->capacity) {
+		while (vec->used + size > vec->capacity)
+			vec->capacity <<= 1;
+
+		vec->mem = realloc(vec->mem, vec->capacity);
+
+		if (!vec->mem) {
+			errx("out of memory: failed to allocate %d bytes", vec->capacity);
+		}
+	}
+
+	memcpy(vec->mem + vec->used, elems, size);
+	vec->used += size;
+	vec->length += count;
+}
+
+void vec_truncate(struct Vec *vec, int length) {
+	assert(0 <= length && length <= vec->length);
+	vec->length = length;
+	vec->used = length * vec->elem_size;
+}
+
 void vec_free(struct Vec *vec) {
 	free(vec->mem);
 	vec->capacity = 0;
@@ -80,22 +108,43 @@ void vec_free(struct Vec *vec) {
 	vec->used = 0;
 }
 
-// compiler errors
-const char *program = NULL;
+// compiler errors, formatted whole so that threads do not interleave them
+static
+int format_error(char *buffer, int size, const char *fmt, va_list args) {
+	int length = min(snprintf(buffer, size, WHITE "%s: " RED "error: " RESET, program_invocation_name), size - 1);
+	length += vsnprintf(buffer + length, size - length, fmt, args);
 
-void set_program(const char *prog) {
-	program = prog;
+	length = min(length, size - 2);
+	buffer[length++] = '\n';
+	buffer[length] = 0;
+	return length;
 }
 
-void errx(const char *fmt, ...) {
-	printf(WHITE "%s: " RED "error: " RESET, program);
+void append_error(struct Vec *out, const char *fmt, ...) {
+	char buffer[1024];
 
 	va_list args;
 	va_start(args, fmt);
+	int length = format_error(buffer, sizeof buffer, fmt, args);
+	va_end(args);
+
+	if (out == NULL) fputs(buffer, stdout);
+	else             vec_append(out, buffer, length);
+}
 
-	vprintf(fmt, args);
+_Thread_local struct Recovery *recovery;
+
+void errx(const char *fmt, ...) {
+	char buffer[1024];
+
+	va_list args;
+	va_start(args, fmt);
+	int length = format_error(buffer, sizeof buffer, fmt, args);
 	va_end(args);
 
-	putchar('\n');
+	if (recovery && recovery->out) vec_append(recovery->out, buffer, length);
+	else                           fputs(buffer, stdout);
+
+	if (recovery) longjmp(recovery->jump, 1);
 	exit(1);
 }
@@ -2,6 +2,7 @@
 #define UTIL_H
 
 #include <assert.h>
+#include <setjmp.h>
 #include <stdnoreturn.h>
 
 // PRINTF type checking
@@ -11,6 +12,13 @@
 #define PRINTF(fmt, first)
 #endif
 
+// keeps the locals of a function out of the frame of its recursive caller
+#if defined(__clang__) || defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
 // ANSI CODES (8-bit terminal colors)
 #define RED      "\e[31;1m"
 #define MAGENTA  "\e[35;1m"
@@ -39,6 +47,43 @@ int __builtin_clz(unsigned int x) {
 
 #endif
 
+// the bit builtins of the language, on the low `bits` bits of x, which are
+// zero above them. a zero has as many leading and trailing zeros as bits
+static inline
+int leading_zeros(unsigned x, int bits) {
+	return x ? __builtin_clz(x) - (32 - bits) : bits;
+}
+
+static inline
+int trailing_zeros(unsigned x, int bits) {
+	int count = 0;
+	while (count < bits && !(x >> count & 1)) count++;
+	return count;
+}
+
+static inline
+int count_ones(unsigned x) {
+	x = x - (x >> 1 & 0x55555555);
+	x = (x & 0x33333333) + (x >> 2 & 0x33333333);
+	x = (x + (x >> 4)) & 0x0f0f0f0f;
+	return x * 0x01010101 >> 24;
+}
+
+static inline
+unsigned swap_bytes(unsigned x, int bits) {
+	unsigned swapped = 0;
+	for (int i = 0; i < bits; i += 8) swapped |= (x >> i & 0xff) << (bits - 8 - i);
+	return swapped;
+}
+
+// by the count modulo the width
+static inline
+unsigned rotate_left(unsigned x, unsigned count, int bits) {
+	unsigned mask = bits == 32 ? ~0u : (1u << bits) - 1;
+	count &= bits - 1;
+	return count ? (x << count | x >> (bits - count)) & mask : x;
+}
+
 static inline
 int max(int a, int b) { return (a > b) ? a : b; }
 
@@ -61,11 +106,26 @@ struct Vec {
 
 struct Vec init_vector(int elem_size);
 void vec_push(struct Vec *, void *elem);
+void vec_append(struct Vec *, const void *elems, int count);
+void vec_truncate(struct Vec *, int length);
 void vec_free(struct Vec *);
 
 
-// compiler errors
-void set_program(const char *prog);
+// compiler errors, prefixed with the name the compiler was run as
 noreturn void errx(const char *fmt, ...) PRINTF(1,2);
 
+// appends the message errx prints (chars), or prints it if the vector is
+// NULL, for errors that only fail one input
+void append_error(struct Vec *, const char *fmt, ...) PRINTF(2,3);
+
+// while a thread has a recovery point errx appends to its output instead,
+// as append_error does, and jumps back to it rather than exiting, so that
+// an input that fails in a backend does not stop the others
+struct Recovery {
+	jmp_buf jump;
+	struct Vec *out;
+};
+
+extern _Thread_local struct Recovery *recovery;
+
 #endif //UTIL_H
@@ -0,0 +1,859 @@
+#include "vm.h"
+
+#include "ast.h"
+#include "bytecode.h"
+#include "parser.h"
+#include "switch.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GNUC__) && !defined(VM_SWITCH)
+#define COMPUTED_GOTO
+#endif
+
+struct Return {
+	const uint8_t *pc;
+	uint32_t fp, top;
+};
+
+struct Machine {
+	uint8_t *memory;
+	uint32_t size;  // bytes of memory
+	uint32_t stack; // where frames start, after the data
+
+	uint32_t *values;
+	int value_count;
+	struct Return *calls;
+	int call_count;
+
+	int64_t steps; // loop iterations and calls allowed
+	char fault[64]; // empty unless execution stopped on one
+};
+
+static
+void init_machine(struct Machine *m, struct Program *program, int frames, int values, int calls) {
+	m->stack = (program->data.length + 15) & ~15;
+	m->size = m->stack + frames;
+	m->value_count = values;
+	m->call_count = calls;
+	m->steps = INT64_MAX;
+	m->fault[0] = 0;
+
+	m->memory = calloc(m->size, 1);
+	m->values = malloc(max(values, 1) * sizeof *m->values);
+	m->calls = malloc(max(calls, 1) * sizeof *m->calls);
+
+	if (!m->memory || !m->values || !m->calls) {
+		errx("out of memory: failed to allocate a machine with %u bytes of memory", m->size);
+	}
+
+	memcpy(m->memory, program->data.mem, program->data.length);
+}
+
+static
+void free_machine(struct Machine *m) {
+	free(m->memory);
+	free(m->values);
+	free(m->calls);
+}
+
+
+#ifdef COMPUTED_GOTO
+#define CASE(op) L_##op
+#define NEXT     goto *labels[*pc++]
+#else
+#define CASE(op) case op
+#define NEXT     continue
+#endif
+
+#define OPERAND() (memcpy(&imm, pc, sizeof imm), pc += sizeof imm, imm)
+
+// `a` is the address, accesses of n bytes must be in memory and not null
+#define CHECK(n) if (a - NULL_GUARD > m->size - NULL_GUARD - (n)) goto bad_address
+
+static
+bool execute(struct Program *program, struct Machine *m, uint32_t *result) {
+	const uint8_t *code = program->code.mem;
+	const struct Function *functions = program->functions.mem;
+	const uint8_t *pc = code + program->start;
+
+	uint8_t *memory = m->memory;
+	uint32_t *sp = m->values; // at the top value, values[0] is never read
+	uint32_t *end = m->values + m->value_count;
+	struct Return *call = m->calls, *last = m->calls + m->call_count;
+	uint32_t fp = m->stack, top = m->stack;
+
+	int64_t steps = m->steps;
+	int32_t imm;
+	uint32_t a, b;
+	uint16_t half;
+
+	if (program->max_stack >= end - sp) goto stack_overflow;
+
+#ifdef COMPUTED_GOTO
+	static const void *const labels[OP_COUNT] = {
+		[OP_HALT] = &&CASE(OP_HALT),   [OP_PUSH] = &&CASE(OP_PUSH),
+		[OP_POP] = &&CASE(OP_POP),     [OP_DUP] = &&CASE(OP_DUP),
+		[OP_LOCAL] = &&CASE(OP_LOCAL), [OP_CLEAR] = &&CASE(OP_CLEAR),
+
+		[OP_LOAD8] = &&CASE(OP_LOAD8),     [OP_LOAD16] = &&CASE(OP_LOAD16),     [OP_LOAD32] = &&CASE(OP_LOAD32),
+		[OP_STORE8] = &&CASE(OP_STORE8),   [OP_STORE16] = &&CASE(OP_STORE16),   [OP_STORE32] = &&CASE(OP_STORE32),
+		[OP_GET8] = &&CASE(OP_GET8),       [OP_GET16] = &&CASE(OP_GET16),       [OP_GET32] = &&CASE(OP_GET32),
+		[OP_SET8] = &&CASE(OP_SET8),       [OP_SET16] = &&CASE(OP_SET16),       [OP_SET32] = &&CASE(OP_SET32),
+		[OP_INC8] = &&CASE(OP_INC8),       [OP_INC16] = &&CASE(OP_INC16),       [OP_INC32] = &&CASE(OP_INC32),
+		[OP_POSTINC8] = &&CASE(OP_POSTINC8), [OP_POSTINC16] = &&CASE(OP_POSTINC16), [OP_POSTINC32] = &&CASE(OP_POSTINC32),
+
+		[OP_ADD] = &&CASE(OP_ADD),   [OP_SUB] = &&CASE(OP_SUB),   [OP_MUL] = &&CASE(OP_MUL),
+		[OP_DIV] = &&CASE(OP_DIV),   [OP_IDIV] = &&CASE(OP_IDIV), [OP_MOD] = &&CASE(OP_MOD), [OP_IMOD] = &&CASE(OP_IMOD),
+		[OP_AND] = &&CASE(OP_AND),   [OP_OR] = &&CASE(OP_OR),     [OP_XOR] = &&CASE(OP_XOR),
+		[OP_SHL] = &&CASE(OP_SHL),   [OP_SHR] = &&CASE(OP_SHR),   [OP_SAR] = &&CASE(OP_SAR),
+		[OP_EQ] = &&CASE(OP_EQ),     [OP_NE] = &&CASE(OP_NE),
+		[OP_LT] = &&CASE(OP_LT),     [OP_LE] = &&CASE(OP_LE),     [OP_GT] = &&CASE(OP_GT),   [OP_GE] = &&CASE(OP_GE),
+		[OP_ILT] = &&CASE(OP_ILT),   [OP_ILE] = &&CASE(OP_ILE),   [OP_IGT] = &&CASE(OP_IGT), [OP_IGE] = &&CASE(OP_IGE),
+		[OP_ADDI] = &&CASE(OP_ADDI), [OP_MULHI] = &&CASE(OP_MULHI), [OP_IMULHI] = &&CASE(OP_IMULHI),
+		[OP_CHECK] = &&CASE(OP_CHECK),
+
+		[OP_NEG] = &&CASE(OP_NEG),   [OP_NOT] = &&CASE(OP_NOT),   [OP_LNOT] = &&CASE(OP_LNOT), [OP_BOOL] = &&CASE(OP_BOOL),
+		[OP_TRUNC8] = &&CASE(OP_TRUNC8), [OP_TRUNC16] = &&CASE(OP_TRUNC16),
+		[OP_CLZ] = &&CASE(OP_CLZ),   [OP_CTZ] = &&CASE(OP_CTZ),   [OP_POPCOUNT] = &&CASE(OP_POPCOUNT),
+		[OP_BSWAP] = &&CASE(OP_BSWAP), [OP_ROTATE] = &&CASE(OP_ROTATE),
+
+		[OP_JUMP] = &&CASE(OP_JUMP), [OP_JZ] = &&CASE(OP_JZ),     [OP_JNZ] = &&CASE(OP_JNZ),
+		[OP_TABLE] = &&CASE(OP_TABLE),
+		[OP_CALL] = &&CASE(OP_CALL), [OP_RET] = &&CASE(OP_RET),
+	};
+
+	NEXT;
+#else
+	for (;;) switch ((enum Opcode)*pc++) {
+#endif
+
+	CASE(OP_HALT):
+		*result = *sp;
+		return true;
+
+	CASE(OP_PUSH):  *++sp = OPERAND(); NEXT;
+	CASE(OP_POP):   sp--; NEXT;
+	CASE(OP_DUP):   sp[1] = sp[0]; sp++; NEXT;
+	CASE(OP_LOCAL): *++sp = fp + OPERAND(); NEXT;
+	CASE(OP_CLEAR): (void)OPERAND(); a = *sp--; CHECK(imm); memset(memory + a, 0, imm); NEXT;
+
+	CASE(OP_LOAD8):  a = *sp; CHECK(1); *sp = memory[a]; NEXT;
+	CASE(OP_LOAD16): a = *sp; CHECK(2); memcpy(&half, memory + a, 2); *sp = half; NEXT;
+	CASE(OP_LOAD32): a = *sp; CHECK(4); memcpy(sp, memory + a, 4); NEXT;
+
+	CASE(OP_STORE8):  b = *sp--; a = *sp; CHECK(1); memory[a] = b; *sp = b; NEXT;
+	CASE(OP_STORE16): b = *sp--; a = *sp; CHECK(2); half = b; memcpy(memory + a, &half, 2); *sp = b; NEXT;
+	CASE(OP_STORE32): b = *sp--; a = *sp; CHECK(4); memcpy(memory + a, &b, 4); *sp = b; NEXT;
+
+	// frame offsets are known to be in the frame
+	CASE(OP_GET8):  a = fp + OPERAND(); *++sp = memory[a]; NEXT;
+	CASE(OP_GET16): a = fp + OPERAND(); memcpy(&half, memory + a, 2); *++sp = half; NEXT;
+	CASE(OP_GET32): a = fp + OPERAND(); memcpy(++sp, memory + a, 4); NEXT;
+
+	CASE(OP_SET8):  a = fp + OPERAND(); memory[a] = *sp--; NEXT;
+	CASE(OP_SET16): a = fp + OPERAND(); half = *sp--; memcpy(memory + a, &half, 2); NEXT;
+	CASE(OP_SET32): a = fp + OPERAND(); memcpy(memory + a, sp--, 4); NEXT;
+
+	CASE(OP_INC8):
+		(void)OPERAND(); a = *sp; CHECK(1);
+		*sp = memory[a] = memory[a] + imm;
+		NEXT;
+
+	CASE(OP_INC16):
+		(void)OPERAND(); a = *sp; CHECK(2);
+		memcpy(&half, memory + a, 2);
+		half += imm;
+		memcpy(memory + a, &half, 2);
+		*sp = half;
+		NEXT;
+
+	CASE(OP_INC32):
+		(void)OPERAND(); a = *sp; CHECK(4);
+		memcpy(&b, memory + a, 4);
+		b += imm;
+		memcpy(memory + a, &b, 4);
+		*sp = b;
+		NEXT;
+
+	CASE(OP_POSTINC8):
+		(void)OPERAND(); a = *sp; CHECK(1);
+		*sp = memory[a];
+		memory[a] += imm;
+		NEXT;
+
+	CASE(OP_POSTINC16):
+		(void)OPERAND(); a = *sp; CHECK(2);
+		memcpy(&half, memory + a, 2);
+		*sp = half;
+		half += imm;
+		memcpy(memory + a, &half, 2);
+		NEXT;
+
+	CASE(OP_POSTINC32):
+		(void)OPERAND(); a = *sp; CHECK(4);
+		memcpy(&b, memory + a, 4);
+		*sp = b;
+		b += imm;
+		memcpy(memory + a, &b, 4);
+		NEXT;
+
+	CASE(OP_ADD): b = *sp--; *sp += b; NEXT;
+	CASE(OP_SUB): b = *sp--; *sp -= b; NEXT;
+	CASE(OP_MUL): b = *sp--; *sp *= b; NEXT;
+
+	CASE(OP_DIV):
+		b = *sp--;
+		if (b == 0) goto division_by_zero;
+		*sp /= b;
+		NEXT;
+
+	CASE(OP_MOD):
+		b = *sp--;
+		if (b == 0) goto division_by_zero;
+		*sp %= b;
+		NEXT;
+
+	// INT_MIN / -1 wraps
+	CASE(OP_IDIV):
+		b = *sp--;
+		if (b == 0) goto division_by_zero;
+		*sp = (b == UINT32_MAX) ? -*sp : (uint32_t)((int32_t)*sp / (int32_t)b);
+		NEXT;
+
+	CASE(OP_IMOD):
+		b = *sp--;
+		if (b == 0) goto division_by_zero;
+		*sp = (b == UINT32_MAX) ? 0 : (uint32_t)((int32_t)*sp % (int32_t)b);
+		NEXT;
+
+	CASE(OP_AND): b = *sp--; *sp &= b; NEXT;
+	CASE(OP_OR):  b = *sp--; *sp |= b; NEXT;
+	CASE(OP_XOR): b = *sp--; *sp ^= b; NEXT;
+
+	// shift counts wrap at 32, as on x86
+	CASE(OP_SHL): b = *sp--; *sp <<= b & 31; NEXT;
+	CASE(OP_SHR): b = *sp--; *sp >>= b & 31; NEXT;
+	CASE(OP_SAR): b = *sp--; *sp = (uint32_t)((int32_t)*sp >> (b & 31)); NEXT;
+
+	CASE(OP_EQ): b = *sp--; *sp = *sp == b; NEXT;
+	CASE(OP_NE): b = *sp--; *sp = *sp != b; NEXT;
+	CASE(OP_LT): b = *sp--; *sp = *sp <  b; NEXT;
+	CASE(OP_LE): b = *sp--; *sp = *sp <= b; NEXT;
+	CASE(OP_GT): b = *sp--; *sp = *sp >  b; NEXT;
+	CASE(OP_GE): b = *sp--; *sp = *sp >= b; NEXT;
+
+	CASE(OP_ILT): b = *sp--; *sp = (int32_t)*sp <  (int32_t)b; NEXT;
+	CASE(OP_ILE): b = *sp--; *sp = (int32_t)*sp <= (int32_t)b; NEXT;
+	CASE(OP_IGT): b = *sp--; *sp = (int32_t)*sp >  (int32_t)b; NEXT;
+	CASE(OP_IGE): b = *sp--; *sp = (int32_t)*sp >= (int32_t)b; NEXT;
+
+	CASE(OP_ADDI): *sp += OPERAND(); NEXT;
+
+	CASE(OP_MULHI):  b = *sp--; *sp = (uint64_t)*sp * b >> 32; NEXT;
+	CASE(OP_IMULHI): b = *sp--; *sp = (uint64_t)((int64_t)(int32_t)*sp * (int32_t)b) >> 32; NEXT;
+
+	CASE(OP_CHECK): a = *sp; if (a >= (uint32_t)OPERAND()) goto out_of_bounds; NEXT;
+
+	CASE(OP_NEG):  *sp = -*sp; NEXT;
+	CASE(OP_NOT):  *sp = ~*sp; NEXT;
+	CASE(OP_LNOT): *sp = !*sp; NEXT;
+	CASE(OP_BOOL): *sp = !!*sp; NEXT;
+
+	CASE(OP_TRUNC8):  *sp &= 0xff;   NEXT;
+	CASE(OP_TRUNC16): *sp &= 0xffff; NEXT;
+
+	CASE(OP_CLZ):      *sp = leading_zeros(*sp, OPERAND());  NEXT;
+	CASE(OP_CTZ):      *sp = trailing_zeros(*sp, OPERAND()); NEXT;
+	CASE(OP_POPCOUNT): (void)OPERAND(); *sp = count_ones(*sp); NEXT;
+	CASE(OP_BSWAP):    *sp = swap_bytes(*sp, OPERAND());     NEXT;
+	CASE(OP_ROTATE):   b = *sp--; *sp = rotate_left(*sp, b, OPERAND()); NEXT;
+
+	CASE(OP_JUMP): pc = code + OPERAND(); NEXT;
+	CASE(OP_JZ):   (void)OPERAND(); if (*sp-- == 0) pc = code + imm; NEXT;
+	// loops jump back with it, so it counts the steps
+	CASE(OP_JNZ):
+		(void)OPERAND();
+		if (*sp-- != 0) {
+			if (--steps < 0) goto out_of_steps;
+			pc = code + imm;
+		}
+		NEXT;
+
+	// the targets follow the operand
+	CASE(OP_TABLE):
+		(void)OPERAND();
+		a = *sp--;
+		if (a < (uint32_t)imm) {
+			memcpy(&imm, pc + a * sizeof imm, sizeof imm);
+			pc = code + imm;
+		} else {
+			pc += (uint32_t)imm * sizeof imm;
+		}
+		NEXT;
+
+	// arguments move from the operand stack to the start of the new frame
+	CASE(OP_CALL): {
+		const struct Function *function = &functions[OPERAND()];
+
+		if (call == last) goto too_deep;
+		if (--steps < 0) goto out_of_steps;
+		if ((uint32_t)function->frame_size > m->size - top) goto stack_overflow;
+
+		sp -= function->param_count;
+		if (function->max_stack >= end - sp) goto stack_overflow;
+
+		*call++ = (struct Return) { pc, fp, top };
+		fp = top;
+		top += function->frame_size;
+
+		memcpy(memory + fp, sp + 1, function->param_count * sizeof *sp);
+		pc = code + function->entry;
+		NEXT;
+	}
+
+	CASE(OP_RET):
+		a = *sp;
+		call--;
+		pc = call->pc, fp = call->fp, top = call->top;
+		*sp = a;
+		NEXT;
+
+#ifndef COMPUTED_GOTO
+	case OP_COUNT: break;
+	}
+#endif
+
+	assert(0 && "unreachable");
+
+bad_address:
+	snprintf(m->fault, sizeof m->fault, "invalid memory access at address 0x%x", a);
+	return false;
+
+division_by_zero:
+	snprintf(m->fault, sizeof m->fault, "division by zero");
+	return false;
+
+out_of_bounds:
+	snprintf(m->fault, sizeof m->fault, "index %u out of bounds for length %u", a, (uint32_t)imm);
+	return false;
+
+stack_overflow:
+	snprintf(m->fault, sizeof m->fault, "stack overflow");
+	return false;
+
+too_deep:
+	snprintf(m->fault, sizeof m->fault, "calls nested more than %d deep", m->call_count);
+	return false;
+
+out_of_steps:
+	snprintf(m->fault, sizeof m->fault, "more than %lld loop iterations and calls", (long long)m->steps);
+	return false;
+}
+
+#undef CASE
+#undef NEXT
+#undef OPERAND
+#undef CHECK
+
+uint32_t run_program(struct Program *program) {
+	struct Machine machine;
+	init_machine(&machine, program, STACK_SIZE, STACK_VALUES, MAX_CALLS);
+
+	uint32_t result = 0;
+	if (!execute(program, &machine, &result)) errx("%s", machine.fault);
+
+	free_machine(&machine);
+	return result;
+}
+
+bool evaluate_constant(struct TypeTable *types, struct AST_Expression *expr, struct Callees *callees,
+                       uint32_t *value, char *fault) {
+	struct Program program;
+	bool constant = compile_constant(&program, types, expr, callees);
+
+	if (fault) fault[0] = 0;
+
+	// without calls no frames, and the operand stack only as deep as needed
+	if (constant) {
+		bool calls = program.functions.length > 0;
+
+		struct Machine machine;
+		init_machine(&machine, &program, calls ? CONSTANT_STACK : 0, calls ? CONSTANT_VALUES : program.max_stack + 1,
+		             calls ? CONSTANT_CALLS : 0);
+		machine.steps = CONSTANT_STEPS;
+
+		constant = execute(&program, &machine, value);
+		if (fault) snprintf(fault, CONSTANT_FAULT_SIZE, "%s", machine.fault);
+		free_machine(&machine);
+	}
+
+	free_program(&program);
+	return constant;
+}
+
+
+// tree walker, the baseline of the benchmark
+
+enum Flow {
+	FLOW_NEXT,
+	FLOW_BREAK,
+	FLOW_RETURN,
+};
+
+struct Walker {
+	struct Program *program;
+	struct TypeTable *types;
+	struct Machine machine;
+
+	struct AST_Declaration *function;
+	uint32_t fp, top;
+	int depth;
+
+	uint32_t result; // of the last return
+	uint64_t nodes;
+};
+
+static
+uint32_t check_address(struct Walker *w, uint32_t address, int size) {
+	if (address - NULL_GUARD > w->machine.size - NULL_GUARD - size) {
+		errx("invalid memory access at address 0x%x", address);
+	}
+
+	return address;
+}
+
+static
+uint32_t load(struct Walker *w, uint32_t address, unsigned type) {
+	int size = storage_size(w->types, type);
+	uint8_t *memory = w->machine.memory + check_address(w, address, size);
+
+	uint32_t value = 0;
+	for (int i = 0; i < size; i++) value |= (uint32_t)memory[i] << (8 * i);
+	return value;
+}
+
+static
+void store(struct Walker *w, uint32_t address, unsigned type, uint32_t value) {
+	int size = storage_size(w->types, type);
+	uint8_t *memory = w->machine.memory + check_address(w, address, size);
+
+	for (int i = 0; i < size; i++) memory[i] = value >> (8 * i);
+}
+
+static
+uint32_t narrow(struct Walker *w, uint32_t value, unsigned type) {
+	if (type == VOID) return value;
+
+	switch (storage_size(w->types, type)) {
+		case 1:  return value & 0xff;
+		case 2:  return value & 0xffff;
+		default: return value;
+	}
+}
+
+static
+int step_of(struct Walker *w, unsigned type) {
+	if (!is_pointer(w->types, type)) return 1;
+
+	unsigned element = pointee(w->types, type);
+	return element == VOID ? 1 : type_size(w->types, element);
+}
+
+static
+uint32_t walk_expression(struct Walker *, struct AST_Expression *);
+
+static
+enum Flow walk_body(struct Walker *, struct AST_Statement *);
+
+static
+uint32_t walk_address(struct Walker *w, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case IDENTIFIER: {
+			struct Slot *slot = find_slot(w->program, expr->identifier.declaration);
+			return slot->kind == SLOT_LOCAL ? w->fp + slot->location : (uint32_t)slot->location;
+		}
+
+		case UNARY_OP:
+			return walk_expression(w, expr->unary_op.rhs);
+
+		case BINARY_OP: {
+			struct AST_ExprBinaryOp *op = &expr->binary_op;
+			unsigned id = expression_type(op->lhs).id;
+
+			if (op->token->value == '.') {
+				struct Field *field = find_field(w->types, id, op->rhs->identifier.token->text);
+				if (!get_type(w->types, id)->soa) return walk_address(w, op->lhs) + field->offset;
+
+				// a[i].f of a soa array: the ith of the array of f
+				struct AST_ExprBinaryOp *element = &op->lhs->binary_op;
+				int length = get_type(w->types, expression_type(element->lhs).id)->length;
+
+				uint32_t base = walk_address(w, element->lhs) + length * field->offset;
+				return base + walk_expression(w, element->rhs) * type_size(w->types, field->type);
+			}
+
+			if (is_array(w->types, id)) {
+				uint32_t base = walk_address(w, op->lhs);
+				return base + walk_expression(w, op->rhs) * type_size(w->types, get_type(w->types, id)->base);
+			}
+
+			uint32_t base = walk_expression(w, op->lhs);
+			uint32_t index = walk_expression(w, op->rhs);
+			return base + index * step_of(w, id);
+		}
+
+		default:
+			assert(0 && "unreachable");
+			return 0;
+	}
+}
+
+static
+uint32_t walk_builtin(struct Walker *w, struct AST_ExprFuncCall *call) {
+	struct AST_Expression *args[MAX_PARAMS];
+	int count = call_arguments(call->args, args);
+
+	uint32_t value = walk_expression(w, args[0]);
+	uint32_t by = count > 1 ? walk_expression(w, args[1]) : 0;
+
+	if (call->builtin == BUILTIN_PREFETCH) return value;
+	return evaluate_builtin(call->builtin, 8 * storage_size(w->types, expression_type(args[0]).id), value, by);
+}
+
+static
+uint32_t walk_call(struct Walker *w, struct AST_ExprFuncCall *call) {
+	if (call->builtin) return walk_builtin(w, call);
+
+	struct AST_Declaration *decl = call->func->identifier.declaration;
+	struct Function *function = (struct Function *)w->program->functions.mem + find_slot(w->program, decl)->location;
+
+	struct AST_Expression *args[MAX_PARAMS];
+	uint32_t values[MAX_PARAMS];
+	int count = call_arguments(call->args, args);
+
+	for (int i = 0; i < count; i++) {
+		values[i] = narrow(w, walk_expression(w, args[i]), decl->params[i]->type.id);
+	}
+
+	if (w->depth == MAX_CALLS) errx("calls nested more than %d deep", MAX_CALLS);
+	if ((uint32_t)function->frame_size > w->machine.size - w->top) errx("stack overflow");
+
+	struct AST_Declaration *caller = w->function;
+	uint32_t fp = w->fp;
+
+	w->function = function->declaration;
+	w->fp = w->top;
+	w->top += function->frame_size;
+	w->depth++;
+
+	memcpy(w->machine.memory + w->fp, values, count * sizeof *values);
+	uint32_t result = walk_body(w, function->declaration->body) == FLOW_RETURN ? w->result : 0;
+
+	w->depth--;
+	w->top = w->fp;
+	w->fp = fp;
+	w->function = caller;
+
+	return result;
+}
+
+static
+uint32_t walk_unary(struct Walker *w, struct AST_ExprUnaryOp *op) {
+	unsigned rhs = expression_type(op->rhs).id;
+
+	if (op->token->type == KEYWORD_SIZEOF) return type_size(w->types, rhs);
+
+	switch (op->token->value) {
+		case '+': return walk_expression(w, op->rhs);
+		case '-': return -walk_expression(w, op->rhs);
+		case '~': return ~walk_expression(w, op->rhs);
+		case '!': return !walk_expression(w, op->rhs);
+
+		case INC: case DEC:
+		case POST_INC: case POST_DEC: {
+			int step = step_of(w, rhs);
+			if (op->token->value == DEC || op->token->value == POST_DEC) step = -step;
+
+			uint32_t address = walk_address(w, op->rhs);
+			uint32_t old = load(w, address, rhs);
+			uint32_t new = narrow(w, old + step, rhs);
+
+			store(w, address, rhs, new);
+			return (op->token->value == POST_INC || op->token->value == POST_DEC) ? old : new;
+		}
+
+		case '*': return walk_address(w, op->rhs);
+		case SHL: return load(w, walk_expression(w, op->rhs), op->type.id);
+	}
+
+	assert(0 && "unreachable");
+	return 0;
+}
+
+static
+uint32_t walk_binary(struct Walker *w, struct AST_Expression *expr) {
+	struct AST_ExprBinaryOp *op = &expr->binary_op;
+	unsigned lhs = expression_type(op->lhs).id;
+	unsigned rhs = expression_type(op->rhs).id;
+
+	if (op->token->type == KEYWORD_ELSE) {
+		uint32_t value = walk_expression(w, op->lhs);
+		return value ? value : narrow(w, walk_expression(w, op->rhs), op->type.id);
+	}
+
+	switch (op->token->value) {
+		case ',':
+			walk_expression(w, op->lhs);
+			return walk_expression(w, op->rhs);
+
+		case '=': {
+			uint32_t address = walk_address(w, op->lhs);
+			uint32_t value = narrow(w, walk_expression(w, op->rhs), lhs);
+
+			store(w, address, lhs, value);
+			return value;
+		}
+
+		case AND: return walk_expression(w, op->lhs) && walk_expression(w, op->rhs);
+		case OR:  return walk_expression(w, op->lhs) || walk_expression(w, op->rhs);
+		case '[': case '.': return load(w, walk_address(w, expr), op->type.id);
+	}
+
+	uint32_t a = walk_expression(w, op->lhs);
+	uint32_t b = walk_expression(w, op->rhs);
+
+	bool left = is_pointer(w->types, lhs);
+	bool right = is_pointer(w->types, rhs);
+
+	// pointer arithmetic scales the integer operand
+	if ((op->token->value == '+' || op->token->value == '-') && (left || right)) {
+		if (left && right) return (int32_t)(a - b) / step_of(w, lhs);
+		if (left)  b *= step_of(w, lhs);
+		if (right) a *= step_of(w, rhs);
+	}
+
+	bool sign = !left && !right && max(max(lhs, rhs), U32) == INT;
+
+	switch (op->token->value) {
+		case '+': return a + b;
+		case '-': return a - b;
+		case '*': return a * b;
+
+		case '/': case '%':
+			if (b == 0) errx("division by zero");
+			if (!sign) return op->token->value == '/' ? a / b : a % b;
+			if (b == UINT32_MAX) return op->token->value == '/' ? -a : 0;
+			return op->token->value == '/' ? (uint32_t)((int32_t)a / (int32_t)b)
+			                               : (uint32_t)((int32_t)a % (int32_t)b);
+
+		case '&': return a & b;
+		case '|': return a | b;
+		case '^': return a ^ b;
+		case SHL: return a << (b & 31);
+		case SHR: return lhs == INT ? (uint32_t)((int32_t)a >> (b & 31)) : a >> (b & 31);
+
+		case EQ:  return a == b;
+		case NEQ: return a != b;
+		case '<': return sign ? (int32_t)a <  (int32_t)b : a <  b;
+		case LEQ: return sign ? (int32_t)a <= (int32_t)b : a <= b;
+		case '>': return sign ? (int32_t)a >  (int32_t)b : a >  b;
+		case GEQ: return sign ? (int32_t)a >= (int32_t)b : a >= b;
+
+		case CHECK_INDEX:
+			if (a >= b) errx("index %u out of bounds for length %u", a, b);
+			return a;
+	}
+
+	assert(0 && "unreachable");
+	return 0;
+}
+
+static
+uint32_t walk_expression(struct Walker *w, struct AST_Expression *expr) {
+	w->nodes++;
+
+	switch (expr->type) {
+		case LITERAL:
+			return expr->literal.value;
+
+		case STRING:
+			return find_slot(w->program, expr->string.token)->location;
+
+		case IDENTIFIER:
+			return load(w, walk_address(w, expr), expr->identifier.type.id);
+
+		case UNARY_OP:
+			return walk_unary(w, &expr->unary_op);
+
+		case BINARY_OP:
+			return walk_binary(w, expr);
+
+		case TYPE_CAST:
+			return narrow(w, walk_expression(w, expr->type_cast.rhs), expr->type_cast.type.id);
+
+		case FUNC_CALL:
+			return walk_call(w, &expr->func_call);
+	}
+
+	assert(0 && "unreachable");
+	return 0;
+}
+
+static
+enum Flow walk_statement(struct Walker *w, struct AST_Statement *statement) {
+	switch (statement->type) {
+		case STMT_EXPRESSION:
+			walk_expression(w, statement->expression);
+			return FLOW_NEXT;
+
+		case STMT_DECLARATION: {
+			struct AST_Declaration *decl = statement->declaration;
+			uint32_t address = w->fp + find_slot(w->program, decl)->location;
+
+			if (is_aggregate(w->types, decl->type.id)) {
+				int size = type_size(w->types, decl->type.id);
+				memset(w->machine.memory + check_address(w, address, size), 0, size);
+				return FLOW_NEXT;
+			}
+
+			uint32_t value = decl->value ? narrow(w, walk_expression(w, decl->value), decl->type.id) : 0;
+
+			store(w, address, decl->type.id, value);
+			return FLOW_NEXT;
+		}
+
+		case STMT_BLOCK:
+			return walk_body(w, statement->block.body);
+
+		case STMT_IF: {
+			struct AST_StmtIf *conditional = &statement->conditional;
+
+			if (walk_expression(w, conditional->condition)) return walk_body(w, conditional->then);
+			return walk_body(w, conditional->otherwise);
+		}
+
+		case STMT_WHILE:
+			while (walk_expression(w, statement->loop.condition)) {
+				enum Flow flow = walk_body(w, statement->loop.body);
+
+				if (flow == FLOW_BREAK) break;
+				if (flow == FLOW_RETURN) return flow;
+			}
+
+			return FLOW_NEXT;
+
+		case STMT_DO:
+			do {
+				enum Flow flow = walk_body(w, statement->loop.body);
+
+				if (flow == FLOW_BREAK) break;
+				if (flow == FLOW_RETURN) return flow;
+			} while (walk_expression(w, statement->loop.condition));
+
+			return FLOW_NEXT;
+
+		case STMT_RETURN:
+			w->result = 0;
+
+			if (statement->expression) {
+				w->result = narrow(w, walk_expression(w, statement->expression), w->function->type.id);
+			}
+
+			return FLOW_RETURN;
+
+		case STMT_BREAK:
+			return FLOW_BREAK;
+
+		// runs on from the label, the labels themselves do nothing
+		case STMT_SWITCH: {
+			struct AST_StmtSwitch *s = &statement->selection;
+			int label = find_case(s, walk_expression(w, s->condition));
+
+			if (label < 0) return FLOW_NEXT;
+
+			enum Flow flow = walk_body(w, s->labels[label]);
+			return flow == FLOW_BREAK ? FLOW_NEXT : flow;
+		}
+
+		case STMT_CASE:
+			return FLOW_NEXT;
+	}
+
+	assert(0 && "unreachable");
+	return FLOW_NEXT;
+}
+
+static
+enum Flow walk_body(struct Walker *w, struct AST_Statement *body) {
+	for (struct AST_Statement *statement = body; statement; statement = statement->next) {
+		enum Flow flow = walk_statement(w, statement);
+		if (flow != FLOW_NEXT) return flow;
+	}
+
+	return FLOW_NEXT;
+}
+
+uint32_t walk_program(struct Program *program, uint64_t *nodes) {
+	struct Walker w = {
+		.program = program,
+		.types = program->types,
+	};
+
+	init_machine(&w.machine, program, STACK_SIZE, 0, 0);
+	w.fp = w.top = w.machine.stack;
+
+	struct AST_Declaration **globals = program->globals.mem;
+
+	for (int i = 0; i < program->globals.length; i++) {
+		struct AST_Declaration *decl = globals[i];
+		if (decl->value == NULL) continue;
+
+		uint32_t value = narrow(&w, walk_expression(&w, decl->value), decl->type.id);
+		store(&w, find_slot(program, decl)->location, decl->type.id, value);
+	}
+
+	struct Function *main = (struct Function *)program->functions.mem + program->main;
+	struct AST_Expression callee = { .type = IDENTIFIER, .identifier = { .token = main->declaration->token,
+	                                                                     .declaration = main->declaration } };
+	struct AST_ExprFuncCall call = { .func = &callee };
+
+	uint32_t result = walk_call(&w, &call);
+	*nodes = w.nodes;
+
+	free_machine(&w.machine);
+	return result;
+}
+
+
+static
+double seconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void benchmark_program(struct Program *program) {
+	uint64_t nodes = 0;
+
+	double start = seconds();
+	uint32_t walked = walk_program(program, &nodes);
+	double walk = seconds() - start;
+
+	start = seconds();
+	uint32_t ran = run_program(program);
+	double run = seconds() - start;
+
+	if (walked != ran) errx("the tree walker returned %u, the bytecode %u", walked, ran);
+
+	printf("main returned %u, %llu operations\n", ran, (unsigned long long)nodes);
+	printf("tree walker: %8.3f s %10.1f Mops/s\n", walk, nodes / walk * 1e-6);
+	printf("bytecode:    %8.3f s %10.1f Mops/s  (%.1fx)\n", run, nodes / run * 1e-6, walk / run);
+	printf("%d bytes of code, %d functions\n", program->code.length, program->functions.length);
+}
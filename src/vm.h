@@ -0,0 +1,55 @@
+#ifndef VM_H_
+#define VM_H_
+
+#include "ast.h"
+#include "bytecode.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// interpreter:
+//
+// dispatches through a table of label addresses, one indirect jump at the
+// end of every instruction, with compilers that have computed goto. the
+// same loop is a switch otherwise, or when built with -DVM_SWITCH. frames
+// live in the memory of the machine above the globals, the operand stack
+// and the return addresses in arrays of their own.
+//
+// constant expressions run on a small machine of their own, with no
+// globals. the functions they call get fixed budgets of memory and steps,
+// a loop iteration or a call each, so that no evaluation at compile time
+// can hang the compiler or exhaust its memory.
+//
+
+enum {
+	STACK_SIZE = 1 << 20,   // bytes of frames
+	STACK_VALUES = 1 << 16, // operand stack
+	MAX_CALLS = 1 << 16,
+
+	// budgets of evaluation at compile time
+	CONSTANT_STEPS = 1 << 24, // loop iterations and calls
+	CONSTANT_STACK = 1 << 16,
+	CONSTANT_VALUES = 1 << 12,
+	CONSTANT_CALLS = 1 << 10,
+	CONSTANT_FAULT_SIZE = 64,
+};
+
+// runs the program from its start and returns what main returns, faults
+// (division by zero, a bad address, overflowing a stack) are fatal
+uint32_t run_program(struct Program *);
+
+// the value of a constant expression, false if it is not one or faults.
+// functions it calls are run within the budgets above, `fault` gets why
+// evaluation stopped if it did, when it is not NULL
+bool evaluate_constant(struct TypeTable *, struct AST_Expression *, struct Callees *, uint32_t *value, char *fault);
+
+// evaluates the program over the AST instead, with the same memory layout
+// and semantics, counting the nodes evaluated
+uint32_t walk_program(struct Program *, uint64_t *nodes);
+
+// runs the program with both and prints their throughput, in nodes the
+// walker evaluated per second
+void benchmark_program(struct Program *);
+
+#endif //VM_H_
@@ -0,0 +1,74 @@
+#include "writer.h"
+
+#include "util.h"
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void open_writer(struct Writer *writer, const char *path) {
+	writer->path = path;
+	writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (writer->fd < 0) errx("cannot open `%s` for writing", path);
+
+	writer->buffer = malloc(WRITER_BUFFER_SIZE);
+	if (!writer->buffer) errx("out of memory: failed to allocate %d bytes", WRITER_BUFFER_SIZE);
+
+	writer->length = 0;
+}
+
+static
+void write_all(struct Writer *writer, const char *text, int length) {
+	for (int written = 0; written < length;) {
+		ssize_t count = write(writer->fd, text + written, length - written);
+		if (count < 0) errx("failed to write `%s`", writer->path);
+
+		written += count;
+	}
+}
+
+static
+void flush(struct Writer *writer) {
+	write_all(writer, writer->buffer, writer->length);
+	writer->length = 0;
+}
+
+void close_writer(struct Writer *writer) {
+	flush(writer);
+
+	if (close(writer->fd) != 0) errx("failed to write `%s`", writer->path);
+	free(writer->buffer);
+}
+
+void write_text(struct Writer *writer, const char *text, int length) {
+	if (writer->length + length > WRITER_BUFFER_SIZE) flush(writer);
+
+	// too long to buffer at all
+	if (length > WRITER_BUFFER_SIZE) {
+		write_all(writer, text, length);
+		return;
+	}
+
+	memcpy(writer->buffer + writer->length, text, length);
+	writer->length += length;
+}
+
+void write_string(struct Writer *writer, const char *text) {
+	write_text(writer, text, strlen(text));
+}
+
+// formatted straight into the buffer, lines are short
+void write_format(struct Writer *writer, const char *fmt, ...) {
+	enum { MAX_LINE = 1024 };
+	if (writer->length + MAX_LINE > WRITER_BUFFER_SIZE) flush(writer);
+
+	va_list args;
+	va_start(args, fmt);
+	int length = vsnprintf(writer->buffer + writer->length, MAX_LINE, fmt, args);
+	va_end(args);
+
+	writer->length += min(length, MAX_LINE - 1);
+}
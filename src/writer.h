@@ -0,0 +1,29 @@
+#ifndef WRITER_H_
+#define WRITER_H_
+
+#include "util.h"
+
+// buffered output to a file descriptor: text is gathered in one large
+// buffer and written with a single write(2) whenever it fills up
+//
+
+enum {
+	WRITER_BUFFER_SIZE = 1 << 20,
+};
+
+struct Writer {
+	const char *path;
+	int fd;
+	char *buffer;
+	int length;
+};
+
+// errors fail the input being compiled, see errx
+void open_writer(struct Writer *, const char *path);
+void close_writer(struct Writer *);
+
+void write_text(struct Writer *, const char *text, int length);
+void write_string(struct Writer *, const char *text);
+void write_format(struct Writer *, const char *fmt, ...) PRINTF(2,3);
+
+#endif //WRITER_H_
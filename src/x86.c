@@ -0,0 +1,1830 @@
+#include "x86.h"
+
+#include "assembler.h"
+#include "ast.h"
+#include "literals.h"
+#include "parser.h"
+#include "switch.h"
+#include "tokens.h"
+#include "types.h"
+#include "util.h"
+#include "vm.h"
+#include "writer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define HAVE_CPUID
+#endif
+
+enum {
+	REGISTERS = 5,       // hold values, in the order they are used
+	SCRATCH = REGISTERS, // holds a spilled operand for one instruction
+};
+
+static const enum Register registers[REGISTERS + 1] = { RSI, RDI, R8, R9, R10, R11 };
+static const enum Register arguments[] = { RDI, RSI, RDX, RCX, R8, R9 };
+
+enum {
+	REGISTER_ARGUMENTS = sizeof arguments / sizeof *arguments,
+
+	// a vector value in register r is in %xmm<r>, the two after the
+	// scratch one hold intermediates of a single operation
+	TEMPORARY = SCRATCH + 1,
+};
+
+
+// pointer keyed tables: offsets of locals, register needs
+
+struct Entry {
+	const void *key;
+	int value;
+};
+
+struct Table {
+	struct Entry *entries;
+	int count, capacity;
+};
+
+static
+unsigned key_hash(const void *key) {
+	return (unsigned)((uintptr_t)key >> 4) * 0x9e3779b1u;
+}
+
+static
+int *lookup(struct Table *table, const void *key) {
+	if (table->capacity == 0) return NULL;
+
+	for (unsigned i = key_hash(key);; i++) {
+		struct Entry *entry = &table->entries[i & (table->capacity - 1)];
+
+		if (entry->key == key) return &entry->value;
+		if (entry->key == NULL) return NULL;
+	}
+}
+
+static
+void insert(struct Table *table, const void *key, int value) {
+	int *existing = lookup(table, key);
+	if (existing) {
+		*existing = value;
+		return;
+	}
+
+	if (2 * (table->count + 1) > table->capacity) {
+		struct Entry *old = table->entries;
+		int capacity = table->capacity;
+
+		table->capacity = max(256, capacity * 2);
+		table->entries = calloc(table->capacity, sizeof *table->entries);
+		if (!table->entries) errx("out of memory: failed to allocate %d entries", table->capacity);
+
+		table->count = 0;
+		for (int i = 0; i < capacity; i++) {
+			if (old[i].key) insert(table, old[i].key, old[i].value);
+		}
+
+		free(old);
+	}
+
+	unsigned i = key_hash(key);
+	while (table->entries[i & (table->capacity - 1)].key) i++;
+
+	table->entries[i & (table->capacity - 1)] = (struct Entry) { key, value };
+	table->count++;
+}
+
+static
+void clear_table(struct Table *table) {
+	if (table->count) memset(table->entries, 0, table->capacity * sizeof *table->entries);
+	table->count = 0;
+}
+
+
+struct Codegen {
+	struct Assembler *as;
+	struct TypeTable *types;
+	unsigned features; // enum Feature
+
+	struct Table locals; // declaration -> offset from %rbp
+	struct Table needs;  // expression -> registers
+
+	struct AST_Declaration *function;
+	int frame, frame_size;
+	int pushed;   // 8-byte pushes on top of the frame, for call alignment
+	unsigned vectors; // registers, by bit, that hold a vector while another operand is evaluated
+	int loop_end; // label that break jumps to
+	int ret;      // label of the epilogue
+	int *labels;  // of the innermost switch
+};
+
+
+// widths
+
+static
+bool wide(struct Codegen *g, unsigned type) {
+	return is_pointer(g->types, type);
+}
+
+// out of line, its buffer would take room in every frame of gen otherwise
+static NOINLINE
+void unsupported(struct TypeTable *types, unsigned type) {
+	char buffer[256];
+	errx("values of type `%s` are not supported by the x86-64 backend", print_type(types, type, buffer, sizeof buffer));
+}
+
+static
+int size_of(struct Codegen *g, unsigned type) {
+	int size = type_size(g->types, type);
+
+	if (size != 1 && size != 2 && size != 4 && size != 8 && !is_vector(g->types, type)) {
+		unsupported(g->types, type);
+	}
+
+	return size;
+}
+
+// values are 32-bit, zero-extended to 64, pointers are 64-bit
+static
+int width(struct Codegen *g, unsigned type) {
+	return wide(g, type) ? 8 : 4;
+}
+
+static
+struct Operand pool(int r) {
+	return reg(registers[r]);
+}
+
+static
+struct Operand vector_pool(int r) {
+	return xmm(r);
+}
+
+// what pointer arithmetic scales by, void * counts bytes
+static
+int element_size(struct Codegen *g, unsigned type) {
+	unsigned element = pointee(g->types, type);
+	return element == VOID ? 1 : type_size(g->types, element);
+}
+
+static
+int log2_of(int size) {
+	return 31 - __builtin_clz(size);
+}
+
+
+// register needs
+
+static
+int pair(int lhs, int rhs) {
+	return lhs == rhs ? lhs + 1 : max(lhs, rhs);
+}
+
+static
+bool is_operator(struct Token *token, unsigned punctuation) {
+	return token->type == PUNCTUATION && token->value == punctuation;
+}
+
+// an operand that fits in the instruction as a 32-bit immediate
+static
+bool immediate(struct Codegen *g, struct AST_ExprBinaryOp *op) {
+	if (op->token->type != PUNCTUATION || op->rhs->type != LITERAL) return false;
+	if (op->rhs->literal.value > INT32_MAX) return false;
+	if (wide(g, expression_type(op->lhs).id) || wide(g, expression_type(op->rhs).id)) {
+		return op->token->value == EQ || op->token->value == NEQ;
+	}
+
+	switch (op->token->value) {
+		case '+': case '-': case '*':
+		case '&': case '|': case '^':
+		case SHL: case SHR:
+		case EQ: case NEQ:
+		case '<': case LEQ: case '>': case GEQ:
+		case CHECK_INDEX:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+static
+int need(struct Codegen *, struct AST_Expression *);
+
+static
+bool static_place(struct Codegen *, struct AST_Expression *, struct Operand *);
+
+// the field `s.name` names
+static
+struct Field *member(struct Codegen *g, struct AST_ExprBinaryOp *op) {
+	return find_field(g->types, expression_type(op->lhs).id, op->rhs->identifier.token->text);
+}
+
+// a[i] of a soa array a, only ever the lhs of `.`
+static
+bool soa_element(struct Codegen *g, struct AST_Expression *expr) {
+	return expr->type == BINARY_OP && is_operator(expr->binary_op.token, '[') &&
+	       is_soa_array(g->types, expression_type(expr->binary_op.lhs).id);
+}
+
+// frame slots and globals are addressed in the instruction, and so are
+// fields and elements at constant offsets in them
+static
+int need_address(struct Codegen *g, struct AST_Expression *expr) {
+	struct Operand place;
+	if (static_place(g, expr, &place)) return 0;
+
+	switch (expr->type) {
+		case UNARY_OP: return need(g, expr->unary_op.rhs);
+
+		case BINARY_OP: {
+			struct AST_ExprBinaryOp *op = &expr->binary_op;
+
+			if (is_operator(op->token, '.')) {
+				if (!soa_element(g, op->lhs)) return need_address(g, op->lhs);
+				op = &op->lhs->binary_op;
+			}
+
+			if (is_array(g->types, expression_type(op->lhs).id)) return pair(need_address(g, op->lhs), need(g, op->rhs));
+			return pair(need(g, op->lhs), need(g, op->rhs));
+		}
+
+		default: assert(0 && "unreachable"); return 0;
+	}
+}
+
+static
+int label_need(struct Codegen *g, struct AST_Expression *expr) {
+	switch (expr->type) {
+		case LITERAL: case STRING: case IDENTIFIER:
+			return 1;
+
+		case UNARY_OP: {
+			struct AST_ExprUnaryOp *op = &expr->unary_op;
+			if (op->token->type == KEYWORD_SIZEOF) return 1;
+
+			switch (op->token->value) {
+				case INC: case DEC: case POST_INC: case POST_DEC: case '*':
+					return max(1, need_address(g, op->rhs));
+
+				default:
+					return need(g, op->rhs);
+			}
+		}
+
+		case BINARY_OP: {
+			struct AST_ExprBinaryOp *op = &expr->binary_op;
+
+			if (op->token->type == KEYWORD_ELSE || is_operator(op->token, ',') ||
+			    is_operator(op->token, AND) || is_operator(op->token, OR)) {
+				return max(need(g, op->lhs), need(g, op->rhs));
+			}
+
+			if (is_operator(op->token, '=')) {
+				if (need_address(g, op->lhs) == 0) return need(g, op->rhs);
+				return pair(need_address(g, op->lhs), need(g, op->rhs));
+			}
+
+			// loads from an address
+			if (is_operator(op->token, '.') || is_array(g->types, expression_type(op->lhs).id)) {
+				return max(1, need_address(g, expr));
+			}
+
+			if (immediate(g, op)) return need(g, op->lhs);
+			return pair(need(g, op->lhs), need(g, op->rhs));
+		}
+
+		case TYPE_CAST:
+			return need(g, expr->type_cast.rhs);
+
+		// every register is clobbered, calls go first. builtins are operations
+		case FUNC_CALL: {
+			struct AST_Expression *args[MAX_PARAMS];
+			if (!expr->func_call.builtin) return REGISTERS;
+
+			int count = call_arguments(expr->func_call.args, args);
+			return count == 1 ? need(g, args[0]) : pair(need(g, args[0]), need(g, args[1]));
+		}
+	}
+
+	assert(0 && "unreachable");
+	return 0;
+}
+
+static
+int need(struct Codegen *g, struct AST_Expression *expr) {
+	int *known = lookup(&g->needs, expr);
+	if (known) return *known;
+
+	int registers = label_need(g, expr);
+	insert(&g->needs, expr, registers);
+	return registers;
+}
+
+
+// places: where an lvalue is, as a memory operand
+
+static
+struct Operand identifier_place(struct Codegen *g, struct AST_Expression *expr) {
+	struct AST_Declaration *decl = expr->identifier.declaration;
+	struct Token *name = expr->identifier.token;
+
+	if (decl->function) {
+		errx("%s:%d:%d: function `%s` cannot be used as a value", name->filename, name->line, name->col, name->text);
+	}
+
+	int *offset = lookup(&g->locals, decl);
+	return offset ? mem(RBP, *offset) : symbol(TARGET_GLOBAL, decl);
+}
+
+static
+struct Operand register_place(int r) {
+	return mem(registers[r], 0);
+}
+
+// identifiers, and fields and elements of them at constant offsets: the
+// index of an element is a literal within the bounds of its array
+static
+bool static_place(struct Codegen *g, struct AST_Expression *expr, struct Operand *place) {
+	if (expr->type == IDENTIFIER) {
+		*place = identifier_place(g, expr);
+		return true;
+	}
+
+	if (expr->type != BINARY_OP) return false;
+	struct AST_ExprBinaryOp *op = &expr->binary_op;
+
+	if (is_operator(op->token, '.')) {
+		struct Field *field = member(g, op);
+		if (!soa_element(g, op->lhs)) {
+			if (!static_place(g, op->lhs, place)) return false;
+
+			place->value += field->offset;
+			return true;
+		}
+
+		// a[i].f is at a + n * offset + i * size(f)
+		struct AST_ExprBinaryOp *element = &op->lhs->binary_op;
+		struct TypeEntry *array = get_type(g->types, expression_type(element->lhs).id);
+
+		if (element->rhs->type != LITERAL || element->rhs->literal.value >= (unsigned)array->length) return false;
+		if (!static_place(g, element->lhs, place)) return false;
+
+		place->value += array->length * field->offset + element->rhs->literal.value * type_size(g->types, field->type);
+		return true;
+	}
+
+	if (is_operator(op->token, '[') && is_array(g->types, expression_type(op->lhs).id)) {
+		struct TypeEntry *array = get_type(g->types, expression_type(op->lhs).id);
+
+		if (op->rhs->type != LITERAL || op->rhs->literal.value >= (unsigned)array->length) return false;
+		if (!static_place(g, op->lhs, place)) return false;
+
+		place->value += op->rhs->literal.value * type_size(g->types, array->base);
+		return true;
+	}
+
+	return false;
+}
+
+static
+void load(struct Codegen *g, struct Operand place, unsigned type, int r) {
+	switch (size_of(g, type)) {
+		case 1: emit_binary(g->as, I_MOVZB, 4, place, pool(r)); break;
+		case 2: emit_binary(g->as, I_MOVZW, 4, place, pool(r)); break;
+		case 4: emit_binary(g->as, I_MOV, 4, place, pool(r));   break;
+		case 8: emit_binary(g->as, I_MOV, 8, place, pool(r));   break;
+		case 16: emit_vector(g->as, I_MOVDQU, place, vector_pool(r)); break;
+	}
+}
+
+static
+void store(struct Codegen *g, struct Operand place, unsigned type, int r) {
+	if (is_vector(g->types, type)) emit_vector(g->as, I_MOVDQU, vector_pool(r), place);
+	else                           emit_binary(g->as, I_MOV, size_of(g, type), pool(r), place);
+}
+
+// every lane of %xmm<x> holds the 32-bit pattern
+static
+void splat(struct Codegen *g, uint32_t pattern, int x) {
+	emit_binary(g->as, I_MOV, 4, imm(pattern), reg(RAX));
+	emit_vector(g->as, I_MOVD, reg(RAX), xmm(x));
+	emit_shuffle(g->as, 0, xmm(x), xmm(x));
+}
+
+static
+void convert(struct Codegen *, unsigned from, unsigned to, int r);
+
+// a scalar in register r narrowed to the lane type, into every lane
+static
+void broadcast(struct Codegen *g, unsigned from, unsigned to, int r) {
+	unsigned lane = lane_type(g->types, to);
+	convert(g, from, lane, r);
+
+	if (lane == U8) emit_binary(g->as, I_IMUL, 4, imm(0x01010101), pool(r));
+	emit_vector(g->as, I_MOVD, pool(r), vector_pool(r));
+	emit_shuffle(g->as, 0, vector_pool(r), vector_pool(r));
+}
+
+// values are canonical for their type: narrowing truncates, widening an
+// int to a pointer sign-extends. a vector cast to another keeps its bits
+static
+void convert(struct Codegen *g, unsigned from, unsigned to, int r) {
+	if (from == VOID || to == VOID || from == to) return;
+
+	if (is_vector(g->types, to)) {
+		if (!is_vector(g->types, from)) broadcast(g, from, to, r);
+		return;
+	}
+
+	if (wide(g, to)) {
+		if (from == INT) emit_binary(g->as, I_MOVSLQ, 8, pool(r), pool(r));
+		return;
+	}
+
+	int size = size_of(g, to);
+	bool narrows = wide(g, from) || size < size_of(g, from);
+
+	if (!narrows) return;
+
+	switch (size) {
+		case 1: emit_binary(g->as, I_MOVZB, 4, pool(r), pool(r)); break;
+		case 2: emit_binary(g->as, I_MOVZW, 4, pool(r), pool(r)); break;
+		case 4: emit_binary(g->as, I_MOV, 4, pool(r), pool(r));   break;
+	}
+}
+
+static
+void test(struct Codegen *g, unsigned type, int r) {
+	emit_binary(g->as, I_TEST, width(g, type), pool(r), pool(r));
+}
+
+// the flags into a 0 or 1 in register t
+static
+void set(struct Codegen *g, enum ConditionCode condition, int t) {
+	emit_set(g->as, condition, RAX);
+	emit_binary(g->as, I_MOVZB, 4, reg(RAX), pool(t));
+}
+
+
+// expressions: the value of an expression evaluated with registers [t, REGISTERS)
+// available ends in register t
+
+static
+void gen(struct Codegen *, struct AST_Expression *, int t);
+
+static
+void gen_address(struct Codegen *, struct AST_Expression *, int t);
+
+// register r onto the stack and back, a vector takes two slots
+static
+void save(struct Codegen *g, bool vector, int r) {
+	if (vector) {
+		emit_binary(g->as, I_SUB, 8, imm(16), reg(RSP));
+		emit_vector(g->as, I_MOVDQU, vector_pool(r), mem(RSP, 0));
+		g->pushed += 2;
+	} else {
+		emit_unary(g->as, I_PUSH, 8, pool(r));
+		g->pushed++;
+	}
+}
+
+static
+void restore(struct Codegen *g, bool vector, int r) {
+	if (vector) {
+		emit_vector(g->as, I_MOVDQU, mem(RSP, 0), vector_pool(r));
+		emit_binary(g->as, I_ADD, 8, imm(16), reg(RSP));
+		g->pushed -= 2;
+	} else {
+		emit_unary(g->as, I_POP, 8, pool(r));
+		g->pushed--;
+	}
+}
+
+// evaluates two operands, the needier one first. when there are not enough
+// registers left for the second the first is pushed while it is evaluated
+static
+void gen_operands(struct Codegen *g, struct AST_Expression *lhs, bool address,
+                  struct AST_Expression *rhs, int t, int *left, int *right) {
+	int lhs_need = address ? need_address(g, lhs) : need(g, lhs);
+	int rhs_need = need(g, rhs);
+	bool lhs_first = lhs_need >= rhs_need;
+
+	struct AST_Expression *first = lhs_first ? lhs : rhs;
+	struct AST_Expression *second = lhs_first ? rhs : lhs;
+	bool vector = !(first == lhs && address) && is_vector(g->types, expression_type(first).id);
+
+	#define GEN(expr, r) ((expr) == lhs && address ? gen_address(g, expr, r) : gen(g, expr, r))
+
+	if (t + 1 < REGISTERS && min(lhs_need, rhs_need) <= REGISTERS - t - 1) {
+		GEN(first, t);
+		if (vector) g->vectors |= 1u << t;
+
+		GEN(second, t + 1);
+		g->vectors &= ~(1u << t);
+
+		*left = lhs_first ? t : t + 1;
+		*right = lhs_first ? t + 1 : t;
+		return;
+	}
+
+	GEN(first, t);
+	save(g, vector, t);
+
+	GEN(second, t);
+	restore(g, vector, SCRATCH);
+
+	#undef GEN
+
+	*left = lhs_first ? SCRATCH : t;
+	*right = lhs_first ? t : SCRATCH;
+}
+
+// the result is in `left`, moved to t
+static
+void move_result(struct Codegen *g, unsigned type, int from, int t) {
+	if (from == t) return;
+
+	if (is_vector(g->types, type)) emit_vector(g->as, I_MOVDQA, vector_pool(from), vector_pool(t));
+	else                           emit_binary(g->as, I_MOV, width(g, type), pool(from), pool(t));
+}
+
+// the vector registers are not part of the calling convention here
+static
+void check_signature(struct Codegen *g, struct AST_Declaration *decl) {
+	bool vectors = is_vector(g->types, decl->type.id);
+	for (int i = 0; i < decl->param_count; i++) vectors |= is_vector(g->types, decl->params[i]->type.id);
+
+	if (vectors) {
+		struct Token *name = decl->token;
+		errx("%s:%d:%d: function `%s` passes vectors, which the x86-64 backend does not support",
+		     name->filename, name->line, name->col, name->text);
+	}
+}
+
+static
+void gen_builtin(struct Codegen *, struct AST_ExprFuncCall *, int t);
+
+// not inlined: gen recurses once per level of an expression, and the
+// arguments and builtins need kilobytes of locals
+static NOINLINE
+void gen_call(struct Codegen *g, struct AST_ExprFuncCall *call, int t) {
+	if (call->builtin) {
+		gen_builtin(g, call, t);
+		return;
+	}
+
+	struct AST_Declaration *decl = call->func->identifier.declaration;
+	check_signature(g, decl);
+
+	struct AST_Expression *args[MAX_PARAMS];
+	int count = call_arguments(call->args, args);
+	int on_stack = max(0, count - REGISTER_ARGUMENTS);
+
+	// the registers in use are caller-saved, the vector ones as well
+	unsigned vectors = g->vectors;
+	for (int i = 0; i < t; i++) save(g, vectors >> i & 1, i);
+	g->vectors = 0;
+
+	// %rsp is 16-byte aligned at the call
+	bool pad = (g->pushed + on_stack) % 2;
+	if (pad) {
+		emit_binary(g->as, I_SUB, 8, imm(8), reg(RSP));
+		g->pushed++;
+	}
+
+	// right to left, each onto the stack, the first six are popped into registers
+	for (int i = count - 1; i >= 0; i--) {
+		gen(g, args[i], 0);
+		convert(g, expression_type(args[i]).id, decl->params[i]->type.id, 0);
+
+		emit_unary(g->as, I_PUSH, 8, pool(0));
+		g->pushed++;
+	}
+
+	for (int i = 0; i < min(count, REGISTER_ARGUMENTS); i++) {
+		emit_unary(g->as, I_POP, 8, reg(arguments[i]));
+		g->pushed--;
+	}
+
+	// %al is the number of vector registers used, in case it is variadic
+	if (decl->body == NULL) emit_binary(g->as, I_XOR, 4, reg(RAX), reg(RAX));
+	emit_call(g->as, decl);
+
+	if (on_stack + pad) {
+		emit_binary(g->as, I_ADD, 8, imm(8 * (on_stack + pad)), reg(RSP));
+		g->pushed -= on_stack + pad;
+	}
+
+	// the callee need not extend a narrow result
+	unsigned type = decl->type.id;
+
+	if (type == VOID)               emit_binary(g->as, I_XOR, 4, pool(t), pool(t));
+	else if (wide(g, type))         emit_binary(g->as, I_MOV, 8, reg(RAX), pool(t));
+	else if (size_of(g, type) == 1) emit_binary(g->as, I_MOVZB, 4, reg(RAX), pool(t));
+	else if (size_of(g, type) == 2) emit_binary(g->as, I_MOVZW, 4, reg(RAX), pool(t));
+	else                            emit_binary(g->as, I_MOV, 4, reg(RAX), pool(t));
+
+	for (int i = t - 1; i >= 0; i--) restore(g, vectors >> i & 1, i);
+	g->vectors = vectors;
+}
+
+// p + i, i + p, p - i: the integer is extended and scaled by the size
+// of an element, which only aggregates have other than a power of two
+static
+void scale(struct Codegen *g, unsigned type, int size, int r) {
+	if (type == INT) emit_binary(g->as, I_MOVSLQ, 8, pool(r), pool(r));
+
+	if (size & (size - 1)) emit_binary(g->as, I_IMUL, 8, imm(size), pool(r));
+	else if (size != 1)    emit_binary(g->as, I_SHL, 8, imm(log2_of(size)), pool(r));
+}
+
+// the inverse of an odd number modulo 2^32, by newton's iteration: each
+// step doubles the number of correct low bits, d is its own inverse to 3
+static
+uint32_t inverse(uint32_t d) {
+	uint32_t x = d;
+	for (int i = 0; i < 4; i++) x *= 2 - d * x;
+	return x;
+}
+
+// a lane of a vector in memory, the index is taken modulo the lanes
+static
+void gen_lane_address(struct Codegen *g, struct AST_ExprBinaryOp *op, int t) {
+	unsigned type = expression_type(op->lhs).id;
+	int left, right;
+
+	gen_operands(g, op->lhs, true, op->rhs, t, &left, &right);
+	emit_binary(g->as, I_AND, 4, imm(lanes(g->types, type) - 1), pool(right));
+
+	int size = size_of(g, lane_type(g->types, type));
+	emit_binary(g->as, I_LEA, 8, indexed(registers[left], registers[right], size), pool(t));
+}
+
+// a lane of a temporary vector goes through the stack
+static
+void gen_lane(struct Codegen *g, struct AST_ExprBinaryOp *op, int t) {
+	unsigned type = expression_type(op->lhs).id;
+	int left, right;
+
+	gen_operands(g, op->lhs, false, op->rhs, t, &left, &right);
+	emit_binary(g->as, I_AND, 4, imm(lanes(g->types, type) - 1), pool(right));
+
+	int size = size_of(g, lane_type(g->types, type));
+	save(g, true, left);
+	load(g, indexed(RSP, registers[right], size), op->type.id, t);
+
+	emit_binary(g->as, I_ADD, 8, imm(16), reg(RSP));
+	g->pushed -= 2;
+}
+
+// p[i], and a[i] of an array in memory
+static
+void gen_index(struct Codegen *g, struct AST_ExprBinaryOp *op, int t) {
+	unsigned type = expression_type(op->lhs).id;
+
+	if (is_vector(g->types, type)) {
+		gen_lane_address(g, op, t);
+		return;
+	}
+
+	bool array = is_array(g->types, type);
+	int left, right;
+	gen_operands(g, op->lhs, array, op->rhs, t, &left, &right);
+
+	scale(g, expression_type(op->rhs).id, array ? type_size(g->types, pointee(g->types, type)) : element_size(g, type), right);
+	emit_binary(g->as, I_ADD, 8, pool(right), pool(left));
+	if (left != t) emit_binary(g->as, I_MOV, 8, pool(left), pool(t));
+}
+
+// s.f, and a[i].f of a soa array a
+static
+void gen_member(struct Codegen *g, struct AST_ExprBinaryOp *op, int t) {
+	struct Field *field = member(g, op);
+
+	if (!soa_element(g, op->lhs)) {
+		gen_address(g, op->lhs, t);
+		if (field->offset) emit_binary(g->as, I_ADD, 8, imm(field->offset), pool(t));
+		return;
+	}
+
+	struct AST_ExprBinaryOp *element = &op->lhs->binary_op;
+	int length = get_type(g->types, expression_type(element->lhs).id)->length;
+	int left, right;
+
+	gen_operands(g, element->lhs, true, element->rhs, t, &left, &right);
+	scale(g, expression_type(element->rhs).id, type_size(g->types, field->type), right);
+	emit_binary(g->as, I_ADD, 8, pool(right), pool(left));
+
+	if (field->offset) emit_binary(g->as, I_ADD, 8, imm(length * field->offset), pool(left));
+	if (left != t) emit_binary(g->as, I_MOV, 8, pool(left), pool(t));
+}
+
+// pushes nothing: a static place is its own, anything else is an address
+// computed into register t
+static
+struct Operand gen_place(struct Codegen *g, struct AST_Expression *expr, int t) {
+	struct Operand place;
+	if (static_place(g, expr, &place)) return place;
+
+	gen_address(g, expr, t);
+	return register_place(t);
+}
+
+static
+void gen_address(struct Codegen *g, struct AST_Expression *expr, int t) {
+	struct Operand place;
+
+	if (static_place(g, expr, &place)) {
+		emit_binary(g->as, I_LEA, 8, place, pool(t));
+		return;
+	}
+
+	switch (expr->type) {
+		// <<p
+		case UNARY_OP:
+			gen(g, expr->unary_op.rhs, t);
+			break;
+
+		// s.f, p[i]
+		case BINARY_OP:
+			if (is_operator(expr->binary_op.token, '.')) gen_member(g, &expr->binary_op, t);
+			else                                        gen_index(g, &expr->binary_op, t);
+			break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+static NOINLINE
+void gen_unary(struct Codegen *g, struct AST_ExprUnaryOp *op, int t) {
+	unsigned rhs = expression_type(op->rhs).id;
+
+	if (op->token->type == KEYWORD_SIZEOF) {
+		emit_binary(g->as, I_MOV, 4, imm(type_size(g->types, rhs)), pool(t));
+		return;
+	}
+
+	switch (op->token->value) {
+		case '+':
+			gen(g, op->rhs, t);
+			break;
+
+		// vectors: 0 - v, and v ^ all ones
+		case '-':
+			gen(g, op->rhs, t);
+
+			if (is_vector(g->types, rhs)) {
+				bool bytes = lane_type(g->types, rhs) == U8;
+
+				emit_vector(g->as, I_PXOR, xmm(TEMPORARY), xmm(TEMPORARY));
+				emit_vector(g->as, bytes ? I_PSUBB : I_PSUBD, vector_pool(t), xmm(TEMPORARY));
+				emit_vector(g->as, I_MOVDQA, xmm(TEMPORARY), vector_pool(t));
+			} else {
+				emit_unary(g->as, I_NEG, 4, pool(t));
+			}
+
+			break;
+
+		case '~':
+			gen(g, op->rhs, t);
+
+			if (is_vector(g->types, rhs)) {
+				emit_vector(g->as, I_PCMPEQD, xmm(TEMPORARY), xmm(TEMPORARY));
+				emit_vector(g->as, I_PXOR, xmm(TEMPORARY), vector_pool(t));
+			} else {
+				emit_unary(g->as, I_NOT, 4, pool(t));
+			}
+
+			break;
+
+		case '!':
+			gen(g, op->rhs, t);
+			test(g, rhs, t);
+			set(g, CC_E, t);
+			break;
+
+		case INC: case DEC:
+		case POST_INC: case POST_DEC: {
+			int step = wide(g, rhs) ? element_size(g, rhs) : 1;
+			if (op->token->value == DEC || op->token->value == POST_DEC) step = -step;
+
+			struct Operand place = gen_place(g, op->rhs, t);
+			int size = size_of(g, rhs);
+
+			if (op->token->value == INC || op->token->value == DEC) {
+				emit_binary(g->as, I_ADD, size, imm(step), place);
+				load(g, place, rhs, t);
+			} else {
+				load(g, place, rhs, SCRATCH);
+				emit_binary(g->as, I_ADD, size, imm(step), place);
+				move_result(g, rhs, SCRATCH, t);
+			}
+
+			break;
+		}
+
+		// address of
+		case '*':
+			gen_address(g, op->rhs, t);
+			break;
+
+		// dereference
+		case SHL:
+			gen(g, op->rhs, t);
+			load(g, register_place(t), op->type.id, t);
+			break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+static NOINLINE
+void gen_logical(struct Codegen *g, struct AST_ExprBinaryOp *op, int t) {
+	bool and = is_operator(op->token, AND);
+	int decided = new_label(g->as), end = new_label(g->as);
+
+	gen(g, op->lhs, t);
+	test(g, expression_type(op->lhs).id, t);
+	emit_jump(g->as, and ? CC_E : CC_NE, decided);
+
+	gen(g, op->rhs, t);
+	test(g, expression_type(op->rhs).id, t);
+	emit_jump(g->as, and ? CC_E : CC_NE, decided);
+
+	emit_binary(g->as, I_MOV, 4, imm(and ? 1 : 0), pool(t));
+	emit_jump(g->as, CC_ALWAYS, end);
+
+	place_label(g->as, decided);
+	emit_binary(g->as, I_MOV, 4, imm(and ? 0 : 1), pool(t));
+	place_label(g->as, end);
+}
+
+// vectors
+
+// every bit of the lanes of register r flipped
+static
+void invert(struct Codegen *g, int r) {
+	emit_vector(g->as, I_PCMPEQD, xmm(TEMPORARY), xmm(TEMPORARY));
+	emit_vector(g->as, I_PXOR, xmm(TEMPORARY), vector_pool(r));
+}
+
+// a = a > b, lane by lane. the compares are signed, flipping the top bits
+// of unsigned lanes keeps their order
+static
+void greater(struct Codegen *g, bool bytes, int a, int b) {
+	splat(g, bytes ? 0x80808080 : 0x80000000, TEMPORARY);
+	emit_vector(g->as, I_PXOR, xmm(TEMPORARY), vector_pool(a));
+	emit_vector(g->as, I_PXOR, xmm(TEMPORARY), vector_pool(b));
+	emit_vector(g->as, bytes ? I_PCMPGTB : I_PCMPGTD, vector_pool(b), vector_pool(a));
+}
+
+// a = a * b for 32-bit lanes: sse2 multiplies the even lanes and the odd
+// lanes separately into 64 bits, the low halves are put back together
+static
+void multiply(struct Codegen *g, int a, int b) {
+	struct Operand even = vector_pool(a), odd = xmm(TEMPORARY);
+
+	emit_vector(g->as, I_MOVDQA, even, odd);
+	emit_vector(g->as, I_PMULUDQ, vector_pool(b), even);
+	emit_vector(g->as, I_PSRLQ, imm(32), odd);
+	emit_vector(g->as, I_PSRLQ, imm(32), vector_pool(b));
+	emit_vector(g->as, I_PMULUDQ, vector_pool(b), odd);
+
+	emit_shuffle(g->as, 0x08, even, even);
+	emit_shuffle(g->as, 0x08, odd, odd);
+	emit_vector(g->as, I_PUNPCKLDQ, odd, even);
+}
+
+static NOINLINE
+void gen_vector_binary(struct Codegen *g, struct AST_ExprBinaryOp *op, int t) {
+	unsigned type = expression_type(op->lhs).id;
+	bool bytes = lane_type(g->types, type) == U8;
+	bool shl = op->token->value == SHL;
+
+	// shifts by a literal count
+	if (immediate(g, op)) {
+		gen(g, op->lhs, t);
+		emit_vector(g->as, shl ? I_PSLLD : I_PSRLD, imm(op->rhs->literal.value & 31), vector_pool(t));
+		return;
+	}
+
+	int left, right;
+	gen_operands(g, op->lhs, false, op->rhs, t, &left, &right);
+
+	struct Operand a = vector_pool(left), b = vector_pool(right);
+	int result = left;
+
+	switch (op->token->value) {
+		case '+': emit_vector(g->as, bytes ? I_PADDB : I_PADDD, b, a); break;
+		case '-': emit_vector(g->as, bytes ? I_PSUBB : I_PSUBD, b, a); break;
+		case '&': emit_vector(g->as, I_PAND, b, a); break;
+		case '|': emit_vector(g->as, I_POR, b, a);  break;
+		case '^': emit_vector(g->as, I_PXOR, b, a); break;
+		case '*': multiply(g, left, right);         break;
+
+		// the count is a scalar, its %xmm register is free
+		case SHL: case SHR:
+			emit_binary(g->as, I_AND, 4, imm(31), pool(right));
+			emit_vector(g->as, I_MOVD, pool(right), b);
+			emit_vector(g->as, shl ? I_PSLLD : I_PSRLD, b, a);
+			break;
+
+		case EQ: case NEQ:
+			emit_vector(g->as, bytes ? I_PCMPEQB : I_PCMPEQD, b, a);
+			if (op->token->value == NEQ) invert(g, left);
+			break;
+
+		// a <= b is !(a > b), a < b is b > a
+		case '>': case LEQ:
+			greater(g, bytes, left, right);
+			if (op->token->value == LEQ) invert(g, left);
+			break;
+
+		case '<': case GEQ:
+			greater(g, bytes, right, left);
+			if (op->token->value == GEQ) invert(g, right);
+			result = right;
+			break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+
+	move_result(g, type, result, t);
+}
+
+// the operand is zero-extended from its width, the bits of its type. on a
+// zero bsr and bsf leave their destination as it was: a cmov picks the
+// result then, or ctz sets the bit above the width first
+static
+void gen_bits(struct Codegen *g, enum Builtin builtin, struct AST_Expression **args, int t) {
+	int bits = 8 * size_of(g, expression_type(args[0]).id);
+	struct Operand x = pool(t), y = reg(RAX);
+
+	if (builtin != BUILTIN_ROTATE) gen(g, args[0], t);
+
+	switch (builtin) {
+		case BUILTIN_CLZ:
+			if (g->features & FEATURE_LZCNT) {
+				emit_binary(g->as, I_LZCNT, 4, x, x);
+				if (bits < 32) emit_binary(g->as, I_SUB, 4, imm(32 - bits), x);
+				break;
+			}
+
+			// bits - 1 less the index of the top bit, which is -1 for zero
+			emit_binary(g->as, I_MOV, 4, imm(-1), y);
+			emit_binary(g->as, I_BSR, 4, x, x);
+			emit_move_if(g->as, CC_E, 4, y, x);
+			emit_unary(g->as, I_NEG, 4, x);
+			emit_binary(g->as, I_ADD, 4, imm(bits - 1), x);
+			break;
+
+		case BUILTIN_CTZ:
+			if (bits < 32) emit_binary(g->as, I_OR, 4, imm(1 << bits), x);
+
+			if (g->features & FEATURE_BMI) {
+				emit_binary(g->as, I_TZCNT, 4, x, x);
+			} else if (bits < 32) {
+				emit_binary(g->as, I_BSF, 4, x, x);
+			} else {
+				emit_binary(g->as, I_MOV, 4, imm(32), y);
+				emit_binary(g->as, I_BSF, 4, x, x);
+				emit_move_if(g->as, CC_E, 4, y, x);
+			}
+
+			break;
+
+		// bits set in pairs, nibbles, then bytes summed into the top byte
+		case BUILTIN_POPCOUNT:
+			if (g->features & FEATURE_POPCNT) {
+				emit_binary(g->as, I_POPCNT, 4, x, x);
+				break;
+			}
+
+			emit_binary(g->as, I_MOV, 4, x, y);
+			emit_binary(g->as, I_SHR, 4, imm(1), y);
+			emit_binary(g->as, I_AND, 4, imm(0x55555555), y);
+			emit_binary(g->as, I_SUB, 4, y, x);
+
+			emit_binary(g->as, I_MOV, 4, x, y);
+			emit_binary(g->as, I_SHR, 4, imm(2), y);
+			emit_binary(g->as, I_AND, 4, imm(0x33333333), y);
+			emit_binary(g->as, I_AND, 4, imm(0x33333333), x);
+			emit_binary(g->as, I_ADD, 4, y, x);
+
+			emit_binary(g->as, I_MOV, 4, x, y);
+			emit_binary(g->as, I_SHR, 4, imm(4), y);
+			emit_binary(g->as, I_ADD, 4, y, x);
+			emit_binary(g->as, I_AND, 4, imm(0x0f0f0f0f), x);
+
+			emit_binary(g->as, I_IMUL, 4, imm(0x01010101), x);
+			emit_binary(g->as, I_SHR, 4, imm(24), x);
+			break;
+
+		case BUILTIN_BSWAP:
+			if (bits == 8) break;
+
+			emit_unary(g->as, I_BSWAP, 4, x);
+			if (bits == 16) emit_binary(g->as, I_SHR, 4, imm(16), x);
+			break;
+
+		// rol of a byte or a word takes its count modulo the width
+		case BUILTIN_ROTATE: {
+			if (args[1]->type == LITERAL) {
+				gen(g, args[0], t);
+				emit_binary(g->as, I_ROL, bits / 8, imm(args[1]->literal.value & (bits - 1)), x);
+				break;
+			}
+
+			int left, right;
+			gen_operands(g, args[0], false, args[1], t, &left, &right);
+
+			emit_binary(g->as, I_MOV, 4, pool(right), reg(RCX));
+			emit_binary(g->as, I_ROL, bits / 8, reg(RCX), pool(left));
+			move_result(g, U32, left, t);
+			break;
+		}
+
+		case BUILTIN_PREFETCH:
+			emit_unary(g->as, I_PREFETCHT0, 8, register_place(t));
+			break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+// shuffle on baseline x86-64, which has no variable shuffle: both vectors
+// go to the stack, the indices above the vector, and each index is
+// replaced by the lane it picks
+static
+void gen_shuffle_lanes(struct Codegen *g, unsigned type, int left, int right, int t) {
+	int count = lanes(g->types, type), size = size_of(g, lane_type(g->types, type));
+	enum Register index = RAX, value = RCX;
+
+	save(g, true, right);
+	save(g, true, left);
+
+	for (int i = 0; i < count; i++) {
+		struct Operand lane = mem(RSP, 16 + i * size);
+
+		emit_binary(g->as, size == 1 ? I_MOVZB : I_MOV, 4, lane, reg(index));
+		emit_binary(g->as, I_AND, 4, imm(count - 1), reg(index));
+		emit_binary(g->as, size == 1 ? I_MOVZB : I_MOV, 4, indexed(RSP, index, size), reg(value));
+		emit_binary(g->as, I_MOV, size, reg(value), lane);
+	}
+
+	emit_vector(g->as, I_MOVDQU, mem(RSP, 16), vector_pool(t));
+	emit_binary(g->as, I_ADD, 8, imm(32), reg(RSP));
+	g->pushed -= 4;
+}
+
+static
+void gen_builtin(struct Codegen *g, struct AST_ExprFuncCall *call, int t) {
+	struct AST_Expression *args[MAX_PARAMS];
+	call_arguments(call->args, args);
+
+	unsigned type = expression_type(args[0]).id;
+	bool bytes = lane_type(g->types, type) == U8;
+
+	switch (call->builtin) {
+		case BUILTIN_MOVEMASK:
+			gen(g, args[0], t);
+			emit_vector(g->as, bytes ? I_PMOVMSKB : I_MOVMSKPS, vector_pool(t), pool(t));
+			break;
+
+		// pshufb picks bytes, a 32-bit lane index 4 * i + 0..3 of them
+		case BUILTIN_SHUFFLE: {
+			int left, right;
+			gen_operands(g, args[0], false, args[1], t, &left, &right);
+
+			if (!(g->features & FEATURE_SSSE3)) {
+				gen_shuffle_lanes(g, type, left, right, t);
+				break;
+			}
+
+			struct Operand indices = vector_pool(right), spread = xmm(TEMPORARY + 1);
+			splat(g, bytes ? 0x0f0f0f0f : 0x00000003, TEMPORARY);
+			emit_vector(g->as, I_PAND, xmm(TEMPORARY), indices);
+
+			if (!bytes) {
+				emit_vector(g->as, I_PSLLD, imm(2), indices);
+
+				for (int shift = 8; shift <= 16; shift *= 2) {
+					emit_vector(g->as, I_MOVDQA, indices, spread);
+					emit_vector(g->as, I_PSLLD, imm(shift), spread);
+					emit_vector(g->as, I_POR, spread, indices);
+				}
+
+				splat(g, 0x03020100, TEMPORARY);
+				emit_vector(g->as, I_PADDB, xmm(TEMPORARY), indices);
+			}
+
+			emit_vector(g->as, I_PSHUFB, indices, vector_pool(left));
+			move_result(g, type, left, t);
+			break;
+		}
+
+		case BUILTIN_CLZ: case BUILTIN_CTZ: case BUILTIN_POPCOUNT:
+		case BUILTIN_BSWAP: case BUILTIN_ROTATE: case BUILTIN_PREFETCH:
+			gen_bits(g, call->builtin, args, t);
+			break;
+
+		case BUILTIN_NONE:
+			assert(0 && "unreachable");
+	}
+}
+
+
+static
+bool is_signed(struct Codegen *g, unsigned lhs, unsigned rhs) {
+	if (wide(g, lhs) || wide(g, rhs)) return false;
+	return max(max(lhs, rhs), U32) == INT;
+}
+
+static
+void gen_arithmetic(struct Codegen *, struct AST_ExprBinaryOp *, int left, int right, int t);
+
+static NOINLINE
+void gen_binary(struct Codegen *g, struct AST_Expression *expr, int t) {
+	struct AST_ExprBinaryOp *op = &expr->binary_op;
+	unsigned type = op->type.id;
+	unsigned lhs = expression_type(op->lhs).id;
+	unsigned rhs = expression_type(op->rhs).id;
+
+	if (op->token->type == KEYWORD_ELSE) {
+		int end = new_label(g->as);
+
+		gen(g, op->lhs, t);
+		test(g, lhs, t);
+		emit_jump(g->as, CC_NE, end);
+
+		gen(g, op->rhs, t);
+		convert(g, rhs, type, t);
+		place_label(g->as, end);
+		return;
+	}
+
+	switch (op->token->value) {
+		case ',':
+			gen(g, op->lhs, t);
+			gen(g, op->rhs, t);
+			return;
+
+		case '=': {
+			struct Operand place;
+
+			if (static_place(g, op->lhs, &place)) {
+				gen(g, op->rhs, t);
+				convert(g, rhs, lhs, t);
+				store(g, place, lhs, t);
+				return;
+			}
+
+			int address, right;
+			gen_operands(g, op->lhs, true, op->rhs, t, &address, &right);
+
+			convert(g, rhs, lhs, right);
+			store(g, register_place(address), lhs, right);
+			move_result(g, lhs, right, t);
+			return;
+		}
+
+		case AND: case OR:
+			gen_logical(g, op, t);
+			return;
+
+		case '[':
+			if (is_vector(g->types, lhs) && expression_type(op->lhs).temporary) {
+				gen_lane(g, op, t);
+				return;
+			}
+
+			// fallthrough
+		case '.':
+			load(g, gen_place(g, expr, t), type, t);
+			return;
+	}
+
+	if (is_vector(g->types, lhs)) {
+		gen_vector_binary(g, op, t);
+		return;
+	}
+
+	int left, right = -1;
+
+	if (immediate(g, op)) {
+		gen(g, op->lhs, t);
+		left = t;
+	} else {
+		gen_operands(g, op->lhs, false, op->rhs, t, &left, &right);
+	}
+
+	gen_arithmetic(g, op, left, right, t);
+}
+
+// the operands are in left and right, or right is -1 and the rhs is an
+// immediate. out of line, like gen_call, to keep the frames of the
+// recursion small: every operand passed by value takes a slot of its own
+static NOINLINE
+void gen_arithmetic(struct Codegen *g, struct AST_ExprBinaryOp *op, int left, int right, int t) {
+	unsigned type = op->type.id;
+	unsigned lhs = expression_type(op->lhs).id;
+	unsigned rhs = expression_type(op->rhs).id;
+	struct Operand operand = right < 0 ? imm(op->rhs->literal.value) : pool(right);
+
+	bool sign = is_signed(g, lhs, rhs);
+	int size = (wide(g, lhs) || wide(g, rhs)) ? 8 : 4;
+
+	// pointer arithmetic
+	if ((op->token->value == '+' || op->token->value == '-') && size == 8) {
+		if (wide(g, lhs) && wide(g, rhs)) {
+			emit_binary(g->as, I_SUB, 8, pool(right), pool(left));
+
+			// the difference is a multiple of the size, exact division by
+			// its odd part is multiplication by the inverse
+			int element = element_size(g, lhs), shift = __builtin_ctz(element);
+			if (shift) emit_binary(g->as, I_SAR, 8, imm(shift), pool(left));
+			if (element >> shift != 1) emit_binary(g->as, I_IMUL, 4, imm((int32_t)inverse(element >> shift)), pool(left));
+
+			emit_binary(g->as, I_MOV, 4, pool(left), pool(t));
+			return;
+		}
+
+		if (wide(g, lhs)) scale(g, rhs, element_size(g, lhs), right);
+		else              scale(g, lhs, element_size(g, rhs), left);
+
+		emit_binary(g->as, op->token->value == '+' ? I_ADD : I_SUB, 8, pool(right), pool(left));
+		if (left != t) emit_binary(g->as, I_MOV, 8, pool(left), pool(t));
+		return;
+	}
+
+	enum ConditionCode condition = CC_ALWAYS;
+
+	switch (op->token->value) {
+		case '+': emit_binary(g->as, I_ADD, 4, operand, pool(left));  break;
+		case '-': emit_binary(g->as, I_SUB, 4, operand, pool(left));  break;
+		case '*': emit_binary(g->as, I_IMUL, 4, operand, pool(left)); break;
+		case '&': emit_binary(g->as, I_AND, 4, operand, pool(left));  break;
+		case '|': emit_binary(g->as, I_OR, 4, operand, pool(left));   break;
+		case '^': emit_binary(g->as, I_XOR, 4, operand, pool(left));  break;
+
+		case '/': case '%':
+			emit_binary(g->as, I_MOV, 4, pool(left), reg(RAX));
+			if (sign) emit_plain(g->as, I_CLTD);
+			else      emit_binary(g->as, I_XOR, 4, reg(RDX), reg(RDX));
+			emit_unary(g->as, sign ? I_IDIV : I_DIV, 4, pool(right));
+			emit_binary(g->as, I_MOV, 4, reg(op->token->value == '/' ? RAX : RDX), pool(t));
+			return;
+
+		// operands are extended to 64 bits, their product is exact there
+		case MUL_HIGH:
+			if (sign) {
+				emit_binary(g->as, I_MOVSLQ, 8, pool(left), pool(left));
+				emit_binary(g->as, I_MOVSLQ, 8, pool(right), pool(right));
+			}
+
+			emit_binary(g->as, I_IMUL, 8, pool(right), pool(left));
+			emit_binary(g->as, sign ? I_SAR : I_SHR, 8, imm(32), pool(left));
+			emit_binary(g->as, I_MOV, 4, pool(left), pool(t));
+			return;
+
+		// ud2 unless the index is below the length
+		case CHECK_INDEX: {
+			int in_bounds = new_label(g->as);
+
+			emit_binary(g->as, I_CMP, 4, operand, pool(left));
+			emit_jump(g->as, CC_B, in_bounds);
+			emit_plain(g->as, I_UD2);
+			place_label(g->as, in_bounds);
+			break;
+		}
+
+		// shifts take the signedness of the lhs alone
+		case SHL: case SHR: {
+			enum Mnemonic shift = op->token->value == SHL ? I_SHL : (lhs == INT) ? I_SAR : I_SHR;
+
+			if (right < 0) {
+				emit_binary(g->as, shift, 4, imm(op->rhs->literal.value & 31), pool(left));
+			} else {
+				emit_binary(g->as, I_MOV, 4, pool(right), reg(RCX));
+				emit_binary(g->as, shift, 4, reg(RCX), pool(left));
+			}
+
+			break;
+		}
+
+		case EQ:  condition = CC_E;  break;
+		case NEQ: condition = CC_NE; break;
+		case '<': condition = sign ? CC_L  : CC_B;  break;
+		case LEQ: condition = sign ? CC_LE : CC_BE; break;
+		case '>': condition = sign ? CC_G  : CC_A;  break;
+		case GEQ: condition = sign ? CC_GE : CC_AE; break;
+
+		default:
+			assert(0 && "unreachable");
+	}
+
+	// an int compared with a pointer is zero-extended already
+	if (condition != CC_ALWAYS) {
+		emit_binary(g->as, I_CMP, size, operand, pool(left));
+		set(g, condition, t);
+		return;
+	}
+
+	move_result(g, type, left, t);
+}
+
+static
+void gen(struct Codegen *g, struct AST_Expression *expr, int t) {
+	switch (expr->type) {
+		case LITERAL:
+			if (expr->literal.value == 0) emit_binary(g->as, I_XOR, 4, pool(t), pool(t));
+			else                          emit_binary(g->as, I_MOV, 4, imm(expr->literal.value), pool(t));
+			break;
+
+		case STRING:
+			emit_binary(g->as, I_LEA, 8, string_operand(g->as, expr->string.token), pool(t));
+			break;
+
+		case IDENTIFIER:
+			load(g, identifier_place(g, expr), expr->identifier.type.id, t);
+			break;
+
+		case UNARY_OP:
+			gen_unary(g, &expr->unary_op, t);
+			break;
+
+		case BINARY_OP:
+			gen_binary(g, expr, t);
+			break;
+
+		case TYPE_CAST:
+			gen(g, expr->type_cast.rhs, t);
+			convert(g, expression_type(expr->type_cast.rhs).id, expr->type_cast.type.id, t);
+			break;
+
+		case FUNC_CALL:
+			gen_call(g, &expr->func_call, t);
+			break;
+	}
+}
+
+
+// statements
+
+static
+void gen_statement(struct Codegen *, struct AST_Statement *);
+
+static
+void gen_body(struct Codegen *g, struct AST_Statement *body) {
+	int frame = g->frame;
+
+	for (struct AST_Statement *statement = body; statement; statement = statement->next) {
+		gen_statement(g, statement);
+	}
+
+	// locals of the block are dead, their bytes are reused
+	g->frame = frame;
+}
+
+static
+void gen_condition(struct Codegen *g, struct AST_Expression *condition, enum ConditionCode jump, int label) {
+	gen(g, condition, 0);
+	test(g, expression_type(condition).id, 0);
+	emit_jump(g->as, jump, label);
+}
+
+// %edi = value - low, compared with the size of the range unless it is known
+static
+void gen_range(struct Codegen *g, struct SwitchNode *n, int outside) {
+	emit_binary(g->as, I_MOV, 4, pool(0), pool(1));
+	if (n->low) emit_binary(g->as, I_SUB, 4, imm((int32_t)n->low), pool(1));
+
+	if (outside >= 0) {
+		emit_binary(g->as, I_CMP, 4, imm((int32_t)(n->high - n->low)), pool(1));
+		emit_jump(g->as, CC_A, outside);
+	}
+}
+
+// the value is in %esi, %edi and %rax are free
+static
+void gen_cases(struct Codegen *g, struct SwitchPlan *plan, int node, int otherwise) {
+	for (; node >= 0; node = switch_node(plan, node)->next) {
+		struct SwitchNode *n = switch_node(plan, node);
+		int label = n->label < 0 ? otherwise : g->labels[n->label];
+
+		if (n->always && (n->test == SWITCH_EQUAL || n->test == SWITCH_RANGE)) {
+			emit_jump(g->as, CC_ALWAYS, label);
+			return;
+		}
+
+		switch (n->test) {
+			case SWITCH_EQUAL:
+				emit_binary(g->as, I_CMP, 4, imm((int32_t)n->low), pool(0));
+				emit_jump(g->as, CC_E, label);
+				break;
+
+			case SWITCH_RANGE:
+				gen_range(g, n, -1);
+				emit_binary(g->as, I_CMP, 4, imm((int32_t)(n->high - n->low)), pool(1));
+				emit_jump(g->as, CC_BE, label);
+				break;
+
+			case SWITCH_BITS: {
+				int next = n->always ? -1 : new_label(g->as);
+				gen_range(g, n, next);
+
+				for (int i = 0; i < n->count; i++) {
+					struct SwitchMask *mask = (struct SwitchMask *)plan->masks.mem + n->first + i;
+
+					emit_binary(g->as, I_MOV, 4, imm((int32_t)mask->bits), reg(RAX));
+					emit_binary(g->as, I_BT, 4, pool(1), reg(RAX));
+					emit_jump(g->as, CC_B, mask->label < 0 ? otherwise : g->labels[mask->label]);
+				}
+
+				emit_jump(g->as, CC_ALWAYS, otherwise);
+				if (next < 0) return;
+
+				place_label(g->as, next);
+				break;
+			}
+
+			// the table holds offsets from itself
+			case SWITCH_TABLE: {
+				int next = n->always ? -1 : new_label(g->as), table = new_label(g->as);
+				int *entries = (int *)plan->entries.mem + n->first;
+				int *targets = malloc(n->count * sizeof *targets);
+				if (!targets) errx("out of memory: failed to allocate a table of %d cases", n->count);
+
+				for (int i = 0; i < n->count; i++) targets[i] = entries[i] < 0 ? otherwise : g->labels[entries[i]];
+
+				gen_range(g, n, next);
+				emit_binary(g->as, I_LEA, 8, label_operand(table), reg(RAX));
+				emit_binary(g->as, I_MOVSLQ, 8, indexed(RAX, registers[1], 4), pool(1));
+				emit_binary(g->as, I_ADD, 8, reg(RAX), pool(1));
+				emit_jump_register(g->as, registers[1]);
+				emit_table(g->as, table, targets, n->count);
+				free(targets);
+
+				if (next < 0) return;
+
+				place_label(g->as, next);
+				break;
+			}
+
+			case SWITCH_SPLIT: {
+				int less = new_label(g->as);
+
+				emit_binary(g->as, I_CMP, 4, imm((int32_t)n->low), pool(0));
+				emit_jump(g->as, plan->sign ? CC_L : CC_B, less);
+
+				gen_cases(g, plan, n->more, otherwise);
+				place_label(g->as, less);
+				gen_cases(g, plan, n->less, otherwise);
+				return;
+			}
+		}
+	}
+
+	emit_jump(g->as, CC_ALWAYS, otherwise);
+}
+
+static
+void gen_switch(struct Codegen *g, struct AST_StmtSwitch *s) {
+	int *labels = g->labels, loop_end = g->loop_end;
+	int end = new_label(g->as);
+
+	g->labels = malloc(max(s->label_count, 1) * sizeof *g->labels);
+	if (!g->labels) errx("out of memory: failed to allocate %d labels", s->label_count);
+
+	for (int i = 0; i < s->label_count; i++) g->labels[i] = new_label(g->as);
+
+	struct SwitchPlan plan;
+	plan_switch(&plan, s, true);
+
+	gen(g, s->condition, 0);
+	gen_cases(g, &plan, plan.root, s->otherwise >= 0 ? g->labels[s->otherwise] : end);
+	free_switch_plan(&plan);
+
+	g->loop_end = end;
+	gen_body(g, s->body);
+	place_label(g->as, end);
+
+	free(g->labels);
+	g->labels = labels;
+	g->loop_end = loop_end;
+}
+
+static
+void gen_statement(struct Codegen *g, struct AST_Statement *statement) {
+	switch (statement->type) {
+		case STMT_EXPRESSION:
+			gen(g, statement->expression, 0);
+			break;
+
+		case STMT_DECLARATION: {
+			struct AST_Declaration *decl = statement->declaration;
+			int size = type_size(g->types, decl->type.id), align = type_align(g->types, decl->type.id);
+
+			g->frame = (g->frame + size + align - 1) / align * align;
+			g->frame_size = max(g->frame_size, g->frame);
+
+			struct Operand place = mem(RBP, -g->frame);
+
+			// aggregates are cleared a byte at a time
+			if (is_aggregate(g->types, decl->type.id)) {
+				emit_binary(g->as, I_LEA, 8, place, reg(RDI));
+				emit_binary(g->as, I_MOV, 4, imm(size), reg(RCX));
+				emit_binary(g->as, I_XOR, 4, reg(RAX), reg(RAX));
+				emit_plain(g->as, I_REP_STOSB);
+			} else if (decl->value) {
+				gen(g, decl->value, 0);
+				convert(g, expression_type(decl->value).id, decl->type.id, 0);
+				store(g, place, decl->type.id, 0);
+			} else if (is_vector(g->types, decl->type.id)) {
+				emit_vector(g->as, I_PXOR, vector_pool(0), vector_pool(0));
+				store(g, place, decl->type.id, 0);
+			} else {
+				emit_binary(g->as, I_MOV, size, imm(0), place);
+			}
+
+			insert(&g->locals, decl, -g->frame);
+			break;
+		}
+
+		case STMT_BLOCK:
+			gen_body(g, statement->block.body);
+			break;
+
+		case STMT_IF: {
+			struct AST_StmtIf *conditional = &statement->conditional;
+			int otherwise = new_label(g->as), end = new_label(g->as);
+
+			gen_condition(g, conditional->condition, CC_E, otherwise);
+			gen_body(g, conditional->then);
+
+			if (conditional->otherwise) emit_jump(g->as, CC_ALWAYS, end);
+			place_label(g->as, otherwise);
+
+			if (conditional->otherwise) {
+				gen_body(g, conditional->otherwise);
+				place_label(g->as, end);
+			}
+
+			break;
+		}
+
+		// the condition goes after the body, one jump per iteration
+		case STMT_WHILE:
+		case STMT_DO: {
+			int body = new_label(g->as), condition = new_label(g->as), end = new_label(g->as);
+			int loop_end = g->loop_end;
+
+			if (statement->type == STMT_WHILE) emit_jump(g->as, CC_ALWAYS, condition);
+			place_label(g->as, body);
+
+			g->loop_end = end;
+			gen_body(g, statement->loop.body);
+			g->loop_end = loop_end;
+
+			place_label(g->as, condition);
+			gen_condition(g, statement->loop.condition, CC_NE, body);
+			place_label(g->as, end);
+			break;
+		}
+
+		case STMT_RETURN: {
+			struct AST_Expression *result = statement->expression;
+			unsigned type = g->function->type.id;
+
+			if (result) {
+				gen(g, result, 0);
+				convert(g, expression_type(result).id, type, 0);
+				emit_binary(g->as, I_MOV, width(g, type), pool(0), reg(RAX));
+			} else {
+				emit_binary(g->as, I_XOR, 4, reg(RAX), reg(RAX));
+			}
+
+			emit_jump(g->as, CC_ALWAYS, g->ret);
+			break;
+		}
+
+		case STMT_BREAK:
+			emit_jump(g->as, CC_ALWAYS, g->loop_end);
+			break;
+
+		case STMT_SWITCH:
+			gen_switch(g, &statement->selection);
+			break;
+
+		case STMT_CASE:
+			place_label(g->as, g->labels[statement->label]);
+			break;
+	}
+}
+
+static
+void gen_function(struct Codegen *g, struct AST_Declaration *decl) {
+	check_signature(g, decl);
+
+	g->function = decl;
+	g->frame = g->frame_size = 0;
+	g->pushed = 0;
+	g->ret = new_label(g->as);
+	clear_table(&g->locals);
+	clear_table(&g->needs);
+
+	begin_function(g->as, decl);
+	emit_unary(g->as, I_PUSH, 8, reg(RBP));
+	emit_binary(g->as, I_MOV, 8, reg(RSP), reg(RBP));
+	int frame = reserve_frame(g->as);
+
+	// register parameters are stored in the frame, the rest are above it
+	for (int i = 0; i < decl->param_count; i++) {
+		if (i < REGISTER_ARGUMENTS) {
+			g->frame += 8;
+			emit_binary(g->as, I_MOV, 8, reg(arguments[i]), mem(RBP, -g->frame));
+			insert(&g->locals, decl->params[i], -g->frame);
+		} else {
+			insert(&g->locals, decl->params[i], 16 + 8 * (i - REGISTER_ARGUMENTS));
+		}
+	}
+
+	g->frame_size = g->frame;
+	gen_body(g, decl->body);
+
+	// falling off the end returns 0
+	emit_binary(g->as, I_XOR, 4, reg(RAX), reg(RAX));
+	place_label(g->as, g->ret);
+	emit_plain(g->as, I_LEAVE);
+	emit_plain(g->as, I_RET);
+
+	end_function(g->as, decl);
+	set_frame(g->as, frame, (g->frame_size + 15) & ~15);
+}
+
+static
+void write_global(struct Assembler *, struct TypeTable *, struct AST_Declaration *);
+
+static
+void generate(struct Assembler *as, struct TypeTable *types, struct AST_Declaration **declarations, int count,
+              unsigned features) {
+	struct Codegen g = {
+		.as = as,
+		.types = types,
+		.features = features,
+	};
+
+	for (int i = 0; i < count; i++) {
+		struct AST_Declaration *decl = declarations[i];
+
+		if (decl->function) {
+			if (decl->body) gen_function(&g, decl);
+		} else if (as->out) {
+			write_global(as, types, decl);
+		}
+	}
+
+	free(g.locals.entries);
+	free(g.needs.entries);
+}
+
+void generate_code(struct Assembler *as, struct TypeTable *types, struct AST_Declaration **declarations, int count,
+                   unsigned features) {
+	assert(as->out == NULL);
+	generate(as, types, declarations, count, features);
+}
+
+unsigned host_features(void) {
+	unsigned features = 0;
+
+#ifdef HAVE_CPUID
+	unsigned a, b, c, d;
+
+	if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_POPCNT))         features |= FEATURE_POPCNT;
+	if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSSE3))          features |= FEATURE_SSSE3;
+	if (__get_cpuid(0x80000001, &a, &b, &c, &d) && (c & bit_LZCNT)) features |= FEATURE_LZCNT;
+	if (__get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_BMI))   features |= FEATURE_BMI;
+#endif
+
+	return features;
+}
+
+
+// data
+
+int global_value(struct Assembler *as, struct TypeTable *types, struct AST_Declaration *decl, uint64_t *bits) {
+	unsigned type = decl->type.id;
+	int size = type_size(types, type);
+
+	*bits = 0;
+	if (decl->value == NULL) return -1;
+	if (decl->value->type == STRING) return string_operand(as, decl->value->string.token).string;
+
+	uint32_t constant;
+	if (!evaluate_constant(types, decl->value, NULL, &constant, NULL)) {
+		struct Token *token = decl->token;
+		errx("%s:%d:%d: initialiser of `%s` is not constant", token->filename, token->line, token->col, token->text);
+	}
+
+	*bits = constant;
+
+	if (is_pointer(types, type) && expression_type(decl->value).id == INT) *bits = (uint64_t)(int64_t)(int32_t)constant;
+	if (size < 8) *bits &= (UINT64_C(1) << (8 * size)) - 1;
+
+	return -1;
+}
+
+static
+void write_escaped(struct Writer *out, const char *text, int length) {
+	char buffer[4 * 64 + 4];
+	int used = 0;
+
+	for (int i = 0; i < length; i++) {
+		unsigned char c = text[i];
+
+		if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') {
+			used += snprintf(buffer + used, 5, "\\%03o", c);
+		} else {
+			buffer[used++] = c;
+		}
+
+		if (used > (int)sizeof buffer - 5) {
+			write_text(out, buffer, used);
+			used = 0;
+		}
+	}
+
+	write_text(out, buffer, used);
+}
+
+static
+void write_global(struct Assembler *as, struct TypeTable *types, struct AST_Declaration *decl) {
+	const char *name = decl->token->text;
+	unsigned type = decl->type.id;
+	int size = type_size(types, type);
+
+	static const char *const directives[] = { [1] = ".byte", [2] = ".short", [4] = ".long", [8] = ".quad" };
+
+	if (decl->value == NULL) {
+		write_format(as->out, "\n\t.bss\n\t.globl %s\n\t.align %d\n\t.type %s, @object\n\t.size %s, %d\n%s:\n\t.zero %d\n",
+		             name, type_align(types, type), name, name, size, name, size);
+		return;
+	}
+
+	if (size != 1 && size != 2 && size != 4 && size != 8) unsupported(types, type);
+
+	write_format(as->out, "\n\t.data\n\t.globl %s\n\t.align %d\n\t.type %s, @object\n\t.size %s, %d\n%s:\n",
+	             name, type_align(types, type), name, name, size, name);
+
+	uint64_t bits;
+	int string = global_value(as, types, decl, &bits);
+
+	if (string >= 0) write_format(as->out, "\t%s .LS%d\n", directives[size], string);
+	else             write_format(as->out, "\t%s %llu\n", directives[size], (unsigned long long)bits);
+}
+
+void emit_assembly(const char *path, const char *source, struct TypeTable *types,
+                   struct AST_Declaration **declarations, int count, unsigned features) {
+	struct Writer out;
+	open_writer(&out, path);
+
+	struct Assembler as;
+	init_assembler(&as, &out);
+
+	write_string(&out, "\t.file \"");
+	write_string(&out, source);
+	write_string(&out, "\"\n");
+	generate(&as, types, declarations, count, features);
+
+	// the literal pool is one blob, each literal a symbol at its offset
+	layout_literals(&as.strings);
+	write_string(&out, "\n\t.section .rodata\n.Lstrings:\n");
+
+	const char *blob = as.strings.blob.mem;
+
+	for (int at = 0; at < as.strings.blob.length;) {
+		int length = strlen(blob + at);
+
+		write_string(&out, "\t.string \"");
+		write_escaped(&out, blob + at, length);
+		write_string(&out, "\"\n");
+		at += length + 1;
+	}
+
+	for (int i = 0; i < as.strings.literals.length; i++) {
+		write_format(&out, "\t.set .LS%d, .Lstrings+%d\n", i, literal_offset(&as.strings, i));
+	}
+
+	write_string(&out, "\n\t.section .note.GNU-stack,\"\",@progbits\n");
+	close_writer(&out);
+	free_assembler(&as);
+}
@@ -0,0 +1,48 @@
+#ifndef X86_H_
+#define X86_H_
+
+#include "assembler.h"
+#include "ast.h"
+#include "types.h"
+
+#include <stdint.h>
+
+// x86-64 code generation:
+//
+// definitions are written as GNU assembly in AT&T syntax, for the System V
+// ABI. every expression is labelled with its Sethi–Ullman register need and
+// the operand that needs more registers is evaluated first, into a stack of
+// caller-saved registers; an operand is only pushed to the machine stack
+// once that stack is full. u8 and u16 are loaded zero-extended and computed
+// on as 32-bit values like u32 and int, loads, stores and conversions use
+// the width of the type. locals live in the frame, globals in .data or .bss
+// and strings in .rodata. functions that are only declared are called
+// through the PLT, so that the C library can be linked in. instructions go
+// through the assembler, which prints them or encodes them for the JIT.
+//
+
+// instructions beyond baseline x86-64 the code may use, by bit. without
+// them the bit builtins take a few instructions more, and shuffle goes
+// through the stack a lane at a time
+enum Feature {
+	FEATURE_POPCNT = 1 << 0,
+	FEATURE_LZCNT  = 1 << 1,
+	FEATURE_BMI    = 1 << 2, // tzcnt
+	FEATURE_SSSE3  = 1 << 3, // pshufb
+};
+
+// those of the machine the compiler runs on
+unsigned host_features(void);
+
+// global initialisers must be constant, errors are fatal. source names the
+// input in the .file directive
+void emit_assembly(const char *path, const char *source, struct TypeTable *, struct AST_Declaration **, int count, unsigned features);
+
+// machine code for every function definition, into an assembler without a writer
+void generate_code(struct Assembler *, struct TypeTable *, struct AST_Declaration **, int count, unsigned features);
+
+// the initial bits of a global, or the index of the string it points to,
+// added to the assembler's strings, -1 otherwise
+int global_value(struct Assembler *, struct TypeTable *, struct AST_Declaration *, uint64_t *bits);
+
+#endif //X86_H_
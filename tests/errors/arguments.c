@@ -0,0 +1,18 @@
+// errors: 7
+u32 f(u32 a, u32 b) { return a + b; }
+u32 g(u8 *p) { return <<p; }
+u32 h(void) { return 1; }
+u32 m1(void) { return f(1); }
+u32 m2(void) { return f(1, 2, 3); }
+u32 m3(void) { return g(5); }
+u32 m4(void) { return f(g("a"), f(h(), f(1, 2))); }
+u32 m5(void) { return h(1); }
+u32 m6(void) { return popcount(1, 2); }
+u32 m7(void) { return rotate(1, "x"); }
+u32 m8(void) { return f(h(), (1, 2)); }
+u32 m9(void) { u32 x = 0; return g(*x); }
+u32 m10(void) { return f(f(f(1, 2), 3), g(f(1))); }
+u32 m11(void) { return shuffle((u8x16)1, (u32x4)2); }
+u32 m12(void) { return movemask((u8x16)1) + bswap((u16)1) + f(1, (u8)2); }
+u32 m13(void) { u8x16 v = shuffle((u8x16)1, (u8x16)2); prefetch(*v); return movemask(v); }
+u32 m14(void) { return g(f(1, 2)); }
@@ -0,0 +1,11 @@
+// errors: 5
+u32 f(u32 x);
+u8 f(u32 x) { return 1; }
+u32 g(u32 a, u32 b);
+u32 g(u32 a) { return a; }
+u32 h(u32 a);
+u32 h(u8 a) { return a; }
+u32 k(u32 a);
+u32 k(u32 b) { return b; }
+u32 main(void) { u32 x = k; return x + k; }
+u32 m(void) { return sizeof k; }
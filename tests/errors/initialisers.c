@@ -0,0 +1,6 @@
+// errors: 2
+u32 h;
+u32 g = h;
+u32 d = 1 / (h - h);
+u32 k = 3 * 4 + 1;
+u32 main(void) { return k; }
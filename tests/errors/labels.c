@@ -0,0 +1,7 @@
+// errors: 3
+u32 duplicate(u32 r) { switch (r) { case 1: r = 1; break; case 2 - 1: r = 2; break; } return r; }
+u32 variable(u32 r) { switch (r) { case r: r = 1; break; } return r; }
+u32 pointer(u32 r) { switch (r) { case "one": r = 1; break; } return r; }
+u32 narrow(u8 c) { switch (c) { case 256: return 1; case 255: return 2; } return 0; }
+u32 one(void) { return 1; }
+u32 called(u32 r) { switch (r) { case one(): r = 1; break; case 2: r = 2; break; } return r; }
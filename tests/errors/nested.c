@@ -0,0 +1,6 @@
+// errors: 1
+u32 main(void) {
+	u32 r = 0;
+	while (r < 3) { r = x; r = r + 1; }
+	return r;
+}
@@ -0,0 +1,2 @@
+// errors: 1
+u32 main(void) { return x; }
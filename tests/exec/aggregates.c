@@ -0,0 +1,52 @@
+// exit: 133
+struct Point { u8 tag; u32 x; u16 y; };
+struct Node;
+struct Node { int value; struct Node *next; };
+union Bits { u32 word; u8 bytes[4]; };
+soa struct Particle { u8 alive; u32 x; u16 y; };
+
+struct Point g;
+struct Point gs[5];
+soa struct Particle;
+struct Particle ps[7];
+int grid[3][4];
+
+int sum(struct Node *n) {
+	int total = 0;
+	while (n) { total = total + (<<n).value; n = (<<n).next; }
+	return total;
+}
+
+int main() {
+	struct Point p;
+	p.x = 40;
+	p.y = 2;
+	p.tag = 1;
+	g.x = p.x + p.y;
+	gs[3].y = 7;
+	int i = 3;
+	gs[i].x = gs[3].y + 1;
+
+	struct Node a;
+	struct Node b;
+	a.value = 5; a.next = *b;
+	b.value = 6; b.next = 0;
+
+	union Bits u;
+	u.word = 0x04030201;
+
+	int j = 0;
+	while (j < 7) { ps[j].x = j * 10; ps[j].y = j; ps[j].alive = j & 1; j++; }
+	int k = 0;
+	int s = 0;
+	while (k < 7) { s = s + ps[k].x + ps[k].y + ps[k].alive; k++; }
+
+	int r = 0;
+	while (r < 3) { int c = 0; while (c < 4) { grid[r][c] = r * 4 + c; c++; } r++; }
+
+	struct Point *q = *gs[1];
+	q[1].x = 9;
+	u32 d = *gs[4] - q;
+
+	return g.x + gs[3].x + sum(*a) + u.bytes[2] + s + grid[2][3] + sizeof(ps) + sizeof(struct Point) + gs[2].x + d + ps[3].y + ps[5].alive;
+}
@@ -0,0 +1,75 @@
+// exit: 0
+u8 gb = 300;
+u16 gw = 70000;
+int gi = -5;
+u8 *msg = "hi\n";
+u32 counter;
+
+u32 many(u32 a, u32 b, u32 c, u32 d, u32 e, u32 f, u32 g, u8 h, int i) {
+	return a + 2*b + 3*c + 4*d + 5*e + 6*f + 7*g + 8*h + 9*i;
+}
+
+u32 strlen2(u8 *s) {
+	u32 n = 0;
+	while (<<s) { s++; n++; }
+	return n;
+}
+
+int divs(int a, int b) { return a / b + a % b; }
+
+u8 narrow(u32 x) { return x; }
+
+u32 deep(u32 a, u32 b, u32 c, u32 d) {
+	return ((a + b) * (c + d) + (a - c) * (b - d)) ^ (((a * b) + (c * d)) * ((a + d) * (b + c)) + ((a ^ b) | (c & d)) * ((a << 2) + (d >> 1)));
+}
+
+u32 nest(u32 a) {
+	return (a + (a + (a + (a + (a + (a + (a + 1))))))) * ((a * 2 + 1) * ((a + 3) * ((a + 4) * ((a + 5) * (a + 6)))));
+}
+
+u32 main(void) {
+	u32 fails = 0;
+	u8 c = 250;
+	c = c + 10;
+	if (c != 4) fails = fails + 1;
+	u16 w = 65535;
+	w++;
+	if (w != 0) fails = fails + 2;
+	int x = -7;
+	if (x / 2 != -3) fails = fails + 4;
+	if (x % 2 != -1) fails = fails + 8;
+	if ((x >> 1) != -4) fails = fails + 16;
+	u32 u = 4294967289;
+	if ((u >> 1) != 2147483644) fails = fails + 32;
+	if (!(x < 0)) fails = fails + 64;
+	if (u < 5) fails = fails + 128;
+	if (many(1, 2, 3, 4, 5, 6, 7, 8, -1) != 1+4+9+16+25+36+49+64-9) fails = fails + 256;
+	if (strlen2(msg) != 3) fails = fails + 512;
+	if (gb != 44) fails = fails + 1024;
+	if (gw != 4464) fails = fails + 2048;
+	if (gi + 5 != 0) fails = fails + 4096;
+	if (divs(17, 5) != 5) fails = fails + 8192;
+	if (narrow(513) != 1) fails = fails + 16384;
+	u32 *p = *counter;
+	<<p = 9;
+	(<<p)++;
+	if (counter != 10) fails = fails + 32768;
+	u32 v = deep(3, 5, 7, 11);
+	u32 n = nest(3);
+	u8 *s = "abcdef";
+	u8 *e = s + 4;
+	if (e - s != 4) fails = fails + 65536;
+	if (s[2] != 99) fails = fails + 131072;
+	s = s + 1;
+	if (<<s != 98) fails = fails + 262144;
+	u32 z = 0;
+	u32 y = z else 7;
+	if (y != 7) fails = fails + 524288;
+	if ((1 && 0) || !(2 || 0)) fails = fails + 1048576;
+	if (~0 != 4294967295) fails = fails + 2097152;
+	if (sizeof(u16) != 2) fails = fails + 4194304;
+	u32 i = 0;
+	do { i++; if (i == 5) break; } while (1);
+	if (i != 5) fails = fails + 8388608;
+	return fails;
+}
@@ -0,0 +1,2005 @@
+// exit: 208
+u32 sum(u32 a) {
+	return a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+		+ a
+	;
+}
+u32 main(void) { return sum(1) & 255; }
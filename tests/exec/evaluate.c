@@ -0,0 +1,21 @@
+// exit: 37
+u32 crc(u32 x) {
+	u32 i = 0;
+	while (i < 8) {
+		if (x & 1) x = (x >> 1) ^ 3988292384;
+		else x = x >> 1;
+		i = i + 1;
+	}
+	return x;
+}
+u32 sq(u32 x) { return x * x; }
+u32 table = crc(1);
+u32 arr[sq(3)];
+u32 main(void) {
+	u32 r = 0;
+	switch (table) {
+		case crc(1): r = 1; break;
+		default: r = 2;
+	}
+	return r + sizeof(arr);
+}
@@ -0,0 +1,5 @@
+// exit: 120
+u32 f(u32 v0, u32 v1, u32 v2, int v3) {
+	return (((((((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))) | (((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0)))) & ((((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))) | (((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))))) + (((((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))) | (((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0)))) & ((((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))) | (((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0)))))) * ((((((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))) | (((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0)))) & ((((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))) | (((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))))) + (((((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))) | (((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0)))) & ((((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0))) | (((v1 * v2) - (v3 * v0)) ^ ((v1 * v2) - (v3 * v0)))))));
+}
+u32 main(void) { u8 *a = "xyz"; u32 k = 1; return f(3, 5, 7, -9) + f(k, a[k], a[2], k - 3) + a[f(1,1,1,1) & 1]; }
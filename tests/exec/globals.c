@@ -0,0 +1,12 @@
+// exit: 150
+u32 crc(u32 x) {
+	u32 i = 0;
+	while (i < 8) {
+		if (x & 1) x = (x >> 1) ^ 3988292384;
+		else x = x >> 1;
+		i = i + 1;
+	}
+	return x;
+}
+u32 table = crc(1);
+u32 main(void) { return table & 255; }
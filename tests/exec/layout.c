@@ -0,0 +1,12 @@
+// exit: 188
+soa struct P { u8 a; u32 b; u16 c; };
+struct Q { u8 a; u32 b; u8 c; u16 d; };
+struct P ps[10];
+u32 main(void) {
+	u32 i = 0;
+	while (i < 10) { ps[i].a = i; ps[i].b = i * 1000; ps[i].c = i + 7; i = i + 1; }
+	u32 s = 0;
+	i = 0;
+	while (i < 10) { s = s + ps[i].a + ps[i].b + ps[i].c; i = i + 1; }
+	return (s + sizeof(ps) + sizeof(struct Q)) & 255;
+}
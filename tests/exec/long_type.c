@@ -0,0 +1,23 @@
+// exit: 0
+// a type longer than the buffers that print it
+u32 main(void) {
+	u32
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		****************************************************************************************************
+		p;
+	u32 x = p;
+	return x - x;
+}
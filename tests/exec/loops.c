@@ -0,0 +1,18 @@
+// exit: 44
+u32 g;
+u32 f(u32 a, u32 b) {
+	u32 x = 4;
+	u32 y = x * 2 + 1;
+	if (y == 9) { g = a + b; } else { g = 0 - 1; }
+	u32 i = 0;
+	u32 k = 3;
+	while (i < a) {
+		if (k != 3) k = 100;
+		i = i + (a + b);
+		g = g + (a + b) * k;
+	}
+	u32 dead = a * b * 77;
+	int n = -8;
+	return g + k + (n / 3) + (n % 3) + (n >> 1) + (a < b && b > 0);
+}
+u32 main(void) { return f(5, 7); }
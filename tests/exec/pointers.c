@@ -0,0 +1,16 @@
+// exit: 137
+u32 buf;
+u32 buf2;
+u32 add(u32 a, u32 b) { return a + b; }
+u16 *ptr(void) { return *buf; }
+u32 main(void) {
+	u16 *p = ptr();
+	<<p = 5;
+	p++;
+	<<p = 7;
+	u16 *q = p - 1;
+	u32 s = (1 + add(2, add(3, 4))) * (add(5, 6) + add(add(7, 8), 9 + add(1, 1)));
+	p[0] = p[0] + 1;
+	u32 *r = *buf;
+	return (s + (<<q) + q[1] + (<<r >> 16) + (p > q) + (q == r)) & 255;
+}
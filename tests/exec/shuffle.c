@@ -0,0 +1,20 @@
+// exit: 121
+// native: the VM has no vectors
+u32 main(void) {
+	u8x16 a;
+	u8x16 idx;
+	u32 i = 0;
+	while (i < 16) { a[i] = i * 7 + 1; idx[i] = (i * 5 + 3) ^ (i << 4); i = i + 1; }
+	u8x16 b = shuffle(a, idx);
+	u32x4 w;
+	u32x4 wi;
+	i = 0;
+	while (i < 4) { w[i] = i * 1000 + 17; wi[i] = 3 - i + (i << 3); i = i + 1; }
+	u32x4 c = shuffle(w, wi);
+	u32 s = 0;
+	i = 0;
+	while (i < 16) { s = s * 31 + b[i]; i = i + 1; }
+	i = 0;
+	while (i < 4) { s = s * 31 + c[i]; i = i + 1; }
+	return s % 251;
+}
@@ -0,0 +1,13 @@
+// exit: 55
+soa struct S { u8 c; int a; u16 b; };
+struct S g[5];
+int main(void) {
+	struct S s[4];
+	u16 *p = *s[1].b;
+	<<p = 7;
+	p = p + 1;
+	<<p = 9;
+	g[2].a = 11;
+	int *q = *g[0].a;
+	return s[1].b + s[2].b + q[2] + sizeof(s) + s[3].c;
+}
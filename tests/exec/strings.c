@@ -0,0 +1,6 @@
+// exit: 7
+u8 *a = "hello world";
+u8 *b = "world";
+u8 *c = "hello world";
+u8 *d = "";
+u32 main(void) { return (b - a) + (c == a) + <<d; }
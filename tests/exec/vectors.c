@@ -0,0 +1,8 @@
+// exit: 255
+// native: the VM has no vectors
+u32 main(void) {
+	u8x16 a = (u8x16)3;
+	u8x16 idx = (u8x16)1;
+	u8x16 b = shuffle(a, idx);
+	return movemask(b == a);
+}
@@ -0,0 +1,3 @@
+// exit: 0
+u32 a[4];
+u32 main(void) { u32 i = 0; u32 s = 0; while (i < 4) { s = s + a[i]; i = i + 1; } return s; }
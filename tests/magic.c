@@ -0,0 +1,139 @@
+// the magic numbers of strength reduction, against division: every
+// dividend for divisors that take each path, edge cases and a sample for
+// many others. built by tests/run.sh with every source but main.c and
+// reduce.c, which it includes for its static functions
+
+#include "../src/reduce.c"
+
+#include <stdio.h>
+#include <string.h>
+
+// how divide_unsigned and divide_signed rewrite a division
+struct Division {
+	uint32_t d, magic;
+	int pre, shift;
+	bool wide; // the magic needs 33 bits
+};
+
+static
+struct Division unsigned_division(uint32_t d) {
+	struct Division division = { .d = d };
+
+	bool found = unsigned_magic(d, 0, &division.magic, &division.shift);
+	if (!found && (d & 1) == 0) found = unsigned_magic(d, division.pre = __builtin_ctz(d), &division.magic, &division.shift);
+
+	if (!found) {
+		int l = 32 - __builtin_clz(d - 1);
+		division.magic = (UINT64_C(1) << (32 + l)) / d - (UINT64_C(1) << 32) + 1;
+		division.shift = l - 1;
+		division.wide = true;
+	}
+
+	return division;
+}
+
+static
+uint32_t divide_u(struct Division *division, uint32_t x) {
+	uint32_t d = division->d;
+
+	if (d == 1) return x;
+	if (is_power_of_two(d)) return x >> log2_of(d);
+	if (d > UINT32_C(1) << 31) return x >= d;
+
+	if (!division->wide) return (uint32_t)((uint64_t)(x >> division->pre) * division->magic >> 32) >> division->shift;
+
+	uint32_t t = (uint64_t)x * division->magic >> 32;
+	return (t + ((x - t) >> 1)) >> division->shift;
+}
+
+static
+struct Division signed_division(uint32_t d) {
+	struct Division division = { .d = d };
+	if (d > 1 && d <= INT32_MAX && !is_power_of_two(d)) signed_magic(d, &division.magic, &division.shift);
+	return division;
+}
+
+static
+int32_t divide_s(struct Division *division, int32_t x) {
+	uint32_t d = division->d;
+
+	if (d == 1) return x;
+
+	if (is_power_of_two(d)) {
+		int k = log2_of(d);
+		return (int32_t)(x + (int32_t)((uint32_t)(x >> 31) >> (32 - k))) >> k;
+	}
+
+	int32_t q = (int64_t)x * (int32_t)division->magic >> 32;
+	if ((int32_t)division->magic < 0) q += x;
+
+	return (q >> division->shift) - (x >> 31);
+}
+
+static int failures;
+
+static
+void check(struct Division *u, struct Division *s, uint32_t x) {
+	uint32_t d = u->d;
+
+	if (divide_u(u, x) != x / d && failures++ < 10) {
+		printf("%u / %u: got %u\n", x, d, divide_u(u, x));
+	}
+
+	int32_t y = x;
+	if (d > INT32_MAX || y == INT32_MIN) return;
+
+	if (divide_s(s, y) != y / (int32_t)d && failures++ < 10) {
+		printf("%d / %d: got %d\n", y, (int32_t)d, divide_s(s, y));
+	}
+}
+
+int main(int argc, char **argv) {
+	// every dividend with `all`, which takes minutes, otherwise both ends
+	uint32_t range = argc > 1 && !strcmp(argv[1], "all") ? UINT32_C(1) << 31 : UINT32_C(1) << 24;
+
+	// a 33-bit magic, an even one with a pre-shift, and the largest divisors
+	static const uint32_t exhaustive[] = { 7, 14, 0x7fffffff, 0x80000001 };
+
+	for (unsigned i = 0; i < sizeof exhaustive / sizeof *exhaustive; i++) {
+		struct Division u = unsigned_division(exhaustive[i]), s = signed_division(exhaustive[i]);
+
+		for (uint32_t x = 0; x < range; x++) {
+			check(&u, &s, x), check(&u, &s, ~x);
+		}
+	}
+
+	// near multiples of the divisor, both ends of the range and a sample
+	uint32_t seed = 1;
+
+	for (uint32_t n = 1; n < 50000; n++) {
+		uint32_t divisors[] = { n, -n, n << (n % 32), ((uint32_t)-1 >> (n % 32)) + n % 3 };
+
+		for (int i = 0; i < 4; i++) {
+			uint32_t d = divisors[i];
+			if (d == 0) continue;
+
+			struct Division u = unsigned_division(d), s = signed_division(d);
+			uint32_t top = (uint32_t)-1 / d * d;
+
+			for (uint32_t k = 0; k < 3; k++) {
+				check(&u, &s, top - k), check(&u, &s, top + k);
+				check(&u, &s, d * k - 1), check(&u, &s, d * k);
+				check(&u, &s, INT32_MAX - k), check(&u, &s, INT32_MIN + k);
+				check(&u, &s, (uint32_t)INT32_MAX / d * d - k);
+			}
+
+			for (int k = 0; k < 16; k++) {
+				seed = seed * 1664525 + 1013904223;
+				check(&u, &s, seed);
+			}
+		}
+	}
+
+	if (failures) {
+		printf("magic numbers: %d failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
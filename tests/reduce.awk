@@ -0,0 +1,46 @@
+# the inputs of tests/reduce.c: the same functions of one operand x, named
+# r<i> in reduced.c and p<i> in plain.c, and in tests.h the C function o<i>
+# of each and the table of tests
+function add(c) { if (c >= 1 && c <= 4294967295 && !(c in seen)) { seen[c] = 1; constants[n++] = c } }
+
+BEGIN {
+	srand(seed)
+	n = 0
+	for (c = 1; c <= 40; c++) add(c)
+	for (k = 1; k < 32; k++) { add(2 ^ k); add(2 ^ k - 1); add(2 ^ k + 1); add(3 * 2 ^ (k - 1)) }
+	for (c = 100; c <= 1000000000; c *= 10) add(c)
+	add(641); add(6700417); add(1431655765); add(2863311530); add(4294967294); add(4294967295)
+	for (i = 0; i < 40; i++) add(int(rand() * 4294967296))
+
+	split("u32 int u16 u8", types, " ")
+	split("uint32_t int32_t uint16_t uint8_t", ctypes, " ")
+	split("4294967295 4294967295 65535 255", masks, " ")
+	split("* / %", ops, " ")
+
+	f = 0
+	for (t = 1; t <= 4; t++) for (o = 1; o <= 3; o++) for (form = 0; form < 2; form++) for (i = 0; i < n; i++) {
+		c = constants[i]; type = types[t]; op = ops[o]
+		signed = type == "int"
+		if (signed && c > 2147483647) continue
+
+		operand = form ? "(x + 3)" : "x"
+		body = sprintf("%s %s %.0f", operand, op, c)
+		result = signed ? "int" : "u32"
+
+		printf "%s r%d(%s x) { return %s; }\n", result, f, type, body > "reduced.c"
+		printf "%s p%d(%s x) { return %s; }\n", result, f, type, body > "plain.c"
+
+		# C promotes to int, the compiler computes on 32 bits
+		cx = form ? "((uint32_t)x + 3u)" : "(uint32_t)x"
+		if (!signed)        cexpr = sprintf("%s %s %.0fu", cx, op, c)
+		else if (op == "*") cexpr = sprintf("(int32_t)(%s * %.0fu)", cx, c)
+		else                cexpr = sprintf("(int32_t)%s %s %.0f", cx, op, c)
+
+		printf "uint32_t r%d(uint32_t), p%d(uint32_t);\n", f, f > "tests.h"
+		printf "static uint32_t o%d(uint32_t a) { %s x = a; return %s; }\n", f, ctypes[t], cexpr > "tests.h"
+		table = table sprintf("\t{ r%d, p%d, o%d, %.0fu, %su, \"%s %s\" },\n", f, f, f, c, masks[t], type, body)
+		f++
+	}
+
+	print "static const struct Test tests[] = {\n" table "};" > "tests.h"
+}
@@ -0,0 +1,65 @@
+// strength reduction, against the code it replaces and against C: each
+// generated function is compiled with the pass as r<i> and without it as
+// p<i>, o<i> computes the same in C. tests/run.sh generates them and the
+// table of tests into tests.h with reduce.awk
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct Test {
+	uint32_t (*reduced)(uint32_t), (*plain)(uint32_t), (*expected)(uint32_t);
+	uint32_t constant;
+	uint32_t mask; // of the operand type
+	const char *expression;
+};
+
+#include "tests.h"
+
+static int failures;
+
+static
+void check(const struct Test *test, uint32_t x) {
+	x &= test->mask;
+
+	uint32_t reduced = test->reduced(x), plain = test->plain(x), expected = test->expected(x);
+	if (reduced == expected && plain == expected) return;
+
+	if (failures++ < 10) {
+		printf("%s, x = %u: reduced %u, plain %u, expected %u\n", test->expression, x, reduced, plain, expected);
+	}
+}
+
+int main(void) {
+	uint32_t seed = 1;
+
+	for (unsigned i = 0; i < sizeof tests / sizeof *tests; i++) {
+		const struct Test *test = &tests[i];
+		uint32_t c = test->constant;
+
+		// every u8 and u16
+		if (test->mask <= UINT16_MAX) {
+			for (uint32_t x = 0; x <= test->mask; x++) check(test, x);
+			continue;
+		}
+
+		// near multiples of the constant, both ends of the range and a sample
+		for (uint32_t k = 0; k < 4; k++) {
+			check(test, c * k - 1), check(test, c * k), check(test, c * k + 1);
+			check(test, UINT32_MAX / c * c - k), check(test, UINT32_MAX - k);
+			check(test, INT32_MAX - k), check(test, INT32_MIN + k);
+			check(test, INT32_MAX / c * c - k), check(test, -(INT32_MAX / c * c) + k);
+		}
+
+		for (int k = 0; k < 4096; k++) {
+			seed = seed * 1664525 + 1013904223;
+			check(test, seed);
+		}
+	}
+
+	if (failures) {
+		printf("strength reduction: %d failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
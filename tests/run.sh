@@ -0,0 +1,224 @@
+#!/bin/sh
+# tests of the compiler, run from anywhere: tests/run.sh [compiler]
+#
+# without a compiler src/*.c is built into a temporary directory. prints
+# each failure and exits 1 if there was any.
+
+cd "$(dirname "$0")/.." || exit 1
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+ucc=${1:-}
+if [ -z "$ucc" ]; then
+	ucc=$tmp/ucc
+	${CC:-cc} -std=gnu11 -O2 -pthread src/*.c -o "$ucc" || exit 1
+fi
+
+failures=0
+
+fail() {
+	echo "FAIL: $*"
+	failures=$((failures + 1))
+}
+
+# the exit status of the compiler itself, "$@" are its arguments
+status() {
+	"$ucc" "$@" > /dev/null 2>&1
+	echo $?
+}
+
+
+# every file in errors/ has the errors its first line counts, `// errors: n`,
+# alone or among other inputs. a syntax-only parse reports the same
+
+printf 'u32 main(void) { return 0; }\n' > "$tmp/clean.c"
+[ "$(status "$tmp/clean.c" "$tmp/clean.c")" = 0 ] || fail "clean inputs exit with an error"
+
+for file in tests/errors/*.c; do
+	[ "$(status "$file")" = 1 ] || fail "$file: exit status is not 1"
+	[ "$(status -fsyntax-only "$file")" = 1 ] || fail "$file: exit status is not 1 with -fsyntax-only"
+	[ "$(status "$tmp/clean.c" "$file" "$tmp/clean.c")" = 1 ] || fail "$file: exit status is not 1 among other inputs"
+
+	"$ucc" "$file" > "$tmp/full.txt" 2>&1
+	errors=$(grep -c "error:" "$tmp/full.txt")
+	[ "// errors: $errors" = "$(head -n 1 "$file")" ] || fail "$file: reports $errors errors"
+
+	"$ucc" -fsyntax-only "$file" > "$tmp/syntax.txt" 2>&1
+	cmp -s "$tmp/full.txt" "$tmp/syntax.txt" || fail "$file: -fsyntax-only reports differ from a full parse"
+done
+
+
+# an initialiser that never finishes is an error of its input, the others
+# are still compiled
+
+printf 'u32 spin(u32 x) { while (1) x++; return x; }\nu32 g = spin(1);\n' > "$tmp/spin.c"
+rm -f "$tmp/clean.c.s"
+[ "$(status -emit-asm "$tmp/spin.c" "$tmp/clean.c")" = 1 ] || fail "a runaway initialiser is not an error"
+[ -f "$tmp/clean.c.s" ] || fail "a runaway initialiser stops the other inputs"
+
+
+# so is one the backend rejects, its error is reported with the output of
+# the inputs after it
+
+printf 'u32x4 twice(u32x4 v) { return v + v; }\n' > "$tmp/vectors.c"
+printf 'u32 main(void) { return 0; }\n' > "$tmp/after.c"
+rm -f "$tmp/clean.c.s" "$tmp/after.c.s"
+"$ucc" -emit-asm "$tmp/clean.c" "$tmp/vectors.c" "$tmp/after.c" > "$tmp/backend.txt" 2>&1
+[ $? = 1 ] || fail "an input the backend rejects is not an error"
+[ -f "$tmp/clean.c.s" ] && [ -f "$tmp/after.c.s" ] || fail "an input the backend rejects stops the other inputs"
+grep -q "vectors.c:1:7: function \`twice\` passes vectors" "$tmp/backend.txt" || fail "the backend error is not reported"
+
+
+# every program in exec/ exits with the status its first line gives,
+# `// exit: n`, compiled to assembly, to an object, and run in memory and
+# on the VM unless its second line is `// native: ...`
+
+for file in tests/exec/*.c; do
+	expected=$(head -n 1 "$file" | sed -n 's|^// exit: ||p')
+	[ -n "$expected" ] || { fail "$file: no \`// exit: n\` line"; continue; }
+
+	for mode in asm asm-native obj run vm; do
+		if [ $mode = vm ] && sed -n 2p "$file" | grep -q '^// native:'; then continue; fi
+
+		rm -f "$tmp/prog"
+		case $mode in
+		asm) "$ucc" -emit-asm="$tmp/prog.s" "$file" && ${CC:-cc} "$tmp/prog.s" -o "$tmp/prog" ;;
+		asm-native) "$ucc" -march=native -emit-asm="$tmp/prog.s" "$file" && ${CC:-cc} "$tmp/prog.s" -o "$tmp/prog" ;;
+		obj) "$ucc" -emit-obj="$tmp/prog.o" "$file" && ${CC:-cc} "$tmp/prog.o" -o "$tmp/prog" ;;
+		esac > /dev/null 2>&1
+
+		case $mode in
+		run) actual=$(status -run "$file") ;;
+		vm) actual=$(status -run=vm "$file") ;;
+		*) [ -x "$tmp/prog" ] && { "$tmp/prog"; actual=$?; } || actual="no program" ;;
+		esac
+
+		[ "$actual" = "$expected" ] || fail "$file: exits with $actual, not $expected ($mode)"
+	done
+done
+
+
+# the JIT runs a chain deeper than exec/chain.c as the VM does, the code
+# generator recurses once per operator
+
+{ echo 'u32 main(void) {'; echo '	u32 a = 1;'; echo '	return (a'; seq 4999 | sed 's/.*/		+ a/'; echo '	) & 255;'; echo '}'; } > "$tmp/deep.c"
+[ "$(status -run "$tmp/deep.c")" = "$(status -run=vm "$tmp/deep.c")" ] || fail "a 5000-term chain runs differently in memory"
+
+
+# a saved snapshot dumps as the compile that saved it did, warnings aside,
+# however deep its expressions. one whose declarations point past its end
+# is rejected
+
+for file in tests/exec/*.c "$tmp/deep.c"; do
+	"$ucc" -fsave-ast="$tmp/ast" "$file" 2>&1 | grep -v "warning: " > "$tmp/saved.txt"
+	"$ucc" -fdump-ast="$tmp/ast" > "$tmp/dumped.txt" 2>&1 || fail "$file: the snapshot does not load"
+	cmp -s "$tmp/saved.txt" "$tmp/dumped.txt" || fail "$file: the snapshot dumps differently"
+done
+
+printf '\377\377\377\177' | dd of="$tmp/ast" bs=1 seek=28 conv=notrunc 2> /dev/null
+[ "$(status -fdump-ast="$tmp/ast")" = 1 ] || fail "a corrupt snapshot is not rejected"
+
+
+# a program compiles the same with its header precompiled. one whose macro
+# name or parameter index points outside the header is rejected
+
+printf '#define SQ(x) ((x) * (x))\n#define TEN 10\nu32 ten(void) { return TEN; }\n' > "$tmp/header.h"
+printf 'u32 main(void) { return SQ(3) + ten(); }\n' > "$tmp/main.c"
+cat "$tmp/header.h" "$tmp/main.c" > "$tmp/whole.c"
+
+"$ucc" -emit-pch="$tmp/header.pch" "$tmp/header.h" || fail "the header does not precompile"
+[ "$(status -include-pch="$tmp/header.pch" -run "$tmp/main.c")" = "$(status -run "$tmp/whole.c")" ] ||
+	fail "a precompiled header changes the program"
+
+# overwrites 4 bytes of the header at the offset in the word at $1, plus $2
+corrupt() {
+	at=$(($(od -An -tu4 -j "$1" -N 4 "$tmp/header.pch") + $2))
+	cp "$tmp/header.pch" "$tmp/corrupt.pch"
+	printf '\377\377\377\177' | dd of="$tmp/corrupt.pch" bs=1 seek="$at" conv=notrunc 2> /dev/null
+	status -include-pch="$tmp/corrupt.pch" "$tmp/main.c"
+}
+
+[ "$(corrupt 24 0)" = 1 ] || fail "a macro name outside the header is not rejected"
+[ "$(corrupt 44 0)" = 1 ] || fail "a parameter index beyond the macro's is not rejected"
+[ "$(corrupt 16 4)" = 1 ] || fail "a file name outside the header is not rejected"
+
+
+# -watch reports each version of its input as a full parse would, parsing
+# again only the definitions that changed
+
+watched=$tmp/watched.c
+printf 'u32 sq(u32 x) { return x * x; }\nu32 twice(u32 x) { return x + x; }\n' > "$watched"
+printf 'u32 main(void) { return sq(3) + twice(2); }\n' >> "$watched"
+
+# until the watcher has reported $1 versions
+reports() {
+	for _ in $(seq 50); do
+		[ "$(grep -c reparsed "$tmp/watch.txt")" -ge "$1" ] && return
+		sleep 0.1
+	done
+}
+
+"$ucc" -watch "$watched" > "$tmp/watch.txt" 2>&1 &
+watcher=$!
+
+reports 1
+sed -i 's/x + x/x + y/' "$watched"
+"$ucc" "$watched" > "$tmp/full.txt" 2>&1
+reports 2
+sed -i 's/x + y/x + x/' "$watched"
+reports 3
+kill $watcher
+
+{ echo "0 errors, 3 definitions reparsed"; cat "$tmp/full.txt"; echo "1 errors, 1 definitions reparsed"
+  echo "0 errors, 1 definitions reparsed"; } > "$tmp/expected.txt"
+sed 's/ in [0-9.]* ms$//' "$tmp/watch.txt" | cmp -s - "$tmp/expected.txt" || fail "-watch reports differ"
+
+# constants that call a function run it again when its body changes, and
+# see the declarations above them
+
+watched=$tmp/constants.c
+printf 'u32 f(u32 x) { return x + 1; }\nu32 t = f(1);\nu32 a[f(1)];\n' > "$watched"
+printf 'u32 main(void) { return t + sizeof(a); }\n' >> "$watched"
+
+"$ucc" -watch "$watched" > "$tmp/watch.txt" 2>&1 &
+watcher=$!
+
+reports 1
+sed -i 's|x + 1|x / 0|' "$watched"
+"$ucc" "$watched" > "$tmp/full.txt" 2>&1
+reports 2
+sed -i 's|x / 0|x + 1|' "$watched"
+reports 3
+kill $watcher
+
+{ echo "0 errors, 4 definitions reparsed"; cat "$tmp/full.txt"; echo "3 errors, 3 definitions reparsed"
+  echo "0 errors, 4 definitions reparsed"; } > "$tmp/expected.txt"
+sed 's/ in [0-9.]* ms$//' "$tmp/watch.txt" | cmp -s - "$tmp/expected.txt" || fail "-watch reports of constants differ"
+
+
+# the magic numbers of strength reduction against division, then every
+# function reduce.awk generates with and without the pass against C.
+# `tests/magic all` checks every dividend, which takes minutes
+
+sources=$(ls src/*.c | grep -v -e main.c -e reduce.c)
+${CC:-cc} -std=gnu11 -O2 -pthread tests/magic.c $sources -o "$tmp/magic" || exit 1
+"$tmp/magic" || fail "magic numbers"
+
+(cd "$tmp" && awk -v seed=1 -f "$OLDPWD/tests/reduce.awk") || exit 1
+"$ucc" -emit-asm="$tmp/reduced.s" "$tmp/reduced.c" || fail "reduced.c does not compile"
+"$ucc" -fno-strength-reduce -emit-asm="$tmp/plain.s" "$tmp/plain.c" || fail "plain.c does not compile"
+
+if ${CC:-cc} -I"$tmp" tests/reduce.c "$tmp/reduced.s" "$tmp/plain.s" -o "$tmp/reduce"; then
+	"$tmp/reduce" || fail "strength reduction"
+else
+	fail "the strength reduction test does not link"
+fi
+
+
+if [ $failures -gt 0 ]; then
+	echo "$failures failed"
+	exit 1
+fi
+
+echo "all passed"